@@ -0,0 +1,114 @@
+#ifndef JSE_ASYNC_LOADER_H
+#define JSE_ASYNC_LOADER_H
+
+#include <atomic>
+#include <future>
+#include <list>
+#include <memory>
+#include <functional>
+
+#include "system/SystemTypes.hpp"
+#include "system/ThreadPool.hpp"
+#include "engine/Updateable.hpp"
+
+/*
+=========================================
+ Background loading
+
+ Files are parsed and decoded on the thread pool, the GPU side
+ is queued and done by Update() on the render thread, limited
+ by a per-frame byte and time budget. Callbacks are invoked
+ from Update() as well.
+=========================================
+*/
+
+namespace jse {
+
+	class Scene;
+	class Texture;
+	class LoadRequest;
+
+	enum LoadState
+	{
+		LoadState_Queued,
+		LoadState_Decoding,
+		LoadState_Uploading,
+		LoadState_Done,
+		LoadState_Failed,
+		LoadState_LastEnum
+	};
+
+	typedef std::shared_ptr<LoadRequest> LoadHandle;
+	typedef std::function<void(const LoadHandle&)> LoadCallback;
+
+	const size_t kDefaultUploadBytesPerFrame = 4 * 1024 * 1024;
+	const float kDefaultUploadMsPerFrame = 2.0f;
+
+	class LoadRequest
+	{
+		friend class AsyncLoader;
+	public:
+		LoadRequest(const String& aFileName) : mFileName(aFileName), mFuture(mPromise.get_future().share()) {}
+		virtual ~LoadRequest() {}
+
+		inline const String& GetFileName() const { return mFileName; }
+		inline LoadState GetState() const { return mState.load(); }
+		inline bool IsFinished() const { return GetState() >= LoadState_Done; }
+		inline bool Succeeded() const { return GetState() == LoadState_Done; }
+		float GetProgress() const;
+
+		// Ready when the request finished, do not wait on it from the render thread
+		inline std::shared_future<bool> GetFuture() const { return mFuture; }
+
+	protected:
+		/* worker thread */
+		virtual bool Decode() = 0;
+
+		/* render thread */
+		virtual void BeginUpload() {}
+		virtual size_t UploadNext() = 0;
+		virtual bool IsUploadDone() const = 0;
+		virtual float GetUploadProgress() const = 0;
+		virtual bool EndUpload() { return true; }
+
+	private:
+		String mFileName;
+		std::atomic<LoadState> mState{ LoadState_Queued };
+		bool mUploadStarted{ false };
+		float mReportedProgress{ 0.0f };
+		LoadCallback mOnProgress;
+		LoadCallback mOnComplete;
+		std::promise<bool> mPromise;
+		std::shared_future<bool> mFuture;
+	};
+
+	class AsyncLoader : public Updateable
+	{
+	public:
+		AsyncLoader(ThreadPool& aPool = GetDefaultThreadPool());
+		~AsyncLoader();
+
+		void SetUploadBudget(const size_t aBytesPerFrame, const float aMsPerFrame);
+
+		// aScene is filled in and compiled in the background, it must not be used until the handle finished
+		LoadHandle LoadScene(Scene* aScene, const String& aFileName, LoadCallback aOnProgress = nullptr, LoadCallback aOnComplete = nullptr);
+		LoadHandle LoadTexture(Texture* aTexture, const String& aFileName, LoadCallback aOnProgress = nullptr, LoadCallback aOnComplete = nullptr);
+
+		// Drains the upload queue within the budget, call once per frame on the render thread
+		void Update(float aTimeStep) override;
+
+		inline size_t GetNumPending() const { return mRequests.size(); }
+		inline size_t GetLastFrameBytes() const { return mLastFrameBytes; }
+
+	private:
+		LoadHandle Submit(LoadHandle aRequest, LoadCallback aOnProgress, LoadCallback aOnComplete);
+		void Finish(const LoadHandle& aRequest, const bool aResult);
+
+		ThreadPool& mPool;
+		std::list<LoadHandle> mRequests;
+		size_t mBudgetBytes;
+		float mBudgetMs;
+		size_t mLastFrameBytes;
+	};
+}
+#endif
@@ -0,0 +1,114 @@
+#ifndef JSE_TEXTURE_STREAMER_H
+#define JSE_TEXTURE_STREAMER_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "system/SystemTypes.hpp"
+#include "system/ThreadPool.hpp"
+#include "graphics/GraphicsTypes.hpp"
+#include "graphics/Bitmap.hpp"
+#include "engine/Updateable.hpp"
+
+/*
+=========================================
+ Mip level texture streaming
+
+ Streamed textures start with their small levels only (up to
+ kStreamBaseSize), higher levels are loaded when the texture is
+ requested at a larger screen size. Requests are made every frame
+ before Update(), which then uploads finished loads, evicts the top
+ levels of the least recently used textures when the resident size
+ would exceed the budget and starts new loads. Files are read and
+ decoded on the thread pool; a promotion reloads the file and keeps
+ the levels from the wanted one down.
+=========================================
+*/
+
+namespace jse {
+
+	class Texture;
+	class GraphicsDriver;
+
+	const size_t kDefaultStreamingBudget = 256 * 1024 * 1024;
+	const size_t kDefaultStreamUploadBytesPerFrame = 8 * 1024 * 1024;
+	const int kStreamBaseSize = 64;
+	const int kMaxStreamJobs = 4;
+
+	class TextureStreamer : public Updateable
+	{
+	public:
+		TextureStreamer(GraphicsDriver* aDriver, ThreadPool& aPool = GetDefaultThreadPool());
+		~TextureStreamer();
+
+		// Resident bytes of all streamed textures are kept below aBytes (the base levels are never evicted)
+		void SetBudget(const size_t aBytes);
+		void SetUploadBudget(const size_t aBytesPerFrame);
+
+		// Creates a texture owned by the streamer, usable once its base levels are uploaded
+		Texture* Load(const String& aFileName);
+
+		// aPixels: the largest on-screen size the texture is drawn at this frame
+		void RequestScreenSize(Texture* aTexture, const float aPixels);
+		void RequestBounds(Texture* aTexture, const Vector3f& aCenter, const float aRadius, const Vector3f& aViewPos, const Matrix& aProj, const int aViewportHeight);
+
+		// Projected diameter in pixels of a bounding sphere with a perspective projection
+		static float GetProjectedSize(const Vector3f& aCenter, const float aRadius, const Vector3f& aViewPos, const Matrix& aProj, const int aViewportHeight);
+
+		// Uploads, evicts and starts loads, call once per frame on the render thread
+		void Update(float aTimeStep) override;
+
+		inline size_t GetResidentBytes() const { return mResidentBytes; }
+		inline int GetNumPendingJobs() const { return mNumJobs; }
+		// First resident level of the full chain, -1 if nothing is loaded yet
+		int GetResidentMip(const Texture* aTexture) const;
+
+	private:
+		struct StreamJob_t
+		{
+			int firstMip;		// -1: base levels of the first load
+			i64 expectedBytes;	// change of the resident size once uploaded
+			int fullSize{ 0 };	// larger side of level 0
+			bool ok{ false };
+			std::atomic<bool> done{ false };
+			Bitmap bitmap;
+			std::vector<size_t> levelBytes;
+		};
+
+		struct StreamedTexture_t
+		{
+			Texture* texture;
+			String fileName;
+			std::vector<size_t> levelBytes;	// per level of the full chain, all images
+			int fullSize{ 0 };
+			int baseMip{ -1 };				// first level of the always resident set
+			int residentMip{ -1 };
+			int wantedMip{ -1 };
+			float requestedPixels{ 0.0f };
+			u64 lastUsed{ 0 };
+			bool failed{ false };
+			std::shared_ptr<StreamJob_t> job;
+		};
+
+		void StartJob(StreamedTexture_t* aTex, const int aFirstMip);
+		bool FinishJob(StreamedTexture_t* aTex, size_t& aBytes);
+		bool EvictOne(const StreamedTexture_t* aKeep);
+		bool FitsBudget(const i64 aGrowth) const;
+		size_t GetBytesFrom(const StreamedTexture_t* aTex, const int aMip) const;
+		int GetMipForPixels(const StreamedTexture_t* aTex, const float aPixels) const;
+
+		GraphicsDriver* mDriver;
+		ThreadPool& mPool;
+		std::vector<std::unique_ptr<StreamedTexture_t>> mTextures;
+		std::unordered_map<const Texture*, StreamedTexture_t*> mByTexture;
+		size_t mBudget;
+		size_t mUploadBudget;
+		size_t mResidentBytes;
+		i64 mPendingBytes;
+		int mNumJobs;
+		u64 mFrame;
+	};
+}
+#endif
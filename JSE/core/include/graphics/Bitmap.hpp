@@ -3,6 +3,7 @@
 
 #include <vector>
 
+#include "system/SystemTypes.hpp"
 #include "graphics/GraphicsTypes.hpp"
 
 namespace jse {
@@ -14,37 +15,60 @@ namespace jse {
 		~BitmapData();
 
 		void SetData(const unsigned char* aData, const int aSize);
+		void Resize(const int aSize);
+
+		inline unsigned char* GetData() { return mData.data(); }
+		inline const unsigned char* GetData() const { return mData.data(); }
+		inline int GetSize() const { return int(mData.size()); }
 	private:
-		unsigned char* mData;
-		int mSize;
+		ByteVector mData;
 	};
 
+	/*
+	 Image container: aNumImages images (cube faces, array layers) each
+	 with aNumMipmaps levels. Level 0 is GetSizeX() x GetSizeY(), every
+	 further level halves both sizes (min. 1).
+	*/
 	class Bitmap
 	{
 	public:
 		Bitmap();
 		~Bitmap();
 		void Init(const int aNumImages, const int aNumMipmaps);
+		// Changes the number of levels, data of the levels kept is preserved
+		void SetNumMipmaps(const int aNumMipmaps);
+		// Drops the aCount largest levels, the next level becomes level 0
+		void RemoveTopMipmaps(const int aCount);
 		BitmapData* GetData(const int aImage, const int aMipLevel);
+		const BitmapData* GetData(const int aImage, const int aMipLevel) const;
 		void SetSize(const int aSizeX, const int aSizeY, const int aDepth);
 
 		inline int GetSizeX() const { return mSizeX; }
 		inline int GetSizeY() const { return mSizeY; }
 		inline int GetDepth() const { return mDepth; }
+		inline int GetMipSizeX(const int aMipLevel) const { return mSizeX >> aMipLevel > 0 ? mSizeX >> aMipLevel : 1; }
+		inline int GetMipSizeY(const int aMipLevel) const { return mSizeY >> aMipLevel > 0 ? mSizeY >> aMipLevel : 1; }
 		inline PixelFormat GetPixelFormat() const { return mPixelFormat; }
 		inline void SetPixelFormat(const PixelFormat a0) { mPixelFormat = a0; }
 		inline bool IsCompressed() const { return mIsCompressed; }
 		inline void SetCompressed(bool a0) { mIsCompressed = a0; }
+		inline bool IsSRGB() const { return mIsSRGB; }
+		inline void SetSRGB(bool a0) { mIsSRGB = a0; }
 		inline int GetBytesPerPixel() const { return mBytesPerPixel; }
 		inline void SetBytesPerPixel(const int a0) { mBytesPerPixel = a0; }
 		inline int GetNumImages() const { return mNumImages; }
+		inline int GetNumMipmaps() const { return mNumMipmaps; }
 		inline void SetFileName(const String& aFileName) { mFilename = aFileName; }
 		inline const String& GetFileName() const { return mFilename;}
 
+		// Size of all images and levels
+		size_t GetTotalSize() const;
+
 	private:
 		std::vector<BitmapData> mImages;
 		String mFilename;
 		bool mIsCompressed;
+		bool mIsSRGB;
 		int mSizeX, mSizeY, mDepth;
 		PixelFormat mPixelFormat;
 		int mBytesPerPixel;
@@ -52,5 +76,23 @@ namespace jse {
 		int mNumMipmaps;
 	};
 
+	bool IsCompressedPixelFormat(const PixelFormat aFormat);
+
+	// Bytes per 4x4 block for block compressed formats, 0 otherwise
+	int GetPixelFormatBlockSize(const PixelFormat aFormat);
+
+	// Bytes of one aSizeX x aSizeY image in a block compressed format
+	size_t GetCompressedImageSize(const PixelFormat aFormat, const int aSizeX, const int aSizeY);
+
+	/*
+	 Reverses the row order of every image and level. Block compressed
+	 data is flipped by swapping the block rows and the pixel rows inside
+	 each block, that works for BC1-BC5 levels whose height is a multiple
+	 of 4 or smaller than 4. BC1, BC3 and BC5 levels of other heights are
+	 decoded, flipped and encoded again (lossy). Returns false and leaves
+	 the bitmap unchanged for BC6H, BC7 and BC2 / BC4 levels of such
+	 heights.
+	*/
+	bool FlipBitmapVertically(Bitmap& aBitmap);
 }
-#endif
\ No newline at end of file
+#endif
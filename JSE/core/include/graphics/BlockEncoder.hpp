@@ -0,0 +1,64 @@
+#ifndef JSE_BLOCK_ENCODER_H
+#define JSE_BLOCK_ENCODER_H
+
+#include "system/SystemTypes.hpp"
+#include "system/Cpu.hpp"
+#include "graphics/Bitmap.hpp"
+
+/*
+=========================================
+ CPU block compression
+
+ BC1 (PixelFormat_DXT1) for opaque color, BC3 (PixelFormat_DXT5)
+ for color with alpha and BC5 for two channel data such as tangent
+ space normal maps (R, G stored, Z rebuilt in the shader).
+ BC1 always uses the 4 color mode: the 3 color mode would decode
+ to transparent black with the RGBA DXT1 GL formats.
+=========================================
+*/
+
+namespace jse {
+
+	enum BlockQuality
+	{
+		BlockQuality_Fast,		// bounding box endpoints
+		BlockQuality_Normal,	// principal axis endpoints
+		BlockQuality_High,		// principal axis + least squares refinement, endpoint search for alpha
+		BlockQuality_LastEnum
+	};
+
+	struct BlockEncodeParams_t
+	{
+		PixelFormat format{ PixelFormat_DXT1 };		// DXT1, DXT5 or BC5
+		BlockQuality quality{ BlockQuality_Normal };
+		bool computeError{ true };					// fill in BlockEncodeStats_t::rmse/psnr
+		SimdLevel simd{ SimdLevel_LastEnum };		// LastEnum: best the CPU supports
+	};
+
+	// PSNR reported for a lossless encode
+	const double kBlockMaxPsnr = 99.0;
+
+	struct BlockEncodeStats_t
+	{
+		double rmse{};			// over the encoded channels of every level, 0..255 scale
+		double psnr{};			// dB, kBlockMaxPsnr if rmse is 0, 0 without computeError
+		double encodeMs{};
+		size_t numBlocks{};
+	};
+
+	/*
+	 Encodes every image and mip level of an uncompressed 8 bit L, LA,
+	 RGB or RGBA bitmap into aDst. Block rows are encoded in parallel on
+	 the default thread pool, partial edge blocks repeat the last row
+	 and column. Rows are kept in memory order, so GL order input stays
+	 upload ready.
+	*/
+	bool EncodeBitmap(const Bitmap& aSrc, Bitmap& aDst, const BlockEncodeParams_t& aParams, BlockEncodeStats_t* aStats = nullptr);
+
+	// Decodes a BC1, BC3 or BC5 bitmap into RGBA8 in aDst (BC5: R, G, 0, 255). aDst may alias aSrc
+	bool DecodeBitmap(const Bitmap& aSrc, Bitmap& aDst);
+
+	BlockQuality GetBlockQuality(const String& aName);
+	const char* GetBlockQualityName(const BlockQuality aQuality);
+}
+#endif
@@ -56,35 +56,6 @@ namespace jse {
 		TestResult testIntersection(const BoundingBox& box) const;
 		//TestResult testIntersection( shared_ptr<const BoundingSphere> sphere ) const;
 	};
-
-	class Frustum : public BoundingVolume
-	{
-	public:
-
-		enum Plane
-		{
-			PLANE_BACK,
-			PLANE_FRONT,
-			PLANE_RIGHT,
-			PLANE_LEFT,
-			PLANE_TOP,
-			PLANE_BOTTOM
-		};
-
-	public:
-
-		Frustum(const mat4& viewMatrix, const mat4& projectionMatrix);
-
-		const vec4& getPlane(const int plane) const;
-
-		TestResult testIntersection(const vec3& point) const;
-		TestResult testIntersection(const BoundingBox& box) const;
-		//TestResult testIntersection( std::shared_ptr<const BoundingSphere> sphere ) const;
-
-	protected:
-
-		vec4 m_planes[6];
-	};
 }
 
 #endif
@@ -0,0 +1,34 @@
+#ifndef JSE_DDS_FILE_H
+#define JSE_DDS_FILE_H
+
+#include "system/SystemTypes.hpp"
+#include "graphics/Bitmap.hpp"
+
+/*
+=========================================
+ DDS container
+
+ Loading handles uncompressed 8 bit per channel images (L8, RGB8,
+ RGBA8), the legacy DXT1-5/ATI1/ATI2 FourCCs and DX10 headers with
+ BC1-BC7, including mip chains and cube maps.
+ Files store the top row first like every other DDS writer, bitmaps
+ are in OpenGL order (bottom row first), so both directions flip the
+ rows (and the rows inside BC blocks, see FlipBitmapVertically).
+ Writers that encode blocks themselves flip before encoding and pass
+ aTopDown. BC6H / BC7 cannot be flipped, they are loaded as stored and
+ not written.
+=========================================
+*/
+
+namespace jse {
+
+	const u32 kDdsMagic = 0x20534444; // "DDS "
+	const char* const kDdsFileExt = ".dds";
+
+	// Writes every mip level of a single 8 bit L, RGB, RGBA or block compressed image.
+	// aTopDown: the rows of aBitmap are already top row first, otherwise they are flipped
+	// and the write fails if they cannot be
+	bool DdsFile_Write(const String& aFileName, const Bitmap& aBitmap, const bool aTopDown = false);
+	bool DdsFile_Load(const String& aFileName, Bitmap& aBitmap);
+}
+#endif
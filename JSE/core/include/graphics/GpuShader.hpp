@@ -2,6 +2,7 @@
 #define JSE_GPU_SHADER_H
 
 #include <memory>
+#include <vector>
 #include "graphics/GraphicsTypes.hpp"
 
 /*
@@ -40,6 +41,57 @@ uniform vec3 g_CameraDir
 */ 
 namespace jse {
 
+	/*
+	 Reflection of a linked program, filled after every successful link or
+	 binary load. Members of arrays of structs are listed per element with
+	 their GLSL names, e.g. "lights[1].diffuse".
+	*/
+	struct ShaderUniform_t
+	{
+		String name;
+		ShaderDataType type;
+		int arraySize;
+		int offset;			// in the block, -1 for the default block
+		int arrayStride;
+		int matrixStride;
+		int location;		// default block only, -1 otherwise
+	};
+
+	struct ShaderUniformBlock_t
+	{
+		String name;
+		int index;
+		int dataSize;
+		int binding;
+		std::vector<ShaderUniform_t> members;
+	};
+
+	struct ShaderReflection_t
+	{
+		std::vector<ShaderUniformBlock_t> blocks;
+		std::vector<ShaderUniform_t> samplers;
+		std::vector<ShaderUniform_t> uniforms;	// default block, without samplers
+
+		inline const ShaderUniformBlock_t* FindBlock(const String& aName) const
+		{
+			for (const auto& it : blocks)
+			{
+				if (it.name == aName)
+					return &it;
+			}
+
+			return nullptr;
+		}
+	};
+
+	// Where a CPU struct puts a block member, see ShaderManager::RegisterUniformLayout
+	struct UniformLayoutMember_t
+	{
+		const char* name;
+		ShaderDataType type;
+		size_t offset;
+	};
+
 	class GpuShaderStage
 	{
 	public:
@@ -47,39 +99,63 @@ namespace jse {
 		GpuShaderStage(const GpuShaderStageType aStageTye, const String& aName) :
 			mStage(aStageTye),
 			mName(aName),
-			mCompiled(false) {};
+			mCompiled(false),
+			mSubmitted(false) {};
 
 		virtual ~GpuShaderStage() {};
 
 		GpuShaderStageType GetStageType() const { return mStage; }
 		inline void SetSource(const String& aSource) { mSource = aSource; }
+		inline const String& GetSource() const { return mSource; }
 		inline bool isCompiled() const { return mCompiled; }
+		inline const String& GetName() const { return mName; }
+
+		// Compile = Submit + Finish. Submit hands the source to the driver and returns,
+		// IsReady polls without waiting, Finish waits and checks the result.
 		virtual bool Compile() = 0;
+		virtual bool Submit() = 0;
+		virtual bool IsReady() = 0;
+		virtual bool Finish() = 0;
 		virtual void Delete() = 0;
 	protected:
 		GpuShaderStageType mStage;
 		String mSource{};
 		String mName;
 		bool mCompiled;
+		bool mSubmitted;
 	};
 
 	class GpuShader
 	{
 	public:
-		GpuShader() : mCompiled(false) {}
+		GpuShader() : mCompiled(false), mSubmitted(false) {}
 		virtual ~GpuShader() {};
 		virtual void AddStage(const GpuShaderStageType aStage, const String& aSourceName, const String& aName) = 0;
 		virtual void AddStage(GpuShaderStage* aShader) = 0;
+		// Same split as GpuShaderStage: Submit compiles the stages and links without
+		// waiting on the driver, the result is only checked by Finish
 		virtual bool Compile() = 0;
+		virtual bool Submit() = 0;
+		virtual bool IsReady() = 0;
+		virtual bool Finish() = 0;
 		virtual void Delete() = 0;
 		inline bool isCompiled() const { return mCompiled; }
+		inline bool isSubmitted() const { return mSubmitted; }
+
+		// Driver specific image of the linked program, LoadBinary fails when the driver rejects it
+		virtual bool GetBinary(ByteVector& aData) = 0;
+		virtual bool LoadBinary(const ByteVector& aData) = 0;
 
 		virtual void Use() = 0;
 
 		virtual void SetFloat(const String& aName, const float aVal) = 0;
 		virtual void SetInt(const String& aName, const int aVal) = 0;
 		virtual void SetFloatv(const String& aName, const size_t aSize, const float* aVal) = 0;
+		// Program state, set once after the link; the program need not be in use
 		virtual void BindUniformBlock(const String& aName, const int aBindingPoint) = 0;
+		virtual void SetSamplerUnit(const String& aName, const TextureUnit aUnit) = 0;
+
+		inline const ShaderReflection_t& GetReflection() const { return mReflection; }
 		
 		virtual void SetVector3(const String&, const float*) = 0;
 		virtual void SetVector4(const String&, const float*) = 0;
@@ -91,6 +167,8 @@ namespace jse {
 		*/
 	protected:
 		bool mCompiled;
+		bool mSubmitted;
+		ShaderReflection_t mReflection;
 	};
 
 }
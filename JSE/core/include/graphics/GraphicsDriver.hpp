@@ -41,6 +41,9 @@ namespace jse
 
         virtual int GetCaps(GraphicsCaps aType) const = 0;
 
+        // Vendor, renderer and version of the driver, changes when compiled programs may no longer load
+        virtual String GetDeviceString() const = 0;
+
         virtual bool GetFullScreenEnabled() const = 0;
 
         virtual void SetVSyncEnabled(int aEnabled, bool aAdaptiv = false) = 0;
@@ -97,6 +100,9 @@ namespace jse
 
         virtual Texture* CreateTexture() = 0;
         virtual void SetActiveTexture(const TextureUnit a0) = 0;
+        // Sampler objects override the sampling state of the texture bound to aUnit, cached by state
+        virtual void BindSampler(const TextureUnit aUnit, const SamplerState_t& aState) = 0;
+        virtual void UnBindSampler(const TextureUnit aUnit) = 0;
         virtual void UnBindBuffer(const BufferTarget aTarget) const = 0;
         virtual void UseShader(GpuShader*) const = 0;
 
@@ -80,6 +80,7 @@ namespace jse {
 		TextureType_2D,
 		TextureType_3D,
 		TextureType_CubeMap,
+		TextureType_2DArray,
 		TextureType_LastEnum
 	};
 
@@ -114,6 +115,18 @@ namespace jse {
 		TextureParam_LastEnum
 	};
 
+	// Sampling state kept apart from the texture, see GraphicsDriver::BindSampler
+	struct SamplerState_t
+	{
+		TextureFilter minFilter{ TextureFilter_Linear_Mipmap_Linear };
+		TextureFilter magFilter{ TextureFilter_Linear };
+		TextureWrapParam wrapS{ TextureWrapParam_Repeat };
+		TextureWrapParam wrapT{ TextureWrapParam_Repeat };
+		TextureWrapParam wrapR{ TextureWrapParam_Repeat };
+
+		inline u32 GetKey() const { return u32(minFilter) | u32(magFilter) << 4 | u32(wrapS) << 8 | u32(wrapT) << 12 | u32(wrapR) << 16; }
+	};
+
 	enum VertexBufferElement
 	{
 		VertexBufferElement_Position,
@@ -170,16 +183,35 @@ namespace jse {
 		ShaderStage_LastEnum
 	};
 
+	// Uniform types as seen by shader reflection
+	enum ShaderDataType
+	{
+		ShaderDataType_Float,
+		ShaderDataType_Vec2,
+		ShaderDataType_Vec3,
+		ShaderDataType_Vec4,
+		ShaderDataType_Int,
+		ShaderDataType_UInt,
+		ShaderDataType_Bool,
+		ShaderDataType_Mat3,
+		ShaderDataType_Mat4,
+		ShaderDataType_Sampler,
+		ShaderDataType_Other,
+		ShaderDataType_LastEnum
+	};
+
 	enum VertexAttribType
 	{
 		VtxAttribType_Float,
 		VtxAttribType_UByte,
 		VtxAttribType_UInt,
+		VtxAttribType_UByteInt,		// integer attribute in the shader (e.g. joint indices)
 		VtxAttribType_LastEnum
 	};
 
-	const int VertexAttribSizes[] = {4, 1, 4, 0};
-	const bool VertexAttribNormalize[] = { false, true , false, false };
+	const int VertexAttribSizes[] = {4, 1, 4, 1, 0};
+	const bool VertexAttribNormalize[] = { false, true , false, false, false };
+	const bool VertexAttribInteger[] = { false, false, false, true, false };
 
     enum GpuProgramFormat {
         GpuProgramFormat_GLSL,
@@ -214,6 +246,10 @@ namespace jse {
 		PixelFormat_LuminanceAlpha32,
 		PixelFormat_RGB32,
 		PixelFormat_RGBA32,
+		PixelFormat_BC4,
+		PixelFormat_BC5,
+		PixelFormat_BC6H,
+		PixelFormat_BC7,
 		PixelFormat_LastEnum,
 	};
 
@@ -226,6 +262,8 @@ namespace jse {
 		GraphicCaps_TextureCompression_DXTC,
 		GraphicCaps_RenderToTexture,
 		GraphicCaps_MaxAnisotropicFiltering,
+		GraphicsCaps_ProgramBinaryFormats,
+		GraphicsCaps_UniformBufferOffsetAlignment,
 		GraphicsCaps_LastEnum
     };
 
@@ -269,6 +307,7 @@ namespace jse {
 		BufferTarget_Index,
 		BufferTarget_Uniform,
 		BufferTarget_Query,
+		BufferTarget_PixelUnpack,
 		BufferTarget_LastEnum
 	};
 
@@ -321,6 +360,8 @@ namespace jse {
 	{
 		AnimationTrackType_Position,
 		AnimationTrackType_Rotation,
+		AnimationTrackType_Scale,
+		AnimationTrackType_Weight,		// morph target weight in v.x
 		AnimationTrackType_LastEnum
 	};
 
@@ -0,0 +1,25 @@
+#ifndef JSE_KTX2_FILE_H
+#define JSE_KTX2_FILE_H
+
+#include "system/SystemTypes.hpp"
+#include "graphics/Bitmap.hpp"
+
+/*
+=========================================
+ KTX2 container
+
+ Non-supercompressed files with BC1-BC7 or 8 bit R/RGB/RGBA
+ formats, all layers, faces and mip levels are loaded.
+ Basis Universal / zstd supercompressed files are rejected.
+ The KTXorientation key decides if the rows are flipped into OpenGL
+ order (bottom row first), without it the top row is stored first.
+=========================================
+*/
+
+namespace jse {
+
+	const char* const kKtx2FileExt = ".ktx2";
+
+	bool Ktx2File_Load(const String& aFileName, Bitmap& aBitmap);
+}
+#endif
@@ -16,6 +16,8 @@ namespace jse {
 			specularIntesity = 0.0f;
 			alpha = 1.0f;
 			type = MaterialType_Diffuse;
+			textureArray = -1;
+			textureLayer = -1;
 		}
 
 		MaterialType type;
@@ -24,6 +26,11 @@ namespace jse {
 		Color3 specular;
 		float specularIntesity;
 		float alpha;
+
+		// diffuse image as a layer of a TextureArrayAllocator array, -1: none
+		int textureArray;
+		int textureLayer;
+		SamplerState_t sampler;
 	};
 }
 
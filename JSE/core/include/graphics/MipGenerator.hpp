@@ -0,0 +1,59 @@
+#ifndef JSE_MIP_GENERATOR_H
+#define JSE_MIP_GENERATOR_H
+
+#include "system/SystemTypes.hpp"
+#include "system/Cpu.hpp"
+#include "graphics/Bitmap.hpp"
+
+namespace jse {
+
+	enum MipFilter
+	{
+		MipFilter_Box,		// 2x2 average
+		MipFilter_Kaiser,	// 6 tap Kaiser windowed sinc, sharper
+		MipFilter_LastEnum
+	};
+
+	struct MipGenParams_t
+	{
+		MipFilter filter{ MipFilter_Box };
+		bool srgb{ false };					// color channels are sRGB encoded, filtered in linear space (also set by Bitmap::IsSRGB)
+		bool preserveAlphaCoverage{ false };	// keep the alpha tested coverage of level 0 on every level
+		float alphaCutoff{ 0.5f };
+		int maxLevels{ 0 };					// 0: full chain down to 1x1
+		SimdLevel simd{ SimdLevel_LastEnum };	// LastEnum: best the CPU supports
+	};
+
+	// Number of levels of a full chain down to 1x1
+	int GetMipCount(const int aSizeX, const int aSizeY);
+
+	enum ImageUsage
+	{
+		ImageUsage_Color,	// sRGB color
+		ImageUsage_Normal,	// tangent space normals
+		ImageUsage_Linear,	// roughness, metallic, occlusion, height, masks
+		ImageUsage_LastEnum
+	};
+
+	/*
+	 Guess from the file name what an image holds. The stem is split into
+	 _ and - separated tokens, the first token after the material name that
+	 names a map decides, case insensitively (col, albedo, n, nrm, normal,
+	 rough, metal, metalness, ao, disp, mask, ...), so the workflow suffix
+	 of *_COL_1K_METALNESS does not make a color map linear. Unknown names
+	 are color.
+	*/
+	ImageUsage MipGen_GetImageUsage(const String& aFileName);
+	inline bool MipGen_IsColorImage(const String& aFileName) { return MipGen_GetImageUsage(aFileName) == ImageUsage_Color; }
+
+	/*
+	 Rebuilds the mip chain of every image in aBitmap from level 0. Rows
+	 are filtered in parallel on the default thread pool. Only uncompressed
+	 8 bit L, LA, RGB and RGBA bitmaps are supported.
+	*/
+	bool GenerateMipmaps(Bitmap& aBitmap, const MipGenParams_t& aParams = MipGenParams_t());
+
+	// Times the scalar reference against the SIMD kernels on aSource and logs the results
+	void MipGen_Benchmark(const Bitmap& aSource, const int aIterations);
+}
+#endif
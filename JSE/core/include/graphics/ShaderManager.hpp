@@ -6,11 +6,31 @@
 #include "system/SystemTypes.hpp"
 #include "system/Filesystem.hpp"
 #include "graphics/GpuShader.hpp"
+#include "system/Timer.hpp"
 
 #include <map>
+#include <vector>
 
 namespace jse {
 
+	/*
+	 Programs are built from their stage files with a set of feature
+	 defines (the variant), every variant is compiled once, queued ahead
+	 of time by PrepareVariant or when first requested. Stage files may
+	 #include "file" relative to shaders/.
+	*/
+	typedef Flag ShaderFeatures;
+
+	#define ShaderFeatures_None			(0U)
+	#define ShaderFeatures_Fog			(1U << 0)	// FOG
+	#define ShaderFeatures_DiffuseArray	(1U << 1)	// HAS_DIFFUSE_ARRAY: diffuse from a texture array layer
+	#define ShaderFeatures_Skinning		(1U << 2)	// SKINNING: vertices blended by the JointBuffer palette
+	#define ShaderFeatures_NumBits		3
+
+	// MAX_LIGHTS: size of the LightBuffer block, also the bound of the light loop
+	const int kMaxShaderLights = 256;
+	const int kMaxShaderIncludeDepth = 8;
+
 	struct ShaderDef
 	{
 		String mName;
@@ -25,6 +45,15 @@ namespace jse {
 		String mFragShader;
 		String mGeomShader;
 		String mCompShader;
+		ShaderFeatures mFeatures;	// of the variant built by Init
+		int mMaxLights;
+	};
+
+	// Uniform block binding point or sampler texture unit by name
+	struct ShaderBindingDef
+	{
+		String mName;
+		int mIndex;
 	};
 
 	struct MaterialProgram
@@ -33,6 +62,10 @@ namespace jse {
 		String mProgram;
 	};
 
+	// Linked programs are stored here (relative to the working dir) by a hash of their sources and the driver
+	const String kShaderCacheDir = "cache/shaders";
+	const u32 kShaderCacheVersion = 1;
+
 	typedef std::map<String, GpuShaderStage*> tStageByName;
 	typedef tStageByName::value_type tStageByNamePair;
 	typedef std::map<String, GpuShader*> tProgramByName;
@@ -46,15 +79,73 @@ namespace jse {
 		ShaderManager(GraphicsDriver* aGraphicsDriver, FileSystem* aFileSystem);
 		~ShaderManager();
 		bool Init();
+
+		// Init in steps: BeginInit submits every program not in the cache to the driver
+		// and returns, IsInitDone polls them without waiting, EndInit waits for the rest.
+		// Loading can go on in between; programs are usable once isCompiled().
+		bool BeginInit();
+		bool IsInitDone();
+		bool EndInit();
+		// Empty disables the program binary cache
+		inline void SetCacheDir(const String& aDir) { mCacheDir = aDir; }
 		GpuShader* GetShaderByName(const String& aName);
 		GpuShader* GetShaderByMaterial(const MaterialType aType);
 
+		// Built on the first request (blocking), nullptr if the program does not exist or fails
+		GpuShader* GetShaderVariant(const String& aName, const ShaderFeatures aFeatures, const int aMaxLights = kMaxShaderLights);
+		GpuShader* GetShaderByMaterial(const MaterialType aType, const ShaderFeatures aFeatures, const int aMaxLights = kMaxShaderLights);
+
+		// Queues a variant like the Init programs: loaded from the binary cache or submitted to
+		// the driver now, finished by IsInitDone / EndInit or at the latest by its first request
+		bool PrepareVariant(const MaterialType aType, const ShaderFeatures aFeatures, const int aMaxLights);
+
+		// MAX_LIGHTS of the variants for aNumLights lights: a power of two from 4, few variants as the count changes
+		static int GetVariantLights(const size_t aNumLights);
+
+		// Binding points are assigned to the blocks of every program once after the link, -1 if the block is unknown
+		int GetUniformBlockBinding(const String& aBlock) const;
+
+		// Checks the reflected layout of aBlock in every program against a CPU struct, now and
+		// for programs built later. Programs that do not match fail: built ones are released and
+		// no longer returned, later ones fail their link. False (and logged) on a mismatch.
+		bool RegisterUniformLayout(const String& aBlock, const UniformLayoutMember_t* aMembers, const size_t aCount);
+
 	private:
-		tProgramByName mShaderByNameMap;
-		tStageByName mStageByName;
+		struct PendingProgram_t
+		{
+			GpuShader* program;
+			String name;
+			String cacheFile;	// empty: no cache
+		};
+
+		bool ReadSource(const String& aFileName, String& aSource, const int aDepth);
+		GpuShader* CreateVariant(const ProgramDef& aDef, const ShaderFeatures aFeatures, const int aMaxLights, const bool aSubmitOnly);
+		bool FinishProgram(const PendingProgram_t& aPending);
+		bool FinishPending(const PendingProgram_t& aPending);
+		void ReleaseProgram(const String& aVariantName);
+		bool SetupProgram(GpuShader* aProgram, const String& aName);
+		bool ValidateLayout(const GpuShader* aProgram, const String& aName, const String& aBlock, const std::vector<UniformLayoutMember_t>& aMembers) const;
+		bool LoadCachedProgram(GpuShader* aProgram, const String& aFileName);
+		void SaveCachedProgram(GpuShader* aProgram, const String& aFileName);
+
+		tProgramByName mShaderByNameMap;	// Init variants, owned by mVariantByName
+		tProgramByName mVariantByName;
+		tStageByName mStageByName;			// by stage name and defines
+		std::map<String, String> mSourceByName;
 		GraphicsDriver* mGraphicsDriver;
 		FileSystem* mFileSystem;
 		tMaterialShader mMaterialShaderMap;
+		String mCacheDir;
+		std::map<String, int> mBlockBindings;
+		std::map<String, int> mSamplerUnits;
+		std::map<String, std::vector<UniformLayoutMember_t>> mUniformLayouts;
+		bool mUseCache{ false };
+		u64 mDeviceHash{ 0 };
+
+		std::vector<PendingProgram_t> mPending;
+		SimpleTimer mInitTimer;
+		int mNumCached{ 0 };
+		bool mInitFailed{ false };
 	};
 }
 #endif
\ No newline at end of file
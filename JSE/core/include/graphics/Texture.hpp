@@ -3,6 +3,7 @@
 
 #include "system/SystemTypes.hpp"
 #include "graphics/GraphicsTypes.hpp"
+#include "graphics/Bitmap.hpp"
 
 namespace jse {
 
@@ -26,19 +27,43 @@ namespace jse {
 		inline TextureWrapParam GetWrapT() const { return mWrapT; }
 		inline TextureWrapParam GetWrapR() const { return mWrapR; }
 		inline TextureUnit GetTextureUnit() const { return mTextureUnit; }
+		inline int GetSizeX() const { return mSize.x; }
+		inline int GetSizeY() const { return mSize.y; }
+		inline int GetNumMipmaps() const { return mNumMipmaps; }
+		inline int GetNumLayers() const { return mNumLayers; }
+		inline bool IsUsable() const { return mUsable; }
 
 		bool LoadFromFile(const String& aFilename);
 
+		// LoadFromFile in two steps: DecodeFile is thread safe, UploadBitmap must run on the render thread
+		static bool DecodeFile(const String& aFilename, Bitmap& aBitmap);
+
+		// Uploads every mip level of aBitmap, mips are generated only for single level uncompressed images.
+		// aPboOffsets: offsets of the (image, mip) data inside the bound pixel unpack buffer, image major
+		bool UploadBitmap(const Bitmap& aBitmap, const size_t* aPboOffsets = nullptr);
+
 		virtual bool UploadToGPU(const unsigned char* data) = 0;
 		virtual void Bind() = 0;
 
+		// Releases the aCount largest levels on the GPU without touching the file, false if not possible
+		virtual bool DropTopMips(const int aCount) = 0;
+
+		// TextureType_2DArray only: allocates aNumLayers layers with the size, format and levels of aLayout,
+		// UploadLayer then fills one layer from a bitmap of that layout
+		virtual bool AllocateLayers(const Bitmap& aLayout, const int aNumLayers) = 0;
+		virtual bool UploadLayer(const Bitmap& aBitmap, const int aLayer) = 0;
+
 	protected:
+		virtual bool UploadBitmapToGPU(const Bitmap& aBitmap, const size_t* aPboOffsets) = 0;
+
 		String mName;
 		String mFileName;
 		TextureType mType;
 		TextureWrapParam mWrapS, mWrapT, mWrapR;
 		TextureFilter mMinFilter, mMagFilter;
 		Vector3l mSize;
+		int mNumMipmaps;
+		int mNumLayers;
 		TextureUnit mTextureUnit;
 		bool mUsable;
 
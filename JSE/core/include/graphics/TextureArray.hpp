@@ -0,0 +1,72 @@
+#ifndef JSE_TEXTURE_ARRAY_H
+#define JSE_TEXTURE_ARRAY_H
+
+#include <vector>
+
+#include "system/SystemTypes.hpp"
+#include "graphics/Bitmap.hpp"
+
+namespace jse {
+
+	class Texture;
+	class GraphicsDriver;
+
+	const int kMaxTextureArrayLayers = 256;
+
+	// Where an image ended up, array -1 if it could not be placed
+	struct TextureLayer_t
+	{
+		int array{ -1 };
+		int layer{ -1 };
+	};
+
+	/*
+	 Groups images of the same size, format and level count into the
+	 layers of GL_TEXTURE_2D_ARRAY textures, so meshes using different
+	 images can be drawn with one texture bound. Files are added first,
+	 Build() decodes them on the thread pool, sizes every array to the
+	 number of layers it needs and uploads the layers. Materials refer to
+	 the result by (array, layer).
+	*/
+	class TextureArrayAllocator
+	{
+	public:
+		TextureArrayAllocator(GraphicsDriver* aDriver) : mGd(aDriver) {}
+		~TextureArrayAllocator();
+
+		// Returns the id of the entry, placed by the next Build()
+		int Add(const String& aFileName);
+
+		// Places the entries added since the last call into new arrays, false if any failed
+		bool Build();
+
+		inline const TextureLayer_t& GetLayer(const int aEntry) const { return mLayers[aEntry]; }
+		inline Texture* GetArray(const int aArray) const { return mArrays[aArray].texture; }
+		inline int GetNumArrays() const { return int(mArrays.size()); }
+
+		void PrintStats() const;
+
+	private:
+		struct Pending_t
+		{
+			int entry;
+			String fileName;
+			Bitmap bitmap;
+			bool ok;
+		};
+
+		struct Array_t
+		{
+			Texture* texture;
+			size_t bytes;
+		};
+
+		static bool IsSameLayout(const Bitmap& a0, const Bitmap& a1);
+
+		GraphicsDriver* mGd;
+		std::vector<Pending_t> mPending;
+		std::vector<TextureLayer_t> mLayers;
+		std::vector<Array_t> mArrays;
+	};
+}
+#endif
@@ -0,0 +1,58 @@
+#ifndef JSE_TEXTURE_BATCH_H
+#define JSE_TEXTURE_BATCH_H
+
+#include <vector>
+
+#include "system/SystemTypes.hpp"
+#include "graphics/Bitmap.hpp"
+
+namespace jse {
+
+	class Texture;
+	class GraphicsDriver;
+
+	struct TextureLoadTiming_t
+	{
+		String fileName;
+		size_t bytes;
+		float decodeMs;
+		float uploadMs;		// CPU side of the upload, the copy from the PBO is asynchronous
+		bool ok;
+	};
+
+	typedef std::vector<TextureLoadTiming_t> TextureLoadTimingVec;
+
+	/*
+	 Loads a set of textures at once: images are decoded on the thread pool
+	 into staging memory, copied into one pixel unpack buffer and uploaded
+	 from there on the calling (GL) thread.
+	*/
+	class TextureBatch
+	{
+	public:
+		TextureBatch(GraphicsDriver* aDriver) : mGd(aDriver) {}
+
+		void Add(Texture* aTexture, const String& aFileName);
+		void Clear();
+
+		// Returns false if any of the textures failed, the others are still loaded
+		bool Load();
+
+		inline const TextureLoadTimingVec& GetTimings() const { return mTimings; }
+		void PrintTimings() const;
+
+	private:
+		struct Entry_t
+		{
+			Texture* texture;
+			String fileName;
+			Bitmap bitmap;
+			std::vector<size_t> offsets;	// per (image, mip) offset in the pixel buffer
+		};
+
+		GraphicsDriver* mGd;
+		std::vector<Entry_t> mEntries;
+		TextureLoadTimingVec mTimings;
+	};
+}
+#endif
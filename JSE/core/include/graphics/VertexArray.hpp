@@ -57,6 +57,7 @@ namespace jse {
 		virtual ~VertexArray() {}
 		virtual void Compile() {}
 		virtual void Bind() {}
+		virtual void UnBind() {}
 	protected:
 		const VertexArrayAttributes mArrayAttributes;
 		const BufferObject* mIndexBuffer;
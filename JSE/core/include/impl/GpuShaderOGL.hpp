@@ -18,7 +18,12 @@ namespace jse {
         void AddStage(GpuShaderStage* aShader);
         void AddStage(const GpuShaderStageType aStage, const String& aSourceName, const String& aName);
         bool Compile();
+        bool Submit();
+        bool IsReady();
+        bool Finish();
         void Delete();
+        bool GetBinary(ByteVector& aData);
+        bool LoadBinary(const ByteVector& aData);
         void Use();
 
         void SetFloat(const String& aName, const float aVal);
@@ -29,9 +34,11 @@ namespace jse {
         void SetMatrix(const String&, const float*);
         void SetMatrix3(const String&, const float*);
         void BindUniformBlock(const String& aName, const int aBindingPoint);
+        void SetSamplerUnit(const String& aName, const TextureUnit aUnit);
 
     private:
         GLint GetLocationCached(const String& aName);
+        void Reflect();
 
         std::vector<GpuShaderStageOGL*> mStages;
         UniformCacheType mUniformCache{};
@@ -45,6 +52,9 @@ namespace jse {
 		~GpuShaderStageOGL();
 		void Delete();
 		bool Compile();
+		bool Submit();
+		bool IsReady();
+		bool Finish();
 		GLuint GetApiId() { return mApiId; }
 
 	private:
@@ -1,6 +1,7 @@
 #ifndef JSE_GRAPHICS_DRIVER_OGL_H
 #define JSE_GRAPHICS_DRIVER_OGL_H
 
+#include <unordered_map>
 #include <GL/glew.h>
 #include <SDL.h>
 #include "system/Logger.hpp"
@@ -27,6 +28,9 @@ namespace jse {
     GLint GetGLTextureFilterInt(const TextureFilter aParam);
     GLenum GetGLPrimitiveEnum(const PrimitiveType aParam);
 
+    // GL_COMPLETION_STATUS_KHR can be polled without waiting for the compiler
+    inline bool GLHasParallelShaderCompile() { return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile; }
+
     struct GLConfig {
         int majorVer;
         int minorVer;
@@ -58,6 +62,7 @@ namespace jse {
         void SwapBuffers() const;
         void SetBlendEnabled(const bool aEnabled);
         int GetCaps(GraphicsCaps aType) const;
+        String GetDeviceString() const;
         void SetVSyncEnabled(int aEnabled, bool aAdaptiv = false);
         void SetGammaCorrection(float a0);
         void ClearFrameBuffer(const ClearFBFlags aFlags);
@@ -96,6 +101,8 @@ namespace jse {
         Texture* CreateTexture();
 
         void SetActiveTexture(const TextureUnit a0);
+        void BindSampler(const TextureUnit aUnit, const SamplerState_t& aState);
+        void UnBindSampler(const TextureUnit aUnit);
 
         void DrawPrimitivesWithBase(const PrimitiveType aType, const unsigned int aCount, const size_t aIndices, const unsigned int aBaseVertex);
 
@@ -108,6 +115,11 @@ namespace jse {
         inline void UnBindBuffer(const BufferTarget aTarget) const { glBindBuffer(GetGLBufferTargetEnum( aTarget ), 0); }
         void UseShader(GpuShader*) const;
 
+        // Texture binds go through here so redundant binds are skipped
+        void BindTexture(const TextureUnit aUnit, const GLenum aTarget, const GLuint aId);
+        // Call before glDeleteTextures, GL unbinds deleted names from every unit
+        void OnDeleteTexture(const GLuint aId);
+
     private:
         void SetSdlGlAttributes(const int aMultisamples, const bool aDebug = false);
     private:
@@ -126,6 +138,10 @@ namespace jse {
         * STATE CACHE VARS
         * ===========================
         */
+        int activeTextureUnit;
+        GLuint boundTextures[TextureUnit_LastEnum];
+        GLuint boundSamplers[TextureUnit_LastEnum];
+        std::unordered_map<u32, GLuint> samplerCache;
 
     };
 }
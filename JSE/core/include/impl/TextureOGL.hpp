@@ -13,13 +13,23 @@ namespace jse {
 		TextureOGL(GraphicsDriverOGL* aDriver);
 		~TextureOGL();
 		void Bind();
+		bool DropTopMips(const int aCount);
+		bool AllocateLayers(const Bitmap& aLayout, const int aNumLayers);
+		bool UploadLayer(const Bitmap& aBitmap, const int aLayer);
 
 	protected:
 		bool UploadToGPU(const unsigned char* data);
+		bool UploadBitmapToGPU(const Bitmap& aBitmap, const size_t* aPboOffsets);
 
 	private:
 		GLuint mApiId;
 		GraphicsDriverOGL* mDriver;
+
+		// format of the last upload or allocation, for DropTopMips and UploadLayer
+		PixelFormat mPixelFormat;
+		GLenum mFormat;
+		GLint mInternalFormat;
+		bool mIsCompressed;
 	};
 }
 #endif
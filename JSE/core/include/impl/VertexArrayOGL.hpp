@@ -17,6 +17,7 @@ namespace jse {
 		~VertexArrayOGL();
 		void Compile();
 		void Bind();
+		void UnBind();
 	private:
 		GraphicsDriverOGL* driver;
 		GLuint mVAO;
@@ -0,0 +1,93 @@
+#ifndef JSE_AABB_TREE_H
+#define JSE_AABB_TREE_H
+
+#include <vector>
+#include <functional>
+
+#include "system/SystemTypes.hpp"
+#include "math/Bounds.hpp"
+#include "math/Frustum.hpp"
+
+/*
+=========================================
+ Dynamic AABB tree
+
+ Incrementally updated bounding volume hierarchy of moving objects
+ (proxies). Leaves store the object bounds grown by a margin, a moved
+ object is only reinserted when it leaves its enlarged box. Insertion
+ picks the sibling with the smallest area increase and the tree is kept
+ balanced with rotations, so the height stays logarithmic.
+
+ Queries report proxies to a callback. RayCastPacket traverses
+ kRayPacketSize rays together with SSE, a node is entered when any of
+ the rays reaches it. QueryFrustum culls hierarchically: subtrees fully
+ inside the frustum are reported without testing their nodes.
+=========================================
+*/
+
+namespace jse {
+
+	// Proxy; return false to stop the query
+	typedef std::function<bool(int)> AabbTreeQueryFunc;
+	// Proxy and the current ray end; returns the new end, 0 stops the query
+	typedef std::function<float(int, float)> AabbTreeRayFunc;
+	// Proxy, mask of the rays that reach it and the per ray ends, which the callback may lower
+	typedef std::function<void(int, int, float*)> AabbTreePacketFunc;
+	// Proxy, true when its bounds are entirely inside the frustum
+	typedef std::function<void(int, bool)> AabbTreeFrustumFunc;
+
+	class AabbTree
+	{
+	public:
+		static const int kNull = -1;
+
+		AabbTree(const float aMargin = 0.1f);
+
+		int CreateProxy(const Aabb_t& aBounds, const int aUser);
+		void DestroyProxy(const int aProxy);
+		// Returns true if the proxy was reinserted
+		bool MoveProxy(const int aProxy, const Aabb_t& aBounds);
+		void Clear();
+
+		inline int GetUser(const int aProxy) const { return mNodes[aProxy].user; }
+		// Bounds with the margin
+		inline const Aabb_t& GetFatBounds(const int aProxy) const { return mNodes[aProxy].bounds; }
+		inline size_t GetProxyNum() const { return mProxyNum; }
+		inline int GetHeight() const { return mRoot == kNull ? 0 : mNodes[mRoot].height; }
+
+		void QueryAabb(const Aabb_t& aBounds, const AabbTreeQueryFunc& aFunc) const;
+		void RayCast(const Ray_t& aRay, const AabbTreeRayFunc& aFunc) const;
+		// kRayPacketSize rays, their tMax is the starting end of each ray
+		void RayCastPacket(const Ray_t* aRays, const AabbTreePacketFunc& aFunc) const;
+		void QueryFrustum(const Frustum& aFrustum, const AabbTreeFrustumFunc& aFunc) const;
+
+	private:
+		struct Node_t
+		{
+			Aabb_t bounds;
+			int parent;		// next free node while on the free list
+			int child1;		// kNull for leaves
+			int child2;
+			int height;		// 0 for leaves, -1 while free
+			int user;
+		};
+
+		inline bool IsLeaf(const int aNode) const { return mNodes[aNode].child1 == kNull; }
+
+		int AllocateNode();
+		void FreeNode(const int aNode);
+		void InsertLeaf(const int aLeaf);
+		void RemoveLeaf(const int aLeaf);
+		int Balance(const int aNode);
+		void Refit(int aNode);
+		void ReportSubtree(const int aNode, const AabbTreeFrustumFunc& aFunc) const;
+
+		std::vector<Node_t> mNodes;
+		int mRoot;
+		int mFreeList;
+		size_t mProxyNum;
+		float mMargin;
+	};
+}
+
+#endif
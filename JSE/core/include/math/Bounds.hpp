@@ -0,0 +1,123 @@
+#ifndef JSE_BOUNDS_H
+#define JSE_BOUNDS_H
+
+#include <cfloat>
+#include <algorithm>
+
+#include "system/SystemTypes.hpp"
+#include "graphics/GraphicsTypes.hpp"
+
+/*
+=========================================
+ Axis aligned boxes and rays
+
+ Shared by the triangle BVH of the meshes and the AABB tree of the
+ scene. A default Aabb_t is empty (min > max) and grows with Aabb_Add.
+ Rays are origin + t * dir for t in [0, tMax], dir does not have to be
+ unit length so a segment is dir = to - from with tMax = 1.
+=========================================
+*/
+
+namespace jse {
+
+	struct Aabb_t
+	{
+		Vector3f min{ FLT_MAX };
+		Vector3f max{ -FLT_MAX };
+	};
+
+	struct Ray_t
+	{
+		Vector3f origin{ 0.0f };
+		Vector3f dir{ 0.0f, 0.0f, -1.0f };
+		float tMax{ FLT_MAX };
+	};
+
+	// Rays the packet queries trace together, one SSE register wide
+	const int kRayPacketSize = 4;
+
+	inline bool Aabb_IsEmpty(const Aabb_t& aBox) { return aBox.min.x > aBox.max.x; }
+
+	inline void Aabb_Add(Aabb_t& aBox, const Vector3f& aPoint)
+	{
+		aBox.min = glm::min(aBox.min, aPoint);
+		aBox.max = glm::max(aBox.max, aPoint);
+	}
+
+	inline Aabb_t Aabb_Union(const Aabb_t& aA, const Aabb_t& aB)
+	{
+		Aabb_t r;
+		r.min = glm::min(aA.min, aB.min);
+		r.max = glm::max(aA.max, aB.max);
+
+		return r;
+	}
+
+	inline bool Aabb_Overlaps(const Aabb_t& aA, const Aabb_t& aB)
+	{
+		return aA.min.x <= aB.max.x && aA.min.y <= aB.max.y && aA.min.z <= aB.max.z &&
+			aB.min.x <= aA.max.x && aB.min.y <= aA.max.y && aB.min.z <= aA.max.z;
+	}
+
+	inline bool Aabb_Contains(const Aabb_t& aOuter, const Aabb_t& aInner)
+	{
+		return aOuter.min.x <= aInner.min.x && aOuter.min.y <= aInner.min.y && aOuter.min.z <= aInner.min.z &&
+			aInner.max.x <= aOuter.max.x && aInner.max.y <= aOuter.max.y && aInner.max.z <= aOuter.max.z;
+	}
+
+	// Half the surface area, the SAH cost of a box
+	inline float Aabb_HalfArea(const Aabb_t& aBox)
+	{
+		const Vector3f d = aBox.max - aBox.min;
+
+		return d.x * d.y + d.y * d.z + d.z * d.x;
+	}
+
+	inline Aabb_t Aabb_Inflate(const Aabb_t& aBox, const float aMargin)
+	{
+		Aabb_t r;
+		r.min = aBox.min - Vector3f(aMargin);
+		r.max = aBox.max + Vector3f(aMargin);
+
+		return r;
+	}
+
+	// Bounds of the box transformed by the affine aM
+	inline Aabb_t Aabb_Transform(const Aabb_t& aBox, const Matrix& aM)
+	{
+		const Vector3f center = (aBox.min + aBox.max) * 0.5f;
+		const Vector3f extent = (aBox.max - aBox.min) * 0.5f;
+		const Matrix3x3 m(aM);
+		const Matrix3x3 a(glm::abs(m[0]), glm::abs(m[1]), glm::abs(m[2]));
+
+		const Vector3f c = m * center + Vector3f(aM[3]);
+		const Vector3f e = a * extent;
+
+		Aabb_t r;
+		r.min = c - e;
+		r.max = c + e;
+
+		return r;
+	}
+
+	// Slab test against aRay with aInvDir = 1 / dir, entry distance (clamped to 0) in aT
+	inline bool Aabb_IntersectRay(const Aabb_t& aBox, const Vector3f& aOrigin, const Vector3f& aInvDir, const float aTMax, float& aT)
+	{
+		const Vector3f t0 = (aBox.min - aOrigin) * aInvDir;
+		const Vector3f t1 = (aBox.max - aOrigin) * aInvDir;
+		const Vector3f tNear = glm::min(t0, t1);
+		const Vector3f tFar = glm::max(t0, t1);
+
+		aT = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		const float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, aTMax));
+
+		return aT <= tExit;
+	}
+
+	inline Vector3f Ray_InvDir(const Vector3f& aDir)
+	{
+		return Vector3f(1.0f / aDir.x, 1.0f / aDir.y, 1.0f / aDir.z);
+	}
+}
+
+#endif
@@ -1,16 +1,89 @@
 #ifndef JSE_FRUSTUM_H
 #define JSE_FRUSTUM_H
 
+#include "system/SystemTypes.hpp"
+#include "system/Cpu.hpp"
 #include "graphics/GraphicsTypes.hpp"
+#include "graphics/BoundingVolume.hpp"
+#include "math/Bounds.hpp"
+
+/*
+=========================================
+ View frustum
+
+ Six planes from the rows of a GL view projection matrix. The normals
+ point inside and have unit length, so plane distances are in world
+ units. The single tests classify one point, sphere or box. The batch
+ tests cull structure of arrays input 4 (SSE) or 8 (AVX2) objects at
+ a time, each plane broadcast over the lanes, and write one visibility
+ bit per object: bit (i & 31) of aVisible[i >> 5]. Objects touching a
+ plane count as visible.
+=========================================
+*/
 
 namespace jse {
+
+	enum FrustumPlane
+	{
+		FrustumPlane_Left,
+		FrustumPlane_Right,
+		FrustumPlane_Bottom,
+		FrustumPlane_Top,
+		FrustumPlane_Near,
+		FrustumPlane_Far,
+		FrustumPlane_LastEnum
+	};
+
+	// Spheres as structure of arrays
+	struct FrustumSpheres_t
+	{
+		const float* x;
+		const float* y;
+		const float* z;
+		const float* radius;
+	};
+
+	// Axis aligned boxes as structure of arrays, center and half extent
+	struct FrustumBoxes_t
+	{
+		const float* x;
+		const float* y;
+		const float* z;
+		const float* extentX;
+		const float* extentY;
+		const float* extentZ;
+	};
+
+	// uint32_t words of the visibility mask of aCount objects
+	inline size_t Frustum_MaskWords(const size_t aCount) { return (aCount + 31) / 32; }
+	inline bool Frustum_IsVisible(const uint32_t* aVisible, const size_t aIdx) { return (aVisible[aIdx >> 5] >> (aIdx & 31)) & 1; }
+
 	class Frustum
 	{
 	public:
-		Frustum(const Matrix& aProjMtx);
+		// A frustum that culls nothing
+		Frustum();
+		Frustum(const Matrix& aViewProj);
+		Frustum(const Matrix& aView, const Matrix& aProj);
+
+		void SetViewProj(const Matrix& aViewProj);
+		inline const Vector4f& GetPlane(const int aPlane) const { return mPlanes[aPlane]; }
+
+		BoundingVolume::TestResult TestPoint(const Vector3f& aPoint) const;
+		BoundingVolume::TestResult TestSphere(const Vector3f& aCenter, const float aRadius) const;
+		BoundingVolume::TestResult TestBox(const BoundingBox& aBox) const;
+		BoundingVolume::TestResult TestAabb(const Aabb_t& aBox) const;
+
+		// aVisible holds Frustum_MaskWords(aCount) words, all of them are written
+		void CullSpheres(const FrustumSpheres_t& aSpheres, const size_t aCount, uint32_t* aVisible, const SimdLevel aSimd = SimdLevel_LastEnum) const;
+		void CullBoxes(const FrustumBoxes_t& aBoxes, const size_t aCount, uint32_t* aVisible, const SimdLevel aSimd = SimdLevel_LastEnum) const;
+
 	private:
-		Vector4f mPlanes[6];
+		Vector4f mPlanes[FrustumPlane_LastEnum];
 	};
+
+	// Times the batch tests on aCount random objects for every SIMD level and logs the results
+	void Frustum_Benchmark(const int aCount, const int aIterations);
 }
 
-#endif
\ No newline at end of file
+#endif
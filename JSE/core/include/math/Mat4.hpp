@@ -0,0 +1,41 @@
+#ifndef JSE_MAT4_H
+#define JSE_MAT4_H
+
+#include "system/SystemTypes.hpp"
+#include "graphics/GraphicsTypes.hpp"
+
+/*
+=========================================
+ 4x4 matrix kernels
+
+ SSE versions of the per node transform math (column major Matrix,
+ same results as GLM up to rounding). Mat4_MulBatch uses AVX2 + FMA
+ when the CPU has it, two columns per register, SSE otherwise.
+ Mat4_NormalMatrixBatch runs the SSE kernel per matrix, the uniform
+ scale test branches per matrix. Affine means the last row is (0, 0, 0, 1).
+=========================================
+*/
+
+namespace jse {
+
+	// aDst = aA * aB, aDst may alias aA or aB
+	void Mat4_Mul(const Matrix& aA, const Matrix& aB, Matrix& aDst);
+
+	// aDst[i] = aA * aB[i], aDst may alias aB
+	void Mat4_MulBatch(const Matrix& aA, const Matrix* aB, Matrix* aDst, const size_t aCount);
+
+	// Inverse of an affine matrix: inverse of the 3x3 part, translation rotated back
+	void Mat4_AffineInverse(const Matrix& aM, Matrix& aDst);
+
+	/*
+	 transpose(inverse()) of the 3x3 part of aM, in a Matrix with the last
+	 row and column of the identity. Rotations with a uniform scale only
+	 divide by the squared scale, other matrices use the cofactors.
+	*/
+	void Mat4_NormalMatrix(const Matrix& aM, Matrix& aDst);
+	void Mat4_NormalMatrixBatch(const Matrix* aM, Matrix* aDst, const size_t aCount);
+
+	// Times the kernels on aCount random affine matrices against GLM and logs the results
+	void Mat4_Benchmark(const int aCount, const int aIterations);
+}
+#endif
@@ -0,0 +1,75 @@
+#ifndef JSE_TRIANGLE_BVH_H
+#define JSE_TRIANGLE_BVH_H
+
+#include <vector>
+
+#include "system/SystemTypes.hpp"
+#include "graphics/GraphicsTypes.hpp"
+#include "math/Bounds.hpp"
+
+/*
+=========================================
+ Triangle BVH
+
+ Static bounding volume hierarchy over the triangles of one mesh, in
+ mesh space. Built once with a binned SAH split, the nodes are a flat
+ array with the two children of an inner node next to each other. The
+ triangle corners are copied in BVH order, so the BVH does not refer to
+ the mesh data and leaves test triangles that are contiguous in memory.
+
+ Ray tests are two sided. RayCastPacket traces kRayPacketSize rays
+ together with SSE: a node is entered when any active ray reaches it
+ and the triangles of a leaf are tested against all rays at once.
+=========================================
+*/
+
+namespace jse {
+
+	class VertexData;
+
+	struct TriangleHit_t
+	{
+		float t{ FLT_MAX };
+		float u{};			// barycentrics of the hit, weights of corner 1 and 2
+		float v{};
+		int triangle{ -1 };	// index of the triangle in the source index list (first index / 3)
+	};
+
+	class TriangleBvh
+	{
+	public:
+		void Build(const VertexData* aVertices, const size_t aNumVertices, const unsigned short* aIndices, const size_t aNumIndices);
+
+		inline bool IsEmpty() const { return mNodes.empty(); }
+		inline const Aabb_t& GetBounds() const { return mNodes[0].bounds; }
+		inline size_t GetNodeNum() const { return mNodes.size(); }
+		inline size_t GetTriangleNum() const { return mTriangles.size(); }
+
+		// Closest hit before aHit.t (set it to aRay.tMax first), aAnyHit returns the first hit found
+		bool RayCast(const Ray_t& aRay, TriangleHit_t& aHit, const bool aAnyHit = false) const;
+		// kRayPacketSize rays, aHits preset like RayCast. Returns the mask of the rays that hit
+		int RayCastPacket(const Ray_t* aRays, TriangleHit_t* aHits) const;
+		// Source triangles whose bounds overlap aBox
+		void QueryAabb(const Aabb_t& aBox, std::vector<int>& aTriangles) const;
+
+		void GetTriangle(const int aTriangle, Vector3f* aCorners) const;
+
+	private:
+		struct Node_t
+		{
+			Aabb_t bounds;
+			u32 first;		// inner node: left child, leaf: first triangle
+			u32 count;		// triangles of a leaf, 0 for inner nodes
+		};
+
+		std::vector<Node_t> mNodes;
+		std::vector<Vector3f> mCorners;		// 3 per triangle, BVH order
+		std::vector<u32> mTriangles;		// source triangle of each BVH slot
+		std::vector<u32> mSlots;			// BVH slot of each source triangle
+	};
+
+	// Separating axis test of a triangle against a box
+	bool TriangleBvh_OverlapsAabb(const Vector3f* aCorners, const Aabb_t& aBox);
+}
+
+#endif
@@ -15,13 +15,16 @@ namespace jse {
 		inline float GetLength() const { return mLength; }
 		void SetLength(const float aLength) { mLength = aLength; }
 		void SetTicksPerSec(const float a0);
+		// Reduces and quantizes every track
+		void Compress(const AnimationCompressParams_t& aParams);
+		// Bytes of key data of all tracks
+		size_t GetMemorySize() const;
 		AnimationTrack& CreateTrack(const String& aName, const AnimationTrackType aType, Node3d* aNode);
 		AnimationTrack& GetTrack(const size_t aIdx);
 		const AnimationTrack* GetTrackByName(const String& aName) const;
 		size_t GetTrackNum() const { return mTracks.size(); };
 		inline float GetTicksPerSec() const { return mTicksPerSec; }
 		inline const String& GetName() const { return mName; }
-		void ApplyFrame(const float aTime);
 
 	private:
 		float mLength;
@@ -0,0 +1,84 @@
+#ifndef JSE_ANIMATION_INSTANCE_H
+#define JSE_ANIMATION_INSTANCE_H
+
+#include <vector>
+
+#include "system/SystemTypes.hpp"
+#include "scene/Animation.hpp"
+#include "scene/AnimationPose.hpp"
+
+namespace jse {
+
+	class Node3d;
+
+	/*
+	 Playback state of a clip: time, speed, weight and the key cursors of
+	 its tracks. The clip itself is only read, so many characters can play
+	 the same Animation through their own instances.
+	*/
+	class AnimationInstance
+	{
+	public:
+		// Tracks are bound to the nodes of the same name under aRoot, or to the track's own node without one
+		AnimationInstance(Animation* aClip, AnimationPose& aPose, Node3d* aRoot = nullptr);
+
+		inline Animation* GetClip() const { return mClip; }
+		inline float GetTime() const { return mTime; }
+		void SetTime(const float aTime);
+		inline float GetSpeed() const { return mSpeed; }
+		void SetSpeed(const float aSpeed) { mSpeed = aSpeed; }
+		inline float GetWeight() const { return mWeight; }
+		void SetWeight(const float aWeight) { mWeight = aWeight; }
+		inline bool IsLooping() const { return mLoop; }
+		void SetLooping(const bool aLoop) { mLoop = aLoop; }
+		// Reached the end of a clip that does not loop
+		inline bool IsFinished() const { return !mLoop && mTime >= mClip->GetLength(); }
+
+		// aTimeStep in seconds, scaled by the clip's ticks per second and the speed
+		void Advance(const float aTimeStep);
+		// Adds the weighted value of every bound track to the current layer of aPose, at full rate
+		void Sample(AnimationPose& aPose, const AnimationBlendMode aMode);
+
+		/*
+		 Sample() in two steps: SampleTracks() evaluates tracks [aFirst, aEnd)
+		 into the instance's own value buffer and may run concurrently for
+		 disjoint ranges, Accumulate() then adds the buffer to aPose.
+		*/
+		inline size_t GetTrackNum() const { return mSlots.size(); }
+		void SampleTracks(const size_t aFirst, const size_t aEnd, const AnimationBlendMode aMode);
+		void Accumulate(AnimationPose& aPose) const;
+
+		/*
+		 Level of detail: with aRate > 1 the tracks are sampled every aRate-th
+		 frame and Accumulate() interpolates between the last two samples (the
+		 pose lags up to aRate - 1 frames), aRate 0 freezes the instance on its
+		 last sample. Call once per frame before sampling, returns true when
+		 the instance samples this frame.
+		*/
+		bool StepLod(const int aRate);
+		inline int GetLodRate() const { return mLodRate; }
+		// Spreads the samples of instances on the same rate over different frames
+		inline void SetLodStagger(const int aStagger) { mLodStagger = aStagger; }
+		// Sphere around the world positions of the bound nodes, false without bound nodes
+		bool GetBounds(Vector3f& aCenter, float& aRadius) const;
+
+	private:
+		Animation* mClip;
+		std::vector<int> mSlots;	// pose slot (weight slot for weight tracks) per track, -1 if the node was not found
+		std::vector<int> mCursors;	// key cursor per track
+		std::vector<Keyframe> mValues;	// last sampled value per track
+		std::vector<Keyframe> mPrevValues;	// the sample before, reduced rates only
+		std::vector<Node3d*> mNodes;	// bound nodes, once each
+		int mLodRate;
+		int mLodPhase;		// frames since the last sample
+		int mLodStagger;
+		bool mLodSnap;		// no history, the next sample is also the previous one
+		bool mHasValues;
+		float mTime;
+		float mSpeed;
+		float mWeight;
+		bool mLoop;
+	};
+}
+
+#endif
@@ -2,29 +2,113 @@
 #define JSE_ANIMATION_MGR_H
 
 #include "system/SystemTypes.hpp"
+#include "system/ThreadPool.hpp"
 #include "scene/Animation.hpp"
+#include "scene/AnimationPose.hpp"
+#include "scene/AnimationInstance.hpp"
+#include "math/Frustum.hpp"
 #include <vector>
+#include <memory>
+
+/*
+=========================================
+ Animation update
+
+ Tracks are sampled on the thread pool in blocks of at most
+ kAnimSampleBlock tracks of one instance; every block writes only the
+ key cursors and value buffer entries of its own tracks. The sampled
+ values are then summed into the pose on the calling thread in layer
+ and instance order, so the result does not depend on the number of
+ threads, and the node transforms are written once in Apply().
+ With level of detail on, distant instances skip the sampling step on
+ most frames and off-screen ones skip it entirely.
+=========================================
+*/
 
 namespace jse {
 
+	const size_t kAnimSampleBlock = 64;
+
+	/*
+	 Animation level of detail. The bounds of an instance are a sphere
+	 around its animated nodes, padded by boundsPadding. Instances whose
+	 bounds cover less than screenSize[i] of the viewport height are
+	 sampled every 2 << i frames, the ones outside the view frustum are
+	 frozen. The view is the one of the last SetLodView().
+	*/
+	struct AnimationLodParams_t
+	{
+		bool enabled{ false };
+		float screenSize[3]{ 0.2f, 0.08f, 0.03f };
+		float boundsPadding{ 1.0f };
+		bool freezeOffscreen{ true };
+	};
+
 	class AnimationManager
 	{
 	public:
-		AnimationManager();
+		AnimationManager(ThreadPool& aPool = GetDefaultThreadPool());
 		~AnimationManager();
 
+		// Registers the clip and plays it looping on the base layer
 		void AddAnimation(Animation* aX);
+		// Advances all instances by aFrameStep seconds, then blends them layer by layer into the node transforms
 		void UpdateState(const float aFrameStep);
+		size_t GetAnimationNum() const { return mAnimVec.size(); }
+		Animation* GetAnimation(const size_t aIdx) const { return mAnimVec[aIdx]; }
+
+		// Layers are blended in the order they were added, layer 0 is an override layer with weight 1
+		int AddLayer(const AnimationBlendMode aMode, const float aWeight = 1.0f);
+		void SetLayerWeight(const int aLayer, const float aWeight);
+		inline size_t GetLayerNum() const { return mLayers.size(); }
+
+		// New instance of aClip on aLayer, owned by the manager; aRoot as for AnimationInstance
+		AnimationInstance* Play(Animation* aClip, const int aLayer = 0, const float aWeight = 1.0f, Node3d* aRoot = nullptr);
+		void Stop(AnimationInstance* aInstance);
+
+		inline void SetLodParams(const AnimationLodParams_t& aParams) { mLodParams = aParams; }
+		inline const AnimationLodParams_t& GetLodParams() const { return mLodParams; }
+		void SetLodView(const Matrix& aView, const Matrix& aProj);
+		// Tracks sampled by the last UpdateState, and the ones of all playing instances
+		inline size_t GetSampledTrackNum() const { return mSampledTracks; }
+		inline size_t GetActiveTrackNum() const { return mActiveTracks; }
 
 	private:
+		struct AnimationLayer_t
+		{
+			AnimationBlendMode mode;
+			float weight;
+			std::vector<std::unique_ptr<AnimationInstance>> instances;
+		};
+
+		struct SampleJob_t
+		{
+			AnimationInstance* instance;
+			size_t first;
+			size_t end;
+			AnimationBlendMode mode;
+		};
+
 		std::vector<Animation*> mAnimVec;
 		using AnimVecIt = std::vector<Animation*>::iterator;
 
-		double mFrame;
-		float mTicksPerSec;
-		float mMaxFrameTime;
+		// 0: frozen, otherwise sample every n-th frame
+		int GetLodRate(const AnimationInstance& aInstance) const;
+
+		std::vector<AnimationLayer_t> mLayers;
+		AnimationPose mPose;
+		ThreadPool& mPool;
+		std::vector<SampleJob_t> mJobs;
+
+		AnimationLodParams_t mLodParams;
+		Frustum mLodFrustum;
+		Vector3f mLodViewPos;
+		float mLodProjScale;	// proj[1][1], 1 / tan(fovY / 2)
+		int mNumPlayed;
+		size_t mSampledTracks;
+		size_t mActiveTracks;
 	};
 
 }
 
-#endif
\ No newline at end of file
+#endif
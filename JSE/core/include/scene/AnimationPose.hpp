@@ -0,0 +1,97 @@
+#ifndef JSE_ANIMATION_POSE_H
+#define JSE_ANIMATION_POSE_H
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+#include "system/SystemTypes.hpp"
+#include "system/ThreadPool.hpp"
+#include "graphics/GraphicsTypes.hpp"
+
+/*
+=========================================
+ Pose buffer
+
+ One TRS slot per animated node, initialized from the node's local
+ matrix (the rest pose). Animations are blended layer by layer: the
+ sampled values of every instance on a layer are summed with their
+ weights (translation and scale weight-normalized, rotations nlerped),
+ EndLayer() then blends the layer result over the pose, replacing it
+ (override) or adding to it (additive). Apply() composes the local
+ matrix of every written slot once and marks the subtree dirty once.
+ Morph target weights have slots of their own, blended the same way
+ as a scalar channel.
+=========================================
+*/
+
+namespace jse {
+
+	class Node3d;
+
+	const size_t kPoseBlendBlock = 256;
+
+	enum AnimationBlendMode
+	{
+		AnimationBlendMode_Override,
+		AnimationBlendMode_Additive,	// values are deltas to the clip's first key
+		AnimationBlendMode_LastEnum
+	};
+
+	struct PoseTransform_t
+	{
+		Vector3f translation;
+		Quat rotation;
+		Vector3f scale;
+	};
+
+	class AnimationPose
+	{
+	public:
+		// Slot of aNode, added with the node's current local transform as rest pose
+		int AddNode(Node3d* aNode);
+		int GetSlot(const Node3d* aNode) const;
+		inline size_t GetSlotNum() const { return mNodes.size(); }
+		inline Node3d* GetNode(const int aSlot) const { return mNodes[aSlot]; }
+		inline const PoseTransform_t& GetTransform(const int aSlot) const { return mTransforms[aSlot]; }
+		// Weight slot of morph target aTarget of aNode, the slot AnimationTrackType_Weight values accumulate to
+		int AddMorphWeight(Node3d* aNode, const int aTarget);
+		inline float GetMorphWeight(const int aSlot) const { return mWeights[aSlot]; }
+
+		// Back to the rest pose, nothing is written
+		void Reset();
+
+		void BeginLayer();
+		// Adds aValue (the aChannel part of it) with aWeight to the layer sum of aSlot
+		void Accumulate(const int aSlot, const AnimationTrackType aChannel, const Keyframe& aValue, const float aWeight);
+		// Blends the layer over the pose, channels with a weight sum below 1 only partially.
+		// Slots are independent here, blocks of kPoseBlendBlock slots run on aPool
+		void EndLayer(const AnimationBlendMode aMode, const float aWeight, ThreadPool& aPool = GetDefaultThreadPool());
+
+		// One matrix compose per written node
+		void Apply();
+
+	private:
+		void BlendSlot(const size_t aSlot, const bool aAdditive, const float aWeight);
+
+		std::vector<Node3d*> mNodes;
+		std::vector<PoseTransform_t> mRest;
+		std::vector<PoseTransform_t> mTransforms;
+		std::vector<u8> mWritten;
+		std::unordered_map<const Node3d*, int> mSlotByNode;
+
+		std::vector<PoseTransform_t> mLayer;		// weighted sums of the current layer
+		std::vector<Vector3f> mLayerWeights;		// translation, rotation and scale weight sums
+
+		std::vector<Node3d*> mWeightNodes;
+		std::vector<int> mWeightTargets;
+		std::vector<float> mWeightRest;
+		std::vector<float> mWeights;
+		std::vector<u8> mWeightWritten;
+		std::vector<float> mWeightLayer;
+		std::vector<float> mWeightLayerSum;
+		std::map<std::pair<const Node3d*, int>, int> mWeightSlots;
+	};
+}
+
+#endif
@@ -12,36 +12,100 @@ namespace jse {
 
 	typedef std::vector<Keyframe> tKeyframeVec;
 
+	// Longest run of keys a single kept segment may replace in AnimationTrack::Reduce
+	const int kMaxReduceSpan = 256;
+
+	struct AnimationCompressParams_t
+	{
+		bool reduce{ true };				// drop keys the neighbours reproduce within the errors below
+		bool quantize{ true };				// 48 bits per key, decoded on sampling
+		float maxPositionError{ 0.0005f };	// scene units
+		float maxRotationError{ 0.0005f };	// radians
+		float maxScaleError{ 0.0005f };
+		float maxWeightError{ 0.001f };
+	};
+
 	class AnimationTrack
 	{
 	public:
 		AnimationTrack(const String& aName, Animation* aParent, const AnimationTrackType aType);
 
-		size_t GetKeyframeNum() const { return mKeyframes.size(); }
+		size_t GetKeyframeNum() const { return mKeyTimes.size(); }
 		Keyframe& CreateKeyframe(const float aTime);
 		void Clear();
+		// Raw key, only before the track is quantized
 		Keyframe& GetKey(const int aIndex);
-		void ApplyOnNode(const float aTime, const float aWeight, const bool aLoop = true);
-		float GetKeyframesAtTime(const float aTime, Keyframe& aKeyframeA, Keyframe& aKeyframeB, int& aIndex, const bool aLoop = true);
+		// Decoded key
+		Keyframe GetKeyValue(const int aIndex) const;
+
+		/*
+		 Removes every key the linear interpolation of the kept keys around
+		 it reproduces within aMaxError (distance, or angle in radians for
+		 rotations). Greedy: each kept key is followed by the furthest one
+		 that still reproduces all keys in between.
+		*/
+		void Reduce(const float aMaxError);
+		/*
+		 Packs the keys into 3 x 16 bits: rotations as the smallest three
+		 components with 15 bits each and the index of the largest, vectors
+		 quantized to the track's value range. The raw keys are released,
+		 sampling decodes the two keys it needs.
+		*/
+		void Quantize();
+		void Compress(const AnimationCompressParams_t& aParams);
+		inline bool IsQuantized() const { return mQuantized; }
+		// Bytes of key data
+		size_t GetMemorySize() const;
+		// Interpolated value at aTime, aCursor as for GetKeyframesAtTime. Looping clips wrap aTime
+		// before sampling (AnimationInstance::Advance), past the last key the track holds it
+		Keyframe Sample(const float aTime, int& aCursor) const;
+		/*
+		 Indices of the keys around aTime and the blend factor between them.
+		 Past the last key aIndexA is the last and aIndexB the first key with
+		 a factor of 0. aCursor is the caller's playback state (-1 to start):
+		 lookups start at the key found by the previous call, so playback is
+		 O(1) per frame; jumps fall back to a binary search. The track itself
+		 is not modified, clips can be sampled by many instances at once.
+		*/
+		float GetKeyframesAtTime(const float aTime, int& aIndexA, int& aIndexB, int& aCursor) const;
 		const String& GetName() const { return mName; }
+		AnimationTrackType GetType() const { return mType; }
+		// Raw keys, empty once the track is quantized
 		const tKeyframeVec& GetKeyframes() const { return mKeyframes; }
+		const std::vector<float>& GetKeyTimes() const { return mKeyTimes; }
 		void SetNode(Node3d* aNode) { mNode = aNode; }
 		Node3d* GetNode() const { return mNode; }
+		// Morph target of the node a weight track animates
+		void SetMorphTarget(const int aTarget) { mMorphTarget = aTarget; }
+		int GetMorphTarget() const { return mMorphTarget; }
 
 	private:
-		Keyframe GetInterpolatedKeyframe(const float aTime, bool aLoop = true);
-		Keyframe GetInterpolatedKeyframe_Linear(const float aTime, bool aLoop);
+		Keyframe GetInterpolatedKeyframe(const float aTime, int& aCursor) const;
+		Keyframe GetInterpolatedKeyframe_Linear(const float aTime, int& aCursor) const;
+		int FindKey(const float aTime, int& aCursor) const;
 
 		AnimationTrackType mType;
 		String mName;
 		Animation* mParent;
 		tKeyframeVec mKeyframes;
+		std::vector<float> mKeyTimes;	// mKeyframes[i].time, packed for the lookup
+		std::vector<u16> mPacked;		// 3 per key once quantized
+		Vector3f mRangeMin;
+		Vector3f mRangeExtent;
+		bool mQuantized;
 		float mMaxFrameTime;
 		bool mUseLinearInterp;
 
 		Node3d* mNode;
+		int mMorphTarget;
 
 	};
+
+	// Distance between two key values, the angle in radians for rotations
+	float AnimationTrack_GetError(const AnimationTrackType aType, const Keyframe& aA, const Keyframe& aB);
+
+	// Times sequential and random key lookups on tracks of aNumKeys keys against a linear scan and logs the results
+	void AnimationTrack_Benchmark(const int aNumKeys, const int aIterations);
 }
 
 #endif
\ No newline at end of file
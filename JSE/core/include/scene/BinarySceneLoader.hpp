@@ -0,0 +1,30 @@
+#ifndef JSE_BINARY_SCENE_LOADER_H
+#define JSE_BINARY_SCENE_LOADER_H
+
+#include <memory>
+
+#include "system/SystemTypes.hpp"
+#include "system/MappedFile.hpp"
+#include "scene/SceneLoader.hpp"
+#include "scene/SceneFile.hpp"
+
+namespace jse {
+
+	// Loads the native .jsb format, mesh data stays in the mapped file until upload
+	class BinarySceneLoader : public SceneLoader
+	{
+	public:
+		BinarySceneLoader(Scene& aScene) : mScene(aScene) {}
+		int LoadScene(const String& aFilename);
+	private:
+		bool ValidateHeader() const;
+		template<class T>
+		const T* GetSection(const SceneFileSection aSection) const;
+		const char* GetString(const u32 aOffset) const;
+
+		Scene& mScene;
+		std::shared_ptr<MappedFile> mFile;
+		const SceneFileHeader_t* mHeader{};
+	};
+}
+#endif // !JSE_BINARY_SCENE_LOADER_H
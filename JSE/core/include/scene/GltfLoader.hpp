@@ -21,13 +21,24 @@ namespace jse {
 		int LoadScene(const String& aFilename);
 	private:
 		Node3d* ImportNode(const tinygltf::Node& aNode, unsigned aLevel = 0);
+		// After the nodes: joints are looked up in mNodes
+		void ImportSkins();
+		// Thread-safe: only reads mModel, writes aDst
+		bool DecodePrimitive(const tinygltf::Primitive& aPrim, Mesh3d& aDst) const;
+		bool DecodeSkinData(const tinygltf::Primitive& aPrim, const size_t aCount, Mesh3d& aDst) const;
+		bool DecodeMorphTargets(const tinygltf::Primitive& aPrim, const size_t aCount, Mesh3d& aDst) const;
+		// Float vec3 accessor of aCount elements, sparse or not, into aDst (sized by the caller)
+		bool ReadVec3(const tinygltf::Accessor& aAccessor, const size_t aCount, std::vector<vec3>& aDst) const;
+		// One weight track per morph target of aTarget's mesh
+		void ImportMorphWeights(const tinygltf::Node& aTarget, Node3d* aNode, const tinygltf::AnimationSampler& aSampler, const size_t aNumKeys, const size_t aNumValues, const float* aTimes, const float* aValues, Animation& aAnim) const;
 		template<class T>
-		void ExtractData(const tinygltf::Accessor& aAccessor, std::unique_ptr<T>& aDest);
+		void ExtractData(const tinygltf::Accessor& aAccessor, std::unique_ptr<T>& aDest) const;
 
 		Scene& mScene;
 		tinygltf::Model mModel;
 		tinygltf::TinyGLTF mLoader;
 		std::vector<unsigned int> meshOffsets;
+		std::vector<Node3d*> mNodes;	// by glTF node index
 		std::map<String, int> mNodeNameLigntIndexMap;
 	};
 }
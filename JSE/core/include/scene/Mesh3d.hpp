@@ -6,8 +6,12 @@
 #include "graphics/Material.hpp"
 #include "graphics/Renderable.hpp"
 
+#include <memory>
+
 namespace jse {
 
+	class TriangleBvh;
+
 	class VertexData
 	{
 	public:
@@ -30,11 +34,30 @@ namespace jse {
 		Vector3f tangent;
 		Vector3f bitangent;
 		Vector2f texcoord;
-		float pad[2]; // padding to 64 byte
+		u8 joints[4];	// skin joint indices, all 0 when not skinned
+		u8 weights[4];	// joint weights, /255 and summing to 255 for skinned vertices
 	};
 
 	const unsigned int kVertexDataSize = sizeof(VertexData);
 
+	// Morph targets with a smaller weight are skipped
+	const float kMorphMinWeight = 1e-4f;
+
+	// One vertex a morph target moves, 16 byte rows for the SIMD path
+	struct MorphDelta_t
+	{
+		Vector3f position;
+		u32 vertex;
+		Vector3f normal;
+		float pad;
+	};
+
+	// Sparse blend shape: only the vertices it moves, by increasing vertex index
+	struct MorphTarget_t
+	{
+		std::vector<MorphDelta_t> deltas;
+	};
+
 	typedef std::vector<VertexData> VertexDataVec;
 	typedef VertexDataVec::iterator VertexDataVecIt;
 	typedef std::vector<unsigned short> ShortPrimitiveIndices;
@@ -53,10 +76,32 @@ namespace jse {
 		void SetMaterial(const Material& aMat) { mMaterial = aMat; }
 		void ClearData();
 		void SetData(const vec3* aPositions, const vec3* aNormals, const vec4* aTangents, const vec2* aTexcoords, const size_t aCount);
+		// 4 joints and 4 weights per vertex of the last SetData
+		void SetSkinData(const u8* aJoints, const u8* aWeights);
 
 		void CompileFromData();
+
+		// Vertex cache and vertex fetch optimization, only for meshes owning their data
+		void Optimize();
+
+		// Triangle BVH of the base vertices for the scene queries, built when the scene compiles
+		void BuildBvh();
+		inline const TriangleBvh* GetBvh() const { return mBvh.get(); }
+
+		void AddMorphTarget(MorphTarget_t&& aTarget);
+		inline const std::vector<MorphTarget_t>& GetMorphTargets() const { return mMorphTargets; }
+		inline bool HasMorphTargets() const { return !mMorphTargets.empty(); }
 		void SetIndex(const unsigned int a0) { mIndex = a0; }
 		unsigned int GetIndex() const { return mIndex; }
+		inline const String& GetName() const { return mName; }
+		inline const Material& GetMaterial() const { return mMaterial; }
+
+		// Use vertex and index data owned by someone else (e.g. a mapped scene file), aOwner keeps it alive
+		void SetExternalData(std::shared_ptr<const void> aOwner, const VertexData* aVertices, const size_t aNumVertices, const unsigned short* aIndices, const size_t aNumIndices);
+		inline const VertexData* GetVertexData() const { return mExternalVertices ? mExternalVertices : vertices.data(); }
+		inline size_t GetVertexCount() const { return mExternalVertices ? mExternalNumVertices : vertices.size(); }
+		inline const unsigned short* GetIndexData() const { return mExternalIndices ? mExternalIndices : indices.data(); }
+		inline size_t GetIndexCount() const { return mExternalIndices ? mExternalNumIndices : indices.size(); }
 		
 		RenderableType GetType() const { return RenderableType::Mesh; }
 
@@ -70,14 +115,30 @@ namespace jse {
 		ShortPrimitiveIndices indices;
 		Material mMaterial;
 		unsigned int mIndex;
+		std::vector<MorphTarget_t> mMorphTargets;
+		std::shared_ptr<const TriangleBvh> mBvh;
 
 		size_t mDataCount{};
 		vec3* mPositionData{};
 		vec3* mNormalData{};
 		vec4* mTangentData{};
 		vec2* mTexcoordData{};
-
+		u8* mJointData{};
+		u8* mWeightData{};
+
+		std::shared_ptr<const void> mExternalOwner;
+		const VertexData* mExternalVertices{};
+		size_t mExternalNumVertices{};
+		const unsigned short* mExternalIndices{};
+		size_t mExternalNumIndices{};
 	};
 
+	/*
+	 Base vertices of aMesh plus the weighted deltas of its morph targets
+	 into aDst (GetVertexCount() vertices). Only the vertices a target
+	 moves are touched, targets below kMorphMinWeight are skipped.
+	*/
+	void Mesh3d_ApplyMorphTargets(const Mesh3d& aMesh, const float* aWeights, const size_t aNumWeights, VertexData* aDst);
+
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef JSE_MESH_OPTIMIZER_H
+#define JSE_MESH_OPTIMIZER_H
+
+#include "system/SystemTypes.hpp"
+#include "scene/Mesh3d.hpp"
+
+namespace jse {
+
+	const unsigned kMeshOptimizerCacheSize = 16;
+
+	// Reorders triangles for the post-transform vertex cache (Tipsify, Sander et al. 2007)
+	void MeshOpt_OptimizeVertexCache(ShortPrimitiveIndices& aIndices, const size_t aNumVertices, const unsigned aCacheSize = kMeshOptimizerCacheSize);
+
+	const unsigned kMeshOptimizerUnused = 0xFFFFFFFFU;
+
+	// Reorders vertices in first-use order and drops unreferenced ones, indices are remapped.
+	// aRemap: new index by old index, kMeshOptimizerUnused for dropped vertices
+	void MeshOpt_OptimizeVertexFetch(VertexDataVec& aVertices, ShortPrimitiveIndices& aIndices, std::vector<unsigned>* aRemap = nullptr);
+
+	// Average cache miss ratio (transformed vertices / triangle) with a FIFO cache
+	float MeshOpt_GetACMR(const ShortPrimitiveIndices& aIndices, const size_t aNumVertices, const unsigned aCacheSize = kMeshOptimizerCacheSize);
+}
+#endif
@@ -13,6 +13,7 @@
 namespace jse {
 
 	class Renderable;
+	class Skin;
 
 	typedef std::vector<Node3d*> Node3dPtrVec;
 	typedef std::vector<std::shared_ptr<Renderable>> RenderablePtrVec;
@@ -30,6 +31,8 @@ namespace jse {
 		
 		void AddScale(const Vector3f& aScale);
 		void SetTransform(const Matrix& aTransform, const bool aUpdate);
+		// Local matrix composed from translation, rotation and scale
+		void SetLocalTransform(const Vector3f& aTranslation, const Quat& aRotation, const Vector3f& aScale);
 		void UpdateRTS();
 		void SetVisible(const bool a0);
 		const Matrix& GetModelMatrix() const;
@@ -42,6 +45,8 @@ namespace jse {
 		void UpdateWorldTransform();
 		void UpdateMatrix();
 		inline const Matrix& GetWorldMatrix() const { return m_mtxWorld; };
+		// Changes every time the world matrix is recomputed
+		inline u32 GetWorldRevision() const { return mWorldRevision; }
 		inline const Node3dPtrVec& GetChildren() const { return mChildNodes; }
 		inline bool HasChildren() const { return !mChildNodes.empty(); }
 		inline const RenderablePtrVec& GetRenderables() const { return mRenderableVec; }
@@ -49,7 +54,19 @@ namespace jse {
 		inline const Vector3f GetModelPosition() const { return m_mtxModel[3]; }
 		inline const Vector3f GetWorldPosition() const { return m_mtxWorld[3]; }
 		inline const bool IsVisible() const { return mVisible; }
+		// Changes every time SetVisible changes the visibility of any node
+		static u32 GetVisibilityRevision();
 		void SetTransformUpdated();
+		// Meshes of a skinned node are deformed by the joints of aSkin, owned by the scene
+		inline void SetSkin(Skin* aSkin) { mSkin = aSkin; }
+		inline Skin* GetSkin() const { return mSkin; }
+		// Weights of the morph targets of the node's meshes, missing ones are 0
+		void SetMorphWeights(const std::vector<float>& aWeights);
+		void SetMorphWeight(const size_t aTarget, const float aWeight);
+		inline float GetMorphWeight(const size_t aTarget) const { return aTarget < mMorphWeights.size() ? mMorphWeights[aTarget] : 0.0f; }
+		inline const std::vector<float>& GetMorphWeights() const { return mMorphWeights; }
+		// Any weight large enough to move a vertex
+		bool HasActiveMorph() const;
 
 	private:
 		
@@ -67,7 +84,10 @@ namespace jse {
 		Node3dPtrVec mChildNodes;
 
 		RenderablePtrVec mRenderableVec;
+		Skin* mSkin{ nullptr };
+		std::vector<float> mMorphWeights;
 
+		u32 mWorldRevision{};
 		bool mTransformUpdated;
 		bool mVisible;
 
@@ -11,8 +11,11 @@
 #include "scene/Node3d.hpp"
 #include "scene/Mesh3d.hpp"
 #include "scene/Light.hpp"
+#include "scene/Skin.hpp"
 #include "scene/AnimationManager.hpp"
 #include "scene/Camera.hpp"
+#include "math/AabbTree.hpp"
+#include "math/TriangleBvh.hpp"
 
 #include <list>
 #include <map>
@@ -28,6 +31,7 @@ namespace jse {
 	class Mesh3d;
 	class GraphicsDriver;
 	class GltfLoader;
+	class TextureArrayAllocator;
 
 	enum RenderPass
 	{
@@ -40,20 +44,53 @@ namespace jse {
 
 	struct DrawEntityDef_t
 	{
-		DrawEntityDef_t(Mesh3d* aPtr, const MaterialType aMaterial, const Matrix& aNormalTrans, const Matrix& aModelTrans, const Matrix& aMVP) :
+		DrawEntityDef_t(Mesh3d* aPtr, const MaterialType aMaterial, const int aTextureArray, const Matrix& aNormalTrans, const Matrix& aModelTrans, const Matrix& aMVP, const int aPalette = -1, const int aDynamicBase = -1) :
 			mPtr(aPtr),
 			mMaterial(aMaterial),
+			mTextureArray(aTextureArray),
+			mPalette(aPalette),
+			mDynamicBase(aDynamicBase),
 			mNormalTrans(aNormalTrans),
 			mModelTrans(aModelTrans),
 			mMVP(aMVP) {}
 
 		Mesh3d* mPtr;
 		MaterialType mMaterial;
+		int mTextureArray;
+		int mPalette;		// first joint matrix in the joint buffer, -1: not skinned on the GPU
+		int mDynamicBase;	// base vertex in the dynamic (morphed / CPU skinned) vertex buffer, -1: static vertices
 		Matrix mNormalTrans;
 		Matrix mModelTrans;
 		Matrix mMVP;
 	};
 
+	// Closest hit of a scene ray query, in world space
+	struct SceneRayHit_t
+	{
+		Node3d* node{};
+		const Mesh3d* mesh{};
+		int triangle{ -1 };			// first index / 3 in the mesh index list
+		float t{ FLT_MAX };			// along the query ray
+		Vector3f position{ 0.0f };
+		Vector3f normal{ 0.0f };	// unit geometric normal, facing the ray origin
+	};
+
+	// Result of a scene overlap query
+	struct SceneOverlap_t
+	{
+		Node3d* node;
+		const Mesh3d* mesh;
+		int triangle;		// -1 for mesh level results
+	};
+
+	struct SceneFrameStats_t
+	{
+		int drawCalls;
+		int stateChanges;		// shader switches
+		size_t sampledTracks;	// animation tracks sampled this frame, fewer than active with animation LOD
+		size_t activeTracks;	// tracks of every playing instance
+	};
+
 	struct UniformLight
 	{
 		vec4 position;
@@ -87,6 +124,8 @@ namespace jse {
 	{
 		friend class AssimpLoader;
 		friend class GltfLoader;
+		friend class BinarySceneLoader;
+		friend class SceneFileWriter;
 
 	public:
 		Scene(const String& aName, ShaderManager* aShaderManager, GraphicsDriver* aGraphDrv, FileSystem* aFileSystem);
@@ -97,15 +136,33 @@ namespace jse {
 		void SetPerspectiveCameraLens(const float aFOV, const float aAspect, const float aZNear, const float aZFar);
 		void AddNode(Node3d* aNode, Node3d* aParent = nullptr);
 		size_t AddMesh(const Mesh3d& aSrc);
+		size_t AddMesh(Mesh3d&& aSrc);
 		std::shared_ptr<Mesh3d> GetMeshByIndex(const int aIdx);
+		inline size_t GetMeshNum() const { return mMeshes.size(); }
 		bool LoadScene(const String& aFileName, const bool aToYUp = false);
+		// CPU side of LoadScene (parse and decode), makes no graphics calls
+		bool LoadSceneData(const String& aFileName);
+		bool SaveScene(const String& aFileName);
 		bool Compile();
+		// Incremental Compile: BeginCompile, UploadMesh for every mesh, EndCompile
+		bool BeginCompile();
+		size_t UploadMesh(const size_t aIndex);
+		bool EndCompile();
+		inline bool IsCompiled() const { return mCompiled; }
 		void Draw();
 		inline float GetDefaultLightRadius() const { return mDefaultLightRadius; }
 		float SetDefaultLightRadius(const float a0);
 		Node3d* GetNodeByName(const String& aName);
 
 		void UpdateAnimation(const float aFrameStep);
+		// Applied to animations as they are loaded, scene files only get quantized (their keys were reduced when cooked)
+		inline void SetAnimationCompression(const AnimationCompressParams_t& aParams) { mAnimCompress = aParams; }
+		inline AnimationManager& GetAnimationManager() { return mAnimMgr; }
+
+		// Counters of the last Draw and UpdateAnimation
+		SceneFrameStats_t GetFrameStats() const;
+		// Logs the frame stats every aFrames frames, 0 disables
+		inline void SetStatsLogInterval(const int aFrames) { mStatsLogInterval = aFrames; }
 
 		MeshQueryResult GetMeshByName(const String& aName);
 
@@ -113,14 +170,66 @@ namespace jse {
 
 		Camera& GetCamera() { return mCamera; }
 
+		// Arrays the material texture layers refer to, the scene does not own it
+		inline void SetTextureArrays(TextureArrayAllocator* aArrays) { mTextureArrays = aArrays; }
+
+		inline size_t GetSkinNum() const { return mSkins.size(); }
+		inline Skin* GetSkin(const size_t aIdx) const { return mSkins[aIdx].get(); }
+		// Skinned meshes are deformed on the CPU into a dynamic vertex buffer instead of in the vertex shader
+		inline void SetCpuSkinning(const bool a0) { mCpuSkinning = a0; }
+		inline bool GetCpuSkinning() const { return mCpuSkinning; }
+
+		/*
+		 Spatial queries. The world bounds of the mesh nodes are kept in a
+		 dynamic AABB tree and every mesh has a triangle BVH, rays hit the
+		 triangles. Every query refits the nodes that moved first, only the
+		 world matrices that changed are recomputed. Hidden nodes and their
+		 children are left out. Skinned and morphed meshes are hit in their
+		 bind pose.
+		*/
+		void UpdateBounds();
+		bool RayCast(const Ray_t& aRay, SceneRayHit_t& aHit);
+		// t of the hit is the fraction of the way from aFrom to aTo
+		bool SegmentCast(const Vector3f& aFrom, const Vector3f& aTo, SceneRayHit_t& aHit);
+		bool LineOfSight(const Vector3f& aFrom, const Vector3f& aTo);
+		// Rays in SIMD packets, aHits[i].mesh is null for a miss. Returns the number of hits
+		size_t RayCastBatch(const Ray_t* aRays, const size_t aCount, SceneRayHit_t* aHits);
+		// Meshes whose bounds overlap aBox, with aTriangles the triangles intersecting it instead
+		void QueryAabb(const Aabb_t& aBox, std::vector<SceneOverlap_t>& aResults, const bool aTriangles = false);
+		// Meshes whose bounds are not outside aFrustum, culled hierarchically
+		void QueryFrustum(const Frustum& aFrustum, std::vector<SceneOverlap_t>& aResults);
+		// World ray through a viewport point in normalized device coordinates, from the near to the far plane
+		Ray_t GetPickRay(const Vector2f& aNdc) const;
+		inline const AabbTree& GetBoundsTree() const { return mBoundsTree; }
+
 	private:
 
-		void BuildDrawList(Node3d* node);
+		struct SceneBounds_t
+		{
+			Node3d* node;
+			const Mesh3d* mesh;
+			int proxy;
+			u32 revision;		// world revision of the node the bounds are from
+			Aabb_t bounds;
+			Matrix invWorld;
+		};
+
+		void CollectDrawNodes(Node3d* node);
+		void CollectBoundsNodes(Node3d* aNode);
+		// nodes were added or shown or hidden since the bounds were built
+		inline bool IsBoundsDirty() const { return mBoundsDirty || mVisibilityRevision != Node3d::GetVisibilityRevision(); }
+		void BuildDrawList();
 		void DrawList();
-		void DrawMesh(const Mesh3d* aMesh);
+		void DrawMesh(const Mesh3d* aMesh, const int aBaseVertex = -1);
+		void AddMeshEntities(Node3d* aNode, const Matrix& aNormalTrans, const Matrix& aModelTrans, const Matrix& aMVP);
+		void UploadDynamicData();
+		void PrepareShaders();
+		bool TraceRay(const Ray_t& aRay, SceneRayHit_t& aHit, const bool aAnyHit);
+		void FillRayHit(const SceneBounds_t& aEntry, const Ray_t& aRay, const TriangleHit_t& aTriHit, SceneRayHit_t& aHit) const;
 		void Init();
 
 		AnimationManager mAnimMgr;
+		AnimationCompressParams_t mAnimCompress;
 
 		String mName;
 		Node3d mRootNode;
@@ -139,17 +248,36 @@ namespace jse {
 		BufferObject* mBuffers[2];
 		BufferObject* mLightsBuffer;
 
+		std::vector<std::unique_ptr<Skin>> mSkins;
+		std::vector<Matrix> mPalettes;		// joint matrices of this frame's skinned draws
+		VertexDataVec mDynamicVertices;		// morphed and CPU skinned vertices of this frame
+		BufferObject* mJointsBuffer;
+		BufferObject* mDynamicVB;
+		VertexArray* mDynamicVA;
+		int mPaletteAlign;					// in matrices, for the uniform buffer offset alignment
+		bool mCpuSkinning;
+
 		bool mCompiled;
 		float mDefaultLightRadius;
 		float mDefaultLightRadius2;
 
 		GpuShader* mCurrentShader;
+		TextureArrayAllocator* mTextureArrays;
 
 		Matrix mV, mP, mVP, mMVP;
 		Vector3f mViewPos;
 		RenderPass mRPass;
 
 		DrawEntityVec mDrawList;
+		std::vector<Node3d*> mDrawNodes;	// visible nodes with renderables, children first
+		std::vector<Matrix> mDrawWorld;		// per draw node: world, normal and MVP matrix
+		std::vector<Matrix> mDrawNormal;
+		std::vector<Matrix> mDrawMVP;
+
+		AabbTree mBoundsTree;
+		std::vector<SceneBounds_t> mBounds;
+		bool mBoundsDirty;
+		u32 mVisibilityRevision;	// Node3d visibility revision of the bounds
 
 		std::map<String, Node3d*> mNodeByName;
 
@@ -158,6 +286,7 @@ namespace jse {
 		int m_drawCallsPerFrame{ 0 };
 		int m_stateChangePerFrame{ 0 };
 		int m_sampleCount{ 0 };
+		int mStatsLogInterval{ 0 };
 
 		Camera mCamera;
 		RenderLightVec mUniformLights;
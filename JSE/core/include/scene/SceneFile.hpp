@@ -0,0 +1,183 @@
+#ifndef JSE_SCENE_FILE_H
+#define JSE_SCENE_FILE_H
+
+#include "system/SystemTypes.hpp"
+#include "graphics/GraphicsTypes.hpp"
+
+/*
+=========================================
+ Native binary scene format (.jsb)
+
+ [SceneFileHeader_t]
+ [section 0] [section 1] ... each section starts on a 64 byte boundary
+
+ Vertex and index sections hold the data exactly as Scene::Compile
+ uploads it (VertexData / unsigned short), so a loader can hand the
+ mapped file to the GPU without touching individual vertices.
+ All offsets are relative to the beginning of the file, strings are
+ stored as offsets into the null terminated string table.
+=========================================
+*/
+
+namespace jse {
+
+	class Scene;
+
+	const u32 kSceneFileMagic = 0x4E43534A; // "JSCN"
+	const u32 kSceneFileVersion = 3;
+	const u32 kSceneFileAlign = 64;
+	const u32 kSceneFileNoIndex = 0xFFFFFFFFU;
+	const char* const kSceneFileExt = ".jsb";
+
+	enum SceneFileSection
+	{
+		SceneFileSection_Strings,
+		SceneFileSection_Nodes,
+		SceneFileSection_NodeMeshRefs,
+		SceneFileSection_Meshes,
+		SceneFileSection_Materials,
+		SceneFileSection_Lights,
+		SceneFileSection_Animations,
+		SceneFileSection_Tracks,
+		SceneFileSection_Keys,
+		SceneFileSection_Skins,
+		SceneFileSection_SkinJoints,
+		SceneFileSection_MorphTargets,
+		SceneFileSection_MorphDeltas,
+		SceneFileSection_MorphWeights,
+		SceneFileSection_Vertices,
+		SceneFileSection_Indices,
+		SceneFileSection_LastEnum
+	};
+
+	#define SceneFileNodeFlag_Visible	(1U << 0)
+
+	struct SceneFileSection_t
+	{
+		u64 offset;
+		u64 size;
+		u32 count;
+		u32 pad;
+	};
+
+	struct SceneFileHeader_t
+	{
+		u32 magic;
+		u32 version;
+		u32 vertexSize;		// sizeof(VertexData) the file was written with
+		u32 numSections;
+		SceneFileSection_t sections[SceneFileSection_LastEnum];
+	};
+
+	// nodes are stored parent first, parent == kSceneFileNoIndex means child of the scene root
+	struct SceneFileNode_t
+	{
+		u32 name;
+		u32 parent;
+		u32 flags;
+		u32 firstMeshRef;
+		u32 numMeshRefs;
+		u32 light;
+		u32 skin;
+		u32 firstMorphWeight;
+		u32 numMorphWeights;
+		float transform[16];
+	};
+
+	struct SceneFileMesh_t
+	{
+		u32 name;
+		u32 material;
+		u32 numVertices;
+		u32 numIndices;
+		u32 firstMorphTarget;
+		u32 numMorphTargets;
+		u64 vertexOffset;	// byte offset inside the vertex section
+		u64 indexOffset;	// byte offset inside the index section
+	};
+
+	struct SceneFileMaterial_t
+	{
+		u32 type;
+		float ambient[3];
+		float diffuse[3];
+		float specular[3];
+		float specularIntensity;
+		float alpha;
+	};
+
+	struct SceneFileLight_t
+	{
+		u32 name;
+		u32 type;
+		float diffuse[3];
+		float specular[3];
+		float linearAtt;
+		float quadraticAtt;
+		float cutoff;
+	};
+
+	struct SceneFileAnimation_t
+	{
+		u32 name;
+		u32 firstTrack;
+		u32 numTracks;
+		float length;
+		float ticksPerSec;
+	};
+
+	struct SceneFileTrack_t
+	{
+		u32 name;
+		u32 type;
+		u32 node;
+		u32 firstKey;
+		u32 numKeys;
+		u32 morphTarget;
+	};
+
+	struct SceneFileKey_t
+	{
+		float time;
+		float value[4];
+	};
+
+	struct SceneFileSkin_t
+	{
+		u32 name;
+		u32 firstJoint;
+		u32 numJoints;
+	};
+
+	struct SceneFileSkinJoint_t
+	{
+		u32 node;
+		float inverseBind[16];
+	};
+
+	struct SceneFileMorphTarget_t
+	{
+		u32 firstDelta;
+		u32 numDeltas;
+	};
+
+	// same layout as MorphDelta_t
+	struct SceneFileMorphDelta_t
+	{
+		float position[3];
+		u32 vertex;
+		float normal[3];
+		float pad;
+	};
+
+	class SceneFileWriter
+	{
+	public:
+		SceneFileWriter(Scene& aScene) : mScene(aScene) {}
+		bool Write(const String& aFileName);
+
+	private:
+		Scene& mScene;
+	};
+}
+#endif // !JSE_SCENE_FILE_H
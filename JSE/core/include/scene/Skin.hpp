@@ -0,0 +1,62 @@
+#ifndef JSE_SKIN_H
+#define JSE_SKIN_H
+
+#include <vector>
+
+#include "system/SystemTypes.hpp"
+#include "graphics/GraphicsTypes.hpp"
+
+/*
+=========================================
+ Skeletal skinning
+
+ A skin is the list of joint nodes with their inverse bind matrices.
+ Every frame the joint palette of a skinned node is built on the CPU
+ from the world transforms of the joints:
+
+	palette[j] = inverse(meshWorld) * jointWorld[j] * inverseBind[j]
+
+ so skinned vertices stay in the mesh space of the node and the
+ node's M / MVP apply unchanged. Vertices carry 4 joint indices and
+ 4 weights (u8, summing to 255), the vertex shader blends the palette
+ matrices (skinning.glsl); Skin_SkinVertices does the same on the CPU.
+=========================================
+*/
+
+namespace jse {
+
+	class Node3d;
+	class Mesh3d;
+	class VertexData;
+
+	// Joints a skin and a vertex can address, the palette of one draw is a 16KB uniform block
+	const int kMaxSkinJoints = 256;
+
+	class Skin
+	{
+	public:
+		Skin(const String& aName);
+
+		void AddJoint(Node3d* aJoint, const Matrix& aInverseBind);
+
+		inline const String& GetName() const { return mName; }
+		inline size_t GetJointNum() const { return mJoints.size(); }
+		inline Node3d* GetJoint(const size_t aIdx) const { return mJoints[aIdx]; }
+		inline const Matrix& GetInverseBind(const size_t aIdx) const { return mInverseBind[aIdx]; }
+
+		// False if a weighted joint index of aMesh is out of the joint list
+		bool CanDeform(const Mesh3d& aMesh) const;
+
+		// Writes GetJointNum() matrices, joint world transforms must be up to date
+		void ComputePalette(const Matrix& aMeshWorld, Matrix* aPalette) const;
+
+	private:
+		String mName;
+		std::vector<Node3d*> mJoints;
+		std::vector<Matrix> mInverseBind;
+	};
+
+	// CPU skinning of position, normal, tangent and bitangent, the other attributes are copied
+	void Skin_SkinVertices(const VertexData* aSrc, const size_t aCount, const Matrix* aPalette, VertexData* aDst);
+}
+#endif
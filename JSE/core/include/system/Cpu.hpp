@@ -0,0 +1,42 @@
+#ifndef JSE_CPU_H
+#define JSE_CPU_H
+
+#include "system/SystemTypes.hpp"
+
+/*
+ x86 SIMD code paths are compiled in on x86 targets only. SSE4.1
+ and AVX2 functions are tagged with JSE_TARGET_SSE41/JSE_TARGET_AVX2
+ and must be selected at runtime with Cpu_HasSSE41()/Cpu_HasAVX2().
+*/
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define JSE_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(JSE_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define JSE_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define JSE_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define JSE_TARGET_SSE41
+#define JSE_TARGET_AVX2
+#endif
+
+namespace jse {
+
+	enum SimdLevel
+	{
+		SimdLevel_Scalar,
+		SimdLevel_SSE,		// SSE4.1
+		SimdLevel_AVX2,		// AVX2 + FMA
+		SimdLevel_LastEnum
+	};
+
+	bool Cpu_HasSSE41();
+	bool Cpu_HasAVX2();
+
+	// Best level supported by both the build and the running CPU
+	SimdLevel Cpu_GetSimdLevel();
+	const char* Cpu_GetSimdLevelName(const SimdLevel aLevel);
+}
+#endif
@@ -0,0 +1,21 @@
+#ifndef JSE_HASH_H
+#define JSE_HASH_H
+
+#include "system/SystemTypes.hpp"
+
+namespace jse {
+
+	// 64 bit xxHash (XXH64), stable across runs and platforms
+	u64 Hash64(const void* aData, const size_t aSize, const u64 aSeed = 0);
+	inline u64 Hash64(const String& aStr, const u64 aSeed = 0) { return Hash64(aStr.data(), aStr.size(), aSeed); }
+	inline u64 Hash64(const ByteVector& aData, const u64 aSeed = 0) { return Hash64(aData.data(), aData.size(), aSeed); }
+
+	// Order dependent combination of two hashes
+	inline u64 HashCombine(const u64 aSeed, const u64 aValue)
+	{
+		return Hash64(&aValue, sizeof(aValue), aSeed);
+	}
+
+	String HashToString(const u64 aHash);
+}
+#endif
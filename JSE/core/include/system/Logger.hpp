@@ -3,6 +3,7 @@
 
 #include <string>
 #include <cstdio>
+#include <mutex>
 
 namespace jse
 {
@@ -20,6 +21,7 @@ namespace jse
 		void ReopenFile();
 		FILE* file;
 		std::string fileName;
+		std::mutex mtx;
 	};
 
 	void Info(const char* fmt, ...);
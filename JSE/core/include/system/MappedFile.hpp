@@ -0,0 +1,38 @@
+#ifndef JSE_MAPPED_FILE_H
+#define JSE_MAPPED_FILE_H
+
+#include "system/SystemTypes.hpp"
+
+namespace jse {
+
+	// Read-only memory mapped file
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool Open(const String& aFileName);
+		void Close();
+
+		inline const u8* GetData() const { return mData; }
+		inline size_t GetSize() const { return mSize; }
+		inline bool IsOpen() const { return mData != nullptr; }
+		inline const String& GetFileName() const { return mFileName; }
+
+	private:
+		String mFileName;
+		const u8* mData;
+		size_t mSize;
+#ifdef _WIN32
+		void* mFileHandle;
+		void* mMappingHandle;
+#else
+		int mFd;
+#endif
+	};
+}
+#endif
@@ -31,6 +31,9 @@ namespace jse {
     typedef int8_t i8;
     typedef uint8_t u8;
 
+    typedef int16_t i16;
+    typedef uint16_t u16;
+
     enum { INT_TYPE, FLOAT_TYPE };
 
     struct AnyValue
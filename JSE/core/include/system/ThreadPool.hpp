@@ -0,0 +1,61 @@
+#ifndef JSE_THREAD_POOL_H
+#define JSE_THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+#include "system/SystemTypes.hpp"
+
+namespace jse {
+
+	typedef std::function<void()> JobFunc;
+	typedef std::function<void(size_t)> ParallelForFunc;
+
+	class ThreadPool
+	{
+	public:
+		// aNumThreads == 0 means one worker per hardware thread (at least one)
+		ThreadPool(const unsigned aNumThreads = 0);
+		~ThreadPool();
+
+		void Enqueue(JobFunc aJob);
+
+		template<class F>
+		auto Submit(F&& aFunc) -> std::future<decltype(aFunc())>
+		{
+			typedef decltype(aFunc()) tResult;
+
+			auto task = std::make_shared<std::packaged_task<tResult()>>(std::forward<F>(aFunc));
+			std::future<tResult> res = task->get_future();
+			Enqueue([task]() { (*task)(); });
+
+			return res;
+		}
+
+		// Runs aFunc(0..aCount-1) on the workers and the calling thread, returns when all done.
+		// Safe to call from inside a job: the caller keeps pulling indices itself.
+		void ParallelFor(const size_t aCount, const ParallelForFunc& aFunc, const size_t aGrainSize = 1);
+
+		inline unsigned GetNumThreads() const { return unsigned(mWorkers.size()); }
+
+	private:
+		void WorkerLoop();
+
+		std::vector<std::thread> mWorkers;
+		std::deque<JobFunc> mJobs;
+		std::mutex mMutex;
+		std::condition_variable mCondition;
+		bool mStop;
+	};
+
+	// Engine-wide pool, created on first use
+	ThreadPool& GetDefaultThreadPool();
+}
+
+#endif
@@ -33,6 +33,10 @@ namespace jse {
 		}
 
 		inline void Reset() { start = std::chrono::steady_clock::now(); }
+		inline double GetElapsedMs() const
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
 		inline void PrintElapsedTime(const String& aMsg)
 		{
 			auto end = std::chrono::steady_clock::now();
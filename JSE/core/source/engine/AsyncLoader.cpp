@@ -0,0 +1,219 @@
+#include <chrono>
+#include <thread>
+
+#include "engine/AsyncLoader.hpp"
+#include "scene/Scene.hpp"
+#include "graphics/Texture.hpp"
+#include "system/Logger.hpp"
+
+namespace jse {
+
+	class SceneLoadRequest : public LoadRequest
+	{
+	public:
+		SceneLoadRequest(Scene* aScene, const String& aFileName) : LoadRequest(aFileName), mScene(aScene) {}
+
+	protected:
+		bool Decode() override { return mScene->LoadSceneData(GetFileName()); }
+
+		void BeginUpload() override
+		{
+			mScene->BeginCompile();
+			mNumMeshes = mScene->GetMeshNum();
+		}
+
+		size_t UploadNext() override { return mScene->UploadMesh(mNextMesh++); }
+		bool IsUploadDone() const override { return mNextMesh >= mNumMeshes; }
+		float GetUploadProgress() const override { return mNumMeshes ? float(mNextMesh) / float(mNumMeshes) : 1.0f; }
+
+		bool EndUpload() override
+		{
+			mScene->UpdateLights();
+
+			return mScene->EndCompile();
+		}
+
+	private:
+		Scene* mScene;
+		size_t mNextMesh{};
+		size_t mNumMeshes{};
+	};
+
+	class TextureLoadRequest : public LoadRequest
+	{
+	public:
+		TextureLoadRequest(Texture* aTexture, const String& aFileName) : LoadRequest(aFileName), mTexture(aTexture) {}
+
+	protected:
+		bool Decode() override { return Texture::DecodeFile(GetFileName(), mBitmap); }
+
+		size_t UploadNext() override
+		{
+			const size_t bytes = mBitmap.GetTotalSize();
+
+			mTexture->SetFileName(GetFileName());
+			mResult = mTexture->UploadBitmap(mBitmap);
+			mUploaded = true;
+			mBitmap = Bitmap();
+
+			return bytes;
+		}
+
+		bool IsUploadDone() const override { return mUploaded; }
+		float GetUploadProgress() const override { return mUploaded ? 1.0f : 0.0f; }
+		bool EndUpload() override { return mResult; }
+
+	private:
+		Texture* mTexture;
+		Bitmap mBitmap;
+		bool mUploaded{};
+		bool mResult{};
+	};
+
+	float LoadRequest::GetProgress() const
+	{
+		switch (GetState())
+		{
+		case LoadState_Uploading:
+			// decoding is counted as the first half
+			return mUploadStarted ? 0.5f + 0.5f * GetUploadProgress() : 0.5f;
+		case LoadState_Done:
+		case LoadState_Failed:
+			return 1.0f;
+		default:
+			return 0.0f;
+		}
+	}
+
+	AsyncLoader::AsyncLoader(ThreadPool& aPool) : Updateable("AsyncLoader"), mPool(aPool)
+	{
+		mBudgetBytes = kDefaultUploadBytesPerFrame;
+		mBudgetMs = kDefaultUploadMsPerFrame;
+		mLastFrameBytes = 0;
+	}
+
+	AsyncLoader::~AsyncLoader()
+	{
+		// decode jobs write into the scenes/textures, let them finish
+		for (const auto& it : mRequests)
+		{
+			while (it->GetState() < LoadState_Uploading)
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void AsyncLoader::SetUploadBudget(const size_t aBytesPerFrame, const float aMsPerFrame)
+	{
+		mBudgetBytes = aBytesPerFrame;
+		mBudgetMs = aMsPerFrame;
+	}
+
+	LoadHandle AsyncLoader::LoadScene(Scene* aScene, const String& aFileName, LoadCallback aOnProgress, LoadCallback aOnComplete)
+	{
+		return Submit(std::make_shared<SceneLoadRequest>(aScene, aFileName), aOnProgress, aOnComplete);
+	}
+
+	LoadHandle AsyncLoader::LoadTexture(Texture* aTexture, const String& aFileName, LoadCallback aOnProgress, LoadCallback aOnComplete)
+	{
+		return Submit(std::make_shared<TextureLoadRequest>(aTexture, aFileName), aOnProgress, aOnComplete);
+	}
+
+	LoadHandle AsyncLoader::Submit(LoadHandle aRequest, LoadCallback aOnProgress, LoadCallback aOnComplete)
+	{
+		aRequest->mOnProgress = aOnProgress;
+		aRequest->mOnComplete = aOnComplete;
+		mRequests.push_back(aRequest);
+
+		mPool.Enqueue([aRequest]() {
+			aRequest->mState = LoadState_Decoding;
+
+			const bool ok = aRequest->Decode();
+			if (!ok)
+			{
+				Error("AsyncLoader: failed to load %s", aRequest->GetFileName().c_str());
+			}
+
+			aRequest->mState = ok ? LoadState_Uploading : LoadState_Failed;
+		});
+
+		return aRequest;
+	}
+
+	void AsyncLoader::Finish(const LoadHandle& aRequest, const bool aResult)
+	{
+		aRequest->mState = aResult ? LoadState_Done : LoadState_Failed;
+		aRequest->mPromise.set_value(aResult);
+
+		if (aRequest->mOnProgress)
+		{
+			aRequest->mOnProgress(aRequest);
+		}
+		if (aRequest->mOnComplete)
+		{
+			aRequest->mOnComplete(aRequest);
+		}
+	}
+
+	void AsyncLoader::Update(float aTimeStep)
+	{
+		using namespace std::chrono;
+
+		const auto start = steady_clock::now();
+		size_t bytes = 0;
+		bool budgetLeft = true;
+
+		for (auto it = mRequests.begin(); it != mRequests.end();)
+		{
+			const LoadHandle req = *it;
+			const LoadState state = req->GetState();
+
+			if (state == LoadState_Failed)
+			{
+				Finish(req, false);
+				it = mRequests.erase(it);
+				continue;
+			}
+
+			if (state != LoadState_Uploading || !budgetLeft)
+			{
+				++it;
+				continue;
+			}
+
+			if (!req->mUploadStarted)
+			{
+				req->BeginUpload();
+				req->mUploadStarted = true;
+			}
+
+			// at least one upload per frame, so oversized items still get through
+			while (!req->IsUploadDone() && budgetLeft)
+			{
+				bytes += req->UploadNext();
+
+				const float elapsedMs = duration<float, std::milli>(steady_clock::now() - start).count();
+				budgetLeft = bytes < mBudgetBytes && elapsedMs < mBudgetMs;
+			}
+
+			if (req->IsUploadDone())
+			{
+				Finish(req, req->EndUpload());
+				it = mRequests.erase(it);
+				continue;
+			}
+
+			const float progress = req->GetProgress();
+			if (req->mOnProgress && progress != req->mReportedProgress)
+			{
+				req->mReportedProgress = progress;
+				req->mOnProgress(req);
+			}
+
+			++it;
+		}
+
+		mLastFrameBytes = bytes;
+	}
+}
@@ -0,0 +1,332 @@
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <algorithm>
+
+#include "engine/TextureStreamer.hpp"
+#include "graphics/GraphicsDriver.hpp"
+#include "graphics/Texture.hpp"
+#include "system/Logger.hpp"
+
+namespace jse {
+
+	TextureStreamer::TextureStreamer(GraphicsDriver* aDriver, ThreadPool& aPool) : Updateable("TextureStreamer"), mDriver(aDriver), mPool(aPool)
+	{
+		mBudget = kDefaultStreamingBudget;
+		mUploadBudget = kDefaultStreamUploadBytesPerFrame;
+		mResidentBytes = 0;
+		mPendingBytes = 0;
+		mNumJobs = 0;
+		mFrame = 1;
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+		// jobs hold their own data, only wait so nothing runs past the streamer
+		for (const auto& it : mTextures)
+		{
+			while (it->job && !it->job->done.load())
+			{
+				std::this_thread::yield();
+			}
+
+			delete it->texture;
+		}
+	}
+
+	void TextureStreamer::SetBudget(const size_t aBytes)
+	{
+		mBudget = aBytes;
+	}
+
+	void TextureStreamer::SetUploadBudget(const size_t aBytesPerFrame)
+	{
+		mUploadBudget = aBytesPerFrame;
+	}
+
+	Texture* TextureStreamer::Load(const String& aFileName)
+	{
+		Texture* texture = mDriver->CreateTexture();
+		texture->SetName(aFileName);
+		texture->SetFileName(aFileName);
+		texture->SetMinMagFilter(TextureFilter_Linear_Mipmap_Linear, TextureFilter_Linear);
+
+		auto tex = std::make_unique<StreamedTexture_t>();
+		tex->texture = texture;
+		tex->fileName = aFileName;
+
+		StartJob(tex.get(), -1);
+
+		mByTexture[texture] = tex.get();
+		mTextures.push_back(std::move(tex));
+
+		return texture;
+	}
+
+	void TextureStreamer::RequestScreenSize(Texture* aTexture, const float aPixels)
+	{
+		auto it = mByTexture.find(aTexture);
+		if (it == mByTexture.end())
+			return;
+
+		StreamedTexture_t* tex = it->second;
+		if (tex->lastUsed != mFrame)
+		{
+			tex->lastUsed = mFrame;
+			tex->requestedPixels = 0.0f;
+		}
+
+		tex->requestedPixels = std::max(tex->requestedPixels, aPixels);
+	}
+
+	void TextureStreamer::RequestBounds(Texture* aTexture, const Vector3f& aCenter, const float aRadius, const Vector3f& aViewPos, const Matrix& aProj, const int aViewportHeight)
+	{
+		RequestScreenSize(aTexture, GetProjectedSize(aCenter, aRadius, aViewPos, aProj, aViewportHeight));
+	}
+
+	float TextureStreamer::GetProjectedSize(const Vector3f& aCenter, const float aRadius, const Vector3f& aViewPos, const Matrix& aProj, const int aViewportHeight)
+	{
+		const Vector3f d = aCenter - aViewPos;
+		const float dist2 = d.x * d.x + d.y * d.y + d.z * d.z;
+
+		// camera inside the sphere: wants everything
+		if (dist2 <= aRadius * aRadius)
+			return std::numeric_limits<float>::max();
+
+		// aProj[1][1] = 1 / tan(fovY / 2)
+		return float(aViewportHeight) * aRadius * aProj[1][1] / std::sqrt(dist2 - aRadius * aRadius);
+	}
+
+	int TextureStreamer::GetResidentMip(const Texture* aTexture) const
+	{
+		auto it = mByTexture.find(aTexture);
+
+		return it != mByTexture.end() ? it->second->residentMip : -1;
+	}
+
+	size_t TextureStreamer::GetBytesFrom(const StreamedTexture_t* aTex, const int aMip) const
+	{
+		size_t bytes = 0;
+		for (size_t mip = std::max(0, aMip); mip < aTex->levelBytes.size(); ++mip)
+		{
+			bytes += aTex->levelBytes[mip];
+		}
+
+		return bytes;
+	}
+
+	int TextureStreamer::GetMipForPixels(const StreamedTexture_t* aTex, const float aPixels) const
+	{
+		if (aPixels <= 0.0f)
+			return aTex->baseMip;
+
+		// largest level whose size still covers aPixels
+		const float ratio = float(aTex->fullSize) / aPixels;
+		const int mip = ratio <= 1.0f ? 0 : int(std::floor(std::log2(ratio)));
+
+		return std::min(mip, aTex->baseMip);
+	}
+
+	bool TextureStreamer::FitsBudget(const i64 aGrowth) const
+	{
+		return i64(mResidentBytes) + mPendingBytes + aGrowth <= i64(mBudget);
+	}
+
+	void TextureStreamer::StartJob(StreamedTexture_t* aTex, const int aFirstMip)
+	{
+		auto job = std::make_shared<StreamJob_t>();
+		job->firstMip = aFirstMip;
+		job->expectedBytes = aFirstMip < 0 ? 0 : i64(GetBytesFrom(aTex, aFirstMip)) - i64(GetBytesFrom(aTex, aTex->residentMip));
+
+		aTex->job = job;
+		mPendingBytes += job->expectedBytes;
+		mNumJobs++;
+
+		const String fileName = aTex->fileName;
+
+		mPool.Enqueue([job, fileName]() {
+			Bitmap& bitmap = job->bitmap;
+
+			if (Texture::DecodeFile(fileName, bitmap))
+			{
+				const int numMips = bitmap.GetNumMipmaps();
+
+				job->fullSize = std::max(bitmap.GetSizeX(), bitmap.GetSizeY());
+				job->levelBytes.assign(numMips, 0);
+
+				for (int image = 0; image < bitmap.GetNumImages(); ++image)
+				{
+					for (int mip = 0; mip < numMips; ++mip)
+					{
+						job->levelBytes[mip] += bitmap.GetData(image, mip)->GetSize();
+					}
+				}
+
+				int first = job->firstMip;
+				if (first < 0)
+				{
+					first = 0;
+					while (first < numMips - 1 && std::max(bitmap.GetMipSizeX(first), bitmap.GetMipSizeY(first)) > kStreamBaseSize)
+					{
+						first++;
+					}
+				}
+
+				job->firstMip = std::min(first, numMips - 1);
+				bitmap.RemoveTopMipmaps(job->firstMip);
+				job->ok = true;
+			}
+
+			job->done = true;
+		});
+	}
+
+	bool TextureStreamer::FinishJob(StreamedTexture_t* aTex, size_t& aBytes)
+	{
+		std::shared_ptr<StreamJob_t> job = aTex->job;
+
+		aTex->job.reset();
+		mPendingBytes -= job->expectedBytes;
+		mNumJobs--;
+
+		if (!job->ok)
+		{
+			Error("TextureStreamer: cannot load %s", aTex->fileName.c_str());
+			aTex->failed = aTex->residentMip < 0;
+			return false;
+		}
+
+		if (aTex->levelBytes.empty())
+		{
+			aTex->levelBytes = job->levelBytes;
+			aTex->fullSize = job->fullSize;
+			aTex->baseMip = job->firstMip;
+		}
+
+		const size_t oldBytes = aTex->residentMip < 0 ? 0 : GetBytesFrom(aTex, aTex->residentMip);
+
+		if (!aTex->texture->UploadBitmap(job->bitmap))
+		{
+			aTex->failed = aTex->residentMip < 0;
+			return false;
+		}
+
+		aTex->residentMip = job->firstMip;
+		mResidentBytes = mResidentBytes - oldBytes + GetBytesFrom(aTex, aTex->residentMip);
+		aBytes += job->bitmap.GetTotalSize();
+
+		return true;
+	}
+
+	bool TextureStreamer::EvictOne(const StreamedTexture_t* aKeep)
+	{
+		StreamedTexture_t* victim = nullptr;
+
+		// least recently used first, textures drawn this frame only down to the level they need
+		for (const auto& it : mTextures)
+		{
+			StreamedTexture_t* tex = it.get();
+
+			if (tex == aKeep || tex->job || tex->residentMip < 0 || tex->residentMip >= tex->baseMip)
+				continue;
+
+			if (tex->lastUsed == mFrame && tex->residentMip >= tex->wantedMip)
+				continue;
+
+			if (!victim || tex->lastUsed < victim->lastUsed)
+			{
+				victim = tex;
+			}
+		}
+
+		if (!victim)
+			return false;
+
+		if (victim->texture->DropTopMips(1))
+		{
+			mResidentBytes -= victim->levelBytes[victim->residentMip];
+			victim->residentMip++;
+		}
+		else
+		{
+			// no GPU side copy: reload without the top level, released when it lands
+			StartJob(victim, victim->residentMip + 1);
+		}
+
+		return true;
+	}
+
+	void TextureStreamer::Update(float aTimeStep)
+	{
+		// finished loads, at least one per frame so large textures get through
+		size_t bytes = 0;
+		for (const auto& it : mTextures)
+		{
+			StreamedTexture_t* tex = it.get();
+
+			if (!tex->job || !tex->job->done.load())
+				continue;
+
+			FinishJob(tex, bytes);
+
+			if (bytes >= mUploadBudget)
+				break;
+		}
+
+		for (const auto& it : mTextures)
+		{
+			StreamedTexture_t* tex = it.get();
+
+			if (tex->residentMip >= 0)
+			{
+				tex->wantedMip = tex->lastUsed == mFrame ? GetMipForPixels(tex, tex->requestedPixels) : tex->baseMip;
+			}
+		}
+
+		// budget lowered or reloads pending
+		while (!FitsBudget(0) && EvictOne(nullptr)) {}
+
+		std::vector<StreamedTexture_t*> candidates;
+		for (const auto& it : mTextures)
+		{
+			StreamedTexture_t* tex = it.get();
+
+			if (!tex->job && !tex->failed && tex->residentMip >= 0 && tex->wantedMip < tex->residentMip)
+			{
+				candidates.push_back(tex);
+			}
+		}
+
+		// most missing levels first, then the largest on screen
+		std::sort(candidates.begin(), candidates.end(), [](const StreamedTexture_t* a, const StreamedTexture_t* b) {
+			const int da = a->residentMip - a->wantedMip;
+			const int db = b->residentMip - b->wantedMip;
+
+			return da != db ? da > db : a->requestedPixels > b->requestedPixels;
+		});
+
+		for (StreamedTexture_t* tex : candidates)
+		{
+			if (mNumJobs >= kMaxStreamJobs)
+				break;
+
+			int target = tex->wantedMip;
+			for (; target < tex->residentMip; ++target)
+			{
+				const i64 growth = i64(GetBytesFrom(tex, target)) - i64(GetBytesFrom(tex, tex->residentMip));
+
+				while (!FitsBudget(growth) && EvictOne(tex)) {}
+
+				if (FitsBudget(growth))
+					break;
+			}
+
+			if (target < tex->residentMip)
+			{
+				StartJob(tex, target);
+			}
+		}
+
+		mFrame++;
+	}
+}
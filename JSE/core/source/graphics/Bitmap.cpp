@@ -1,4 +1,8 @@
+#include <cstring>
+#include <algorithm>
+
 #include "graphics/Bitmap.hpp"
+#include "graphics/BlockEncoder.hpp"
 #include "system/Heap.hpp"
 
 namespace jse {
@@ -7,6 +11,7 @@ namespace jse {
 		mNumMipmaps(1),
 		mBytesPerPixel(0),
 		mIsCompressed(false),
+		mIsSRGB(false),
 		mDepth(0),
 		mSizeX(0),
 		mSizeY(0),
@@ -15,21 +20,73 @@ namespace jse {
 		mImages.resize(1);
 	}
 
+	Bitmap::~Bitmap()
+	{
+	}
+
 	void Bitmap::Init(const int aNumImages, const int aNumMipmaps)
 	{
 		mNumImages = aNumImages;
 		mNumMipmaps = aNumMipmaps;
 
 		const int size = mNumImages * mNumMipmaps;
+		mImages.clear();
 		mImages.resize(size);
 	}
 
+	void Bitmap::SetNumMipmaps(const int aNumMipmaps)
+	{
+		std::vector<BitmapData> images(size_t(mNumImages) * aNumMipmaps);
+
+		for (int image = 0; image < mNumImages; ++image)
+		{
+			for (int mip = 0; mip < mNumMipmaps && mip < aNumMipmaps; ++mip)
+			{
+				images[image * aNumMipmaps + mip] = std::move(mImages[image * mNumMipmaps + mip]);
+			}
+		}
+
+		mImages.swap(images);
+		mNumMipmaps = aNumMipmaps;
+	}
+
+	void Bitmap::RemoveTopMipmaps(const int aCount)
+	{
+		if (aCount <= 0 || aCount >= mNumMipmaps)
+			return;
+
+		const int numMips = mNumMipmaps - aCount;
+		std::vector<BitmapData> images(size_t(mNumImages) * numMips);
+
+		for (int image = 0; image < mNumImages; ++image)
+		{
+			for (int mip = 0; mip < numMips; ++mip)
+			{
+				images[image * numMips + mip] = std::move(mImages[image * mNumMipmaps + mip + aCount]);
+			}
+		}
+
+		mSizeX = GetMipSizeX(aCount);
+		mSizeY = GetMipSizeY(aCount);
+		mImages.swap(images);
+		mNumMipmaps = numMips;
+	}
+
 	BitmapData* Bitmap::GetData(const int aImage, const int aMipLevel)
 	{
-		if (aImage > mNumImages) return NULL;
-		if (aMipLevel > mNumMipmaps) return NULL;
+		if (aImage >= mNumImages) return NULL;
+		if (aMipLevel >= mNumMipmaps) return NULL;
+
+		const int index = aImage * mNumMipmaps + aMipLevel;
+		return &mImages[index];
+	}
+
+	const BitmapData* Bitmap::GetData(const int aImage, const int aMipLevel) const
+	{
+		if (aImage >= mNumImages) return NULL;
+		if (aMipLevel >= mNumMipmaps) return NULL;
 
-		const int index = aImage * aMipLevel;
+		const int index = aImage * mNumMipmaps + aMipLevel;
 		return &mImages[index];
 	}
 
@@ -40,33 +97,248 @@ namespace jse {
 		mDepth = aDepth;
 	}
 
+	size_t Bitmap::GetTotalSize() const
+	{
+		size_t size = 0;
+		for (const auto& it : mImages)
+		{
+			size += it.GetSize();
+		}
+
+		return size;
+	}
+
 
-	BitmapData::BitmapData() : mSize(0), mData(NULL)
+	BitmapData::BitmapData()
 	{
 	}
 
 	BitmapData::~BitmapData()
 	{
-		if (mData)
+	}
+
+	void BitmapData::SetData(const unsigned char* aData, const int aSize)
+	{
+		mData.resize(aSize);
+
+		memcpy(mData.data(), aData, aSize);
+	}
+
+	void BitmapData::Resize(const int aSize)
+	{
+		mData.resize(aSize);
+	}
+
+
+	bool IsCompressedPixelFormat(const PixelFormat aFormat)
+	{
+		return GetPixelFormatBlockSize(aFormat) != 0;
+	}
+
+	int GetPixelFormatBlockSize(const PixelFormat aFormat)
+	{
+		switch (aFormat)
 		{
-			delete[] mData;
+			case PixelFormat_DXT1:
+			case PixelFormat_BC4:
+				return 8;
+			case PixelFormat_DXT2:
+			case PixelFormat_DXT3:
+			case PixelFormat_DXT4:
+			case PixelFormat_DXT5:
+			case PixelFormat_BC5:
+			case PixelFormat_BC6H:
+			case PixelFormat_BC7:
+				return 16;
+			default:
+				return 0;
 		}
 	}
 
-	void BitmapData::SetData(const unsigned char* aData, const int aSize)
+	size_t GetCompressedImageSize(const PixelFormat aFormat, const int aSizeX, const int aSizeY)
+	{
+		const size_t blocksX = size_t(aSizeX + 3) / 4;
+		const size_t blocksY = size_t(aSizeY + 3) / 4;
+
+		return blocksX * blocksY * GetPixelFormatBlockSize(aFormat);
+	}
+
+	// Row r of a block with aRows valid rows moves to row aRows - 1 - r
+	static inline int Bitmap_FlipRow(const int aRow, const int aRows)
 	{
-		if (mData && aSize != mSize)
+		return aRow < aRows ? aRows - 1 - aRow : aRow;
+	}
+
+	// BC1 color: 2 endpoints, then one byte of 2 bit indices per row
+	static void Bitmap_FlipColorBlock(u8* aBlock, const int aRows)
+	{
+		u8 rows[4];
+		std::memcpy(rows, aBlock + 4, 4);
+		for (int r = 0; r < 4; ++r)
 		{
-			delete[] mData;
-			mData = NULL;
+			aBlock[4 + Bitmap_FlipRow(r, aRows)] = rows[r];
 		}
+	}
 
-		if (!mData) mData = new unsigned char[aSize];
+	// BC2 alpha: 4 bit per pixel, 2 bytes per row
+	static void Bitmap_FlipExplicitAlphaBlock(u8* aBlock, const int aRows)
+	{
+		u8 rows[8];
+		std::memcpy(rows, aBlock, 8);
+		for (int r = 0; r < 4; ++r)
+		{
+			const int d = Bitmap_FlipRow(r, aRows);
+			aBlock[d * 2] = rows[r * 2];
+			aBlock[d * 2 + 1] = rows[r * 2 + 1];
+		}
+	}
 
-		mSize = aSize;
+	// BC3 alpha / BC4: 2 endpoints, then 48 bits of 3 bit indices, 12 bits per row
+	static void Bitmap_FlipInterpAlphaBlock(u8* aBlock, const int aRows)
+	{
+		u64 bits = 0;
+		for (int i = 0; i < 6; ++i)
+		{
+			bits |= u64(aBlock[2 + i]) << (8 * i);
+		}
 
-		memcpy(mData, aData, aSize);
+		u64 flipped = 0;
+		for (int r = 0; r < 4; ++r)
+		{
+			flipped |= ((bits >> (12 * r)) & 0xFFF) << (12 * Bitmap_FlipRow(r, aRows));
+		}
+
+		for (int i = 0; i < 6; ++i)
+		{
+			aBlock[2 + i] = u8(flipped >> (8 * i));
+		}
+	}
+
+	static void Bitmap_FlipBlock(const PixelFormat aFormat, u8* aBlock, const int aRows)
+	{
+		switch (aFormat)
+		{
+			case PixelFormat_DXT1:
+				Bitmap_FlipColorBlock(aBlock, aRows);
+				break;
+			case PixelFormat_DXT2:
+			case PixelFormat_DXT3:
+				Bitmap_FlipExplicitAlphaBlock(aBlock, aRows);
+				Bitmap_FlipColorBlock(aBlock + 8, aRows);
+				break;
+			case PixelFormat_DXT4:
+			case PixelFormat_DXT5:
+				Bitmap_FlipInterpAlphaBlock(aBlock, aRows);
+				Bitmap_FlipColorBlock(aBlock + 8, aRows);
+				break;
+			case PixelFormat_BC4:
+				Bitmap_FlipInterpAlphaBlock(aBlock, aRows);
+				break;
+			case PixelFormat_BC5:
+				Bitmap_FlipInterpAlphaBlock(aBlock, aRows);
+				Bitmap_FlipInterpAlphaBlock(aBlock + 8, aRows);
+				break;
+			default:
+				break;
+		}
 	}
 
+	// Block rows can only be swapped when no block straddles the flipped rows
+	static inline bool Bitmap_CanSwapBlockRows(const int aSizeY)
+	{
+		return aSizeY <= 4 || (aSizeY & 3) == 0;
+	}
 
-}
\ No newline at end of file
+	// Decodes one level, flips the pixels and encodes it again, for block heights that cannot be swapped
+	static bool Bitmap_FlipReencode(const PixelFormat aFormat, const int aSizeX, const int aSizeY, BitmapData* aData)
+	{
+		Bitmap level;
+		level.SetSize(aSizeX, aSizeY, 1);
+		level.SetPixelFormat(aFormat);
+		level.SetCompressed(true);
+		level.SetBytesPerPixel(0);
+		level.Init(1, 1);
+		level.GetData(0, 0)->SetData(aData->GetData(), aData->GetSize());
+
+		BlockEncodeParams_t params;
+		params.format = aFormat;
+		params.computeError = false;
+
+		if (!DecodeBitmap(level, level) || !FlipBitmapVertically(level) || !EncodeBitmap(level, level, params))
+			return false;
+
+		const BitmapData* encoded = level.GetData(0, 0);
+		aData->SetData(encoded->GetData(), encoded->GetSize());
+
+		return true;
+	}
+
+	bool FlipBitmapVertically(Bitmap& aBitmap)
+	{
+		const PixelFormat format = aBitmap.GetPixelFormat();
+		const bool compressed = IsCompressedPixelFormat(format);
+		const bool reencode = format == PixelFormat_DXT1 || format == PixelFormat_DXT5 || format == PixelFormat_BC5;
+
+		if (compressed)
+		{
+			// BC6H and BC7 partitions and anchor indices do not survive a row swap
+			if (format == PixelFormat_BC6H || format == PixelFormat_BC7)
+				return false;
+
+			for (int mip = 0; mip < aBitmap.GetNumMipmaps(); ++mip)
+			{
+				if (!Bitmap_CanSwapBlockRows(aBitmap.GetMipSizeY(mip)) && !reencode)
+					return false;
+			}
+		}
+
+		ByteVector row;
+
+		for (int image = 0; image < aBitmap.GetNumImages(); ++image)
+		{
+			for (int mip = 0; mip < aBitmap.GetNumMipmaps(); ++mip)
+			{
+				BitmapData* data = aBitmap.GetData(image, mip);
+				const int h = aBitmap.GetMipSizeY(mip);
+				const int numRows = compressed ? (h + 3) / 4 : h;
+
+				if (data->GetSize() == 0 || numRows == 0)
+					continue;
+
+				if (compressed && !Bitmap_CanSwapBlockRows(h))
+				{
+					if (!Bitmap_FlipReencode(format, aBitmap.GetMipSizeX(mip), h, data))
+						return false;
+					continue;
+				}
+
+				// a row of pixels, or of blocks
+				const size_t pitch = size_t(data->GetSize()) / numRows;
+				u8* ptr = data->GetData();
+
+				row.resize(pitch);
+				for (int r = 0; r < numRows / 2; ++r)
+				{
+					u8* a = ptr + r * pitch;
+					u8* b = ptr + (numRows - 1 - r) * pitch;
+					std::memcpy(row.data(), a, pitch);
+					std::memcpy(a, b, pitch);
+					std::memcpy(b, row.data(), pitch);
+				}
+
+				if (compressed)
+				{
+					const int blockSize = GetPixelFormatBlockSize(format);
+					const int rows = std::min(h, 4);
+
+					for (size_t offset = 0; offset + blockSize <= size_t(data->GetSize()); offset += blockSize)
+					{
+						Bitmap_FlipBlock(format, ptr + offset, rows);
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+}
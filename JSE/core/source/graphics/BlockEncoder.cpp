@@ -0,0 +1,860 @@
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#include "graphics/BlockEncoder.hpp"
+#include "system/ThreadPool.hpp"
+#include "system/Logger.hpp"
+
+namespace jse {
+
+	const int kBlockRefineSteps = 2;
+	const int kBlockPowerSteps = 8;
+	const int kBlockAlphaSearch = 3;
+
+	/* one 4x4 block, color in SoA floats for the index search */
+	struct BlockPixels_t
+	{
+		alignas(32) float r[16];
+		alignas(32) float g[16];
+		alignas(32) float b[16];
+		u8 rgba[16][4];
+		u16 validMask;
+	};
+
+	// squared error of the best palette entry per pixel, indices written to aIndices
+	typedef float (*BlockColorFitFunc)(const BlockPixels_t& aBlock, const float aPalette[4][3], int* aIndices);
+
+	static const char* const sBlockQualityNames[] = { "fast", "normal", "high" };
+
+	BlockQuality GetBlockQuality(const String& aName)
+	{
+		for (int i = 0; i < BlockQuality_LastEnum; ++i)
+		{
+			if (aName == sBlockQualityNames[i])
+				return BlockQuality(i);
+		}
+
+		return BlockQuality_LastEnum;
+	}
+
+	const char* GetBlockQualityName(const BlockQuality aQuality)
+	{
+		return aQuality < BlockQuality_LastEnum ? sBlockQualityNames[aQuality] : "unknown";
+	}
+
+	/* palette fitting kernels */
+
+	static float BlockEncoder_FitColors_Scalar(const BlockPixels_t& aBlock, const float aPalette[4][3], int* aIndices)
+	{
+		float error = 0.0f;
+
+		for (int i = 0; i < 16; ++i)
+		{
+			float best = 1e30f;
+			int bestIndex = 0;
+
+			for (int k = 0; k < 4; ++k)
+			{
+				const float dr = aBlock.r[i] - aPalette[k][0];
+				const float dg = aBlock.g[i] - aPalette[k][1];
+				const float db = aBlock.b[i] - aPalette[k][2];
+				const float d = dr * dr + dg * dg + db * db;
+
+				if (d < best)
+				{
+					best = d;
+					bestIndex = k;
+				}
+			}
+
+			aIndices[i] = bestIndex;
+			error += best;
+		}
+
+		return error;
+	}
+
+#if defined(JSE_SIMD_X86)
+
+	JSE_TARGET_SSE41 static float BlockEncoder_FitColors_SSE(const BlockPixels_t& aBlock, const float aPalette[4][3], int* aIndices)
+	{
+		__m128 error = _mm_setzero_ps();
+
+		for (int i = 0; i < 16; i += 4)
+		{
+			const __m128 r = _mm_load_ps(aBlock.r + i);
+			const __m128 g = _mm_load_ps(aBlock.g + i);
+			const __m128 b = _mm_load_ps(aBlock.b + i);
+			__m128 best = _mm_set1_ps(1e30f);
+			__m128 bestIndex = _mm_setzero_ps();
+
+			for (int k = 0; k < 4; ++k)
+			{
+				const __m128 dr = _mm_sub_ps(r, _mm_set1_ps(aPalette[k][0]));
+				const __m128 dg = _mm_sub_ps(g, _mm_set1_ps(aPalette[k][1]));
+				const __m128 db = _mm_sub_ps(b, _mm_set1_ps(aPalette[k][2]));
+				const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+				const __m128 less = _mm_cmplt_ps(d, best);
+
+				best = _mm_min_ps(best, d);
+				bestIndex = _mm_blendv_ps(bestIndex, _mm_castsi128_ps(_mm_set1_epi32(k)), less);
+			}
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(aIndices + i), _mm_castps_si128(bestIndex));
+			error = _mm_add_ps(error, best);
+		}
+
+		error = _mm_hadd_ps(error, error);
+		error = _mm_hadd_ps(error, error);
+
+		return _mm_cvtss_f32(error);
+	}
+
+	JSE_TARGET_AVX2 static float BlockEncoder_FitColors_AVX2(const BlockPixels_t& aBlock, const float aPalette[4][3], int* aIndices)
+	{
+		__m256 error = _mm256_setzero_ps();
+
+		for (int i = 0; i < 16; i += 8)
+		{
+			const __m256 r = _mm256_load_ps(aBlock.r + i);
+			const __m256 g = _mm256_load_ps(aBlock.g + i);
+			const __m256 b = _mm256_load_ps(aBlock.b + i);
+			__m256 best = _mm256_set1_ps(1e30f);
+			__m256 bestIndex = _mm256_setzero_ps();
+
+			for (int k = 0; k < 4; ++k)
+			{
+				const __m256 dr = _mm256_sub_ps(r, _mm256_set1_ps(aPalette[k][0]));
+				const __m256 dg = _mm256_sub_ps(g, _mm256_set1_ps(aPalette[k][1]));
+				const __m256 db = _mm256_sub_ps(b, _mm256_set1_ps(aPalette[k][2]));
+				const __m256 d = _mm256_fmadd_ps(db, db, _mm256_fmadd_ps(dg, dg, _mm256_mul_ps(dr, dr)));
+				const __m256 less = _mm256_cmp_ps(d, best, _CMP_LT_OQ);
+
+				best = _mm256_min_ps(best, d);
+				bestIndex = _mm256_blendv_ps(bestIndex, _mm256_castsi256_ps(_mm256_set1_epi32(k)), less);
+			}
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(aIndices + i), _mm256_castps_si256(bestIndex));
+			error = _mm256_add_ps(error, best);
+		}
+
+		__m128 sum = _mm_add_ps(_mm256_castps256_ps128(error), _mm256_extractf128_ps(error, 1));
+		sum = _mm_hadd_ps(sum, sum);
+		sum = _mm_hadd_ps(sum, sum);
+
+		return _mm_cvtss_f32(sum);
+	}
+
+#endif
+
+	static BlockColorFitFunc BlockEncoder_GetFitFunc(const SimdLevel aLevel)
+	{
+#if defined(JSE_SIMD_X86)
+		if (aLevel == SimdLevel_AVX2)
+			return BlockEncoder_FitColors_AVX2;
+		if (aLevel == SimdLevel_SSE)
+			return BlockEncoder_FitColors_SSE;
+#endif
+		return BlockEncoder_FitColors_Scalar;
+	}
+
+	/* BC1 color block */
+
+	static inline u16 BlockEncoder_To565(const float* aColor)
+	{
+		const int r = std::min(31, std::max(0, int(aColor[0] * (31.0f / 255.0f) + 0.5f)));
+		const int g = std::min(63, std::max(0, int(aColor[1] * (63.0f / 255.0f) + 0.5f)));
+		const int b = std::min(31, std::max(0, int(aColor[2] * (31.0f / 255.0f) + 0.5f)));
+
+		return u16((r << 11) | (g << 5) | b);
+	}
+
+	static inline void BlockEncoder_From565(const u16 aColor, int* aRGB)
+	{
+		const int r = (aColor >> 11) & 31;
+		const int g = (aColor >> 5) & 63;
+		const int b = aColor & 31;
+
+		aRGB[0] = (r << 3) | (r >> 2);
+		aRGB[1] = (g << 2) | (g >> 4);
+		aRGB[2] = (b << 3) | (b >> 2);
+	}
+
+	static void BlockEncoder_GetPalette(const u16 aC0, const u16 aC1, int aPalette[4][3])
+	{
+		BlockEncoder_From565(aC0, aPalette[0]);
+		BlockEncoder_From565(aC1, aPalette[1]);
+
+		for (int c = 0; c < 3; ++c)
+		{
+			aPalette[2][c] = (2 * aPalette[0][c] + aPalette[1][c]) / 3;
+			aPalette[3][c] = (aPalette[0][c] + 2 * aPalette[1][c]) / 3;
+		}
+	}
+
+	static void BlockEncoder_BoundingBox(const BlockPixels_t& aBlock, float* aMin, float* aMax)
+	{
+		const float* channels[3] = { aBlock.r, aBlock.g, aBlock.b };
+
+		for (int c = 0; c < 3; ++c)
+		{
+			aMin[c] = *std::min_element(channels[c], channels[c] + 16);
+			aMax[c] = *std::max_element(channels[c], channels[c] + 16);
+		}
+
+		// pick the diagonal of the box following the sign of the r/g and b/g correlation
+		const float center[3] = { 0.5f * (aMin[0] + aMax[0]), 0.5f * (aMin[1] + aMax[1]), 0.5f * (aMin[2] + aMax[2]) };
+		float covRG = 0.0f, covBG = 0.0f;
+
+		for (int i = 0; i < 16; ++i)
+		{
+			covRG += (aBlock.r[i] - center[0]) * (aBlock.g[i] - center[1]);
+			covBG += (aBlock.b[i] - center[2]) * (aBlock.g[i] - center[1]);
+		}
+
+		if (covRG < 0.0f) std::swap(aMin[0], aMax[0]);
+		if (covBG < 0.0f) std::swap(aMin[2], aMax[2]);
+
+		// inset by 1/16 of the range, the extremes are rarely hit exactly
+		for (int c = 0; c < 3; ++c)
+		{
+			const float inset = (aMax[c] - aMin[c]) / 16.0f;
+			aMin[c] += inset;
+			aMax[c] -= inset;
+		}
+	}
+
+	static void BlockEncoder_PrincipalAxis(const BlockPixels_t& aBlock, float* aMin, float* aMax)
+	{
+		float mean[3] = { 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; ++i)
+		{
+			mean[0] += aBlock.r[i];
+			mean[1] += aBlock.g[i];
+			mean[2] += aBlock.b[i];
+		}
+		for (int c = 0; c < 3; ++c)
+		{
+			mean[c] /= 16.0f;
+		}
+
+		float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; ++i)
+		{
+			const float r = aBlock.r[i] - mean[0];
+			const float g = aBlock.g[i] - mean[1];
+			const float b = aBlock.b[i] - mean[2];
+
+			cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+			cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+		}
+
+		// power iteration, starting from the box diagonal
+		float bmin[3], bmax[3];
+		BlockEncoder_BoundingBox(aBlock, bmin, bmax);
+		float axis[3] = { bmax[0] - bmin[0], bmax[1] - bmin[1], bmax[2] - bmin[2] };
+
+		for (int it = 0; it < kBlockPowerSteps; ++it)
+		{
+			const float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+			const float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+			const float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+			const float len = std::max(std::abs(x), std::max(std::abs(y), std::abs(z)));
+
+			if (len < 1e-6f)
+				break;
+
+			axis[0] = x / len;
+			axis[1] = y / len;
+			axis[2] = z / len;
+		}
+
+		const float len2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+		if (len2 < 1e-12f)
+		{
+			// flat block
+			for (int c = 0; c < 3; ++c)
+			{
+				aMin[c] = aMax[c] = mean[c];
+			}
+			return;
+		}
+
+		float tmin = 1e30f, tmax = -1e30f;
+		for (int i = 0; i < 16; ++i)
+		{
+			const float t = ((aBlock.r[i] - mean[0]) * axis[0] + (aBlock.g[i] - mean[1]) * axis[1] + (aBlock.b[i] - mean[2]) * axis[2]) / len2;
+			tmin = std::min(tmin, t);
+			tmax = std::max(tmax, t);
+		}
+
+		const float inset = (tmax - tmin) / 16.0f;
+		tmin += inset;
+		tmax -= inset;
+
+		for (int c = 0; c < 3; ++c)
+		{
+			aMin[c] = mean[c] + axis[c] * tmin;
+			aMax[c] = mean[c] + axis[c] * tmax;
+		}
+	}
+
+	// least squares endpoints for fixed indices, false if the system is singular
+	static bool BlockEncoder_RefineEndpoints(const BlockPixels_t& aBlock, const int* aIndices, float* aC0, float* aC1)
+	{
+		static const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+		float x[3] = { 0.0f, 0.0f, 0.0f };
+		float y[3] = { 0.0f, 0.0f, 0.0f };
+
+		for (int i = 0; i < 16; ++i)
+		{
+			const float t = weights[aIndices[i]];
+			const float s = 1.0f - t;
+			const float p[3] = { aBlock.r[i], aBlock.g[i], aBlock.b[i] };
+
+			aa += s * s;
+			bb += t * t;
+			ab += s * t;
+
+			for (int c = 0; c < 3; ++c)
+			{
+				x[c] += s * p[c];
+				y[c] += t * p[c];
+			}
+		}
+
+		const float det = aa * bb - ab * ab;
+		if (std::abs(det) < 1e-6f)
+			return false;
+
+		for (int c = 0; c < 3; ++c)
+		{
+			aC0[c] = std::min(255.0f, std::max(0.0f, (x[c] * bb - y[c] * ab) / det));
+			aC1[c] = std::min(255.0f, std::max(0.0f, (y[c] * aa - x[c] * ab) / det));
+		}
+
+		return true;
+	}
+
+	// quantizes the endpoints and picks the indices, returns the squared error
+	static float BlockEncoder_FitEndpoints(const BlockPixels_t& aBlock, const float* aE0, const float* aE1, BlockColorFitFunc aFit, u16& aC0, u16& aC1, int* aIndices)
+	{
+		aC0 = BlockEncoder_To565(aE0);
+		aC1 = BlockEncoder_To565(aE1);
+
+		// 4 color mode needs c0 > c1
+		if (aC0 < aC1)
+		{
+			std::swap(aC0, aC1);
+		}
+
+		int palette[4][3];
+		BlockEncoder_GetPalette(aC0, aC1, palette);
+
+		float fpalette[4][3];
+		for (int k = 0; k < 4; ++k)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				fpalette[k][c] = float(palette[k][c]);
+			}
+		}
+
+		if (aC0 == aC1)
+		{
+			// decodes in 3 color mode, index 0 is still c0
+			fpalette[2][0] = fpalette[3][0] = 1e15f;
+		}
+
+		return aFit(aBlock, fpalette, aIndices);
+	}
+
+	static void BlockEncoder_EncodeColor(const BlockPixels_t& aBlock, const BlockQuality aQuality, BlockColorFitFunc aFit, u8* aOut)
+	{
+		float e0[3], e1[3];
+		if (aQuality == BlockQuality_Fast)
+		{
+			BlockEncoder_BoundingBox(aBlock, e1, e0);
+		}
+		else
+		{
+			BlockEncoder_PrincipalAxis(aBlock, e1, e0);
+		}
+
+		u16 c0, c1;
+		int indices[16];
+		float error = BlockEncoder_FitEndpoints(aBlock, e0, e1, aFit, c0, c1, indices);
+
+		if (aQuality == BlockQuality_High)
+		{
+			for (int it = 0; it < kBlockRefineSteps && error > 0.0f; ++it)
+			{
+				float r0[3], r1[3];
+
+				// indices refer to the swapped, quantized endpoints
+				if (!BlockEncoder_RefineEndpoints(aBlock, indices, r0, r1))
+					break;
+
+				u16 n0, n1;
+				int newIndices[16];
+				const float newError = BlockEncoder_FitEndpoints(aBlock, r0, r1, aFit, n0, n1, newIndices);
+				if (newError >= error)
+					break;
+
+				error = newError;
+				c0 = n0;
+				c1 = n1;
+				std::copy(newIndices, newIndices + 16, indices);
+			}
+		}
+
+		u32 bits = 0;
+		if (c0 != c1)
+		{
+			for (int i = 0; i < 16; ++i)
+			{
+				bits |= u32(indices[i]) << (2 * i);
+			}
+		}
+
+		aOut[0] = u8(c0 & 0xFF);
+		aOut[1] = u8(c0 >> 8);
+		aOut[2] = u8(c1 & 0xFF);
+		aOut[3] = u8(c1 >> 8);
+		aOut[4] = u8(bits & 0xFF);
+		aOut[5] = u8((bits >> 8) & 0xFF);
+		aOut[6] = u8((bits >> 16) & 0xFF);
+		aOut[7] = u8(bits >> 24);
+	}
+
+	static void BlockEncoder_DecodeColor(const u8* aIn, u8 aRGB[16][3])
+	{
+		const u16 c0 = u16(aIn[0] | (aIn[1] << 8));
+		const u16 c1 = u16(aIn[2] | (aIn[3] << 8));
+		const u32 bits = u32(aIn[4]) | (u32(aIn[5]) << 8) | (u32(aIn[6]) << 16) | (u32(aIn[7]) << 24);
+
+		int palette[4][3];
+		BlockEncoder_GetPalette(c0, c1, palette);
+
+		for (int i = 0; i < 16; ++i)
+		{
+			const int k = (bits >> (2 * i)) & 3;
+			for (int c = 0; c < 3; ++c)
+			{
+				aRGB[i][c] = u8(palette[k][c]);
+			}
+		}
+	}
+
+	/* BC4 single channel block, also the alpha of BC3 and both halves of BC5 */
+
+	static void BlockEncoder_GetAlphaPalette(const int aA0, const int aA1, int aPalette[8])
+	{
+		aPalette[0] = aA0;
+		aPalette[1] = aA1;
+
+		if (aA0 > aA1)
+		{
+			for (int k = 2; k < 8; ++k)
+			{
+				aPalette[k] = ((8 - k) * aA0 + (k - 1) * aA1 + 3) / 7;
+			}
+		}
+		else
+		{
+			for (int k = 2; k < 6; ++k)
+			{
+				aPalette[k] = ((6 - k) * aA0 + (k - 1) * aA1 + 2) / 5;
+			}
+			aPalette[6] = 0;
+			aPalette[7] = 255;
+		}
+	}
+
+	static int BlockEncoder_FitAlpha(const u8* aValues, const int aA0, const int aA1, const bool aNearest, int* aIndices)
+	{
+		int palette[8];
+		BlockEncoder_GetAlphaPalette(aA0, aA1, palette);
+
+		int error = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			int best = 0;
+
+			if (aNearest || aA0 == aA1)
+			{
+				int bestError = 1 << 30;
+				for (int k = 0; k < 8; ++k)
+				{
+					const int d = (aValues[i] - palette[k]) * (aValues[i] - palette[k]);
+					if (d < bestError)
+					{
+						bestError = d;
+						best = k;
+					}
+				}
+			}
+			else
+			{
+				// position on the a1..a0 ramp mapped to the index order a0, a1, interpolants
+				const int p = std::min(7, std::max(0, ((aValues[i] - aA1) * 14 + (aA0 - aA1)) / (2 * (aA0 - aA1))));
+				best = p == 7 ? 0 : p == 0 ? 1 : 8 - p;
+			}
+
+			aIndices[i] = best;
+			error += (aValues[i] - palette[best]) * (aValues[i] - palette[best]);
+		}
+
+		return error;
+	}
+
+	static void BlockEncoder_EncodeAlpha(const u8* aValues, const BlockQuality aQuality, u8* aOut)
+	{
+		const int vmin = *std::min_element(aValues, aValues + 16);
+		const int vmax = *std::max_element(aValues, aValues + 16);
+		int a0 = vmax, a1 = vmin;
+		int indices[16];
+		int error = BlockEncoder_FitAlpha(aValues, a0, a1, aQuality != BlockQuality_Fast, indices);
+
+		if (aQuality == BlockQuality_High && vmax - vmin > 2 * kBlockAlphaSearch)
+		{
+			for (int d0 = 0; d0 <= kBlockAlphaSearch; ++d0)
+			{
+				for (int d1 = 0; d1 <= kBlockAlphaSearch; ++d1)
+				{
+					int candidate[16];
+					const int e = BlockEncoder_FitAlpha(aValues, vmax - d0, vmin + d1, true, candidate);
+
+					if (e < error)
+					{
+						error = e;
+						a0 = vmax - d0;
+						a1 = vmin + d1;
+						std::copy(candidate, candidate + 16, indices);
+					}
+				}
+			}
+		}
+
+		u64 bits = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			bits |= u64(indices[i]) << (3 * i);
+		}
+
+		aOut[0] = u8(a0);
+		aOut[1] = u8(a1);
+		for (int i = 0; i < 6; ++i)
+		{
+			aOut[2 + i] = u8((bits >> (8 * i)) & 0xFF);
+		}
+	}
+
+	static void BlockEncoder_DecodeAlpha(const u8* aIn, u8 aValues[16])
+	{
+		int palette[8];
+		BlockEncoder_GetAlphaPalette(aIn[0], aIn[1], palette);
+
+		u64 bits = 0;
+		for (int i = 0; i < 6; ++i)
+		{
+			bits |= u64(aIn[2 + i]) << (8 * i);
+		}
+
+		for (int i = 0; i < 16; ++i)
+		{
+			aValues[i] = u8(palette[(bits >> (3 * i)) & 7]);
+		}
+	}
+
+	/* bitmap level */
+
+	static void BlockEncoder_FetchBlock(const u8* aPixels, const int aSizeX, const int aSizeY, const int aChannels, const int aBlockX, const int aBlockY, BlockPixels_t& aBlock)
+	{
+		aBlock.validMask = 0;
+
+		for (int py = 0; py < 4; ++py)
+		{
+			const int y = aBlockY * 4 + py;
+			const u8* row = aPixels + size_t(std::min(y, aSizeY - 1)) * aSizeX * aChannels;
+
+			for (int px = 0; px < 4; ++px)
+			{
+				const int x = aBlockX * 4 + px;
+				const u8* s = row + std::min(x, aSizeX - 1) * aChannels;
+				u8* d = aBlock.rgba[py * 4 + px];
+
+				switch (aChannels)
+				{
+					case 1: d[0] = d[1] = d[2] = s[0]; d[3] = 255; break;
+					case 2: d[0] = d[1] = d[2] = s[0]; d[3] = s[1]; break;
+					case 3: d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = 255; break;
+					default: d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = s[3]; break;
+				}
+
+				if (x < aSizeX && y < aSizeY)
+				{
+					aBlock.validMask |= u16(1 << (py * 4 + px));
+				}
+			}
+		}
+
+		for (int i = 0; i < 16; ++i)
+		{
+			aBlock.r[i] = aBlock.rgba[i][0];
+			aBlock.g[i] = aBlock.rgba[i][1];
+			aBlock.b[i] = aBlock.rgba[i][2];
+		}
+	}
+
+	// encodes one block, returns the squared error of the valid pixels if computeError is set
+	static double BlockEncoder_EncodeBlock(const BlockPixels_t& aBlock, const BlockEncodeParams_t& aParams, BlockColorFitFunc aFit, u8* aOut)
+	{
+		u8 channel[16];
+		u8 decoded[16][4];
+
+		switch (aParams.format)
+		{
+			case PixelFormat_DXT1:
+				BlockEncoder_EncodeColor(aBlock, aParams.quality, aFit, aOut);
+				break;
+			case PixelFormat_DXT5:
+				for (int i = 0; i < 16; ++i) channel[i] = aBlock.rgba[i][3];
+				BlockEncoder_EncodeAlpha(channel, aParams.quality, aOut);
+				BlockEncoder_EncodeColor(aBlock, aParams.quality, aFit, aOut + 8);
+				break;
+			default:
+				for (int i = 0; i < 16; ++i) channel[i] = aBlock.rgba[i][0];
+				BlockEncoder_EncodeAlpha(channel, aParams.quality, aOut);
+				for (int i = 0; i < 16; ++i) channel[i] = aBlock.rgba[i][1];
+				BlockEncoder_EncodeAlpha(channel, aParams.quality, aOut + 8);
+				break;
+		}
+
+		if (!aParams.computeError)
+			return 0.0;
+
+		int count = 3;
+		u8 rgb[16][3];
+		u8 values[16];
+
+		switch (aParams.format)
+		{
+			case PixelFormat_DXT1:
+				BlockEncoder_DecodeColor(aOut, rgb);
+				for (int i = 0; i < 16; ++i) std::copy(rgb[i], rgb[i] + 3, decoded[i]);
+				break;
+			case PixelFormat_DXT5:
+				count = 4;
+				BlockEncoder_DecodeAlpha(aOut, values);
+				BlockEncoder_DecodeColor(aOut + 8, rgb);
+				for (int i = 0; i < 16; ++i) { std::copy(rgb[i], rgb[i] + 3, decoded[i]); decoded[i][3] = values[i]; }
+				break;
+			default:
+				count = 2;
+				BlockEncoder_DecodeAlpha(aOut, values);
+				for (int i = 0; i < 16; ++i) decoded[i][0] = values[i];
+				BlockEncoder_DecodeAlpha(aOut + 8, values);
+				for (int i = 0; i < 16; ++i) decoded[i][1] = values[i];
+				break;
+		}
+
+		double error = 0.0;
+		for (int i = 0; i < 16; ++i)
+		{
+			if (!(aBlock.validMask & (1 << i)))
+				continue;
+
+			for (int c = 0; c < count; ++c)
+			{
+				const int d = int(aBlock.rgba[i][c]) - int(decoded[i][c]);
+				error += d * d;
+			}
+		}
+
+		return error;
+	}
+
+	bool EncodeBitmap(const Bitmap& aSrc, Bitmap& aDst, const BlockEncodeParams_t& aParams, BlockEncodeStats_t* aStats)
+	{
+		const int channels = aSrc.GetBytesPerPixel();
+
+		if (aSrc.IsCompressed() || channels < 1 || channels > 4)
+		{
+			Error("EncodeBitmap: unsupported source format in %s", aSrc.GetFileName().c_str());
+			return false;
+		}
+
+		if (aParams.format != PixelFormat_DXT1 && aParams.format != PixelFormat_DXT5 && aParams.format != PixelFormat_BC5)
+		{
+			Error("EncodeBitmap: unsupported target format %d", int(aParams.format));
+			return false;
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		const BlockColorFitFunc fit = BlockEncoder_GetFitFunc(std::min(aParams.simd, Cpu_GetSimdLevel()));
+		const int blockSize = GetPixelFormatBlockSize(aParams.format);
+
+		// aDst may alias aSrc
+		Bitmap result;
+		result.SetFileName(aSrc.GetFileName());
+		result.SetSize(aSrc.GetSizeX(), aSrc.GetSizeY(), aSrc.GetDepth());
+		result.SetPixelFormat(aParams.format);
+		result.SetCompressed(true);
+		result.SetSRGB(aParams.format != PixelFormat_BC5 && aSrc.IsSRGB());
+		result.SetBytesPerPixel(0);
+		result.Init(aSrc.GetNumImages(), aSrc.GetNumMipmaps());
+
+		double totalError = 0.0;
+		size_t totalSamples = 0;
+		size_t totalBlocks = 0;
+		const int samplesPerPixel = aParams.format == PixelFormat_DXT1 ? 3 : aParams.format == PixelFormat_DXT5 ? 4 : 2;
+
+		for (int image = 0; image < aSrc.GetNumImages(); ++image)
+		{
+			for (int mip = 0; mip < aSrc.GetNumMipmaps(); ++mip)
+			{
+				const int w = aSrc.GetMipSizeX(mip);
+				const int h = aSrc.GetMipSizeY(mip);
+				const int blocksX = (w + 3) / 4;
+				const int blocksY = (h + 3) / 4;
+				const u8* src = aSrc.GetData(image, mip)->GetData();
+				BitmapData* dst = result.GetData(image, mip);
+
+				dst->Resize(int(GetCompressedImageSize(aParams.format, w, h)));
+				u8* out = dst->GetData();
+
+				std::vector<double> rowErrors(blocksY, 0.0);
+
+				GetDefaultThreadPool().ParallelFor(blocksY, [&](size_t by) {
+					BlockPixels_t block;
+					double error = 0.0;
+
+					for (int bx = 0; bx < blocksX; ++bx)
+					{
+						BlockEncoder_FetchBlock(src, w, h, channels, bx, int(by), block);
+						error += BlockEncoder_EncodeBlock(block, aParams, fit, out + (by * blocksX + bx) * blockSize);
+					}
+
+					rowErrors[by] = error;
+				});
+
+				for (double e : rowErrors)
+				{
+					totalError += e;
+				}
+
+				totalSamples += size_t(w) * h * samplesPerPixel;
+				totalBlocks += size_t(blocksX) * blocksY;
+			}
+		}
+
+		aDst = std::move(result);
+
+		if (aStats)
+		{
+			aStats->numBlocks = totalBlocks;
+			aStats->encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			aStats->rmse = aParams.computeError && totalSamples ? std::sqrt(totalError / double(totalSamples)) : 0.0;
+			aStats->psnr = !aParams.computeError ? 0.0 : aStats->rmse > 0.0 ? std::min(kBlockMaxPsnr, 20.0 * std::log10(255.0 / aStats->rmse)) : kBlockMaxPsnr;
+		}
+
+		return true;
+	}
+
+	bool DecodeBitmap(const Bitmap& aSrc, Bitmap& aDst)
+	{
+		const PixelFormat format = aSrc.GetPixelFormat();
+
+		if (format != PixelFormat_DXT1 && format != PixelFormat_DXT5 && format != PixelFormat_BC5)
+		{
+			Error("DecodeBitmap: unsupported format %d in %s", int(format), aSrc.GetFileName().c_str());
+			return false;
+		}
+
+		const int blockSize = GetPixelFormatBlockSize(format);
+
+		// aDst may alias aSrc
+		Bitmap result;
+		result.SetFileName(aSrc.GetFileName());
+		result.SetSize(aSrc.GetSizeX(), aSrc.GetSizeY(), aSrc.GetDepth());
+		result.SetPixelFormat(PixelFormat_RGBA);
+		result.SetCompressed(false);
+		result.SetSRGB(aSrc.IsSRGB());
+		result.SetBytesPerPixel(4);
+		result.Init(aSrc.GetNumImages(), aSrc.GetNumMipmaps());
+
+		for (int image = 0; image < aSrc.GetNumImages(); ++image)
+		{
+			for (int mip = 0; mip < aSrc.GetNumMipmaps(); ++mip)
+			{
+				const int w = aSrc.GetMipSizeX(mip);
+				const int h = aSrc.GetMipSizeY(mip);
+				const int blocksX = (w + 3) / 4;
+				const int blocksY = (h + 3) / 4;
+				const BitmapData* src = aSrc.GetData(image, mip);
+				BitmapData* dst = result.GetData(image, mip);
+
+				if (src->GetSize() < int(GetCompressedImageSize(format, w, h)))
+				{
+					Error("DecodeBitmap: level %d of %s is truncated", mip, aSrc.GetFileName().c_str());
+					return false;
+				}
+
+				dst->Resize(w * h * 4);
+				u8* out = dst->GetData();
+
+				for (int by = 0; by < blocksY; ++by)
+				{
+					for (int bx = 0; bx < blocksX; ++bx)
+					{
+						const u8* in = src->GetData() + (by * blocksX + bx) * blockSize;
+						u8 rgb[16][3];
+						u8 alpha[16];
+						u8 red[16];
+						u8 green[16];
+
+						switch (format)
+						{
+							case PixelFormat_DXT1:
+								BlockEncoder_DecodeColor(in, rgb);
+								std::fill(alpha, alpha + 16, u8(255));
+								break;
+							case PixelFormat_DXT5:
+								BlockEncoder_DecodeAlpha(in, alpha);
+								BlockEncoder_DecodeColor(in + 8, rgb);
+								break;
+							default:
+								BlockEncoder_DecodeAlpha(in, red);
+								BlockEncoder_DecodeAlpha(in + 8, green);
+								for (int i = 0; i < 16; ++i) { rgb[i][0] = red[i]; rgb[i][1] = green[i]; rgb[i][2] = 0; }
+								std::fill(alpha, alpha + 16, u8(255));
+								break;
+						}
+
+						// partial edge blocks only write their valid pixels
+						for (int i = 0; i < 16; ++i)
+						{
+							const int x = bx * 4 + (i & 3);
+							const int y = by * 4 + (i >> 2);
+							if (x >= w || y >= h)
+								continue;
+
+							u8* d = out + (size_t(y) * w + x) * 4;
+							d[0] = rgb[i][0];
+							d[1] = rgb[i][1];
+							d[2] = rgb[i][2];
+							d[3] = alpha[i];
+						}
+					}
+				}
+			}
+		}
+
+		aDst = std::move(result);
+
+		return true;
+	}
+}
@@ -0,0 +1,377 @@
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#include "graphics/DdsFile.hpp"
+#include "system/Logger.hpp"
+#include "system/MappedFile.hpp"
+
+namespace jse {
+
+	#define DDSD_CAPS			0x1
+	#define DDSD_HEIGHT			0x2
+	#define DDSD_WIDTH			0x4
+	#define DDSD_PITCH			0x8
+	#define DDSD_PIXELFORMAT	0x1000
+	#define DDSD_LINEARSIZE		0x80000
+	#define DDSD_MIPMAPCOUNT	0x20000
+	#define DDPF_ALPHAPIXELS	0x1
+	#define DDPF_FOURCC			0x4
+	#define DDPF_RGB			0x40
+	#define DDPF_LUMINANCE		0x20000
+	#define DDSCAPS_COMPLEX		0x8
+	#define DDSCAPS_TEXTURE		0x1000
+	#define DDSCAPS_MIPMAP		0x400000
+	#define DDSCAPS2_CUBEMAP	0x200
+	#define DDS_RESOURCE_MISC_TEXTURECUBE 0x4
+	#define DDS_DIMENSION_TEXTURE2D 3
+
+	#define DDS_FOURCC(a, b, c, d) (u32(a) | (u32(b) << 8) | (u32(c) << 16) | (u32(d) << 24))
+
+	enum DxgiFormat
+	{
+		DxgiFormat_R8G8B8A8_UNORM = 28,
+		DxgiFormat_R8G8B8A8_UNORM_SRGB = 29,
+		DxgiFormat_BC1_UNORM = 71,
+		DxgiFormat_BC1_UNORM_SRGB = 72,
+		DxgiFormat_BC2_UNORM = 74,
+		DxgiFormat_BC2_UNORM_SRGB = 75,
+		DxgiFormat_BC3_UNORM = 77,
+		DxgiFormat_BC3_UNORM_SRGB = 78,
+		DxgiFormat_BC4_UNORM = 80,
+		DxgiFormat_BC5_UNORM = 83,
+		DxgiFormat_BC6H_UF16 = 95,
+		DxgiFormat_BC7_UNORM = 98,
+		DxgiFormat_BC7_UNORM_SRGB = 99
+	};
+
+	struct DdsPixelFormat_t
+	{
+		u32 size;
+		u32 flags;
+		u32 fourCC;
+		u32 rgbBitCount;
+		u32 rBitMask;
+		u32 gBitMask;
+		u32 bBitMask;
+		u32 aBitMask;
+	};
+
+	struct DdsHeader_t
+	{
+		u32 size;
+		u32 flags;
+		u32 height;
+		u32 width;
+		u32 pitchOrLinearSize;
+		u32 depth;
+		u32 mipMapCount;
+		u32 reserved1[11];
+		DdsPixelFormat_t ddspf;
+		u32 caps;
+		u32 caps2;
+		u32 caps3;
+		u32 caps4;
+		u32 reserved2;
+	};
+
+	struct DdsHeaderDX10_t
+	{
+		u32 dxgiFormat;
+		u32 resourceDimension;
+		u32 miscFlag;
+		u32 arraySize;
+		u32 miscFlags2;
+	};
+
+	static_assert(sizeof(DdsHeader_t) == 124, "DDS header size mismatch");
+
+	static bool DdsFile_GetFourCCFormat(const u32 aFourCC, PixelFormat& aFormat)
+	{
+		switch (aFourCC)
+		{
+			case DDS_FOURCC('D', 'X', 'T', '1'): aFormat = PixelFormat_DXT1; return true;
+			case DDS_FOURCC('D', 'X', 'T', '2'): aFormat = PixelFormat_DXT2; return true;
+			case DDS_FOURCC('D', 'X', 'T', '3'): aFormat = PixelFormat_DXT3; return true;
+			case DDS_FOURCC('D', 'X', 'T', '4'): aFormat = PixelFormat_DXT4; return true;
+			case DDS_FOURCC('D', 'X', 'T', '5'): aFormat = PixelFormat_DXT5; return true;
+			case DDS_FOURCC('A', 'T', 'I', '1'):
+			case DDS_FOURCC('B', 'C', '4', 'U'): aFormat = PixelFormat_BC4; return true;
+			case DDS_FOURCC('A', 'T', 'I', '2'):
+			case DDS_FOURCC('B', 'C', '5', 'U'): aFormat = PixelFormat_BC5; return true;
+			default:
+				return false;
+		}
+	}
+
+	static bool DdsFile_GetDxgiFormat(const u32 aDxgi, PixelFormat& aFormat, bool& aSRGB)
+	{
+		aSRGB = false;
+
+		switch (aDxgi)
+		{
+			case DxgiFormat_R8G8B8A8_UNORM_SRGB: aSRGB = true; [[fallthrough]];
+			case DxgiFormat_R8G8B8A8_UNORM: aFormat = PixelFormat_RGBA; return true;
+			case DxgiFormat_BC1_UNORM_SRGB: aSRGB = true; [[fallthrough]];
+			case DxgiFormat_BC1_UNORM: aFormat = PixelFormat_DXT1; return true;
+			case DxgiFormat_BC2_UNORM_SRGB: aSRGB = true; [[fallthrough]];
+			case DxgiFormat_BC2_UNORM: aFormat = PixelFormat_DXT3; return true;
+			case DxgiFormat_BC3_UNORM_SRGB: aSRGB = true; [[fallthrough]];
+			case DxgiFormat_BC3_UNORM: aFormat = PixelFormat_DXT5; return true;
+			case DxgiFormat_BC4_UNORM: aFormat = PixelFormat_BC4; return true;
+			case DxgiFormat_BC5_UNORM: aFormat = PixelFormat_BC5; return true;
+			case DxgiFormat_BC6H_UF16: aFormat = PixelFormat_BC6H; return true;
+			case DxgiFormat_BC7_UNORM_SRGB: aSRGB = true; [[fallthrough]];
+			case DxgiFormat_BC7_UNORM: aFormat = PixelFormat_BC7; return true;
+			default:
+				return false;
+		}
+	}
+
+	static bool DdsFile_GetWriteFormat(const Bitmap& aBitmap, u32& aFourCC, u32& aDxgi)
+	{
+		const bool srgb = aBitmap.IsSRGB();
+
+		aFourCC = 0;
+		aDxgi = 0;
+
+		// the legacy header has no sRGB flag, those need DX10
+		switch (aBitmap.GetPixelFormat())
+		{
+			case PixelFormat_RGBA:	if (srgb) aDxgi = DxgiFormat_R8G8B8A8_UNORM_SRGB; return true;
+			case PixelFormat_RGB:
+			case PixelFormat_Luminance: return true;
+			case PixelFormat_DXT1:	if (srgb) aDxgi = DxgiFormat_BC1_UNORM_SRGB; else aFourCC = DDS_FOURCC('D', 'X', 'T', '1'); return true;
+			case PixelFormat_DXT3:	if (srgb) aDxgi = DxgiFormat_BC2_UNORM_SRGB; else aFourCC = DDS_FOURCC('D', 'X', 'T', '3'); return true;
+			case PixelFormat_DXT5:	if (srgb) aDxgi = DxgiFormat_BC3_UNORM_SRGB; else aFourCC = DDS_FOURCC('D', 'X', 'T', '5'); return true;
+			case PixelFormat_BC4:	aFourCC = DDS_FOURCC('A', 'T', 'I', '1'); return true;
+			case PixelFormat_BC5:	aFourCC = DDS_FOURCC('A', 'T', 'I', '2'); return true;
+			case PixelFormat_BC6H:	aDxgi = DxgiFormat_BC6H_UF16; return true;
+			case PixelFormat_BC7:	aDxgi = srgb ? DxgiFormat_BC7_UNORM_SRGB : DxgiFormat_BC7_UNORM; return true;
+			default:
+				return false;
+		}
+	}
+
+	bool DdsFile_Write(const String& aFileName, const Bitmap& aBitmap, const bool aTopDown)
+	{
+		const int channels = aBitmap.GetBytesPerPixel();
+		const bool compressed = aBitmap.IsCompressed();
+		u32 fourCC, dxgi;
+
+		if (aBitmap.GetNumImages() != 1 || !DdsFile_GetWriteFormat(aBitmap, fourCC, dxgi))
+		{
+			Error("DDS: unsupported bitmap format (%s)", aFileName.c_str());
+			return false;
+		}
+
+		DdsHeader_t hdr{};
+		hdr.size = sizeof(DdsHeader_t);
+		hdr.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT;
+		hdr.width = u32(aBitmap.GetSizeX());
+		hdr.height = u32(aBitmap.GetSizeY());
+		hdr.mipMapCount = u32(aBitmap.GetNumMipmaps());
+		hdr.ddspf.size = sizeof(DdsPixelFormat_t);
+		hdr.caps = DDSCAPS_TEXTURE;
+
+		if (compressed)
+		{
+			hdr.flags |= DDSD_LINEARSIZE;
+			hdr.pitchOrLinearSize = u32(aBitmap.GetData(0, 0)->GetSize());
+		}
+		else
+		{
+			hdr.flags |= DDSD_PITCH;
+			hdr.pitchOrLinearSize = u32(aBitmap.GetSizeX() * channels);
+		}
+
+		if (aBitmap.GetNumMipmaps() > 1)
+		{
+			hdr.flags |= DDSD_MIPMAPCOUNT;
+			hdr.caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+		}
+
+		DdsHeaderDX10_t hdr10{};
+
+		if (dxgi)
+		{
+			hdr.ddspf.flags = DDPF_FOURCC;
+			hdr.ddspf.fourCC = DDS_FOURCC('D', 'X', '1', '0');
+			hdr10.dxgiFormat = dxgi;
+			hdr10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+			hdr10.arraySize = 1;
+		}
+		else if (fourCC)
+		{
+			hdr.ddspf.flags = DDPF_FOURCC;
+			hdr.ddspf.fourCC = fourCC;
+		}
+		else if (channels == 1)
+		{
+			hdr.ddspf.flags = DDPF_LUMINANCE;
+			hdr.ddspf.rgbBitCount = 8;
+			hdr.ddspf.rBitMask = 0xFF;
+		}
+		else
+		{
+			// byte order in memory is R, G, B, A
+			hdr.ddspf.flags = DDPF_RGB | (channels == 4 ? DDPF_ALPHAPIXELS : 0);
+			hdr.ddspf.rgbBitCount = u32(channels * 8);
+			hdr.ddspf.rBitMask = 0x000000FF;
+			hdr.ddspf.gBitMask = 0x0000FF00;
+			hdr.ddspf.bBitMask = 0x00FF0000;
+			hdr.ddspf.aBitMask = channels == 4 ? 0xFF000000 : 0;
+		}
+
+		// the file stores the top row first, nothing is written in GL order
+		const Bitmap* rows = &aBitmap;
+		Bitmap flipped;
+		if (!aTopDown)
+		{
+			flipped = aBitmap;
+			if (!FlipBitmapVertically(flipped))
+			{
+				Error("DDS: cannot flip the rows of %s", aFileName.c_str());
+				return false;
+			}
+			rows = &flipped;
+		}
+
+		std::ofstream out(aFileName, std::ios::binary | std::ios::trunc);
+		if (!out.good())
+		{
+			Error("DDS: cannot write %s", aFileName.c_str());
+			return false;
+		}
+
+		out.write(reinterpret_cast<const char*>(&kDdsMagic), sizeof(kDdsMagic));
+		out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+		if (dxgi)
+		{
+			out.write(reinterpret_cast<const char*>(&hdr10), sizeof(hdr10));
+		}
+
+		for (int mip = 0; mip < rows->GetNumMipmaps(); ++mip)
+		{
+			const BitmapData* data = rows->GetData(0, mip);
+			out.write(reinterpret_cast<const char*>(data->GetData()), data->GetSize());
+		}
+
+		return out.good();
+	}
+
+	bool DdsFile_Load(const String& aFileName, Bitmap& aBitmap)
+	{
+		MappedFile file;
+		if (!file.Open(aFileName))
+			return false;
+
+		const u8* ptr = file.GetData();
+		const u8* end = ptr + file.GetSize();
+
+		DdsHeader_t hdr;
+		if (file.GetSize() < sizeof(u32) + sizeof(hdr) || *reinterpret_cast<const u32*>(ptr) != kDdsMagic)
+		{
+			Error("DDS: invalid header in %s", aFileName.c_str());
+			return false;
+		}
+
+		std::memcpy(&hdr, ptr + sizeof(u32), sizeof(hdr));
+		ptr += sizeof(u32) + sizeof(hdr);
+
+		if (hdr.size != sizeof(DdsHeader_t))
+		{
+			Error("DDS: invalid header in %s", aFileName.c_str());
+			return false;
+		}
+
+		PixelFormat format = PixelFormat_Unknown;
+		bool isSRGB = false;
+		int numImages = (hdr.caps2 & DDSCAPS2_CUBEMAP) ? 6 : 1;
+		int bytesPerPixel = 0;
+
+		if ((hdr.ddspf.flags & DDPF_FOURCC) && hdr.ddspf.fourCC == DDS_FOURCC('D', 'X', '1', '0'))
+		{
+			DdsHeaderDX10_t dx10;
+			if (size_t(end - ptr) < sizeof(dx10))
+			{
+				Error("DDS: truncated file %s", aFileName.c_str());
+				return false;
+			}
+
+			std::memcpy(&dx10, ptr, sizeof(dx10));
+			ptr += sizeof(dx10);
+
+			if (!DdsFile_GetDxgiFormat(dx10.dxgiFormat, format, isSRGB))
+			{
+				Error("DDS: unsupported DXGI format %d in %s", int(dx10.dxgiFormat), aFileName.c_str());
+				return false;
+			}
+
+			numImages = int(std::max(1U, dx10.arraySize)) * ((dx10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) ? 6 : 1);
+			bytesPerPixel = format == PixelFormat_RGBA ? 4 : 0;
+		}
+		else if (hdr.ddspf.flags & DDPF_FOURCC)
+		{
+			if (!DdsFile_GetFourCCFormat(hdr.ddspf.fourCC, format))
+			{
+				Error("DDS: unsupported FourCC in %s", aFileName.c_str());
+				return false;
+			}
+		}
+		else if ((hdr.ddspf.flags & DDPF_LUMINANCE) && hdr.ddspf.rgbBitCount == 8)
+		{
+			format = PixelFormat_Luminance;
+			bytesPerPixel = 1;
+		}
+		else if ((hdr.ddspf.flags & DDPF_RGB) && hdr.ddspf.rBitMask == 0xFF && (hdr.ddspf.rgbBitCount == 24 || hdr.ddspf.rgbBitCount == 32))
+		{
+			format = hdr.ddspf.rgbBitCount == 32 ? PixelFormat_RGBA : PixelFormat_RGB;
+			bytesPerPixel = int(hdr.ddspf.rgbBitCount / 8);
+		}
+		else
+		{
+			Error("DDS: unsupported pixel format in %s", aFileName.c_str());
+			return false;
+		}
+
+		const int numMips = (hdr.flags & DDSD_MIPMAPCOUNT) ? std::max(1, int(hdr.mipMapCount)) : 1;
+		const bool isCompressed = IsCompressedPixelFormat(format);
+
+		aBitmap.SetFileName(aFileName);
+		aBitmap.SetSize(int(hdr.width), int(hdr.height), int(std::max(1U, hdr.depth)));
+		aBitmap.SetPixelFormat(format);
+		aBitmap.SetCompressed(isCompressed);
+		aBitmap.SetSRGB(isSRGB);
+		aBitmap.SetBytesPerPixel(bytesPerPixel);
+		aBitmap.Init(numImages, numMips);
+
+		// images one after the other, each with its full mip chain
+		for (int image = 0; image < numImages; ++image)
+		{
+			for (int mip = 0; mip < numMips; ++mip)
+			{
+				const int w = aBitmap.GetMipSizeX(mip);
+				const int h = aBitmap.GetMipSizeY(mip);
+				const size_t size = isCompressed ? GetCompressedImageSize(format, w, h) : size_t(w) * h * bytesPerPixel;
+
+				if (size_t(end - ptr) < size)
+				{
+					Error("DDS: truncated file %s", aFileName.c_str());
+					return false;
+				}
+
+				aBitmap.GetData(image, mip)->SetData(ptr, int(size));
+				ptr += size;
+			}
+		}
+
+		// GL expects the bottom row first
+		if (!FlipBitmapVertically(aBitmap))
+		{
+			Warning("DDS: cannot flip %s, it is uploaded as stored", aFileName.c_str());
+		}
+
+		return true;
+	}
+}
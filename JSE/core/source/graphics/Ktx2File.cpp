@@ -0,0 +1,217 @@
+#include <cstring>
+#include <algorithm>
+
+#include "graphics/Ktx2File.hpp"
+#include "system/Logger.hpp"
+#include "system/MappedFile.hpp"
+
+namespace jse {
+
+	static const u8 kKtx2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	enum VkFormat
+	{
+		VkFormat_R8_UNORM = 9,
+		VkFormat_R8G8B8_UNORM = 23,
+		VkFormat_R8G8B8_SRGB = 29,
+		VkFormat_R8G8B8A8_UNORM = 37,
+		VkFormat_R8G8B8A8_SRGB = 43,
+		VkFormat_BC1_RGB_UNORM = 131,
+		VkFormat_BC1_RGB_SRGB = 132,
+		VkFormat_BC1_RGBA_UNORM = 133,
+		VkFormat_BC1_RGBA_SRGB = 134,
+		VkFormat_BC2_UNORM = 135,
+		VkFormat_BC2_SRGB = 136,
+		VkFormat_BC3_UNORM = 137,
+		VkFormat_BC3_SRGB = 138,
+		VkFormat_BC4_UNORM = 139,
+		VkFormat_BC5_UNORM = 141,
+		VkFormat_BC6H_UFLOAT = 143,
+		VkFormat_BC7_UNORM = 145,
+		VkFormat_BC7_SRGB = 146
+	};
+
+	struct Ktx2Header_t
+	{
+		u8 identifier[12];
+		u32 vkFormat;
+		u32 typeSize;
+		u32 pixelWidth;
+		u32 pixelHeight;
+		u32 pixelDepth;
+		u32 layerCount;
+		u32 faceCount;
+		u32 levelCount;
+		u32 supercompressionScheme;
+		u32 dfdByteOffset;
+		u32 dfdByteLength;
+		u32 kvdByteOffset;
+		u32 kvdByteLength;
+		u64 sgdByteOffset;
+		u64 sgdByteLength;
+	};
+
+	struct Ktx2Level_t
+	{
+		u64 byteOffset;
+		u64 byteLength;
+		u64 uncompressedByteLength;
+	};
+
+	static_assert(sizeof(Ktx2Header_t) == 80, "KTX2 header size mismatch");
+
+	static bool Ktx2File_GetFormat(const u32 aVkFormat, PixelFormat& aFormat, bool& aSRGB, int& aBytesPerPixel)
+	{
+		aSRGB = false;
+		aBytesPerPixel = 0;
+
+		switch (aVkFormat)
+		{
+			case VkFormat_R8_UNORM:			aFormat = PixelFormat_Luminance; aBytesPerPixel = 1; return true;
+			case VkFormat_R8G8B8_SRGB:		aSRGB = true; [[fallthrough]];
+			case VkFormat_R8G8B8_UNORM:		aFormat = PixelFormat_RGB; aBytesPerPixel = 3; return true;
+			case VkFormat_R8G8B8A8_SRGB:	aSRGB = true; [[fallthrough]];
+			case VkFormat_R8G8B8A8_UNORM:	aFormat = PixelFormat_RGBA; aBytesPerPixel = 4; return true;
+			case VkFormat_BC1_RGB_SRGB:
+			case VkFormat_BC1_RGBA_SRGB:	aSRGB = true; [[fallthrough]];
+			case VkFormat_BC1_RGB_UNORM:
+			case VkFormat_BC1_RGBA_UNORM:	aFormat = PixelFormat_DXT1; return true;
+			case VkFormat_BC2_SRGB:			aSRGB = true; [[fallthrough]];
+			case VkFormat_BC2_UNORM:		aFormat = PixelFormat_DXT3; return true;
+			case VkFormat_BC3_SRGB:			aSRGB = true; [[fallthrough]];
+			case VkFormat_BC3_UNORM:		aFormat = PixelFormat_DXT5; return true;
+			case VkFormat_BC4_UNORM:		aFormat = PixelFormat_BC4; return true;
+			case VkFormat_BC5_UNORM:		aFormat = PixelFormat_BC5; return true;
+			case VkFormat_BC6H_UFLOAT:		aFormat = PixelFormat_BC6H; return true;
+			case VkFormat_BC7_SRGB:			aSRGB = true; [[fallthrough]];
+			case VkFormat_BC7_UNORM:		aFormat = PixelFormat_BC7; return true;
+			default:
+				return false;
+		}
+	}
+
+	// True if the KTXorientation key says the first row is the top one ("rd", the default)
+	static bool Ktx2File_IsTopDown(const u8* aData, const size_t aFileSize, const Ktx2Header_t& aHeader)
+	{
+		if (aHeader.kvdByteLength == 0 || size_t(aHeader.kvdByteOffset) + aHeader.kvdByteLength > aFileSize)
+			return true;
+
+		static const char kOrientationKey[] = "KTXorientation";
+
+		const u8* ptr = aData + aHeader.kvdByteOffset;
+		const u8* end = ptr + aHeader.kvdByteLength;
+
+		// { u32 length, key\0value, padding to 4 bytes } entries
+		while (end - ptr >= 4)
+		{
+			u32 length;
+			std::memcpy(&length, ptr, sizeof(length));
+			ptr += sizeof(length);
+
+			if (length > size_t(end - ptr))
+				break;
+
+			const char* key = reinterpret_cast<const char*>(ptr);
+			if (length > sizeof(kOrientationKey) && std::memcmp(key, kOrientationKey, sizeof(kOrientationKey)) == 0)
+			{
+				// second letter is the y axis, 'u' means the first row is the bottom one
+				return !(length > sizeof(kOrientationKey) + 1 && key[sizeof(kOrientationKey) + 1] == 'u');
+			}
+
+			ptr += (length + 3) & ~3U;
+		}
+
+		return true;
+	}
+
+	bool Ktx2File_Load(const String& aFileName, Bitmap& aBitmap)
+	{
+		MappedFile file;
+		if (!file.Open(aFileName))
+			return false;
+
+		const u8* data = file.GetData();
+		const size_t fileSize = file.GetSize();
+
+		Ktx2Header_t hdr;
+		if (fileSize < sizeof(hdr) || std::memcmp(data, kKtx2Identifier, sizeof(kKtx2Identifier)) != 0)
+		{
+			Error("KTX2: invalid header in %s", aFileName.c_str());
+			return false;
+		}
+
+		std::memcpy(&hdr, data, sizeof(hdr));
+
+		if (hdr.supercompressionScheme != 0)
+		{
+			Error("KTX2: supercompressed files are not supported (%s)", aFileName.c_str());
+			return false;
+		}
+
+		PixelFormat format = PixelFormat_Unknown;
+		bool isSRGB = false;
+		int bytesPerPixel = 0;
+
+		if (!Ktx2File_GetFormat(hdr.vkFormat, format, isSRGB, bytesPerPixel))
+		{
+			Error("KTX2: unsupported vkFormat %d in %s", int(hdr.vkFormat), aFileName.c_str());
+			return false;
+		}
+
+		if (hdr.pixelDepth > 1)
+		{
+			Error("KTX2: 3D textures are not supported (%s)", aFileName.c_str());
+			return false;
+		}
+
+		const int numLevels = std::max(1, int(hdr.levelCount));
+		const int numLayers = std::max(1, int(hdr.layerCount));
+		const int numFaces = std::max(1, int(hdr.faceCount));
+		const int numImages = numLayers * numFaces;
+		const bool isCompressed = IsCompressedPixelFormat(format);
+
+		if (fileSize < sizeof(hdr) + numLevels * sizeof(Ktx2Level_t))
+		{
+			Error("KTX2: truncated file %s", aFileName.c_str());
+			return false;
+		}
+
+		const Ktx2Level_t* levels = reinterpret_cast<const Ktx2Level_t*>(data + sizeof(hdr));
+
+		aBitmap.SetFileName(aFileName);
+		aBitmap.SetSize(int(hdr.pixelWidth), int(std::max(1U, hdr.pixelHeight)), 1);
+		aBitmap.SetPixelFormat(format);
+		aBitmap.SetCompressed(isCompressed);
+		aBitmap.SetSRGB(isSRGB);
+		aBitmap.SetBytesPerPixel(bytesPerPixel);
+		aBitmap.Init(numImages, numLevels);
+
+		// a level holds every layer and face of that level, layer major
+		for (int mip = 0; mip < numLevels; ++mip)
+		{
+			const int w = aBitmap.GetMipSizeX(mip);
+			const int h = aBitmap.GetMipSizeY(mip);
+			const size_t size = isCompressed ? GetCompressedImageSize(format, w, h) : size_t(w) * h * bytesPerPixel;
+
+			const Ktx2Level_t level = levels[mip];
+			if (level.byteOffset + level.byteLength > fileSize || level.byteLength < size * numImages)
+			{
+				Error("KTX2: invalid level %d in %s", mip, aFileName.c_str());
+				return false;
+			}
+
+			for (int image = 0; image < numImages; ++image)
+			{
+				aBitmap.GetData(image, mip)->SetData(data + level.byteOffset + image * size, int(size));
+			}
+		}
+
+		// GL expects the bottom row first
+		if (Ktx2File_IsTopDown(data, fileSize, hdr) && !FlipBitmapVertically(aBitmap))
+		{
+			Warning("KTX2: cannot flip %s, it is uploaded as stored", aFileName.c_str());
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,789 @@
+#include <cmath>
+#include <cctype>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "graphics/MipGenerator.hpp"
+#include "system/ThreadPool.hpp"
+#include "system/Logger.hpp"
+
+namespace jse {
+
+	/*
+	 Levels are filtered as RGBA float in linear space (4 floats per pixel,
+	 missing channels are padded). Level 0 is converted row by row while
+	 building level 1, so a full float copy of the source is never made.
+	*/
+
+	const int kMipKaiserTaps = 6;
+	const int kMipLinearSteps = 1 << 16;
+	const int kMipRowGrain = 8;
+
+	typedef void (*MipBoxRowFunc)(const float* aRow0, const float* aRow1, float* aDst, const int aDstWidth, const int aSrcWidth);
+	typedef void (*MipKaiserRowFunc)(const float* aSrc, float* aDst, const int aDstWidth, const int aSrcWidth, const float* aWeights);
+	typedef void (*MipKaiserColFunc)(const float* const* aRows, float* aDst, const int aCount, const float* aWeights);
+
+	struct MipKernels_t
+	{
+		MipBoxRowFunc box;
+		MipKaiserRowFunc kaiserRow;
+		MipKaiserColFunc kaiserCol;
+	};
+
+	struct MipTables_t
+	{
+		MipTables_t()
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				const float c = i / 255.0f;
+				toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+
+			for (int i = 0; i < kMipLinearSteps; ++i)
+			{
+				const float l = float(i) / float(kMipLinearSteps - 1);
+				const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+				toSRGB[i] = u8(std::min(255.0f, c * 255.0f + 0.5f));
+			}
+		}
+
+		float toLinear[256];
+		u8 toSRGB[kMipLinearSteps];
+	};
+
+	struct MipImage_t
+	{
+		int sizeX{}, sizeY{};
+		std::vector<float> pixels;
+
+		inline float* Row(const int aY) { return pixels.data() + size_t(aY) * sizeX * 4; }
+	};
+
+	struct MipFormat_t
+	{
+		int channels;
+		int colorChannels;	// channels that are sRGB encoded when srgb is on
+		int alphaChannel;	// -1 if none
+		bool srgb;
+	};
+
+	static const MipTables_t& MipGen_GetTables()
+	{
+		static MipTables_t sTables;
+
+		return sTables;
+	}
+
+	static double MipGen_BesselI0(const double aX)
+	{
+		double sum = 1.0, term = 1.0;
+		for (int k = 1; k < 32; ++k)
+		{
+			term *= (aX / (2.0 * k)) * (aX / (2.0 * k));
+			sum += term;
+		}
+
+		return sum;
+	}
+
+	static void MipGen_GetKaiserWeights(float* aWeights)
+	{
+		const double alpha = 4.0;
+		const double radius = 3.0;
+		const double pi = 3.14159265358979323846;
+		double sum = 0.0;
+		double w[kMipKaiserTaps];
+
+		// source pixel centers at -2.5 .. 2.5 from the destination center
+		for (int k = 0; k < kMipKaiserTaps; ++k)
+		{
+			const double d = k - 2.5;
+			const double x = pi * d * 0.5;
+			const double sinc = std::sin(x) / x;
+			const double t = d / radius;
+			const double window = MipGen_BesselI0(alpha * std::sqrt(1.0 - t * t)) / MipGen_BesselI0(alpha);
+
+			w[k] = sinc * window;
+			sum += w[k];
+		}
+
+		for (int k = 0; k < kMipKaiserTaps; ++k)
+		{
+			aWeights[k] = float(w[k] / sum);
+		}
+	}
+
+	/* format conversion */
+
+	static void MipGen_RowToFloat(const u8* aSrc, float* aDst, const int aWidth, const MipFormat_t& aFmt)
+	{
+		const MipTables_t& tab = MipGen_GetTables();
+		const int n = aFmt.channels;
+
+		for (int x = 0; x < aWidth; ++x)
+		{
+			const u8* s = aSrc + x * n;
+			float* d = aDst + x * 4;
+
+			d[0] = d[1] = d[2] = 0.0f;
+			d[3] = 1.0f;
+
+			for (int c = 0; c < n; ++c)
+			{
+				const int dc = c == aFmt.alphaChannel ? 3 : c;
+				d[dc] = (aFmt.srgb && c < aFmt.colorChannels) ? tab.toLinear[s[c]] : s[c] * (1.0f / 255.0f);
+			}
+		}
+	}
+
+	static void MipGen_RowToBytes(const float* aSrc, u8* aDst, const int aWidth, const MipFormat_t& aFmt)
+	{
+		const MipTables_t& tab = MipGen_GetTables();
+		const int n = aFmt.channels;
+
+		for (int x = 0; x < aWidth; ++x)
+		{
+			const float* s = aSrc + x * 4;
+			u8* d = aDst + x * n;
+
+			for (int c = 0; c < n; ++c)
+			{
+				const int sc = c == aFmt.alphaChannel ? 3 : c;
+				const float v = std::min(1.0f, std::max(0.0f, s[sc]));
+
+				d[c] = (aFmt.srgb && c < aFmt.colorChannels) ? tab.toSRGB[int(v * (kMipLinearSteps - 1) + 0.5f)] : u8(v * 255.0f + 0.5f);
+			}
+		}
+	}
+
+	/* scalar reference kernels */
+
+	static void MipGen_BoxRowTail(const float* aRow0, const float* aRow1, float* aDst, const int aFirst, const int aDstWidth, const int aSrcWidth)
+	{
+		for (int x = aFirst; x < aDstWidth; ++x)
+		{
+			const int x0 = std::min(2 * x, aSrcWidth - 1);
+			const int x1 = std::min(2 * x + 1, aSrcWidth - 1);
+
+			for (int c = 0; c < 4; ++c)
+			{
+				aDst[x * 4 + c] = 0.25f * (aRow0[x0 * 4 + c] + aRow0[x1 * 4 + c] + aRow1[x0 * 4 + c] + aRow1[x1 * 4 + c]);
+			}
+		}
+	}
+
+	// Last destination pixel of a row over an odd source width: the 3 last columns of every row
+	static void MipGen_BoxOddColumn(const float* const* aRows, const int aNumRows, float* aDst, const int aDstWidth, const int aSrcWidth)
+	{
+		const float scale = 1.0f / float(3 * aNumRows);
+		float* d = aDst + (aDstWidth - 1) * 4;
+
+		for (int c = 0; c < 4; ++c)
+		{
+			float sum = 0.0f;
+			for (int r = 0; r < aNumRows; ++r)
+			{
+				for (int x = aSrcWidth - 3; x < aSrcWidth; ++x)
+				{
+					sum += aRows[r][x * 4 + c];
+				}
+			}
+
+			d[c] = sum * scale;
+		}
+	}
+
+	static void MipGen_BoxRow_Scalar(const float* aRow0, const float* aRow1, float* aDst, const int aDstWidth, const int aSrcWidth)
+	{
+		MipGen_BoxRowTail(aRow0, aRow1, aDst, 0, aDstWidth, aSrcWidth);
+	}
+
+	static void MipGen_KaiserPixel(const float* aSrc, float* aDst, const int aX, const int aSrcWidth, const float* aWeights)
+	{
+		float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+		for (int k = 0; k < kMipKaiserTaps; ++k)
+		{
+			const int sx = std::min(std::max(2 * aX - 2 + k, 0), aSrcWidth - 1);
+			for (int c = 0; c < 4; ++c)
+			{
+				acc[c] += aWeights[k] * aSrc[sx * 4 + c];
+			}
+		}
+
+		for (int c = 0; c < 4; ++c)
+		{
+			aDst[aX * 4 + c] = acc[c];
+		}
+	}
+
+	static void MipGen_KaiserRow_Scalar(const float* aSrc, float* aDst, const int aDstWidth, const int aSrcWidth, const float* aWeights)
+	{
+		for (int x = 0; x < aDstWidth; ++x)
+		{
+			MipGen_KaiserPixel(aSrc, aDst, x, aSrcWidth, aWeights);
+		}
+	}
+
+	static void MipGen_KaiserCol_Scalar(const float* const* aRows, float* aDst, const int aCount, const float* aWeights)
+	{
+		for (int i = 0; i < aCount; ++i)
+		{
+			float acc = 0.0f;
+			for (int k = 0; k < kMipKaiserTaps; ++k)
+			{
+				acc += aWeights[k] * aRows[k][i];
+			}
+
+			aDst[i] = std::min(1.0f, std::max(0.0f, acc));
+		}
+	}
+
+	// first and last+1 destination pixel whose taps are all inside the source row
+	static void MipGen_KaiserInterior(const int aDstWidth, const int aSrcWidth, int& aBegin, int& aEnd)
+	{
+		aBegin = 1;
+		aEnd = std::max(aBegin, std::min(aDstWidth, (aSrcWidth - 4) / 2 + 1));
+	}
+
+#if defined(JSE_SIMD_X86)
+
+	/* SSE4.1 kernels, one RGBA pixel per register */
+
+	JSE_TARGET_SSE41 static void MipGen_BoxRow_SSE(const float* aRow0, const float* aRow1, float* aDst, const int aDstWidth, const int aSrcWidth)
+	{
+		const __m128 quarter = _mm_set1_ps(0.25f);
+		const int n = std::min(aDstWidth, aSrcWidth / 2);
+
+		int x = 0;
+		for (; x < n; ++x)
+		{
+			const float* a = aRow0 + 8 * x;
+			const float* b = aRow1 + 8 * x;
+			const __m128 s0 = _mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(a + 4));
+			const __m128 s1 = _mm_add_ps(_mm_loadu_ps(b), _mm_loadu_ps(b + 4));
+
+			_mm_storeu_ps(aDst + 4 * x, _mm_mul_ps(_mm_add_ps(s0, s1), quarter));
+		}
+
+		MipGen_BoxRowTail(aRow0, aRow1, aDst, x, aDstWidth, aSrcWidth);
+	}
+
+	JSE_TARGET_SSE41 static void MipGen_KaiserRow_SSE(const float* aSrc, float* aDst, const int aDstWidth, const int aSrcWidth, const float* aWeights)
+	{
+		int begin, end;
+		MipGen_KaiserInterior(aDstWidth, aSrcWidth, begin, end);
+
+		__m128 w[kMipKaiserTaps];
+		for (int k = 0; k < kMipKaiserTaps; ++k)
+		{
+			w[k] = _mm_set1_ps(aWeights[k]);
+		}
+
+		for (int x = 0; x < std::min(begin, aDstWidth); ++x)
+		{
+			MipGen_KaiserPixel(aSrc, aDst, x, aSrcWidth, aWeights);
+		}
+
+		for (int x = begin; x < end; ++x)
+		{
+			const float* p = aSrc + 4 * (2 * x - 2);
+			__m128 acc = _mm_mul_ps(w[0], _mm_loadu_ps(p));
+			for (int k = 1; k < kMipKaiserTaps; ++k)
+			{
+				acc = _mm_add_ps(acc, _mm_mul_ps(w[k], _mm_loadu_ps(p + 4 * k)));
+			}
+
+			_mm_storeu_ps(aDst + 4 * x, acc);
+		}
+
+		for (int x = std::max(end, begin); x < aDstWidth; ++x)
+		{
+			MipGen_KaiserPixel(aSrc, aDst, x, aSrcWidth, aWeights);
+		}
+	}
+
+	JSE_TARGET_SSE41 static void MipGen_KaiserCol_SSE(const float* const* aRows, float* aDst, const int aCount, const float* aWeights)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		int i = 0;
+		for (; i + 4 <= aCount; i += 4)
+		{
+			__m128 acc = _mm_mul_ps(_mm_set1_ps(aWeights[0]), _mm_loadu_ps(aRows[0] + i));
+			for (int k = 1; k < kMipKaiserTaps; ++k)
+			{
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(aWeights[k]), _mm_loadu_ps(aRows[k] + i)));
+			}
+
+			_mm_storeu_ps(aDst + i, _mm_min_ps(one, _mm_max_ps(zero, acc)));
+		}
+
+		const float* rows[kMipKaiserTaps];
+		for (int k = 0; k < kMipKaiserTaps; ++k)
+		{
+			rows[k] = aRows[k] + i;
+		}
+
+		MipGen_KaiserCol_Scalar(rows, aDst + i, aCount - i, aWeights);
+	}
+
+	/* AVX2 kernels, two RGBA pixels per register */
+
+	JSE_TARGET_AVX2 static void MipGen_BoxRow_AVX2(const float* aRow0, const float* aRow1, float* aDst, const int aDstWidth, const int aSrcWidth)
+	{
+		const __m256 quarter = _mm256_set1_ps(0.25f);
+		const int n = std::min(aDstWidth, aSrcWidth / 2);
+
+		int x = 0;
+		for (; x + 2 <= n; x += 2)
+		{
+			const float* a = aRow0 + 8 * x;
+			const float* b = aRow1 + 8 * x;
+			const __m256 s0 = _mm256_add_ps(_mm256_loadu_ps(a), _mm256_loadu_ps(b));			// p0 | p1
+			const __m256 s1 = _mm256_add_ps(_mm256_loadu_ps(a + 8), _mm256_loadu_ps(b + 8));	// p2 | p3
+			const __m256 lo = _mm256_permute2f128_ps(s0, s1, 0x20);							// p0 | p2
+			const __m256 hi = _mm256_permute2f128_ps(s0, s1, 0x31);							// p1 | p3
+
+			_mm256_storeu_ps(aDst + 4 * x, _mm256_mul_ps(_mm256_add_ps(lo, hi), quarter));
+		}
+
+		MipGen_BoxRowTail(aRow0, aRow1, aDst, x, aDstWidth, aSrcWidth);
+	}
+
+	JSE_TARGET_AVX2 static void MipGen_KaiserRow_AVX2(const float* aSrc, float* aDst, const int aDstWidth, const int aSrcWidth, const float* aWeights)
+	{
+		int begin, end;
+		MipGen_KaiserInterior(aDstWidth, aSrcWidth, begin, end);
+
+		__m256 w[kMipKaiserTaps];
+		for (int k = 0; k < kMipKaiserTaps; ++k)
+		{
+			w[k] = _mm256_set1_ps(aWeights[k]);
+		}
+
+		for (int x = 0; x < std::min(begin, aDstWidth); ++x)
+		{
+			MipGen_KaiserPixel(aSrc, aDst, x, aSrcWidth, aWeights);
+		}
+
+		int x = begin;
+		for (; x + 2 <= end; x += 2)
+		{
+			// destination x and x + 1 read source pixels two apart
+			const float* p = aSrc + 4 * (2 * x - 2);
+			__m256 acc = _mm256_setzero_ps();
+			for (int k = 0; k < kMipKaiserTaps; ++k)
+			{
+				const __m256 v = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 4 * k)), _mm_loadu_ps(p + 4 * k + 8), 1);
+				acc = _mm256_fmadd_ps(w[k], v, acc);
+			}
+
+			_mm256_storeu_ps(aDst + 4 * x, acc);
+		}
+
+		for (; x < aDstWidth; ++x)
+		{
+			MipGen_KaiserPixel(aSrc, aDst, x, aSrcWidth, aWeights);
+		}
+	}
+
+	JSE_TARGET_AVX2 static void MipGen_KaiserCol_AVX2(const float* const* aRows, float* aDst, const int aCount, const float* aWeights)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+
+		int i = 0;
+		for (; i + 8 <= aCount; i += 8)
+		{
+			__m256 acc = _mm256_mul_ps(_mm256_set1_ps(aWeights[0]), _mm256_loadu_ps(aRows[0] + i));
+			for (int k = 1; k < kMipKaiserTaps; ++k)
+			{
+				acc = _mm256_fmadd_ps(_mm256_set1_ps(aWeights[k]), _mm256_loadu_ps(aRows[k] + i), acc);
+			}
+
+			_mm256_storeu_ps(aDst + i, _mm256_min_ps(one, _mm256_max_ps(zero, acc)));
+		}
+
+		const float* rows[kMipKaiserTaps];
+		for (int k = 0; k < kMipKaiserTaps; ++k)
+		{
+			rows[k] = aRows[k] + i;
+		}
+
+		MipGen_KaiserCol_Scalar(rows, aDst + i, aCount - i, aWeights);
+	}
+
+#endif
+
+	static MipKernels_t MipGen_GetKernels(const SimdLevel aLevel)
+	{
+#if defined(JSE_SIMD_X86)
+		if (aLevel == SimdLevel_AVX2)
+		{
+			return { MipGen_BoxRow_AVX2, MipGen_KaiserRow_AVX2, MipGen_KaiserCol_AVX2 };
+		}
+		if (aLevel == SimdLevel_SSE)
+		{
+			return { MipGen_BoxRow_SSE, MipGen_KaiserRow_SSE, MipGen_KaiserCol_SSE };
+		}
+#endif
+		return { MipGen_BoxRow_Scalar, MipGen_KaiserRow_Scalar, MipGen_KaiserCol_Scalar };
+	}
+
+	/* source rows: either the 8 bit level 0 (converted on the fly) or a float level */
+
+	class MipGen_Source
+	{
+	public:
+		MipGen_Source(const u8* aBytes, const int aSizeX, const int aSizeY, const MipFormat_t& aFmt) :
+			mBytes(aBytes), mImage(nullptr), mSizeX(aSizeX), mSizeY(aSizeY), mFmt(aFmt) {}
+
+		MipGen_Source(MipImage_t& aImage, const MipFormat_t& aFmt) :
+			mBytes(nullptr), mImage(&aImage), mSizeX(aImage.sizeX), mSizeY(aImage.sizeY), mFmt(aFmt) {}
+
+		const float* GetRow(const int aY, float* aScratch) const
+		{
+			const int y = std::min(std::max(aY, 0), mSizeY - 1);
+
+			if (mImage)
+				return mImage->Row(y);
+
+			MipGen_RowToFloat(mBytes + size_t(y) * mSizeX * mFmt.channels, aScratch, mSizeX, mFmt);
+
+			return aScratch;
+		}
+
+		inline int GetSizeX() const { return mSizeX; }
+		inline int GetSizeY() const { return mSizeY; }
+
+	private:
+		const u8* mBytes;
+		MipImage_t* mImage;
+		int mSizeX, mSizeY;
+		MipFormat_t mFmt;
+	};
+
+	static void MipGen_Downsample(const MipGen_Source& aSrc, MipImage_t& aDst, const MipFilter aFilter, const MipKernels_t& aKernels, const float* aWeights)
+	{
+		ThreadPool& pool = GetDefaultThreadPool();
+		const int srcX = aSrc.GetSizeX();
+		const int srcY = aSrc.GetSizeY();
+
+		aDst.sizeX = std::max(1, srcX >> 1);
+		aDst.sizeY = std::max(1, srcY >> 1);
+		aDst.pixels.resize(size_t(aDst.sizeX) * aDst.sizeY * 4);
+
+		if (aFilter == MipFilter_Box)
+		{
+			// odd sizes: the last column / row of the destination averages 3 source pixels
+			const bool oddX = srcX > 1 && (srcX & 1);
+			const bool oddY = srcY > 1 && (srcY & 1);
+
+			pool.ParallelFor(aDst.sizeY, [&](size_t y) {
+				thread_local std::vector<float> scratch0, scratch1, scratch2, edge;
+				scratch0.resize(size_t(srcX) * 4);
+				scratch1.resize(size_t(srcX) * 4);
+
+				const float* rows[3];
+				int numRows = 2;
+				rows[0] = aSrc.GetRow(int(2 * y), scratch0.data());
+				rows[1] = aSrc.GetRow(int(2 * y + 1), scratch1.data());
+
+				float* dst = aDst.Row(int(y));
+				aKernels.box(rows[0], rows[1], dst, aDst.sizeX, srcX);
+
+				if (oddY && int(y) == aDst.sizeY - 1)
+				{
+					scratch2.resize(size_t(srcX) * 4);
+					edge.resize(size_t(aDst.sizeX) * 4);
+					rows[numRows++] = aSrc.GetRow(int(2 * y + 2), scratch2.data());
+
+					aKernels.box(rows[2], rows[2], edge.data(), aDst.sizeX, srcX);
+					for (int i = 0; i < aDst.sizeX * 4; ++i)
+					{
+						dst[i] = (2.0f * dst[i] + edge[i]) * (1.0f / 3.0f);
+					}
+				}
+
+				if (oddX)
+				{
+					MipGen_BoxOddColumn(rows, numRows, dst, aDst.sizeX, srcX);
+				}
+			}, kMipRowGrain);
+
+			return;
+		}
+
+		// separable: horizontal pass over every source row, then vertical
+		MipImage_t tmp;
+		tmp.sizeX = aDst.sizeX;
+		tmp.sizeY = srcY;
+		tmp.pixels.resize(size_t(tmp.sizeX) * tmp.sizeY * 4);
+
+		pool.ParallelFor(srcY, [&](size_t y) {
+			thread_local std::vector<float> scratch;
+			scratch.resize(size_t(srcX) * 4);
+
+			aKernels.kaiserRow(aSrc.GetRow(int(y), scratch.data()), tmp.Row(int(y)), tmp.sizeX, srcX, aWeights);
+		}, kMipRowGrain);
+
+		pool.ParallelFor(aDst.sizeY, [&](size_t y) {
+			const float* rows[kMipKaiserTaps];
+			for (int k = 0; k < kMipKaiserTaps; ++k)
+			{
+				rows[k] = tmp.Row(std::min(std::max(int(2 * y) - 2 + k, 0), srcY - 1));
+			}
+
+			aKernels.kaiserCol(rows, aDst.Row(int(y)), aDst.sizeX * 4, aWeights);
+		}, kMipRowGrain);
+	}
+
+	static float MipGen_GetAlphaCoverage(const MipImage_t& aImage, const float aCutoff, const float aScale)
+	{
+		const size_t count = size_t(aImage.sizeX) * aImage.sizeY;
+		size_t covered = 0;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (aImage.pixels[i * 4 + 3] * aScale >= aCutoff)
+				covered++;
+		}
+
+		return float(covered) / float(count);
+	}
+
+	static void MipGen_ScaleAlphaToCoverage(MipImage_t& aImage, const float aCutoff, const float aCoverage)
+	{
+		float lo = 0.0f, hi = 8.0f;
+
+		for (int i = 0; i < 12; ++i)
+		{
+			const float mid = 0.5f * (lo + hi);
+			if (MipGen_GetAlphaCoverage(aImage, aCutoff, mid) < aCoverage)
+				lo = mid;
+			else
+				hi = mid;
+		}
+
+		// coverage is a step function of the scale, take the closer side
+		const float errLo = std::abs(MipGen_GetAlphaCoverage(aImage, aCutoff, lo) - aCoverage);
+		const float errHi = std::abs(MipGen_GetAlphaCoverage(aImage, aCutoff, hi) - aCoverage);
+		const float scale = errLo < errHi ? lo : hi;
+
+		for (size_t i = 3; i < aImage.pixels.size(); i += 4)
+		{
+			aImage.pixels[i] = std::min(1.0f, aImage.pixels[i] * scale);
+		}
+	}
+
+	static bool MipGen_GetFormat(const Bitmap& aBitmap, const bool aSRGB, MipFormat_t& aFmt)
+	{
+		aFmt.srgb = aSRGB;
+
+		switch (aBitmap.GetPixelFormat())
+		{
+			case PixelFormat_Luminance:			aFmt.channels = 1; aFmt.colorChannels = 1; aFmt.alphaChannel = -1; return true;
+			case PixelFormat_LuminanceAlpha:	aFmt.channels = 2; aFmt.colorChannels = 1; aFmt.alphaChannel = 1; return true;
+			case PixelFormat_RGB:				aFmt.channels = 3; aFmt.colorChannels = 3; aFmt.alphaChannel = -1; return true;
+			case PixelFormat_RGBA:				aFmt.channels = 4; aFmt.colorChannels = 3; aFmt.alphaChannel = 3; return true;
+			default:
+				return false;
+		}
+	}
+
+	int GetMipCount(const int aSizeX, const int aSizeY)
+	{
+		int n = 1;
+		for (int s = std::max(aSizeX, aSizeY); s > 1; s >>= 1)
+		{
+			n++;
+		}
+
+		return n;
+	}
+
+	struct MipUsageToken_t
+	{
+		const char* token;
+		ImageUsage usage;
+	};
+
+	static const MipUsageToken_t kMipUsageTokens[] = {
+		{ "col", ImageUsage_Color }, { "color", ImageUsage_Color }, { "albedo", ImageUsage_Color },
+		{ "diffuse", ImageUsage_Color }, { "basecolor", ImageUsage_Color }, { "emissive", ImageUsage_Color },
+		{ "n", ImageUsage_Normal }, { "nrm", ImageUsage_Normal }, { "normal", ImageUsage_Normal },
+		{ "rough", ImageUsage_Linear }, { "roughness", ImageUsage_Linear }, { "metal", ImageUsage_Linear },
+		{ "metallic", ImageUsage_Linear }, { "metalness", ImageUsage_Linear }, { "mr", ImageUsage_Linear },
+		{ "orm", ImageUsage_Linear }, { "ao", ImageUsage_Linear }, { "occlusion", ImageUsage_Linear },
+		{ "h", ImageUsage_Linear }, { "height", ImageUsage_Linear }, { "disp", ImageUsage_Linear },
+		{ "displacement", ImageUsage_Linear }, { "mask", ImageUsage_Linear }, { "spec", ImageUsage_Linear }
+	};
+
+	ImageUsage MipGen_GetImageUsage(const String& aFileName)
+	{
+		const size_t slash = aFileName.find_last_of("/\\");
+		const size_t begin = slash == String::npos ? 0 : slash + 1;
+		const size_t dot = aFileName.find_last_of('.');
+		const size_t end = dot == String::npos || dot < begin ? aFileName.size() : dot;
+
+		String stem = aFileName.substr(begin, end - begin);
+		std::transform(stem.begin(), stem.end(), stem.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+
+		std::vector<String> tokens;
+		size_t pos = 0;
+		while (pos <= stem.size())
+		{
+			const size_t sep = std::min(stem.find_first_of("_-", pos), stem.size());
+			if (sep > pos)
+			{
+				tokens.push_back(stem.substr(pos, sep - pos));
+			}
+			pos = sep + 1;
+		}
+
+		// the first token is the material name unless it is the only one
+		for (size_t i = tokens.size() > 1 ? 1 : 0; i < tokens.size(); ++i)
+		{
+			for (const MipUsageToken_t& t : kMipUsageTokens)
+			{
+				if (tokens[i] == t.token)
+					return t.usage;
+			}
+		}
+
+		return ImageUsage_Color;
+	}
+
+	bool GenerateMipmaps(Bitmap& aBitmap, const MipGenParams_t& aParams)
+	{
+		MipFormat_t fmt;
+		if (aBitmap.IsCompressed() || !MipGen_GetFormat(aBitmap, aParams.srgb || aBitmap.IsSRGB(), fmt))
+		{
+			Error("GenerateMipmaps: unsupported format in %s", aBitmap.GetFileName().c_str());
+			return false;
+		}
+
+		SimdLevel simd = std::min(aParams.simd, Cpu_GetSimdLevel());
+		const MipKernels_t kernels = MipGen_GetKernels(simd);
+
+		float weights[kMipKaiserTaps];
+		MipGen_GetKaiserWeights(weights);
+
+		int numMips = GetMipCount(aBitmap.GetSizeX(), aBitmap.GetSizeY());
+		if (aParams.maxLevels > 0)
+		{
+			numMips = std::min(numMips, aParams.maxLevels);
+		}
+
+		aBitmap.SetNumMipmaps(numMips);
+
+		const bool keepCoverage = aParams.preserveAlphaCoverage && fmt.alphaChannel >= 0;
+
+		for (int image = 0; image < aBitmap.GetNumImages(); ++image)
+		{
+			const BitmapData* base = aBitmap.GetData(image, 0);
+			MipGen_Source src(base->GetData(), aBitmap.GetSizeX(), aBitmap.GetSizeY(), fmt);
+			MipImage_t levels[2];
+			float coverage = 0.0f;
+
+			if (keepCoverage)
+			{
+				MipImage_t level0;
+				level0.sizeX = aBitmap.GetSizeX();
+				level0.sizeY = aBitmap.GetSizeY();
+				level0.pixels.resize(size_t(level0.sizeX) * level0.sizeY * 4);
+				for (int y = 0; y < level0.sizeY; ++y)
+				{
+					src.GetRow(y, level0.Row(y));
+				}
+
+				coverage = MipGen_GetAlphaCoverage(level0, aParams.alphaCutoff, 1.0f);
+			}
+
+			for (int mip = 1; mip < numMips; ++mip)
+			{
+				MipImage_t& dst = levels[mip & 1];
+
+				if (mip == 1)
+				{
+					MipGen_Downsample(src, dst, aParams.filter, kernels, weights);
+				}
+				else
+				{
+					MipGen_Downsample(MipGen_Source(levels[(mip - 1) & 1], fmt), dst, aParams.filter, kernels, weights);
+				}
+
+				if (keepCoverage)
+				{
+					MipGen_ScaleAlphaToCoverage(dst, aParams.alphaCutoff, coverage);
+				}
+
+				BitmapData* out = aBitmap.GetData(image, mip);
+				out->Resize(dst.sizeX * dst.sizeY * fmt.channels);
+
+				GetDefaultThreadPool().ParallelFor(dst.sizeY, [&](size_t y) {
+					MipGen_RowToBytes(dst.Row(int(y)), out->GetData() + y * dst.sizeX * fmt.channels, dst.sizeX, fmt);
+				}, kMipRowGrain * 4);
+			}
+		}
+
+		return true;
+	}
+
+	void MipGen_Benchmark(const Bitmap& aSource, const int aIterations)
+	{
+		static const char* const filterNames[] = { "box", "kaiser" };
+
+		for (int filter = 0; filter < MipFilter_LastEnum; ++filter)
+		{
+			Bitmap reference;
+
+			for (int level = 0; level <= Cpu_GetSimdLevel(); ++level)
+			{
+				MipGenParams_t params;
+				params.filter = MipFilter(filter);
+				params.simd = SimdLevel(level);
+
+				Bitmap result;
+				double total = 0.0;
+
+				for (int i = 0; i < aIterations; ++i)
+				{
+					result = aSource;
+					result.SetNumMipmaps(1);
+
+					const auto start = std::chrono::steady_clock::now();
+					GenerateMipmaps(result, params);
+					total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				}
+
+				if (level == SimdLevel_Scalar)
+				{
+					reference = result;
+				}
+
+				// largest 8 bit difference against the scalar reference
+				int maxDiff = 0;
+				for (int image = 0; image < result.GetNumImages(); ++image)
+				{
+					for (int mip = 0; mip < result.GetNumMipmaps(); ++mip)
+					{
+						const BitmapData* a = result.GetData(image, mip);
+						const BitmapData* b = reference.GetData(image, mip);
+						for (int k = 0; k < a->GetSize(); ++k)
+						{
+							maxDiff = std::max(maxDiff, std::abs(int(a->GetData()[k]) - int(b->GetData()[k])));
+						}
+					}
+				}
+
+				Info("MipGen %s %s: %fms / chain, max diff %d", filterNames[filter], Cpu_GetSimdLevelName(SimdLevel(level)), total / aIterations, maxDiff);
+			}
+		}
+	}
+}
@@ -1,6 +1,13 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
 #include "graphics/ShaderManager.hpp"
 #include "graphics/GraphicsTypes.hpp"
 #include "system/Logger.hpp"
+#include "system/Hash.hpp"
+#include "system/Timer.hpp"
 
 namespace jse {
 
@@ -14,15 +21,99 @@ namespace jse {
 	};
 
 	const ProgramDef program_defs[] = {
-		{MaterialType_ZPass, "zpass", "zpass_vtx", "zpass_frag", "", ""},
-		{MaterialType_Specular, "specular", "specular_vtx", "specular_frag", "", ""}
-//		{MaterialType_Diffuse, "diffuse", "diffuse_vtx", "diffuse_frag", "", ""}
+		{MaterialType_ZPass, "zpass", "zpass_vtx", "zpass_frag", "", "", ShaderFeatures_None, kMaxShaderLights},
+		{MaterialType_Specular, "specular", "specular_vtx", "specular_frag", "", "", ShaderFeatures_Fog, kMaxShaderLights}
+//		{MaterialType_Diffuse, "diffuse", "diffuse_vtx", "diffuse_frag", "", "", ShaderFeatures_Fog, kMaxShaderLights}
+	};
+
+	// fixed bindings, blocks and samplers not listed get the next free one
+	const ShaderBindingDef uniform_block_defs[] = {
+		{"LightBuffer", 0},
+		{"JointBuffer", 1}
+	};
+
+	const ShaderBindingDef sampler_defs[] = {
+		{"diffuseArray", TextureUnit_0}
+	};
+
+	static int ShaderManager_GetNextFree(const std::map<String, int>& aBindings)
+	{
+		int next = 0;
+		for (const auto& it : aBindings)
+		{
+			next = std::max(next, it.second + 1);
+		}
+
+		return next;
+	}
+
+	static const char* ShaderManager_GetTypeName(const ShaderDataType aType)
+	{
+		static const char* const names[] = { "float", "vec2", "vec3", "vec4", "int", "uint", "bool", "mat3", "mat4", "sampler", "other" };
+
+		return aType < ShaderDataType_LastEnum ? names[aType] : "?";
+	}
+
+	// by bit of ShaderFeatures
+	const char* const kShaderFeatureDefines[ShaderFeatures_NumBits] = {
+		"FOG",
+		"HAS_DIFFUSE_ARRAY",
+		"SKINNING"
 	};
 
+	static String ShaderManager_GetDefines(const ShaderFeatures aFeatures, const int aMaxLights)
+	{
+		String result;
+
+		for (int i = 0; i < ShaderFeatures_NumBits; ++i)
+		{
+			if (aFeatures & (1U << i))
+			{
+				result += String("#define ") + kShaderFeatureDefines[i] + "\n";
+			}
+		}
+
+		result += "#define MAX_LIGHTS " + std::to_string(aMaxLights) + "\n";
+
+		return result;
+	}
+
+	static String ShaderManager_GetVariantName(const String& aName, const ShaderFeatures aFeatures, const int aMaxLights)
+	{
+		return aName + "#" + std::to_string(aFeatures) + "_" + std::to_string(aMaxLights);
+	}
+
+	// Defines go right after #version, #line keeps the compiler messages on the file's lines
+	static String ShaderManager_AddDefines(const String& aSource, const String& aDefines)
+	{
+		const size_t version = aSource.find("#version");
+		if (version == String::npos)
+			return aDefines + "#line 1\n" + aSource;
+
+		const size_t eol = aSource.find('\n', version);
+		if (eol == String::npos)
+			return aSource + "\n" + aDefines;
+
+		const int line = 2 + int(std::count(aSource.begin(), aSource.begin() + version, '\n'));
+
+		return aSource.substr(0, eol + 1) + aDefines + "#line " + std::to_string(line) + "\n" + aSource.substr(eol + 1);
+	}
+
 	ShaderManager::ShaderManager(GraphicsDriver* aGraphicsDriver, FileSystem* aFileSystem)
 	{
 		mGraphicsDriver = aGraphicsDriver;
 		mFileSystem = aFileSystem;
+		mCacheDir = kShaderCacheDir;
+
+		for (const auto& it : uniform_block_defs)
+		{
+			mBlockBindings[it.mName] = it.mIndex;
+		}
+
+		for (const auto& it : sampler_defs)
+		{
+			mSamplerUnits[it.mName] = it.mIndex;
+		}
 	}
 
 	ShaderManager::~ShaderManager()
@@ -32,67 +123,409 @@ namespace jse {
 			delete it->second;
 		}
 
-		for (auto it = mShaderByNameMap.begin(); it != mShaderByNameMap.end(); it++)
+		for (auto it = mVariantByName.begin(); it != mVariantByName.end(); it++)
 		{
 			delete it->second;
 		}
 	}
 
+	bool ShaderManager::ReadSource(const String& aFileName, String& aSource, const int aDepth)
+	{
+		if (aDepth > kMaxShaderIncludeDepth)
+		{
+			Error("Shader include %s: too deep, recursive include ?", aFileName.c_str());
+			return false;
+		}
+
+		String text;
+		if (!mFileSystem->ReadTextFileBase("shaders/" + aFileName, text))
+			return false;
+
+		std::istringstream in(text);
+		String line;
+		int lineNo = 0;
+
+		while (std::getline(in, line))
+		{
+			lineNo++;
+
+			const size_t start = line.find_first_not_of(" \t");
+			if (start == String::npos || line.compare(start, 8, "#include") != 0)
+			{
+				aSource += line;
+				aSource += '\n';
+				continue;
+			}
+
+			const size_t q0 = line.find('"', start + 8);
+			const size_t q1 = q0 == String::npos ? String::npos : line.find('"', q0 + 1);
+			if (q1 == String::npos)
+			{
+				Error("%s(%d): malformed #include", aFileName.c_str(), lineNo);
+				return false;
+			}
+
+			aSource += "#line 1\n";
+			if (!ReadSource(line.substr(q0 + 1, q1 - q0 - 1), aSource, aDepth + 1))
+			{
+				Error("%s(%d): cannot include %s", aFileName.c_str(), lineNo, line.c_str());
+				return false;
+			}
+			aSource += "#line " + std::to_string(lineNo + 1) + "\n";
+		}
+
+		return true;
+	}
+
+	GpuShader* ShaderManager::CreateVariant(const ProgramDef& aDef, const ShaderFeatures aFeatures, const int aMaxLights, const bool aSubmitOnly)
+	{
+		const String defines = ShaderManager_GetDefines(aFeatures, aMaxLights);
+		const String variantName = ShaderManager_GetVariantName(aDef.mName, aFeatures, aMaxLights);
+		const String* stageNames[] = { &aDef.mVertShader, &aDef.mFragShader, &aDef.mGeomShader, &aDef.mCompShader };
+
+		GpuShader* program = mGraphicsDriver->CreateGpuShader();
+		u64 key = HashCombine(mDeviceHash, Hash64(defines));
+
+		for (const String* name : stageNames)
+		{
+			if (name->empty())
+				continue;
+
+			auto src = mSourceByName.find(*name);
+			auto def = std::find_if(std::begin(shader_defs), std::end(shader_defs), [name](const ShaderDef& d) { return d.mName == *name; });
+			if (src == mSourceByName.end() || def == std::end(shader_defs))
+			{
+				Error("Program %s: no stage %s", aDef.mName.c_str(), name->c_str());
+				delete program;
+				return nullptr;
+			}
+
+			// stages are shared by the variants with the same defines
+			const String stageName = *name + "#" + HashToString(Hash64(defines));
+			GpuShaderStage* stage;
+
+			auto it = mStageByName.find(stageName);
+			if (it != mStageByName.end())
+			{
+				stage = it->second;
+			}
+			else
+			{
+				stage = mGraphicsDriver->CreateGpuShaderStage(def->mType, *name);
+				stage->SetSource(ShaderManager_AddDefines(src->second, defines));
+				mStageByName.insert(tStageByNamePair(stageName, stage));
+			}
+
+			program->AddStage(stage);
+			key = HashCombine(key, Hash64(stage->GetSource(), stage->GetStageType()));
+		}
+
+		const String cacheFile = mUseCache ? mFileSystem->Resolve(mCacheDir + "/" + aDef.mName + "_" + HashToString(key) + ".bin") : String();
+
+		if (mUseCache && LoadCachedProgram(program, cacheFile))
+		{
+			mNumCached++;
+
+			if (!SetupProgram(program, variantName))
+			{
+				delete program;
+				return nullptr;
+			}
+		}
+		else if (!program->Submit())
+		{
+			Error("Program %s not compile !", variantName.c_str());
+			delete program;
+			return nullptr;
+		}
+		else if (aSubmitOnly)
+		{
+			mPending.push_back(PendingProgram_t{ program, variantName, cacheFile });
+		}
+		else if (!FinishProgram(PendingProgram_t{ program, variantName, cacheFile }))
+		{
+			delete program;
+			return nullptr;
+		}
+
+		mVariantByName.insert(tProgramByNamePair(variantName, program));
+
+		return program;
+	}
+
+	bool ShaderManager::LoadCachedProgram(GpuShader* aProgram, const String& aFileName)
+	{
+		if (!std::filesystem::exists(aFileName))
+			return false;
+
+		const ByteVector binary = mFileSystem->ReadBinaryFile(aFileName);
+
+		if (binary.empty() || !aProgram->LoadBinary(binary))
+		{
+			// new driver build or corrupt file, rebuilt from source and overwritten
+			Warning("Program binary %s rejected", aFileName.c_str());
+			return false;
+		}
+
+		return true;
+	}
+
+	void ShaderManager::SaveCachedProgram(GpuShader* aProgram, const String& aFileName)
+	{
+		ByteVector binary;
+
+		if (!aProgram->GetBinary(binary))
+			return;
+
+		std::error_code ec;
+		std::filesystem::create_directories(std::filesystem::path(aFileName).parent_path(), ec);
+
+		std::ofstream out(aFileName, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+		{
+			Warning("Cannot write program binary %s", aFileName.c_str());
+			return;
+		}
+
+		out.write(reinterpret_cast<const char*>(binary.data()), binary.size());
+	}
+
 	bool ShaderManager::Init()
 	{
-		// Loading shader stages
+		return BeginInit() && EndInit();
+	}
+
+	bool ShaderManager::BeginInit()
+	{
+		mInitTimer.Reset();
+		mNumCached = 0;
+		mInitFailed = false;
+
+		mUseCache = !mCacheDir.empty() && mGraphicsDriver->GetCaps(GraphicsCaps_ProgramBinaryFormats) > 0;
+		mDeviceHash = Hash64(mGraphicsDriver->GetDeviceString(), kShaderCacheVersion);
+
+		// Stage sources with includes resolved, compiled per variant
 		for (int i = 0; i < sizeof(shader_defs) / sizeof(ShaderDef); i++)
 		{
-			GpuShaderStage* stage = mGraphicsDriver->CreateGpuShaderStage(shader_defs[i].mType, shader_defs[i].mName);
 			String source;
-			if (!mFileSystem->ReadTextFileBase("shaders/" + shader_defs[i].mName + ".glsl", source))
+			if (!ReadSource(shader_defs[i].mName + ".glsl", source, 0))
 			{
 				Error("Shader stage %s not found !", shader_defs[i].mName.c_str());
 				return false;
 			}
 
-			stage->SetSource(source);
-			if (!stage->Compile())
+			mSourceByName[shader_defs[i].mName] = source;
+		}
+
+		for (int i = 0; i < sizeof(program_defs) / sizeof(ProgramDef); i++)
+		{
+			GpuShader* program = CreateVariant(program_defs[i], program_defs[i].mFeatures, program_defs[i].mMaxLights, true);
+			if (!program)
 			{
-				Error("Shader stage %s not compiled !", shader_defs[i].mName.c_str());
-				return false;
+				mInitFailed = true;
+				continue;
 			}
 
-			mStageByName.insert(tStageByNamePair(shader_defs[i].mName, stage));
+			mShaderByNameMap.insert(tProgramByNamePair(program_defs[i].mName, program));
+			mMaterialShaderMap.insert(tMaterialShaderPair(program_defs[i].mMaterial, program));
 		}
 
-		for (int i = 0; i < sizeof(program_defs) / sizeof(ProgramDef); i++)
+		Info("ShaderManager: %d programs submitted in %.2f ms", int(mPending.size()), mInitTimer.GetElapsedMs());
+
+		return !mInitFailed;
+	}
+
+	bool ShaderManager::FinishProgram(const PendingProgram_t& aPending)
+	{
+		if (!aPending.program->Finish())
 		{
-			GpuShader* program = mGraphicsDriver->CreateGpuShader();
-			if (!program_defs[i].mVertShader.empty())
+			Error("Program %s not compile !", aPending.name.c_str());
+			return false;
+		}
+
+		if (!SetupProgram(aPending.program, aPending.name))
+			return false;
+
+		if (!aPending.cacheFile.empty())
+		{
+			SaveCachedProgram(aPending.program, aPending.cacheFile);
+		}
+
+		return true;
+	}
+
+	// Failed programs are kept as nullptr, variants fall back to the Init program and the draw loop skips missing ones
+	bool ShaderManager::FinishPending(const PendingProgram_t& aPending)
+	{
+		if (FinishProgram(aPending))
+			return true;
+
+		ReleaseProgram(aPending.name);
+
+		return false;
+	}
+
+	bool ShaderManager::SetupProgram(GpuShader* aProgram, const String& aName)
+	{
+		const ShaderReflection_t& reflection = aProgram->GetReflection();
+		bool result = true;
+
+		// names copied, BindUniformBlock updates the reflection
+		std::vector<String> blocks;
+		for (const auto& it : reflection.blocks)
+		{
+			blocks.push_back(it.name);
+		}
+
+		for (const String& block : blocks)
+		{
+			auto it = mBlockBindings.find(block);
+			if (it == mBlockBindings.end())
 			{
-				auto it = mStageByName.find(program_defs[i].mVertShader);
-				if (it != mStageByName.end())
-				{
-					program->AddStage(it->second);
-				}
+				it = mBlockBindings.insert(std::make_pair(block, ShaderManager_GetNextFree(mBlockBindings))).first;
 			}
 
-			if (!program_defs[i].mFragShader.empty())
+			aProgram->BindUniformBlock(block, it->second);
+
+			auto layout = mUniformLayouts.find(block);
+			if (layout != mUniformLayouts.end())
 			{
-				auto it = mStageByName.find(program_defs[i].mFragShader);
-				if (it != mStageByName.end())
-				{
-					program->AddStage(it->second);
-				}
+				result = ValidateLayout(aProgram, aName, block, layout->second) && result;
 			}
+		}
 
-			if (!program->Compile())
+		for (const auto& sampler : reflection.samplers)
+		{
+			auto it = mSamplerUnits.find(sampler.name);
+			if (it == mSamplerUnits.end())
 			{
-				Error("Program %s not compile !", program_defs[i].mName.c_str());
-				return false;
+				it = mSamplerUnits.insert(std::make_pair(sampler.name, ShaderManager_GetNextFree(mSamplerUnits))).first;
 			}
 
-			mShaderByNameMap.insert(tProgramByNamePair(program_defs[i].mName, program));
-			mMaterialShaderMap.insert(tMaterialShaderPair(program_defs[i].mMaterial, program));
+			aProgram->SetSamplerUnit(sampler.name, TextureUnit(it->second));
+		}
+
+		return result;
+	}
+
+	bool ShaderManager::ValidateLayout(const GpuShader* aProgram, const String& aName, const String& aBlock, const std::vector<UniformLayoutMember_t>& aMembers) const
+	{
+		const ShaderUniformBlock_t* block = aProgram->GetReflection().FindBlock(aBlock);
+		if (!block)
+			return true;
+
+		bool result = true;
+
+		for (const auto& member : aMembers)
+		{
+			auto it = std::find_if(block->members.begin(), block->members.end(), [&member](const ShaderUniform_t& u) { return u.name == member.name; });
+
+			if (it == block->members.end())
+			{
+				Error("Program %s, block %s: no member %s", aName.c_str(), aBlock.c_str(), member.name);
+				result = false;
+			}
+			else if (it->type != member.type || size_t(it->offset) != member.offset)
+			{
+				Error("Program %s, block %s: %s is %s at %d in the shader, %s at %d on the CPU", aName.c_str(), aBlock.c_str(), member.name,
+					ShaderManager_GetTypeName(it->type), it->offset, ShaderManager_GetTypeName(member.type), int(member.offset));
+				result = false;
+			}
+		}
+
+		return result;
+	}
+
+	bool ShaderManager::RegisterUniformLayout(const String& aBlock, const UniformLayoutMember_t* aMembers, const size_t aCount)
+	{
+		std::vector<UniformLayoutMember_t>& layout = mUniformLayouts[aBlock];
+		layout.assign(aMembers, aMembers + aCount);
+
+		std::vector<String> failed;
+
+		for (const auto& it : mVariantByName)
+		{
+			if (it.second && it.second->isCompiled() && !ValidateLayout(it.second, it.first, aBlock, layout))
+			{
+				failed.push_back(it.first);
+			}
+		}
+
+		for (const String& name : failed)
+		{
+			Error("Program %s released, it does not match the registered uniform layouts", name.c_str());
+			ReleaseProgram(name);
+			mInitFailed = true;
+		}
+
+		return failed.empty();
+	}
+
+	// A program that failed or turned out unusable: dropped from every map, requests then return nullptr
+	void ShaderManager::ReleaseProgram(const String& aVariantName)
+	{
+		auto it = mVariantByName.find(aVariantName);
+		if (it == mVariantByName.end() || !it->second)
+			return;
+
+		GpuShader* program = it->second;
+
+		mPending.erase(std::remove_if(mPending.begin(), mPending.end(), [program](const PendingProgram_t& p) { return p.program == program; }), mPending.end());
+
+		for (auto p = mShaderByNameMap.begin(); p != mShaderByNameMap.end();)
+		{
+			p = p->second == program ? mShaderByNameMap.erase(p) : std::next(p);
+		}
+
+		for (auto m = mMaterialShaderMap.begin(); m != mMaterialShaderMap.end();)
+		{
+			m = m->second == program ? mMaterialShaderMap.erase(m) : std::next(m);
 		}
-        
-        return true;
+
+		delete program;
+		it->second = nullptr;
+	}
+
+	int ShaderManager::GetUniformBlockBinding(const String& aBlock) const
+	{
+		auto it = mBlockBindings.find(aBlock);
+
+		return it != mBlockBindings.end() ? it->second : -1;
+	}
+
+	bool ShaderManager::IsInitDone()
+	{
+		for (size_t i = 0; i < mPending.size();)
+		{
+			if (!mPending[i].program->IsReady())
+			{
+				++i;
+				continue;
+			}
+
+			const PendingProgram_t pending = mPending[i];
+			mPending.erase(mPending.begin() + i);
+			mInitFailed = !FinishPending(pending) || mInitFailed;
+		}
+
+		return mPending.empty();
+	}
+
+	bool ShaderManager::EndInit()
+	{
+		const std::vector<PendingProgram_t> pending = std::move(mPending);
+		mPending.clear();
+
+		for (const auto& it : pending)
+		{
+			mInitFailed = !FinishPending(it) || mInitFailed;
+		}
+
+		const int numPrograms = int(std::count_if(mVariantByName.begin(), mVariantByName.end(), [](const tProgramByNamePair& p) { return p.second != nullptr; }));
+		Info("ShaderManager: %d programs ready in %.2f ms, %d from the binary cache (%s)", numPrograms, mInitTimer.GetElapsedMs(), mNumCached,
+			mNumCached == numPrograms ? "warm" : "cold");
+
+		return !mInitFailed;
 	}
 
 	GpuShader* ShaderManager::GetShaderByName(const String& aName)
@@ -108,6 +541,93 @@ namespace jse {
 		}
 	}
 	
+	GpuShader* ShaderManager::GetShaderVariant(const String& aName, const ShaderFeatures aFeatures, const int aMaxLights)
+	{
+		const int maxLights = std::min(std::max(aMaxLights, 1), kMaxShaderLights);
+
+		const String variantName = ShaderManager_GetVariantName(aName, aFeatures, maxLights);
+
+		auto it = mVariantByName.find(variantName);
+		if (it != mVariantByName.end())
+		{
+			// prepared but not finished yet, wait for this one only
+			GpuShader* program = it->second;
+			auto pending = std::find_if(mPending.begin(), mPending.end(), [program](const PendingProgram_t& p) { return p.program == program; });
+			if (pending != mPending.end())
+			{
+				const PendingProgram_t p = *pending;
+				mPending.erase(pending);
+
+				return FinishPending(p) ? program : nullptr;
+			}
+
+			return program;
+		}
+
+		for (const ProgramDef& def : program_defs)
+		{
+			if (def.mName == aName)
+			{
+				GpuShader* program = CreateVariant(def, aFeatures, maxLights, false);
+				if (!program)
+				{
+					// remembered so a broken variant is not recompiled on every request
+					mVariantByName.insert(tProgramByNamePair(variantName, nullptr));
+				}
+
+				return program;
+			}
+		}
+
+		return nullptr;
+	}
+
+	bool ShaderManager::PrepareVariant(const MaterialType aType, const ShaderFeatures aFeatures, const int aMaxLights)
+	{
+		auto def = std::find_if(std::begin(program_defs), std::end(program_defs), [aType](const ProgramDef& d) { return d.mMaterial == aType; });
+		if (def == std::end(program_defs))
+			return false;
+
+		const int maxLights = std::min(std::max(aMaxLights, 1), kMaxShaderLights);
+		const String variantName = ShaderManager_GetVariantName(def->mName, aFeatures, maxLights);
+
+		auto it = mVariantByName.find(variantName);
+		if (it != mVariantByName.end())
+			return it->second != nullptr;
+
+		if (!CreateVariant(*def, aFeatures, maxLights, true))
+		{
+			mVariantByName.insert(tProgramByNamePair(variantName, nullptr));
+			return false;
+		}
+
+		return true;
+	}
+
+	int ShaderManager::GetVariantLights(const size_t aNumLights)
+	{
+		int maxLights = 4;
+		while (maxLights < int(aNumLights) && maxLights < kMaxShaderLights)
+		{
+			maxLights *= 2;
+		}
+
+		return maxLights;
+	}
+
+	GpuShader* ShaderManager::GetShaderByMaterial(const MaterialType aType, const ShaderFeatures aFeatures, const int aMaxLights)
+	{
+		for (const ProgramDef& def : program_defs)
+		{
+			if (def.mMaterial == aType)
+			{
+				return GetShaderVariant(def.mName, aFeatures, aMaxLights);
+			}
+		}
+
+		return nullptr;
+	}
+
 	GpuShader* ShaderManager::GetShaderByMaterial(const MaterialType aType)
 	{
 		auto it = mMaterialShaderMap.find(aType);
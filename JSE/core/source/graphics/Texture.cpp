@@ -1,4 +1,8 @@
 #include "graphics/Texture.hpp"
+#include "graphics/DdsFile.hpp"
+#include "graphics/Ktx2File.hpp"
+#include "graphics/MipGenerator.hpp"
+#include "system/Logger.hpp"
 #include "stb_image.h"
 
 namespace jse {
@@ -14,6 +18,8 @@ namespace jse {
 		mMinFilter = TextureFilter_Linear;
 		mMagFilter = TextureFilter_Linear;
 		mSize = Vector3l(0);
+		mNumMipmaps = 0;
+		mNumLayers = 0;
 		mUsable = false;
 		mTextureUnit = TextureUnit_0;
 	}
@@ -56,26 +62,74 @@ namespace jse {
 
 	bool Texture::LoadFromFile(const String& aFilename)
 	{
-		int x, y, n;
-		bool result = false;
+		Bitmap bitmap;
 
 		mFileName = aFilename;
 
-		stbi_set_flip_vertically_on_load(true);
+		if (!DecodeFile(aFilename, bitmap))
+			return false;
+
+		return UploadBitmap(bitmap);
+	}
 
-		unsigned char* data = stbi_load(mFileName.c_str(), &x, &y, &n, 0);
+	static bool Texture_HasExt(const String& aFilename, const String& aExt)
+	{
+		return aFilename.size() > aExt.size() && aFilename.compare(aFilename.size() - aExt.size(), aExt.size(), aExt) == 0;
+	}
 
-		if (data)
+	bool Texture::DecodeFile(const String& aFilename, Bitmap& aBitmap)
+	{
+		// containers hold upload ready data, possibly block compressed with mips
+		if (Texture_HasExt(aFilename, kDdsFileExt))
 		{
-			mSize.x = x;
-			mSize.y = y;
-			mSize.z = n;
+			return DdsFile_Load(aFilename, aBitmap);
+		}
+		if (Texture_HasExt(aFilename, kKtx2FileExt))
+		{
+			return Ktx2File_Load(aFilename, aBitmap);
+		}
+
+		int x, y, n;
 
-			result = UploadToGPU(data);
-			stbi_image_free(data);
+		stbi_set_flip_vertically_on_load_thread(true);
+
+		unsigned char* data = stbi_load(aFilename.c_str(), &x, &y, &n, 0);
+		if (!data)
+		{
+			Error("Cannot load image %s: %s", aFilename.c_str(), stbi_failure_reason());
+			return false;
 		}
 
-		return result;;
+		static const PixelFormat formats[] = { PixelFormat_Luminance, PixelFormat_LuminanceAlpha, PixelFormat_RGB, PixelFormat_RGBA };
+
+		aBitmap.SetFileName(aFilename);
+		aBitmap.SetSize(x, y, 1);
+		aBitmap.SetPixelFormat(formats[n - 1]);
+		aBitmap.SetCompressed(false);
+		aBitmap.SetBytesPerPixel(n);
+		aBitmap.Init(1, 1);
+		aBitmap.GetData(0, 0)->SetData(data, x * y * n);
+
+		stbi_image_free(data);
+
+		// build the chain here on the worker instead of glGenerateMipmap on the render thread,
+		// color images are filtered in linear space and stored sRGB encoded again
+		MipGenParams_t params;
+		params.srgb = MipGen_IsColorImage(aFilename);
+
+		return GenerateMipmaps(aBitmap, params);
+	}
+
+	bool Texture::UploadBitmap(const Bitmap& aBitmap, const size_t* aPboOffsets)
+	{
+		// mSize still holds the previous size here, UploadBitmapToGPU compares against it
+		mUsable = UploadBitmapToGPU(aBitmap, aPboOffsets);
+
+		mSize.x = aBitmap.GetSizeX();
+		mSize.y = aBitmap.GetSizeY();
+		mSize.z = aBitmap.GetBytesPerPixel();
+
+		return mUsable;
 	}
 
 }
@@ -0,0 +1,124 @@
+#include <algorithm>
+
+#include "graphics/TextureArray.hpp"
+#include "graphics/Texture.hpp"
+#include "graphics/GraphicsDriver.hpp"
+#include "system/ThreadPool.hpp"
+#include "system/Logger.hpp"
+
+namespace jse {
+
+	TextureArrayAllocator::~TextureArrayAllocator()
+	{
+		for (const auto& it : mArrays)
+		{
+			delete it.texture;
+		}
+	}
+
+	int TextureArrayAllocator::Add(const String& aFileName)
+	{
+		Pending_t p{};
+		p.entry = int(mLayers.size());
+		p.fileName = aFileName;
+
+		mPending.push_back(std::move(p));
+		mLayers.push_back(TextureLayer_t{});
+
+		return int(mLayers.size()) - 1;
+	}
+
+	bool TextureArrayAllocator::IsSameLayout(const Bitmap& a0, const Bitmap& a1)
+	{
+		return a0.GetSizeX() == a1.GetSizeX() && a0.GetSizeY() == a1.GetSizeY() &&
+			a0.GetNumMipmaps() == a1.GetNumMipmaps() && a0.GetPixelFormat() == a1.GetPixelFormat() &&
+			a0.IsCompressed() == a1.IsCompressed() && a0.IsSRGB() == a1.IsSRGB();
+	}
+
+	bool TextureArrayAllocator::Build()
+	{
+		bool result = true;
+
+		GetDefaultThreadPool().ParallelFor(mPending.size(), [this](size_t i) {
+			Pending_t& p = mPending[i];
+			p.ok = Texture::DecodeFile(p.fileName, p.bitmap);
+		});
+
+		/* Group by layout, every group is split into arrays of at most kMaxTextureArrayLayers */
+
+		std::vector<std::vector<Pending_t*>> groups;
+
+		for (auto& p : mPending)
+		{
+			if (!p.ok || p.bitmap.GetNumImages() != 1)
+			{
+				Error("TextureArray: cannot use %s as a layer", p.fileName.c_str());
+				result = false;
+				continue;
+			}
+
+			auto it = std::find_if(groups.begin(), groups.end(), [&p](const std::vector<Pending_t*>& g) {
+				return g.size() < size_t(kMaxTextureArrayLayers) && IsSameLayout(g[0]->bitmap, p.bitmap);
+			});
+
+			if (it == groups.end())
+			{
+				groups.emplace_back();
+				it = groups.end() - 1;
+			}
+
+			it->push_back(&p);
+		}
+
+		for (const auto& g : groups)
+		{
+			const Bitmap& layout = g[0]->bitmap;
+			const int arrayIndex = int(mArrays.size());
+
+			Texture* texture = mGd->CreateTexture();
+			texture->SetName("array" + std::to_string(arrayIndex) + "_" + std::to_string(layout.GetSizeX()) + "x" + std::to_string(layout.GetSizeY()));
+			texture->SetType(TextureType_2DArray);
+			texture->SetMinMagFilter(TextureFilter_Linear_Mipmap_Linear, TextureFilter_Linear);
+
+			if (!texture->AllocateLayers(layout, int(g.size())))
+			{
+				delete texture;
+				result = false;
+				continue;
+			}
+
+			Array_t array{ texture, 0 };
+
+			for (size_t layer = 0; layer < g.size(); ++layer)
+			{
+				Pending_t* p = g[layer];
+
+				if (!texture->UploadLayer(p->bitmap, int(layer)))
+				{
+					result = false;
+					continue;
+				}
+
+				mLayers[p->entry].array = arrayIndex;
+				mLayers[p->entry].layer = int(layer);
+				array.bytes += p->bitmap.GetTotalSize();
+			}
+
+			mArrays.push_back(array);
+		}
+
+		mPending.clear();
+
+		return result;
+	}
+
+	void TextureArrayAllocator::PrintStats() const
+	{
+		for (const auto& it : mArrays)
+		{
+			const Texture* t = it.texture;
+
+			Info("%s: %d layers, %d levels, %.2f MB", t->GetName().c_str(), t->GetNumLayers(), t->GetNumMipmaps(), double(it.bytes) / (1024.0 * 1024.0));
+		}
+	}
+}
@@ -0,0 +1,145 @@
+#include <chrono>
+#include <cstring>
+
+#include "graphics/TextureBatch.hpp"
+#include "graphics/Texture.hpp"
+#include "graphics/GraphicsDriver.hpp"
+#include "graphics/Buffer.hpp"
+#include "system/ThreadPool.hpp"
+#include "system/Logger.hpp"
+
+namespace jse {
+
+	static float TextureBatch_MsSince(const std::chrono::steady_clock::time_point& aStart)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - aStart).count();
+	}
+
+	void TextureBatch::Add(Texture* aTexture, const String& aFileName)
+	{
+		Entry_t e{};
+		e.texture = aTexture;
+		e.fileName = aFileName;
+
+		mEntries.push_back(e);
+	}
+
+	void TextureBatch::Clear()
+	{
+		mEntries.clear();
+		mTimings.clear();
+	}
+
+	bool TextureBatch::Load()
+	{
+		using namespace std::chrono;
+
+		const auto batchStart = steady_clock::now();
+		mTimings.assign(mEntries.size(), TextureLoadTiming_t{});
+
+		/* Decode on the workers */
+
+		GetDefaultThreadPool().ParallelFor(mEntries.size(), [this](size_t i) {
+			Entry_t& e = mEntries[i];
+			TextureLoadTiming_t& t = mTimings[i];
+
+			const auto start = steady_clock::now();
+
+			t.fileName = e.fileName;
+			t.ok = Texture::DecodeFile(e.fileName, e.bitmap);
+			t.bytes = e.bitmap.GetTotalSize();
+			t.decodeMs = TextureBatch_MsSince(start);
+		});
+
+		/* Stage everything in one pixel unpack buffer */
+
+		size_t totalBytes = 0;
+		for (auto& e : mEntries)
+		{
+			e.offsets.clear();
+			for (int image = 0; image < e.bitmap.GetNumImages(); ++image)
+			{
+				for (int mip = 0; mip < e.bitmap.GetNumMipmaps(); ++mip)
+				{
+					e.offsets.push_back(totalBytes);
+					totalBytes += (size_t(e.bitmap.GetData(image, mip)->GetSize()) + 15) & ~size_t(15);
+				}
+			}
+		}
+
+		if (totalBytes == 0)
+		{
+			// Nothing to upload, an empty batch is fine but failed decodes are still reported
+			for (const auto& t : mTimings)
+			{
+				if (!t.ok) return false;
+			}
+			return true;
+		}
+
+		BufferObject* pbo = mGd->CreateBuffer(BufferTarget_PixelUnpack, BufferUsage_StreamDraw, totalBytes);
+		pbo->Bind();
+		u8* staging = reinterpret_cast<u8*>(pbo->Map(BufferAccess_WriteOnly));
+
+		if (staging)
+		{
+			GetDefaultThreadPool().ParallelFor(mEntries.size(), [this, staging](size_t i) {
+				const Entry_t& e = mEntries[i];
+				const int numMips = e.bitmap.GetNumMipmaps();
+
+				for (size_t k = 0; k < e.offsets.size(); ++k)
+				{
+					const BitmapData* bd = e.bitmap.GetData(int(k) / numMips, int(k) % numMips);
+					std::memcpy(staging + e.offsets[k], bd->GetData(), bd->GetSize());
+				}
+			});
+
+			pbo->UnMap();
+			pbo->Bind();
+		}
+		else
+		{
+			Warning("TextureBatch: cannot map pixel buffer, uploading from client memory");
+			mGd->UnBindBuffer(BufferTarget_PixelUnpack);
+		}
+
+		/* Upload, with a bound PBO the pixel pointer is an offset into it */
+
+		bool result = true;
+		for (size_t i = 0; i < mEntries.size(); ++i)
+		{
+			Entry_t& e = mEntries[i];
+			TextureLoadTiming_t& t = mTimings[i];
+
+			if (!t.ok)
+			{
+				result = false;
+				continue;
+			}
+
+			const auto start = steady_clock::now();
+
+			e.texture->SetFileName(e.fileName);
+			t.ok = e.texture->UploadBitmap(e.bitmap, staging ? e.offsets.data() : nullptr);
+			t.uploadMs = TextureBatch_MsSince(start);
+
+			result = result && t.ok;
+			e.bitmap = Bitmap();
+		}
+
+		mGd->UnBindBuffer(BufferTarget_PixelUnpack);
+		delete pbo;
+
+		Info("TextureBatch: %d textures, %d KB in %fms", int(mEntries.size()), int(totalBytes / 1024), TextureBatch_MsSince(batchStart));
+
+		return result;
+	}
+
+	void TextureBatch::PrintTimings() const
+	{
+		for (const auto& t : mTimings)
+		{
+			Info("%s: %s %d KB, decode %fms, upload %fms", t.fileName.c_str(), t.ok ? "ok" : "FAILED", int(t.bytes / 1024), t.decodeMs, t.uploadMs);
+		}
+	}
+}
@@ -1,7 +1,10 @@
 #include <GL/glew.h>
+#include <algorithm>
 #include <memory>
+#include <cstring>
 #include "system/Logger.hpp"
 #include "impl/GpuShaderOGL.hpp"
+#include "impl/GraphicsDriverOGL.hpp"
 
 namespace jse {
 
@@ -22,6 +25,11 @@ namespace jse {
 	}
 
 	bool GpuShaderOGL::Compile()
+	{
+		return Submit() && Finish();
+	}
+
+	bool GpuShaderOGL::Submit()
 	{
 		mCompiled = false;
 
@@ -30,24 +38,57 @@ namespace jse {
 			mProgramId = glCreateProgram();
 		}
 
+		// the link is queued behind the stage compiles, nothing here waits for the driver
 		for (auto it : mStages)
 		{
-			if (!it->Compile()) {
+			if (!it->Submit()) {
 				return false;
 			}
 		}
 
-		GLint result = GL_FALSE;
-
 		for (auto it : mStages)
 		{
 			glAttachShader(mProgramId, it->GetApiId());
 		}
 
-		Info("Linking program...");
-
+		glProgramParameteri(mProgramId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 		glLinkProgram(mProgramId);
 
+		mSubmitted = true;
+
+		return true;
+	}
+
+	bool GpuShaderOGL::IsReady()
+	{
+		if (!mSubmitted || !GLHasParallelShaderCompile())
+			return true;
+
+		GLint done = GL_FALSE;
+		glGetProgramiv(mProgramId, GL_COMPLETION_STATUS_KHR, &done);
+
+		return done == GL_TRUE;
+	}
+
+	bool GpuShaderOGL::Finish()
+	{
+		if (!mSubmitted)
+			return mCompiled;
+
+		mSubmitted = false;
+
+		// stage errors are reported with the stage name, a failed stage fails the link anyway
+		bool stagesOk = true;
+		for (auto it : mStages)
+		{
+			stagesOk = it->Finish() && stagesOk;
+		}
+
+		if (!stagesOk)
+			return false;
+
+		GLint result = GL_FALSE;
+
 		glGetProgramiv(mProgramId, GL_LINK_STATUS, &result);
 		if (result == GL_FALSE)
 		{
@@ -57,16 +98,182 @@ namespace jse {
 				std::vector<char> logBuf(infologLen);
 				glGetProgramInfoLog(mProgramId, infologLen, nullptr, logBuf.data());
 				Error("Linking of shader program failed: %s", logBuf.data());
-
-				return false;
 			}
+
+			return false;
 		}
 
 		mCompiled = true;
+		Reflect();
 
 		return true;
 	}
 
+	static ShaderDataType GpuShaderOGL_GetDataType(const GLenum aType)
+	{
+		switch (aType)
+		{
+			case GL_FLOAT:				return ShaderDataType_Float;
+			case GL_FLOAT_VEC2:			return ShaderDataType_Vec2;
+			case GL_FLOAT_VEC3:			return ShaderDataType_Vec3;
+			case GL_FLOAT_VEC4:			return ShaderDataType_Vec4;
+			case GL_INT:				return ShaderDataType_Int;
+			case GL_UNSIGNED_INT:		return ShaderDataType_UInt;
+			case GL_BOOL:				return ShaderDataType_Bool;
+			case GL_FLOAT_MAT3:			return ShaderDataType_Mat3;
+			case GL_FLOAT_MAT4:			return ShaderDataType_Mat4;
+			case GL_SAMPLER_1D:
+			case GL_SAMPLER_2D:
+			case GL_SAMPLER_3D:
+			case GL_SAMPLER_CUBE:
+			case GL_SAMPLER_2D_SHADOW:
+			case GL_SAMPLER_2D_ARRAY:
+			case GL_SAMPLER_2D_ARRAY_SHADOW:
+			case GL_SAMPLER_CUBE_SHADOW:
+			case GL_INT_SAMPLER_2D:
+			case GL_UNSIGNED_INT_SAMPLER_2D:
+			case GL_SAMPLER_BUFFER:		return ShaderDataType_Sampler;
+			default:
+				return ShaderDataType_Other;
+		}
+	}
+
+	void GpuShaderOGL::Reflect()
+	{
+		mReflection = ShaderReflection_t{};
+		mUniformCache.clear();
+
+		GLint numBlocks = 0, numUniforms = 0, maxLength = 0;
+		glGetProgramiv(mProgramId, GL_ACTIVE_UNIFORM_BLOCKS, &numBlocks);
+		glGetProgramiv(mProgramId, GL_ACTIVE_UNIFORMS, &numUniforms);
+		glGetProgramiv(mProgramId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+		std::vector<char> name(std::max(maxLength, 1) + 1);
+
+		for (GLint i = 0; i < numBlocks; ++i)
+		{
+			GLint length = 0;
+			glGetActiveUniformBlockiv(mProgramId, i, GL_UNIFORM_BLOCK_NAME_LENGTH, &length);
+
+			std::vector<char> blockName(std::max(length, 1) + 1);
+			glGetActiveUniformBlockName(mProgramId, i, GLsizei(blockName.size()), nullptr, blockName.data());
+
+			ShaderUniformBlock_t block{};
+			block.name = blockName.data();
+			block.index = i;
+			glGetActiveUniformBlockiv(mProgramId, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+			glGetActiveUniformBlockiv(mProgramId, i, GL_UNIFORM_BLOCK_BINDING, &block.binding);
+
+			mReflection.blocks.push_back(block);
+		}
+
+		if (numUniforms <= 0)
+			return;
+
+		std::vector<GLuint> indices(numUniforms);
+		for (GLint i = 0; i < numUniforms; ++i)
+		{
+			indices[i] = GLuint(i);
+		}
+
+		const GLenum params[] = { GL_UNIFORM_TYPE, GL_UNIFORM_SIZE, GL_UNIFORM_BLOCK_INDEX, GL_UNIFORM_OFFSET, GL_UNIFORM_ARRAY_STRIDE, GL_UNIFORM_MATRIX_STRIDE };
+		std::vector<GLint> values[6];
+
+		for (int p = 0; p < 6; ++p)
+		{
+			values[p].resize(numUniforms);
+			glGetActiveUniformsiv(mProgramId, numUniforms, indices.data(), params[p], values[p].data());
+		}
+
+		for (GLint i = 0; i < numUniforms; ++i)
+		{
+			glGetActiveUniformName(mProgramId, GLuint(i), GLsizei(name.size()), nullptr, name.data());
+
+			ShaderUniform_t u{};
+			u.name = name.data();
+			u.type = GpuShaderOGL_GetDataType(GLenum(values[0][i]));
+			u.arraySize = values[1][i];
+			u.offset = values[3][i];
+			u.arrayStride = values[4][i];
+			u.matrixStride = values[5][i];
+			u.location = -1;
+
+			const GLint blockIndex = values[2][i];
+
+			if (blockIndex >= 0 && blockIndex < numBlocks)
+			{
+				mReflection.blocks[blockIndex].members.push_back(u);
+				continue;
+			}
+
+			u.location = glGetUniformLocation(mProgramId, u.name.c_str());
+			mUniformCache.insert(UniformCacheType::value_type(u.name, u.location));
+
+			if (u.type == ShaderDataType_Sampler)
+			{
+				mReflection.samplers.push_back(u);
+			}
+			else
+			{
+				mReflection.uniforms.push_back(u);
+			}
+		}
+	}
+
+	bool GpuShaderOGL::GetBinary(ByteVector& aData)
+	{
+		if (!mCompiled)
+			return false;
+
+		GLint length = 0;
+		glGetProgramiv(mProgramId, GL_PROGRAM_BINARY_LENGTH, &length);
+
+		if (length <= 0)
+			return false;
+
+		// binary format first, glProgramBinary needs it back
+		aData.resize(sizeof(GLenum) + length);
+
+		GLenum format = 0;
+		GLsizei written = 0;
+		glGetProgramBinary(mProgramId, length, &written, &format, aData.data() + sizeof(GLenum));
+		std::memcpy(aData.data(), &format, sizeof(GLenum));
+
+		aData.resize(sizeof(GLenum) + written);
+
+		return written > 0;
+	}
+
+	bool GpuShaderOGL::LoadBinary(const ByteVector& aData)
+	{
+		mCompiled = false;
+
+		if (aData.size() <= sizeof(GLenum))
+			return false;
+
+		if (!mProgramId)
+		{
+			mProgramId = glCreateProgram();
+		}
+
+		GLenum format;
+		std::memcpy(&format, aData.data(), sizeof(GLenum));
+
+		glProgramBinary(mProgramId, format, aData.data() + sizeof(GLenum), GLsizei(aData.size() - sizeof(GLenum)));
+
+		GLint result = GL_FALSE;
+		glGetProgramiv(mProgramId, GL_LINK_STATUS, &result);
+
+		mCompiled = result == GL_TRUE;
+
+		if (mCompiled)
+		{
+			Reflect();
+		}
+
+		return mCompiled;
+	}
+
 	void GpuShaderOGL::Use()
 	{
 		if (mCompiled)
@@ -172,6 +379,24 @@ namespace jse {
 		}
 
 		glUniformBlockBinding(mProgramId, block_index, aBindingPoint);
+
+		for (auto& it : mReflection.blocks)
+		{
+			if (it.index == GLint(block_index))
+			{
+				it.binding = aBindingPoint;
+			}
+		}
+	}
+
+	void GpuShaderOGL::SetSamplerUnit(const String& aName, const TextureUnit aUnit)
+	{
+		const GLint location = GetLocationCached(aName);
+
+		if (location > -1)
+		{
+			glProgramUniform1i(mProgramId, location, GLint(aUnit));
+		}
 	}
 
 	GLint GpuShaderOGL::GetLocationCached(const String& aName)
@@ -8,7 +8,12 @@ namespace jse {
 
 	bool GpuShaderStageOGL::Compile()
 	{
-		if (mCompiled)
+		return Submit() && Finish();
+	}
+
+	bool GpuShaderStageOGL::Submit()
+	{
+		if (mCompiled || mSubmitted)
 			return true;
 
 		if (mSource.empty())
@@ -27,11 +32,38 @@ namespace jse {
 			}
 		}
 
-		GLint result = GL_FALSE;
-
 		char const* source_cstr = mSource.c_str();
 		glShaderSource(mApiId, 1, &source_cstr, nullptr);
 		glCompileShader(mApiId);
+
+		mSubmitted = true;
+
+		return true;
+	}
+
+	bool GpuShaderStageOGL::IsReady()
+	{
+		if (!mSubmitted || !GLHasParallelShaderCompile())
+			return true;
+
+		GLint done = GL_FALSE;
+		glGetShaderiv(mApiId, GL_COMPLETION_STATUS_KHR, &done);
+
+		return done == GL_TRUE;
+	}
+
+	bool GpuShaderStageOGL::Finish()
+	{
+		if (mCompiled)
+			return true;
+
+		if (!mSubmitted)
+			return false;
+
+		mSubmitted = false;
+
+		// waits for the compiler if it is still running
+		GLint result = GL_FALSE;
 		glGetShaderiv(mApiId, GL_COMPILE_STATUS, &result);
 
 		if (result == GL_FALSE)
@@ -72,6 +72,7 @@ namespace jse {
 			case TextureType_2D:		return GL_TEXTURE_2D;
 			case TextureType_3D:		return GL_TEXTURE_3D;
 			case TextureType_CubeMap:	return GL_TEXTURE_CUBE_MAP;
+			case TextureType_2DArray:	return GL_TEXTURE_2D_ARRAY;
 			default:
 				return 0;
 		}
@@ -143,6 +144,7 @@ namespace jse {
 			case VtxAttribType_Float:		return GL_FLOAT;
 			case VtxAttribType_UByte:		return GL_UNSIGNED_BYTE;
 			case VtxAttribType_UInt:		return GL_UNSIGNED_INT;
+			case VtxAttribType_UByteInt:	return GL_UNSIGNED_BYTE;
 			default:
 				return 0;
 		}
@@ -174,6 +176,7 @@ namespace jse {
 			case BufferTarget_Index:		return GL_ELEMENT_ARRAY_BUFFER;
 			case BufferTarget_Uniform:		return GL_UNIFORM_BUFFER;
 			case BufferTarget_Query:		return GL_QUERY_BUFFER;
+			case BufferTarget_PixelUnpack:	return GL_PIXEL_UNPACK_BUFFER;
 			default:
 				return 0;
 		}
@@ -226,10 +229,22 @@ namespace jse {
 		gl_Context = 0;
 		pWindow = 0;
 		vMajor = vMinor = 0;
+
+		activeTextureUnit = 0;
+		for (int i = 0; i < TextureUnit_LastEnum; ++i)
+		{
+			boundTextures[i] = 0;
+			boundSamplers[i] = 0;
+		}
 	}
 
 	GraphicsDriverOGL::~GraphicsDriverOGL()
 	{
+		for (const auto& it : samplerCache)
+		{
+			glDeleteSamplers(1, &it.second);
+		}
+
 		if (gl_Context)
 		{
 			SDL_GL_DeleteContext(gl_Context);
@@ -463,6 +478,17 @@ namespace jse {
 		Info("GL Version: %s", gl_version);
 		Info("GL Extensions: %d", n);
 
+		// let the driver use as many compiler threads as it likes, see ShaderManager::BeginInit
+		if (GLEW_KHR_parallel_shader_compile)
+		{
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		}
+		else if (GLEW_ARB_parallel_shader_compile)
+		{
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		}
+		Info("GL parallel shader compile: %s", GLHasParallelShaderCompile() ? "yes" : "no");
+
         initHasBeenRun = true;
 		//SDL_SetRelativeMouseMode(SDL_TRUE);
 		//SDL_CaptureMouse(SDL_TRUE);
@@ -502,12 +528,32 @@ namespace jse {
 				glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &Max);
 				return (int)Max;
 			}
+			case GraphicsCaps_ProgramBinaryFormats:		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n); break;
+			case GraphicsCaps_UniformBufferOffsetAlignment:	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &n); break;
 
 		}
 
 		return n;
 	}
 
+	String GraphicsDriverOGL::GetDeviceString() const
+	{
+		const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		String result;
+
+		for (const GLenum name : names)
+		{
+			const GLubyte* str = glGetString(name);
+			if (str)
+			{
+				result += reinterpret_cast<const char*>(str);
+			}
+			result += ";";
+		}
+
+		return result;
+	}
+
 	void GraphicsDriverOGL::SetVSyncEnabled(int aEnabled, bool aAdaptiv)
 	{
 		SDL_GL_SetSwapInterval(aEnabled && aAdaptiv ? -1 : aEnabled);
@@ -606,9 +652,71 @@ namespace jse {
 	}
 	void GraphicsDriverOGL::SetActiveTexture(const TextureUnit a0)
 	{
-		const GLenum unit = GL_TEXTURE0 + a0;
+		if (activeTextureUnit != a0)
+		{
+			activeTextureUnit = a0;
+			glActiveTexture(GL_TEXTURE0 + a0);
+		}
+	}
+
+	void GraphicsDriverOGL::BindTexture(const TextureUnit aUnit, const GLenum aTarget, const GLuint aId)
+	{
+		// one name per unit is tracked, binding another target on the same unit is not used
+		if (boundTextures[aUnit] == aId && aId)
+			return;
 
-		glActiveTexture(unit);
+		SetActiveTexture(aUnit);
+		glBindTexture(aTarget, aId);
+		boundTextures[aUnit] = aId;
+	}
+
+	void GraphicsDriverOGL::OnDeleteTexture(const GLuint aId)
+	{
+		for (int i = 0; i < TextureUnit_LastEnum; ++i)
+		{
+			if (boundTextures[i] == aId)
+			{
+				boundTextures[i] = 0;
+			}
+		}
+	}
+
+	void GraphicsDriverOGL::BindSampler(const TextureUnit aUnit, const SamplerState_t& aState)
+	{
+		const u32 key = aState.GetKey();
+		GLuint id = 0;
+
+		auto it = samplerCache.find(key);
+		if (it != samplerCache.end())
+		{
+			id = it->second;
+		}
+		else
+		{
+			glGenSamplers(1, &id);
+			glSamplerParameteri(id, GL_TEXTURE_MIN_FILTER, GetGLTextureFilterInt(aState.minFilter));
+			glSamplerParameteri(id, GL_TEXTURE_MAG_FILTER, GetGLTextureFilterInt(aState.magFilter));
+			glSamplerParameteri(id, GL_TEXTURE_WRAP_S, GetGLTextureWrapInt(aState.wrapS));
+			glSamplerParameteri(id, GL_TEXTURE_WRAP_T, GetGLTextureWrapInt(aState.wrapT));
+			glSamplerParameteri(id, GL_TEXTURE_WRAP_R, GetGLTextureWrapInt(aState.wrapR));
+
+			samplerCache[key] = id;
+		}
+
+		if (boundSamplers[aUnit] != id)
+		{
+			glBindSampler(aUnit, id);
+			boundSamplers[aUnit] = id;
+		}
+	}
+
+	void GraphicsDriverOGL::UnBindSampler(const TextureUnit aUnit)
+	{
+		if (boundSamplers[aUnit])
+		{
+			glBindSampler(aUnit, 0);
+			boundSamplers[aUnit] = 0;
+		}
 	}
 
 	void GraphicsDriverOGL::DrawPrimitivesWithBase(const PrimitiveType aType, const unsigned int aCount, const size_t aIndices, const unsigned int aBaseVertex)
@@ -1,20 +1,30 @@
+#include <cmath>
+#include <algorithm>
+
 #include "impl/TextureOGL.hpp"
 #include "impl/GraphicsDriverOGL.hpp"
 
 namespace jse {
 
 	GLint GetGLPixelInternalFormat(const int aChannel);
+	GLenum GetGLCompressedFormatEnum(const PixelFormat aFormat, const bool aSRGB);
+	GLenum GetGLPixelFormatEnum(const PixelFormat aFormat);
 
 	TextureOGL::TextureOGL(GraphicsDriverOGL* aDriver) : Texture()
 	{
 		mDriver = aDriver;
 		mApiId = 0;
+		mPixelFormat = PixelFormat_Unknown;
+		mFormat = 0;
+		mInternalFormat = 0;
+		mIsCompressed = false;
 	}
 
 	TextureOGL::~TextureOGL()
 	{
 		if (mApiId)
 		{
+			mDriver->OnDeleteTexture(mApiId);
 			glDeleteTextures(1, &mApiId);
 		}
 	}
@@ -23,12 +33,28 @@ namespace jse {
 	{
 		if (mApiId)
 		{
-			GLenum unit = GL_TEXTURE0 + mTextureUnit;
-			glActiveTexture(unit);
-			glBindTexture(GetGLTextureTypeEnum(mType), mApiId);
+			mDriver->BindTexture(mTextureUnit, GetGLTextureTypeEnum(mType), mApiId);
 		}
 	}
 
+	static bool TextureOGL_GetFormats(const Bitmap& aBitmap, GLenum& aFormat, GLint& aInternalFormat)
+	{
+		aFormat = GetGLPixelFormatEnum(aBitmap.GetPixelFormat());
+		aInternalFormat = aFormat;
+
+		if (aBitmap.IsCompressed())
+		{
+			aFormat = GetGLCompressedFormatEnum(aBitmap.GetPixelFormat(), aBitmap.IsSRGB());
+			aInternalFormat = aFormat;
+		}
+		else if (aBitmap.IsSRGB())
+		{
+			aInternalFormat = aFormat == GL_RGBA ? GL_SRGB8_ALPHA8 : GL_SRGB8;
+		}
+
+		return aFormat != 0;
+	}
+
 	bool TextureOGL::UploadToGPU(const unsigned char* data)
 	{
 		if (!mApiId)
@@ -45,7 +71,7 @@ namespace jse {
 		const GLint iformat = GetGLPixelInternalFormat(mSize.z);
 
 
-		glBindTexture(target, mApiId);
+		mDriver->BindTexture(mTextureUnit, target, mApiId);
 
 		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
@@ -69,11 +95,305 @@ namespace jse {
 		}
 
 		glGenerateMipmap(target);
-		glBindTexture(target, 0);
+		mDriver->BindTexture(mTextureUnit, target, 0);
+
+		mNumMipmaps = 1 + int(std::log2(std::max(1, std::max(mSize.x, mSize.y))));
+
+		return true;
+	}
+
+	bool TextureOGL::UploadBitmapToGPU(const Bitmap& aBitmap, const size_t* aPboOffsets)
+	{
+		const bool isCompressed = aBitmap.IsCompressed();
+		const bool isCube = mType == TextureType_CubeMap;
+		const int numFaces = isCube ? 6 : 1;
+		const int numMips = aBitmap.GetNumMipmaps();
+
+		if (mType != TextureType_2D && !isCube)
+		{
+			Error("Texture %s: only 2D and cube map bitmaps are supported", mName.c_str());
+			return false;
+		}
+
+		if (aBitmap.GetNumImages() < numFaces)
+		{
+			Error("Texture %s: cube map needs 6 images, bitmap has %d", mName.c_str(), aBitmap.GetNumImages());
+			return false;
+		}
+
+		GLenum format;
+		GLint iformat;
+
+		if (!TextureOGL_GetFormats(aBitmap, format, iformat))
+		{
+			Error("Texture %s: unsupported pixel format %d", mName.c_str(), int(aBitmap.GetPixelFormat()));
+			return false;
+		}
+
+		// re-specified with another size or chain (streaming): start from a new name so the old levels are released
+		if (mApiId && (mNumMipmaps != numMips || mSize.x != aBitmap.GetSizeX() || mSize.y != aBitmap.GetSizeY()))
+		{
+			mDriver->OnDeleteTexture(mApiId);
+			glDeleteTextures(1, &mApiId);
+			mApiId = 0;
+		}
+
+		if (!mApiId)
+		{
+			glGenTextures(1, &mApiId);
+		}
+
+		const GLenum target = GetGLTextureTypeEnum(mType);
+
+		mDriver->BindTexture(mTextureUnit, target, mApiId);
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GetGLTextureWrapInt(mWrapS));
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GetGLTextureWrapInt(mWrapT));
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GetGLTextureFilterInt(mMinFilter));
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GetGLTextureFilterInt(mMagFilter));
+
+		for (int face = 0; face < numFaces; ++face)
+		{
+			const GLenum imageTarget = isCube ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+
+			for (int mip = 0; mip < numMips; ++mip)
+			{
+				const BitmapData* bd = aBitmap.GetData(face, mip);
+				const GLsizei w = aBitmap.GetMipSizeX(mip);
+				const GLsizei h = aBitmap.GetMipSizeY(mip);
+				const void* data = aPboOffsets ? reinterpret_cast<const void*>(aPboOffsets[face * numMips + mip]) : bd->GetData();
+
+				if (isCompressed)
+				{
+					glCompressedTexImage2D(imageTarget, mip, format, w, h, 0, bd->GetSize(), data);
+				}
+				else
+				{
+					glTexImage2D(imageTarget, mip, iformat, w, h, 0, format, GL_UNSIGNED_BYTE, data);
+				}
+			}
+		}
+
+		glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+
+		// block compressed data cannot be mipmapped by the driver, use what is in the file
+		if (numMips == 1 && !isCompressed)
+		{
+			glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 1000);
+			glGenerateMipmap(target);
+		}
+		else
+		{
+			glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, numMips - 1);
+		}
+
+		mDriver->BindTexture(mTextureUnit, target, 0);
+
+		mNumMipmaps = numMips;
+		mPixelFormat = aBitmap.GetPixelFormat();
+		mFormat = format;
+		mInternalFormat = iformat;
+		mIsCompressed = isCompressed;
+
+		return true;
+	}
+
+	bool TextureOGL::DropTopMips(const int aCount)
+	{
+		// needs GL 4.3 / ARB_copy_image to move the kept levels into a smaller texture
+		if (!GLEW_ARB_copy_image || !mApiId || mType != TextureType_2D || aCount <= 0 || aCount >= mNumMipmaps)
+			return false;
+
+		const GLenum target = GL_TEXTURE_2D;
+		const int numMips = mNumMipmaps - aCount;
+		const int sizeX = std::max(1, mSize.x >> aCount);
+		const int sizeY = std::max(1, mSize.y >> aCount);
+		GLuint newId = 0;
+
+		glGenTextures(1, &newId);
+		mDriver->BindTexture(mTextureUnit, target, newId);
+
+		for (int mip = 0; mip < numMips; ++mip)
+		{
+			const GLsizei w = std::max(1, sizeX >> mip);
+			const GLsizei h = std::max(1, sizeY >> mip);
+
+			if (mIsCompressed)
+			{
+				glCompressedTexImage2D(target, mip, mFormat, w, h, 0, GLsizei(GetCompressedImageSize(mPixelFormat, w, h)), nullptr);
+			}
+			else
+			{
+				glTexImage2D(target, mip, mInternalFormat, w, h, 0, mFormat, GL_UNSIGNED_BYTE, nullptr);
+			}
+		}
+
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GetGLTextureWrapInt(mWrapS));
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GetGLTextureWrapInt(mWrapT));
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GetGLTextureFilterInt(mMinFilter));
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GetGLTextureFilterInt(mMagFilter));
+		glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, numMips - 1);
+		mDriver->BindTexture(mTextureUnit, target, 0);
+
+		for (int mip = 0; mip < numMips; ++mip)
+		{
+			const GLsizei w = std::max(1, sizeX >> mip);
+			const GLsizei h = std::max(1, sizeY >> mip);
+
+			glCopyImageSubData(mApiId, target, mip + aCount, 0, 0, 0, newId, target, mip, 0, 0, 0, w, h, 1);
+		}
+
+		mDriver->OnDeleteTexture(mApiId);
+		glDeleteTextures(1, &mApiId);
+		mApiId = newId;
+		mSize.x = sizeX;
+		mSize.y = sizeY;
+		mNumMipmaps = numMips;
+
+		return true;
+	}
+
+	bool TextureOGL::AllocateLayers(const Bitmap& aLayout, const int aNumLayers)
+	{
+		if (mType != TextureType_2DArray || aNumLayers <= 0)
+		{
+			Error("Texture %s: layers need a 2D array texture", mName.c_str());
+			return false;
+		}
+
+		GLenum format;
+		GLint iformat;
+
+		if (!TextureOGL_GetFormats(aLayout, format, iformat))
+		{
+			Error("Texture %s: unsupported pixel format %d", mName.c_str(), int(aLayout.GetPixelFormat()));
+			return false;
+		}
+
+		const bool isCompressed = aLayout.IsCompressed();
+		const int numMips = aLayout.GetNumMipmaps();
+		const GLenum target = GL_TEXTURE_2D_ARRAY;
+
+		if (mApiId)
+		{
+			mDriver->OnDeleteTexture(mApiId);
+			glDeleteTextures(1, &mApiId);
+		}
+
+		glGenTextures(1, &mApiId);
+		mDriver->BindTexture(mTextureUnit, target, mApiId);
+
+		for (int mip = 0; mip < numMips; ++mip)
+		{
+			const GLsizei w = aLayout.GetMipSizeX(mip);
+			const GLsizei h = aLayout.GetMipSizeY(mip);
+
+			if (isCompressed)
+			{
+				const GLsizei size = GLsizei(GetCompressedImageSize(aLayout.GetPixelFormat(), w, h) * aNumLayers);
+				glCompressedTexImage3D(target, mip, format, w, h, aNumLayers, 0, size, nullptr);
+			}
+			else
+			{
+				glTexImage3D(target, mip, iformat, w, h, aNumLayers, 0, format, GL_UNSIGNED_BYTE, nullptr);
+			}
+		}
+
+		// defaults for draws without a sampler object
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GetGLTextureWrapInt(mWrapS));
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GetGLTextureWrapInt(mWrapT));
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GetGLTextureFilterInt(mMinFilter));
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GetGLTextureFilterInt(mMagFilter));
+		glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, numMips - 1);
+
+		mDriver->BindTexture(mTextureUnit, target, 0);
+
+		mSize = Vector3l(aLayout.GetSizeX(), aLayout.GetSizeY(), aLayout.GetBytesPerPixel());
+		mNumMipmaps = numMips;
+		mNumLayers = aNumLayers;
+		mPixelFormat = aLayout.GetPixelFormat();
+		mFormat = format;
+		mInternalFormat = iformat;
+		mIsCompressed = isCompressed;
+		mUsable = true;
 
 		return true;
 	}
 
+	bool TextureOGL::UploadLayer(const Bitmap& aBitmap, const int aLayer)
+	{
+		if (!mApiId || mType != TextureType_2DArray || aLayer < 0 || aLayer >= mNumLayers)
+			return false;
+
+		if (aBitmap.GetSizeX() != mSize.x || aBitmap.GetSizeY() != mSize.y || aBitmap.GetNumMipmaps() != mNumMipmaps ||
+			aBitmap.GetPixelFormat() != mPixelFormat || aBitmap.IsCompressed() != mIsCompressed)
+		{
+			Error("Texture %s: layer %s does not match the array layout", mName.c_str(), aBitmap.GetFileName().c_str());
+			return false;
+		}
+
+		const GLenum target = GL_TEXTURE_2D_ARRAY;
+
+		mDriver->BindTexture(mTextureUnit, target, mApiId);
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		for (int mip = 0; mip < mNumMipmaps; ++mip)
+		{
+			const BitmapData* bd = aBitmap.GetData(0, mip);
+			const GLsizei w = aBitmap.GetMipSizeX(mip);
+			const GLsizei h = aBitmap.GetMipSizeY(mip);
+
+			if (mIsCompressed)
+			{
+				glCompressedTexSubImage3D(target, mip, 0, 0, aLayer, w, h, 1, mFormat, bd->GetSize(), bd->GetData());
+			}
+			else
+			{
+				glTexSubImage3D(target, mip, 0, 0, aLayer, w, h, 1, mFormat, GL_UNSIGNED_BYTE, bd->GetData());
+			}
+		}
+
+		mDriver->BindTexture(mTextureUnit, target, 0);
+
+		return true;
+	}
+
+	GLenum GetGLCompressedFormatEnum(const PixelFormat aFormat, const bool aSRGB)
+	{
+		switch (aFormat)
+		{
+			case PixelFormat_DXT1:	return aSRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+			case PixelFormat_DXT2:
+			case PixelFormat_DXT3:	return aSRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT : GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+			case PixelFormat_DXT4:
+			case PixelFormat_DXT5:	return aSRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+			case PixelFormat_BC4:	return GL_COMPRESSED_RED_RGTC1;
+			case PixelFormat_BC5:	return GL_COMPRESSED_RG_RGTC2;
+			case PixelFormat_BC6H:	return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+			case PixelFormat_BC7:	return aSRGB ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+			default:
+				return 0;
+		}
+	}
+
+	GLenum GetGLPixelFormatEnum(const PixelFormat aFormat)
+	{
+		switch (aFormat)
+		{
+			case PixelFormat_Luminance:			return GL_RED;
+			case PixelFormat_LuminanceAlpha:	return GL_RG;
+			case PixelFormat_RGB:				return GL_RGB;
+			case PixelFormat_RGBA:				return GL_RGBA;
+			default:
+				return 0;
+		}
+	}
+
 	GLint GetGLPixelInternalFormat(const int aChannel)
 	{
 		switch (aChannel)
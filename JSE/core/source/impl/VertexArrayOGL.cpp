@@ -32,13 +32,25 @@ namespace jse {
 		{
 			it->mBuffer->Bind();
 			glEnableVertexAttribArray(it->index);
-			glVertexAttribPointer(
-				it->index,
-				it->size,
-				GetGLVertexAttribTypeEnum(it->type),
-				VertexAttribNormalize[it->type] ? GL_TRUE : GL_FALSE,
-				it->stride,
-				reinterpret_cast<void*>(pointer + it->basePointer));
+			if (VertexAttribInteger[it->type])
+			{
+				glVertexAttribIPointer(
+					it->index,
+					it->size,
+					GetGLVertexAttribTypeEnum(it->type),
+					it->stride,
+					reinterpret_cast<void*>(pointer + it->basePointer));
+			}
+			else
+			{
+				glVertexAttribPointer(
+					it->index,
+					it->size,
+					GetGLVertexAttribTypeEnum(it->type),
+					VertexAttribNormalize[it->type] ? GL_TRUE : GL_FALSE,
+					it->stride,
+					reinterpret_cast<void*>(pointer + it->basePointer));
+			}
 
 			pointer += static_cast<GLintptr>( it->size ) * VertexAttribSizes[it->type];
 		}
@@ -54,4 +66,9 @@ namespace jse {
 	{
 		glBindVertexArray(mVAO);
 	}
+
+	void VertexArrayOGL::UnBind()
+	{
+		glBindVertexArray(0);
+	}
 }
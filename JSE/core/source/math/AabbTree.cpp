@@ -0,0 +1,553 @@
+#include <algorithm>
+
+#include "math/AabbTree.hpp"
+#include "system/Cpu.hpp"
+
+namespace jse {
+
+	// Traversal stack, the balanced tree stays far below this height
+	static const int kAabbTreeStackSize = 128;
+
+	AabbTree::AabbTree(const float aMargin)
+	{
+		mRoot = kNull;
+		mFreeList = kNull;
+		mProxyNum = 0;
+		mMargin = aMargin;
+	}
+
+	void AabbTree::Clear()
+	{
+		mNodes.clear();
+		mRoot = kNull;
+		mFreeList = kNull;
+		mProxyNum = 0;
+	}
+
+	int AabbTree::AllocateNode()
+	{
+		int node;
+
+		if (mFreeList != kNull)
+		{
+			node = mFreeList;
+			mFreeList = mNodes[node].parent;
+		}
+		else
+		{
+			node = int(mNodes.size());
+			mNodes.emplace_back();
+		}
+
+		Node_t& n = mNodes[node];
+		n.parent = kNull;
+		n.child1 = kNull;
+		n.child2 = kNull;
+		n.height = 0;
+		n.user = -1;
+
+		return node;
+	}
+
+	void AabbTree::FreeNode(const int aNode)
+	{
+		mNodes[aNode].parent = mFreeList;
+		mNodes[aNode].height = -1;
+		mFreeList = aNode;
+	}
+
+	int AabbTree::CreateProxy(const Aabb_t& aBounds, const int aUser)
+	{
+		const int proxy = AllocateNode();
+
+		mNodes[proxy].bounds = Aabb_Inflate(aBounds, mMargin);
+		mNodes[proxy].user = aUser;
+
+		InsertLeaf(proxy);
+		++mProxyNum;
+
+		return proxy;
+	}
+
+	void AabbTree::DestroyProxy(const int aProxy)
+	{
+		RemoveLeaf(aProxy);
+		FreeNode(aProxy);
+		--mProxyNum;
+	}
+
+	bool AabbTree::MoveProxy(const int aProxy, const Aabb_t& aBounds)
+	{
+		const Aabb_t& fat = mNodes[aProxy].bounds;
+
+		// still inside the enlarged box, which is not much larger than needed either
+		if (Aabb_Contains(fat, aBounds) && Aabb_Contains(Aabb_Inflate(aBounds, 4.0f * mMargin), fat))
+			return false;
+
+		RemoveLeaf(aProxy);
+		mNodes[aProxy].bounds = Aabb_Inflate(aBounds, mMargin);
+		InsertLeaf(aProxy);
+
+		return true;
+	}
+
+	void AabbTree::InsertLeaf(const int aLeaf)
+	{
+		if (mRoot == kNull)
+		{
+			mRoot = aLeaf;
+			mNodes[aLeaf].parent = kNull;
+			return;
+		}
+
+		// descend to the sibling with the smallest area increase
+		const Aabb_t leafBounds = mNodes[aLeaf].bounds;
+		int index = mRoot;
+
+		while (!IsLeaf(index))
+		{
+			const Node_t& n = mNodes[index];
+			const float area = Aabb_HalfArea(n.bounds);
+			const float combinedArea = Aabb_HalfArea(Aabb_Union(n.bounds, leafBounds));
+
+			// new parent here, or the area the leaf adds to every node further down
+			const float cost = 2.0f * combinedArea;
+			const float inheritance = 2.0f * (combinedArea - area);
+
+			float childCost[2];
+			const int children[2] = { n.child1, n.child2 };
+
+			for (int c = 0; c < 2; ++c)
+			{
+				const Aabb_t& childBounds = mNodes[children[c]].bounds;
+				const float grown = Aabb_HalfArea(Aabb_Union(childBounds, leafBounds));
+
+				childCost[c] = (IsLeaf(children[c]) ? grown : grown - Aabb_HalfArea(childBounds)) + inheritance;
+			}
+
+			if (cost < childCost[0] && cost < childCost[1])
+				break;
+
+			index = childCost[0] < childCost[1] ? children[0] : children[1];
+		}
+
+		const int sibling = index;
+		const int oldParent = mNodes[sibling].parent;
+		const int newParent = AllocateNode();
+
+		Node_t& p = mNodes[newParent];
+		p.parent = oldParent;
+		p.bounds = Aabb_Union(leafBounds, mNodes[sibling].bounds);
+		p.height = mNodes[sibling].height + 1;
+		p.child1 = sibling;
+		p.child2 = aLeaf;
+
+		if (oldParent != kNull)
+		{
+			if (mNodes[oldParent].child1 == sibling)
+				mNodes[oldParent].child1 = newParent;
+			else
+				mNodes[oldParent].child2 = newParent;
+		}
+		else
+		{
+			mRoot = newParent;
+		}
+
+		mNodes[sibling].parent = newParent;
+		mNodes[aLeaf].parent = newParent;
+
+		Refit(newParent);
+	}
+
+	void AabbTree::RemoveLeaf(const int aLeaf)
+	{
+		if (aLeaf == mRoot)
+		{
+			mRoot = kNull;
+			return;
+		}
+
+		const int parent = mNodes[aLeaf].parent;
+		const int grandParent = mNodes[parent].parent;
+		const int sibling = mNodes[parent].child1 == aLeaf ? mNodes[parent].child2 : mNodes[parent].child1;
+
+		if (grandParent != kNull)
+		{
+			if (mNodes[grandParent].child1 == parent)
+				mNodes[grandParent].child1 = sibling;
+			else
+				mNodes[grandParent].child2 = sibling;
+
+			mNodes[sibling].parent = grandParent;
+			FreeNode(parent);
+
+			Refit(grandParent);
+		}
+		else
+		{
+			mRoot = sibling;
+			mNodes[sibling].parent = kNull;
+			FreeNode(parent);
+		}
+	}
+
+	void AabbTree::Refit(int aNode)
+	{
+		while (aNode != kNull)
+		{
+			aNode = Balance(aNode);
+
+			Node_t& n = mNodes[aNode];
+			const Node_t& c1 = mNodes[n.child1];
+			const Node_t& c2 = mNodes[n.child2];
+
+			n.height = 1 + std::max(c1.height, c2.height);
+			n.bounds = Aabb_Union(c1.bounds, c2.bounds);
+
+			aNode = n.parent;
+		}
+	}
+
+	// Rotates the higher child up when the heights of the children differ by more than one
+	int AabbTree::Balance(const int aNode)
+	{
+		Node_t& a = mNodes[aNode];
+		if (IsLeaf(aNode) || a.height < 2)
+			return aNode;
+
+		const int ib = a.child1;
+		const int ic = a.child2;
+		Node_t& b = mNodes[ib];
+		Node_t& c = mNodes[ic];
+		const int balance = c.height - b.height;
+
+		if (balance > 1)
+		{
+			const int iF = c.child1;
+			const int iG = c.child2;
+			Node_t& f = mNodes[iF];
+			Node_t& g = mNodes[iG];
+
+			c.child1 = aNode;
+			c.parent = a.parent;
+			a.parent = ic;
+
+			if (c.parent != kNull)
+			{
+				if (mNodes[c.parent].child1 == aNode)
+					mNodes[c.parent].child1 = ic;
+				else
+					mNodes[c.parent].child2 = ic;
+			}
+			else
+			{
+				mRoot = ic;
+			}
+
+			if (f.height > g.height)
+			{
+				c.child2 = iF;
+				a.child2 = iG;
+				g.parent = aNode;
+				a.bounds = Aabb_Union(b.bounds, g.bounds);
+				c.bounds = Aabb_Union(a.bounds, f.bounds);
+				a.height = 1 + std::max(b.height, g.height);
+				c.height = 1 + std::max(a.height, f.height);
+			}
+			else
+			{
+				c.child2 = iG;
+				a.child2 = iF;
+				f.parent = aNode;
+				a.bounds = Aabb_Union(b.bounds, f.bounds);
+				c.bounds = Aabb_Union(a.bounds, g.bounds);
+				a.height = 1 + std::max(b.height, f.height);
+				c.height = 1 + std::max(a.height, g.height);
+			}
+
+			return ic;
+		}
+
+		if (balance < -1)
+		{
+			const int iD = b.child1;
+			const int iE = b.child2;
+			Node_t& d = mNodes[iD];
+			Node_t& e = mNodes[iE];
+
+			b.child1 = aNode;
+			b.parent = a.parent;
+			a.parent = ib;
+
+			if (b.parent != kNull)
+			{
+				if (mNodes[b.parent].child1 == aNode)
+					mNodes[b.parent].child1 = ib;
+				else
+					mNodes[b.parent].child2 = ib;
+			}
+			else
+			{
+				mRoot = ib;
+			}
+
+			if (d.height > e.height)
+			{
+				b.child2 = iD;
+				a.child1 = iE;
+				e.parent = aNode;
+				a.bounds = Aabb_Union(c.bounds, e.bounds);
+				b.bounds = Aabb_Union(a.bounds, d.bounds);
+				a.height = 1 + std::max(c.height, e.height);
+				b.height = 1 + std::max(a.height, d.height);
+			}
+			else
+			{
+				b.child2 = iE;
+				a.child1 = iD;
+				d.parent = aNode;
+				a.bounds = Aabb_Union(c.bounds, d.bounds);
+				b.bounds = Aabb_Union(a.bounds, e.bounds);
+				a.height = 1 + std::max(c.height, d.height);
+				b.height = 1 + std::max(a.height, e.height);
+			}
+
+			return ib;
+		}
+
+		return aNode;
+	}
+
+	void AabbTree::QueryAabb(const Aabb_t& aBounds, const AabbTreeQueryFunc& aFunc) const
+	{
+		if (mRoot == kNull)
+			return;
+
+		int stack[kAabbTreeStackSize];
+		int sp = 0;
+		stack[sp++] = mRoot;
+
+		while (sp)
+		{
+			const int node = stack[--sp];
+			const Node_t& n = mNodes[node];
+
+			if (!Aabb_Overlaps(n.bounds, aBounds))
+				continue;
+
+			if (IsLeaf(node))
+			{
+				if (!aFunc(node))
+					return;
+			}
+			else
+			{
+				stack[sp++] = n.child2;
+				stack[sp++] = n.child1;
+			}
+		}
+	}
+
+	void AabbTree::RayCast(const Ray_t& aRay, const AabbTreeRayFunc& aFunc) const
+	{
+		if (mRoot == kNull)
+			return;
+
+		const Vector3f invDir = Ray_InvDir(aRay.dir);
+		float tMax = aRay.tMax;
+		int stack[kAabbTreeStackSize];
+		int sp = 0;
+		stack[sp++] = mRoot;
+
+		while (sp)
+		{
+			const int node = stack[--sp];
+			const Node_t& n = mNodes[node];
+			float t;
+
+			if (!Aabb_IntersectRay(n.bounds, aRay.origin, invDir, tMax, t))
+				continue;
+
+			if (IsLeaf(node))
+			{
+				tMax = aFunc(node, tMax);
+				if (tMax <= 0.0f)
+					return;
+			}
+			else
+			{
+				stack[sp++] = n.child2;
+				stack[sp++] = n.child1;
+			}
+		}
+	}
+
+#if defined(JSE_SIMD_X86)
+
+	void AabbTree::RayCastPacket(const Ray_t* aRays, const AabbTreePacketFunc& aFunc) const
+	{
+		if (mRoot == kNull)
+			return;
+
+		float ends[kRayPacketSize];
+		Vector3f invDir[kRayPacketSize];
+		for (int i = 0; i < kRayPacketSize; ++i)
+		{
+			ends[i] = aRays[i].tMax;
+			invDir[i] = Ray_InvDir(aRays[i].dir);
+		}
+
+		// one lane per ray
+		const __m128 ox = _mm_setr_ps(aRays[0].origin.x, aRays[1].origin.x, aRays[2].origin.x, aRays[3].origin.x);
+		const __m128 oy = _mm_setr_ps(aRays[0].origin.y, aRays[1].origin.y, aRays[2].origin.y, aRays[3].origin.y);
+		const __m128 oz = _mm_setr_ps(aRays[0].origin.z, aRays[1].origin.z, aRays[2].origin.z, aRays[3].origin.z);
+		const __m128 ix = _mm_setr_ps(invDir[0].x, invDir[1].x, invDir[2].x, invDir[3].x);
+		const __m128 iy = _mm_setr_ps(invDir[0].y, invDir[1].y, invDir[2].y, invDir[3].y);
+		const __m128 iz = _mm_setr_ps(invDir[0].z, invDir[1].z, invDir[2].z, invDir[3].z);
+		const __m128 zero = _mm_setzero_ps();
+		__m128 t = _mm_loadu_ps(ends);
+
+		int stack[kAabbTreeStackSize];
+		int sp = 0;
+		stack[sp++] = mRoot;
+
+		while (sp)
+		{
+			const int node = stack[--sp];
+			const Node_t& n = mNodes[node];
+
+			const __m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.bounds.min.x), ox), ix);
+			const __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.bounds.max.x), ox), ix);
+			const __m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.bounds.min.y), oy), iy);
+			const __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.bounds.max.y), oy), iy);
+			const __m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.bounds.min.z), oz), iz);
+			const __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.bounds.max.z), oz), iz);
+
+			const __m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx0, tx1), _mm_min_ps(ty0, ty1)), _mm_max_ps(_mm_min_ps(tz0, tz1), zero));
+			const __m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx0, tx1), _mm_max_ps(ty0, ty1)), _mm_min_ps(_mm_max_ps(tz0, tz1), t));
+
+			const int mask = _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+			if (!mask)
+				continue;
+
+			if (IsLeaf(node))
+			{
+				aFunc(node, mask, ends);
+				t = _mm_loadu_ps(ends);
+			}
+			else
+			{
+				stack[sp++] = n.child2;
+				stack[sp++] = n.child1;
+			}
+		}
+	}
+
+#else
+
+	void AabbTree::RayCastPacket(const Ray_t* aRays, const AabbTreePacketFunc& aFunc) const
+	{
+		if (mRoot == kNull)
+			return;
+
+		float ends[kRayPacketSize];
+		Vector3f invDir[kRayPacketSize];
+		for (int i = 0; i < kRayPacketSize; ++i)
+		{
+			ends[i] = aRays[i].tMax;
+			invDir[i] = Ray_InvDir(aRays[i].dir);
+		}
+
+		int stack[kAabbTreeStackSize];
+		int sp = 0;
+		stack[sp++] = mRoot;
+
+		while (sp)
+		{
+			const int node = stack[--sp];
+			const Node_t& n = mNodes[node];
+			int mask = 0;
+
+			for (int i = 0; i < kRayPacketSize; ++i)
+			{
+				float t;
+				if (Aabb_IntersectRay(n.bounds, aRays[i].origin, invDir[i], ends[i], t))
+				{
+					mask |= 1 << i;
+				}
+			}
+
+			if (!mask)
+				continue;
+
+			if (IsLeaf(node))
+			{
+				aFunc(node, mask, ends);
+			}
+			else
+			{
+				stack[sp++] = n.child2;
+				stack[sp++] = n.child1;
+			}
+		}
+	}
+
+#endif
+
+	void AabbTree::QueryFrustum(const Frustum& aFrustum, const AabbTreeFrustumFunc& aFunc) const
+	{
+		if (mRoot == kNull)
+			return;
+
+		int stack[kAabbTreeStackSize];
+		int sp = 0;
+		stack[sp++] = mRoot;
+
+		while (sp)
+		{
+			const int node = stack[--sp];
+			const Node_t& n = mNodes[node];
+			const BoundingVolume::TestResult res = aFrustum.TestAabb(n.bounds);
+
+			if (res == BoundingVolume::TEST_OUTSIDE)
+				continue;
+
+			if (res == BoundingVolume::TEST_INSIDE)
+			{
+				ReportSubtree(node, aFunc);
+			}
+			else if (IsLeaf(node))
+			{
+				aFunc(node, false);
+			}
+			else
+			{
+				stack[sp++] = n.child2;
+				stack[sp++] = n.child1;
+			}
+		}
+	}
+
+	void AabbTree::ReportSubtree(const int aNode, const AabbTreeFrustumFunc& aFunc) const
+	{
+		int stack[kAabbTreeStackSize];
+		int sp = 0;
+		stack[sp++] = aNode;
+
+		while (sp)
+		{
+			const int node = stack[--sp];
+
+			if (IsLeaf(node))
+			{
+				aFunc(node, true);
+			}
+			else
+			{
+				stack[sp++] = mNodes[node].child2;
+				stack[sp++] = mNodes[node].child1;
+			}
+		}
+	}
+}
@@ -0,0 +1,392 @@
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "math/Frustum.hpp"
+#include "system/Logger.hpp"
+
+namespace jse {
+
+	Frustum::Frustum()
+	{
+		for (auto& p : mPlanes)
+		{
+			p = Vector4f(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+	}
+
+	Frustum::Frustum(const Matrix& aViewProj)
+	{
+		SetViewProj(aViewProj);
+	}
+
+	Frustum::Frustum(const Matrix& aView, const Matrix& aProj)
+	{
+		SetViewProj(aProj * aView);
+	}
+
+	void Frustum::SetViewProj(const Matrix& aViewProj)
+	{
+		const Matrix& vp = aViewProj;
+		const Vector4f w(vp[0][3], vp[1][3], vp[2][3], vp[3][3]);
+
+		// rows of the view projection matrix, normals point inside
+		for (int i = 0; i < 3; ++i)
+		{
+			const Vector4f row(vp[0][i], vp[1][i], vp[2][i], vp[3][i]);
+
+			mPlanes[2 * i] = w + row;
+			mPlanes[2 * i + 1] = w - row;
+		}
+
+		for (auto& p : mPlanes)
+		{
+			const float len = glm::length(Vector3f(p));
+			if (len > 0.0f)
+			{
+				p /= len;
+			}
+		}
+	}
+
+	BoundingVolume::TestResult Frustum::TestPoint(const Vector3f& aPoint) const
+	{
+		return TestSphere(aPoint, 0.0f);
+	}
+
+	BoundingVolume::TestResult Frustum::TestSphere(const Vector3f& aCenter, const float aRadius) const
+	{
+		BoundingVolume::TestResult result = BoundingVolume::TEST_INSIDE;
+
+		for (const auto& p : mPlanes)
+		{
+			const float d = glm::dot(Vector3f(p), aCenter) + p.w;
+
+			if (d < -aRadius)
+				return BoundingVolume::TEST_OUTSIDE;
+
+			if (d < aRadius)
+				result = BoundingVolume::TEST_INTERSECT;
+		}
+
+		return result;
+	}
+
+	BoundingVolume::TestResult Frustum::TestBox(const BoundingBox& aBox) const
+	{
+		Aabb_t box;
+		box.min = aBox.position + aBox.minimum;
+		box.max = aBox.position + aBox.maximum;
+
+		return TestAabb(box);
+	}
+
+	BoundingVolume::TestResult Frustum::TestAabb(const Aabb_t& aBox) const
+	{
+		const Vector3f center = (aBox.min + aBox.max) * 0.5f;
+		const Vector3f extent = (aBox.max - aBox.min) * 0.5f;
+		BoundingVolume::TestResult result = BoundingVolume::TEST_INSIDE;
+
+		for (const auto& p : mPlanes)
+		{
+			const Vector3f n(p);
+			const float d = glm::dot(n, center) + p.w;
+			const float r = glm::dot(glm::abs(n), extent);
+
+			if (d < -r)
+				return BoundingVolume::TEST_OUTSIDE;
+
+			if (d < r)
+				result = BoundingVolume::TEST_INTERSECT;
+		}
+
+		return result;
+	}
+
+	static inline bool Frustum_SphereOutside(const Vector4f* aPlanes, const FrustumSpheres_t& aSpheres, const size_t aIdx)
+	{
+		for (int p = 0; p < FrustumPlane_LastEnum; ++p)
+		{
+			const Vector4f& pl = aPlanes[p];
+
+			if (pl.x * aSpheres.x[aIdx] + pl.y * aSpheres.y[aIdx] + pl.z * aSpheres.z[aIdx] + pl.w < -aSpheres.radius[aIdx])
+				return true;
+		}
+
+		return false;
+	}
+
+	static inline bool Frustum_BoxOutside(const Vector4f* aPlanes, const FrustumBoxes_t& aBoxes, const size_t aIdx)
+	{
+		for (int p = 0; p < FrustumPlane_LastEnum; ++p)
+		{
+			const Vector4f& pl = aPlanes[p];
+			const float d = pl.x * aBoxes.x[aIdx] + pl.y * aBoxes.y[aIdx] + pl.z * aBoxes.z[aIdx] + pl.w;
+			const float r = std::abs(pl.x) * aBoxes.extentX[aIdx] + std::abs(pl.y) * aBoxes.extentY[aIdx] + std::abs(pl.z) * aBoxes.extentZ[aIdx];
+
+			if (d + r < 0.0f)
+				return true;
+		}
+
+		return false;
+	}
+
+#if defined(JSE_SIMD_X86)
+
+	/* The SIMD kernels cull whole lanes and return the first object left for the scalar tail */
+
+	static size_t Frustum_CullSpheres_SSE(const Vector4f* aPlanes, const FrustumSpheres_t& aSpheres, const size_t aCount, uint32_t* aVisible)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		size_t i = 0;
+
+		for (; i + 4 <= aCount; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(aSpheres.x + i);
+			const __m128 y = _mm_loadu_ps(aSpheres.y + i);
+			const __m128 z = _mm_loadu_ps(aSpheres.z + i);
+			const __m128 nr = _mm_sub_ps(zero, _mm_loadu_ps(aSpheres.radius + i));
+			__m128 out = zero;
+
+			for (int p = 0; p < FrustumPlane_LastEnum; ++p)
+			{
+				const Vector4f& pl = aPlanes[p];
+				__m128 d = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(pl.x)), _mm_set1_ps(pl.w));
+				d = _mm_add_ps(d, _mm_mul_ps(y, _mm_set1_ps(pl.y)));
+				d = _mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(pl.z)));
+
+				out = _mm_or_ps(out, _mm_cmplt_ps(d, nr));
+			}
+
+			aVisible[i >> 5] |= uint32_t(~_mm_movemask_ps(out) & 0xf) << (i & 31);
+		}
+
+		return i;
+	}
+
+	static size_t Frustum_CullBoxes_SSE(const Vector4f* aPlanes, const FrustumBoxes_t& aBoxes, const size_t aCount, uint32_t* aVisible)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		size_t i = 0;
+
+		for (; i + 4 <= aCount; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(aBoxes.x + i);
+			const __m128 y = _mm_loadu_ps(aBoxes.y + i);
+			const __m128 z = _mm_loadu_ps(aBoxes.z + i);
+			const __m128 ex = _mm_loadu_ps(aBoxes.extentX + i);
+			const __m128 ey = _mm_loadu_ps(aBoxes.extentY + i);
+			const __m128 ez = _mm_loadu_ps(aBoxes.extentZ + i);
+			__m128 out = zero;
+
+			for (int p = 0; p < FrustumPlane_LastEnum; ++p)
+			{
+				// center distance plus the extent projected on the normal
+				const Vector4f& pl = aPlanes[p];
+				__m128 d = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(pl.x)), _mm_set1_ps(pl.w));
+				d = _mm_add_ps(d, _mm_mul_ps(y, _mm_set1_ps(pl.y)));
+				d = _mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(pl.z)));
+				d = _mm_add_ps(d, _mm_mul_ps(ex, _mm_set1_ps(std::abs(pl.x))));
+				d = _mm_add_ps(d, _mm_mul_ps(ey, _mm_set1_ps(std::abs(pl.y))));
+				d = _mm_add_ps(d, _mm_mul_ps(ez, _mm_set1_ps(std::abs(pl.z))));
+
+				out = _mm_or_ps(out, _mm_cmplt_ps(d, zero));
+			}
+
+			aVisible[i >> 5] |= uint32_t(~_mm_movemask_ps(out) & 0xf) << (i & 31);
+		}
+
+		return i;
+	}
+
+	JSE_TARGET_AVX2 static size_t Frustum_CullSpheres_AVX2(const Vector4f* aPlanes, const FrustumSpheres_t& aSpheres, const size_t aCount, uint32_t* aVisible)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		size_t i = 0;
+
+		for (; i + 8 <= aCount; i += 8)
+		{
+			const __m256 x = _mm256_loadu_ps(aSpheres.x + i);
+			const __m256 y = _mm256_loadu_ps(aSpheres.y + i);
+			const __m256 z = _mm256_loadu_ps(aSpheres.z + i);
+			const __m256 nr = _mm256_sub_ps(zero, _mm256_loadu_ps(aSpheres.radius + i));
+			__m256 out = zero;
+
+			for (int p = 0; p < FrustumPlane_LastEnum; ++p)
+			{
+				const Vector4f& pl = aPlanes[p];
+				__m256 d = _mm256_fmadd_ps(x, _mm256_set1_ps(pl.x), _mm256_set1_ps(pl.w));
+				d = _mm256_fmadd_ps(y, _mm256_set1_ps(pl.y), d);
+				d = _mm256_fmadd_ps(z, _mm256_set1_ps(pl.z), d);
+
+				out = _mm256_or_ps(out, _mm256_cmp_ps(d, nr, _CMP_LT_OQ));
+			}
+
+			aVisible[i >> 5] |= uint32_t(~_mm256_movemask_ps(out) & 0xff) << (i & 31);
+		}
+
+		return i;
+	}
+
+	JSE_TARGET_AVX2 static size_t Frustum_CullBoxes_AVX2(const Vector4f* aPlanes, const FrustumBoxes_t& aBoxes, const size_t aCount, uint32_t* aVisible)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		size_t i = 0;
+
+		for (; i + 8 <= aCount; i += 8)
+		{
+			const __m256 x = _mm256_loadu_ps(aBoxes.x + i);
+			const __m256 y = _mm256_loadu_ps(aBoxes.y + i);
+			const __m256 z = _mm256_loadu_ps(aBoxes.z + i);
+			const __m256 ex = _mm256_loadu_ps(aBoxes.extentX + i);
+			const __m256 ey = _mm256_loadu_ps(aBoxes.extentY + i);
+			const __m256 ez = _mm256_loadu_ps(aBoxes.extentZ + i);
+			__m256 out = zero;
+
+			for (int p = 0; p < FrustumPlane_LastEnum; ++p)
+			{
+				const Vector4f& pl = aPlanes[p];
+				__m256 d = _mm256_fmadd_ps(x, _mm256_set1_ps(pl.x), _mm256_set1_ps(pl.w));
+				d = _mm256_fmadd_ps(y, _mm256_set1_ps(pl.y), d);
+				d = _mm256_fmadd_ps(z, _mm256_set1_ps(pl.z), d);
+				d = _mm256_fmadd_ps(ex, _mm256_set1_ps(std::abs(pl.x)), d);
+				d = _mm256_fmadd_ps(ey, _mm256_set1_ps(std::abs(pl.y)), d);
+				d = _mm256_fmadd_ps(ez, _mm256_set1_ps(std::abs(pl.z)), d);
+
+				out = _mm256_or_ps(out, _mm256_cmp_ps(d, zero, _CMP_LT_OQ));
+			}
+
+			aVisible[i >> 5] |= uint32_t(~_mm256_movemask_ps(out) & 0xff) << (i & 31);
+		}
+
+		return i;
+	}
+
+#endif
+
+	void Frustum::CullSpheres(const FrustumSpheres_t& aSpheres, const size_t aCount, uint32_t* aVisible, const SimdLevel aSimd) const
+	{
+		const SimdLevel simd = std::min(aSimd, Cpu_GetSimdLevel());
+		size_t first = 0;
+
+		std::fill(aVisible, aVisible + Frustum_MaskWords(aCount), 0u);
+
+#if defined(JSE_SIMD_X86)
+		if (simd == SimdLevel_AVX2)
+		{
+			first = Frustum_CullSpheres_AVX2(mPlanes, aSpheres, aCount, aVisible);
+		}
+		else if (simd == SimdLevel_SSE)
+		{
+			first = Frustum_CullSpheres_SSE(mPlanes, aSpheres, aCount, aVisible);
+		}
+#endif
+
+		for (size_t i = first; i < aCount; ++i)
+		{
+			if (!Frustum_SphereOutside(mPlanes, aSpheres, i))
+			{
+				aVisible[i >> 5] |= 1u << (i & 31);
+			}
+		}
+	}
+
+	void Frustum::CullBoxes(const FrustumBoxes_t& aBoxes, const size_t aCount, uint32_t* aVisible, const SimdLevel aSimd) const
+	{
+		const SimdLevel simd = std::min(aSimd, Cpu_GetSimdLevel());
+		size_t first = 0;
+
+		std::fill(aVisible, aVisible + Frustum_MaskWords(aCount), 0u);
+
+#if defined(JSE_SIMD_X86)
+		if (simd == SimdLevel_AVX2)
+		{
+			first = Frustum_CullBoxes_AVX2(mPlanes, aBoxes, aCount, aVisible);
+		}
+		else if (simd == SimdLevel_SSE)
+		{
+			first = Frustum_CullBoxes_SSE(mPlanes, aBoxes, aCount, aVisible);
+		}
+#endif
+
+		for (size_t i = first; i < aCount; ++i)
+		{
+			if (!Frustum_BoxOutside(mPlanes, aBoxes, i))
+			{
+				aVisible[i >> 5] |= 1u << (i & 31);
+			}
+		}
+	}
+
+	static size_t Frustum_CountVisible(const std::vector<uint32_t>& aVisible, const size_t aCount)
+	{
+		size_t count = 0;
+
+		for (size_t i = 0; i < aCount; ++i)
+		{
+			count += Frustum_IsVisible(aVisible.data(), i);
+		}
+
+		return count;
+	}
+
+	void Frustum_Benchmark(const int aCount, const int aIterations)
+	{
+		// objects scattered around a camera at the origin looking down -z
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> size(0.5f, 5.0f);
+
+		std::vector<float> data[7];
+		for (auto& d : data)
+		{
+			d.resize(aCount);
+		}
+
+		for (int i = 0; i < aCount; ++i)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				data[k][i] = pos(rng);
+				data[3 + k][i] = size(rng);
+			}
+		}
+
+		const Frustum frustum(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f));
+		const FrustumSpheres_t spheres = { data[0].data(), data[1].data(), data[2].data(), data[3].data() };
+		const FrustumBoxes_t boxes = { data[0].data(), data[1].data(), data[2].data(), data[3].data(), data[4].data(), data[5].data() };
+
+		static const char* const shapeNames[] = { "spheres", "boxes" };
+
+		for (int shape = 0; shape < 2; ++shape)
+		{
+			std::vector<uint32_t> reference, visible(Frustum_MaskWords(aCount));
+
+			for (int level = 0; level <= Cpu_GetSimdLevel(); ++level)
+			{
+				const auto start = std::chrono::steady_clock::now();
+
+				for (int i = 0; i < aIterations; ++i)
+				{
+					if (shape == 0)
+						frustum.CullSpheres(spheres, aCount, visible.data(), SimdLevel(level));
+					else
+						frustum.CullBoxes(boxes, aCount, visible.data(), SimdLevel(level));
+				}
+
+				const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / aIterations;
+
+				if (level == SimdLevel_Scalar)
+				{
+					reference = visible;
+				}
+
+				Info("Frustum %s x%d %s: %fms (%.0f objects / ms), %zu visible, %s", shapeNames[shape], aCount, Cpu_GetSimdLevelName(SimdLevel(level)),
+					ms, aCount / std::max(ms, 1e-6), Frustum_CountVisible(visible, aCount), visible == reference ? "matches scalar" : "MISMATCH");
+			}
+		}
+	}
+}
@@ -0,0 +1,351 @@
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "math/Mat4.hpp"
+#include "system/Cpu.hpp"
+#include "system/Logger.hpp"
+
+namespace jse {
+
+	// relative tolerance of the uniform scale test, against the squared column length
+	static const float kMat4UniformEpsilon = 1e-5f;
+
+	static bool Mat4_IsUniform(const float aL0, const float aL1, const float aL2, const float aD01, const float aD02, const float aD12)
+	{
+		const float eps = kMat4UniformEpsilon * aL0;
+
+		return aL0 > 0.0f && std::abs(aL1 - aL0) <= eps && std::abs(aL2 - aL0) <= eps &&
+			std::abs(aD01) <= eps && std::abs(aD02) <= eps && std::abs(aD12) <= eps;
+	}
+
+#if defined(JSE_SIMD_X86)
+
+	/* SSE2 baseline, one matrix column per register */
+
+	static inline __m128 Mat4_MulColumn(const __m128* aA, const __m128 aCol)
+	{
+		__m128 r = _mm_mul_ps(aA[0], _mm_shuffle_ps(aCol, aCol, _MM_SHUFFLE(0, 0, 0, 0)));
+		r = _mm_add_ps(r, _mm_mul_ps(aA[1], _mm_shuffle_ps(aCol, aCol, _MM_SHUFFLE(1, 1, 1, 1))));
+		r = _mm_add_ps(r, _mm_mul_ps(aA[2], _mm_shuffle_ps(aCol, aCol, _MM_SHUFFLE(2, 2, 2, 2))));
+		r = _mm_add_ps(r, _mm_mul_ps(aA[3], _mm_shuffle_ps(aCol, aCol, _MM_SHUFFLE(3, 3, 3, 3))));
+
+		return r;
+	}
+
+	static inline void Mat4_Load(const Matrix& aM, __m128* aCols)
+	{
+		const float* m = &aM[0][0];
+
+		for (int c = 0; c < 4; ++c)
+		{
+			aCols[c] = _mm_loadu_ps(m + 4 * c);
+		}
+	}
+
+	static inline void Mat4_Store(const __m128* aCols, Matrix& aM)
+	{
+		float* m = &aM[0][0];
+
+		for (int c = 0; c < 4; ++c)
+		{
+			_mm_storeu_ps(m + 4 * c, aCols[c]);
+		}
+	}
+
+	// x + y + z in all lanes
+	static inline __m128 Mat4_Dot3(const __m128 aA, const __m128 aB)
+	{
+		const __m128 m = _mm_mul_ps(aA, aB);
+		const __m128 s = _mm_add_ps(_mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1))), _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 2, 2, 2)));
+
+		return _mm_shuffle_ps(s, s, _MM_SHUFFLE(0, 0, 0, 0));
+	}
+
+	// w is 0 when both w are 0
+	static inline __m128 Mat4_Cross(const __m128 aA, const __m128 aB)
+	{
+		const __m128 ayzx = _mm_shuffle_ps(aA, aA, _MM_SHUFFLE(3, 0, 2, 1));
+		const __m128 byzx = _mm_shuffle_ps(aB, aB, _MM_SHUFFLE(3, 0, 2, 1));
+		const __m128 c = _mm_sub_ps(_mm_mul_ps(aA, byzx), _mm_mul_ps(ayzx, aB));
+
+		return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+	}
+
+	// 3x3 part of aM with w = 0, true for a rotation with a uniform scale (squared scale in aScale2)
+	static inline bool Mat4_LoadBasis(const Matrix& aM, __m128* aCols, float& aScale2)
+	{
+		const __m128 mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		const float* m = &aM[0][0];
+
+		for (int c = 0; c < 3; ++c)
+		{
+			aCols[c] = _mm_and_ps(_mm_loadu_ps(m + 4 * c), mask);
+		}
+
+		aScale2 = _mm_cvtss_f32(Mat4_Dot3(aCols[0], aCols[0]));
+
+		return Mat4_IsUniform(aScale2,
+			_mm_cvtss_f32(Mat4_Dot3(aCols[1], aCols[1])),
+			_mm_cvtss_f32(Mat4_Dot3(aCols[2], aCols[2])),
+			_mm_cvtss_f32(Mat4_Dot3(aCols[0], aCols[1])),
+			_mm_cvtss_f32(Mat4_Dot3(aCols[0], aCols[2])),
+			_mm_cvtss_f32(Mat4_Dot3(aCols[1], aCols[2])));
+	}
+
+	// columns of transpose(inverse()) of the basis
+	static inline void Mat4_InverseTranspose(const __m128* aCols, const bool aUniform, const float aScale2, __m128* aDst)
+	{
+		if (aUniform)
+		{
+			const __m128 s = _mm_set1_ps(1.0f / aScale2);
+
+			for (int c = 0; c < 3; ++c)
+			{
+				aDst[c] = _mm_mul_ps(aCols[c], s);
+			}
+			return;
+		}
+
+		aDst[0] = Mat4_Cross(aCols[1], aCols[2]);
+		aDst[1] = Mat4_Cross(aCols[2], aCols[0]);
+		aDst[2] = Mat4_Cross(aCols[0], aCols[1]);
+
+		const float det = _mm_cvtss_f32(Mat4_Dot3(aCols[0], aDst[0]));
+		if (det != 0.0f)
+		{
+			const __m128 s = _mm_set1_ps(1.0f / det);
+
+			for (int c = 0; c < 3; ++c)
+			{
+				aDst[c] = _mm_mul_ps(aDst[c], s);
+			}
+		}
+	}
+
+	void Mat4_Mul(const Matrix& aA, const Matrix& aB, Matrix& aDst)
+	{
+		__m128 a[4], b[4];
+
+		Mat4_Load(aA, a);
+		Mat4_Load(aB, b);
+
+		for (int c = 0; c < 4; ++c)
+		{
+			b[c] = Mat4_MulColumn(a, b[c]);
+		}
+
+		Mat4_Store(b, aDst);
+	}
+
+	static void Mat4_MulBatch_SSE(const Matrix& aA, const Matrix* aB, Matrix* aDst, const size_t aCount)
+	{
+		__m128 a[4];
+		Mat4_Load(aA, a);
+
+		for (size_t i = 0; i < aCount; ++i)
+		{
+			__m128 b[4];
+			Mat4_Load(aB[i], b);
+
+			for (int c = 0; c < 4; ++c)
+			{
+				b[c] = Mat4_MulColumn(a, b[c]);
+			}
+
+			Mat4_Store(b, aDst[i]);
+		}
+	}
+
+	// two columns per register: in-lane broadcasts of B against A's columns repeated in both lanes
+	JSE_TARGET_AVX2 static void Mat4_MulBatch_AVX2(const Matrix& aA, const Matrix* aB, Matrix* aDst, const size_t aCount)
+	{
+		const float* a = &aA[0][0];
+		const __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a));
+		const __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 4));
+		const __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 8));
+		const __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 12));
+
+		for (size_t i = 0; i < aCount; ++i)
+		{
+			const float* b = &aB[i][0][0];
+			float* d = &aDst[i][0][0];
+
+			const __m256 b01 = _mm256_loadu_ps(b);
+			const __m256 b23 = _mm256_loadu_ps(b + 8);
+
+			__m256 r01 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, _MM_SHUFFLE(0, 0, 0, 0)));
+			__m256 r23 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, _MM_SHUFFLE(0, 0, 0, 0)));
+			r01 = _mm256_fmadd_ps(a1, _mm256_permute_ps(b01, _MM_SHUFFLE(1, 1, 1, 1)), r01);
+			r23 = _mm256_fmadd_ps(a1, _mm256_permute_ps(b23, _MM_SHUFFLE(1, 1, 1, 1)), r23);
+			r01 = _mm256_fmadd_ps(a2, _mm256_permute_ps(b01, _MM_SHUFFLE(2, 2, 2, 2)), r01);
+			r23 = _mm256_fmadd_ps(a2, _mm256_permute_ps(b23, _MM_SHUFFLE(2, 2, 2, 2)), r23);
+			r01 = _mm256_fmadd_ps(a3, _mm256_permute_ps(b01, _MM_SHUFFLE(3, 3, 3, 3)), r01);
+			r23 = _mm256_fmadd_ps(a3, _mm256_permute_ps(b23, _MM_SHUFFLE(3, 3, 3, 3)), r23);
+
+			_mm256_storeu_ps(d, r01);
+			_mm256_storeu_ps(d + 8, r23);
+		}
+	}
+
+	void Mat4_MulBatch(const Matrix& aA, const Matrix* aB, Matrix* aDst, const size_t aCount)
+	{
+		if (Cpu_HasAVX2())
+		{
+			Mat4_MulBatch_AVX2(aA, aB, aDst, aCount);
+		}
+		else
+		{
+			Mat4_MulBatch_SSE(aA, aB, aDst, aCount);
+		}
+	}
+
+	void Mat4_AffineInverse(const Matrix& aM, Matrix& aDst)
+	{
+		__m128 cols[3], inv[4];
+		float scale2;
+
+		const bool uniform = Mat4_LoadBasis(aM, cols, scale2);
+		const __m128 t = _mm_loadu_ps(&aM[3][0]);
+
+		// the inverse is the transpose of the inverse transpose
+		Mat4_InverseTranspose(cols, uniform, scale2, inv);
+		inv[3] = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(inv[0], inv[1], inv[2], inv[3]);
+
+		__m128 r = _mm_mul_ps(inv[0], _mm_shuffle_ps(t, t, _MM_SHUFFLE(0, 0, 0, 0)));
+		r = _mm_add_ps(r, _mm_mul_ps(inv[1], _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1))));
+		r = _mm_add_ps(r, _mm_mul_ps(inv[2], _mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 2, 2, 2))));
+
+		inv[3] = _mm_sub_ps(_mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f), r);
+
+		Mat4_Store(inv, aDst);
+	}
+
+	void Mat4_NormalMatrix(const Matrix& aM, Matrix& aDst)
+	{
+		__m128 cols[3], dst[4];
+		float scale2;
+
+		const bool uniform = Mat4_LoadBasis(aM, cols, scale2);
+
+		Mat4_InverseTranspose(cols, uniform, scale2, dst);
+		dst[3] = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+
+		Mat4_Store(dst, aDst);
+	}
+
+#else
+
+	void Mat4_Mul(const Matrix& aA, const Matrix& aB, Matrix& aDst)
+	{
+		aDst = aA * aB;
+	}
+
+	void Mat4_MulBatch(const Matrix& aA, const Matrix* aB, Matrix* aDst, const size_t aCount)
+	{
+		for (size_t i = 0; i < aCount; ++i)
+		{
+			aDst[i] = aA * aB[i];
+		}
+	}
+
+	void Mat4_AffineInverse(const Matrix& aM, Matrix& aDst)
+	{
+		aDst = glm::affineInverse(aM);
+	}
+
+	void Mat4_NormalMatrix(const Matrix& aM, Matrix& aDst)
+	{
+		const Matrix3x3 m(aM);
+		const float l0 = glm::dot(m[0], m[0]);
+
+		if (Mat4_IsUniform(l0, glm::dot(m[1], m[1]), glm::dot(m[2], m[2]), glm::dot(m[0], m[1]), glm::dot(m[0], m[2]), glm::dot(m[1], m[2])))
+		{
+			aDst = Matrix(m * (1.0f / l0));
+		}
+		else
+		{
+			aDst = Matrix(glm::inverseTranspose(m));
+		}
+	}
+
+#endif
+
+	void Mat4_NormalMatrixBatch(const Matrix* aM, Matrix* aDst, const size_t aCount)
+	{
+		for (size_t i = 0; i < aCount; ++i)
+		{
+			Mat4_NormalMatrix(aM[i], aDst[i]);
+		}
+	}
+
+	static float Mat4_MaxDiff(const std::vector<Matrix>& aA, const std::vector<Matrix>& aB)
+	{
+		float diff = 0.0f;
+
+		for (size_t i = 0; i < aA.size(); ++i)
+		{
+			for (int k = 0; k < 16; ++k)
+			{
+				diff = std::max(diff, std::abs((&aA[i][0][0])[k] - (&aB[i][0][0])[k]));
+			}
+		}
+
+		return diff;
+	}
+
+	template<class F>
+	static double Mat4_Time(const int aIterations, const F& aFunc)
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < aIterations; ++i)
+		{
+			aFunc();
+		}
+
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / aIterations;
+	}
+
+	void Mat4_Benchmark(const int aCount, const int aIterations)
+	{
+		// node transforms: rotation, translation and a uniform scale for every other one
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+		std::vector<Matrix> src(aCount);
+		for (int i = 0; i < aCount; ++i)
+		{
+			const Quat q = glm::normalize(Quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+			const Vector3f s = (i & 1) ? Vector3f(scale(rng)) : Vector3f(scale(rng), scale(rng), scale(rng));
+
+			src[i] = glm::mat4_cast(q);
+			src[i][0] *= s.x;
+			src[i][1] *= s.y;
+			src[i][2] *= s.z;
+			src[i][3] = Vector4f(dist(rng) * 10.0f, dist(rng) * 10.0f, dist(rng) * 10.0f, 1.0f);
+		}
+
+		const Matrix vp = glm::perspective(glm::radians(45.0f), 1.5f, 0.1f, 100.0f) * glm::inverse(src[0]);
+		std::vector<Matrix> ref(aCount), out(aCount);
+
+		double glmMs = Mat4_Time(aIterations, [&]() { for (int i = 0; i < aCount; ++i) ref[i] = vp * src[i]; });
+		double simdMs = Mat4_Time(aIterations, [&]() { Mat4_MulBatch(vp, src.data(), out.data(), src.size()); });
+		Info("Mat4 multiply x%d: glm %fms, %s %fms, max diff %g", aCount, glmMs, Cpu_GetSimdLevelName(Cpu_GetSimdLevel()), simdMs, Mat4_MaxDiff(ref, out));
+
+		glmMs = Mat4_Time(aIterations, [&]() { for (int i = 0; i < aCount; ++i) ref[i] = glm::affineInverse(src[i]); });
+		simdMs = Mat4_Time(aIterations, [&]() { for (int i = 0; i < aCount; ++i) Mat4_AffineInverse(src[i], out[i]); });
+		Info("Mat4 affine inverse x%d: glm %fms, simd %fms, max diff %g", aCount, glmMs, simdMs, Mat4_MaxDiff(ref, out));
+
+		// what the draw list did before
+		glmMs = Mat4_Time(aIterations, [&]() { for (int i = 0; i < aCount; ++i) ref[i] = Matrix3x3(glm::transpose(glm::inverse(src[i]))); });
+		simdMs = Mat4_Time(aIterations, [&]() { Mat4_NormalMatrixBatch(src.data(), out.data(), src.size()); });
+		Info("Mat4 normal matrix x%d: glm %fms, simd %fms, max diff %g", aCount, glmMs, simdMs, Mat4_MaxDiff(ref, out));
+	}
+}
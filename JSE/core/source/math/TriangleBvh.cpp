@@ -0,0 +1,535 @@
+#include <cmath>
+#include <algorithm>
+
+#include "math/TriangleBvh.hpp"
+#include "scene/Mesh3d.hpp"
+#include "system/Cpu.hpp"
+
+namespace jse {
+
+	// SAH bins per axis
+	static const int kBvhBins = 12;
+	// Nodes with up to kBvhLeafSize triangles are not split, up to kBvhMaxLeafSize if splitting does not pay off
+	static const u32 kBvhLeafSize = 4;
+	static const u32 kBvhMaxLeafSize = 16;
+	// Deeper nodes become leaves, bounds the traversal stacks
+	static const int kBvhMaxDepth = 60;
+
+	struct TriangleBvhBuildItem_t
+	{
+		u32 node;
+		int depth;
+	};
+
+	static Aabb_t TriangleBvh_RangeBounds(const std::vector<Aabb_t>& aTriBounds, const u32* aTriangles, const u32 aCount)
+	{
+		Aabb_t r;
+
+		for (u32 i = 0; i < aCount; ++i)
+		{
+			r = Aabb_Union(r, aTriBounds[aTriangles[i]]);
+		}
+
+		return r;
+	}
+
+	void TriangleBvh::Build(const VertexData* aVertices, const size_t aNumVertices, const unsigned short* aIndices, const size_t aNumIndices)
+	{
+		mNodes.clear();
+		mCorners.clear();
+		mTriangles.clear();
+		mSlots.clear();
+
+		const u32 numTris = u32(aNumIndices / 3);
+		if (!numTris || !aNumVertices)
+			return;
+
+		std::vector<Aabb_t> triBounds(numTris);
+		std::vector<Vector3f> centroids(numTris);
+
+		for (u32 t = 0; t < numTris; ++t)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				// out of range indices collapse to vertex 0, the loaders reject them anyway
+				const size_t idx = aIndices[3 * t + k];
+				Aabb_Add(triBounds[t], aVertices[idx < aNumVertices ? idx : 0].position);
+			}
+			centroids[t] = (triBounds[t].min + triBounds[t].max) * 0.5f;
+		}
+
+		mTriangles.resize(numTris);
+		for (u32 t = 0; t < numTris; ++t)
+		{
+			mTriangles[t] = t;
+		}
+
+		mNodes.reserve(2 * numTris);
+		mNodes.push_back({ TriangleBvh_RangeBounds(triBounds, mTriangles.data(), numTris), 0, numTris });
+
+		std::vector<TriangleBvhBuildItem_t> stack;
+		stack.push_back({ 0, 0 });
+
+		while (!stack.empty())
+		{
+			const TriangleBvhBuildItem_t item = stack.back();
+			stack.pop_back();
+
+			const Node_t node = mNodes[item.node];
+			if (node.count <= kBvhLeafSize || item.depth >= kBvhMaxDepth)
+				continue;
+
+			u32* tris = mTriangles.data() + node.first;
+
+			Aabb_t centroidBounds;
+			for (u32 i = 0; i < node.count; ++i)
+			{
+				Aabb_Add(centroidBounds, centroids[tris[i]]);
+			}
+
+			// binned SAH: cost of each bin boundary on each axis
+			float bestCost = FLT_MAX;
+			int bestAxis = -1;
+			int bestSplit = 0;
+
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+				if (extent <= 0.0f)
+					continue;
+
+				Aabb_t bins[kBvhBins];
+				u32 counts[kBvhBins] = {};
+				const float scale = kBvhBins / extent;
+
+				for (u32 i = 0; i < node.count; ++i)
+				{
+					const int b = std::min(kBvhBins - 1, int((centroids[tris[i]][axis] - centroidBounds.min[axis]) * scale));
+					bins[b] = Aabb_Union(bins[b], triBounds[tris[i]]);
+					counts[b]++;
+				}
+
+				float rightCost[kBvhBins];
+				Aabb_t right;
+				u32 rightCount = 0;
+				for (int b = kBvhBins - 1; b > 0; --b)
+				{
+					right = Aabb_Union(right, bins[b]);
+					rightCount += counts[b];
+					rightCost[b] = rightCount ? Aabb_HalfArea(right) * rightCount : 0.0f;
+				}
+
+				Aabb_t left;
+				u32 leftCount = 0;
+				for (int b = 1; b < kBvhBins; ++b)
+				{
+					left = Aabb_Union(left, bins[b - 1]);
+					leftCount += counts[b - 1];
+
+					const float cost = (leftCount ? Aabb_HalfArea(left) * leftCount : 0.0f) + rightCost[b];
+					if (leftCount && leftCount < node.count && cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestSplit = b;
+					}
+				}
+			}
+
+			u32 mid = node.count / 2;
+
+			if (bestAxis >= 0)
+			{
+				if (bestCost >= Aabb_HalfArea(node.bounds) * node.count && node.count <= kBvhMaxLeafSize)
+					continue;
+
+				const float minC = centroidBounds.min[bestAxis];
+				const float scale = kBvhBins / (centroidBounds.max[bestAxis] - minC);
+
+				mid = u32(std::partition(tris, tris + node.count, [&](const u32 aTri) {
+					return std::min(kBvhBins - 1, int((centroids[aTri][bestAxis] - minC) * scale)) < bestSplit;
+				}) - tris);
+			}
+			else if (node.count <= kBvhMaxLeafSize)
+			{
+				// all centroids in one point, nothing to split
+				continue;
+			}
+
+			const u32 left = u32(mNodes.size());
+			mNodes.push_back({ TriangleBvh_RangeBounds(triBounds, tris, mid), node.first, mid });
+			mNodes.push_back({ TriangleBvh_RangeBounds(triBounds, tris + mid, node.count - mid), node.first + mid, node.count - mid });
+
+			mNodes[item.node].first = left;
+			mNodes[item.node].count = 0;
+
+			stack.push_back({ left, item.depth + 1 });
+			stack.push_back({ left + 1, item.depth + 1 });
+		}
+
+		mCorners.resize(3 * size_t(numTris));
+		mSlots.resize(numTris);
+
+		for (u32 slot = 0; slot < numTris; ++slot)
+		{
+			const u32 t = mTriangles[slot];
+			mSlots[t] = slot;
+
+			for (int k = 0; k < 3; ++k)
+			{
+				const size_t idx = aIndices[3 * t + k];
+				mCorners[3 * slot + k] = aVertices[idx < aNumVertices ? idx : 0].position;
+			}
+		}
+	}
+
+	// Moeller-Trumbore, both sides
+	static inline bool TriangleBvh_Intersect(const Vector3f* aCorners, const Vector3f& aOrigin, const Vector3f& aDir, const float aTMax, float& aT, float& aU, float& aV)
+	{
+		const Vector3f e1 = aCorners[1] - aCorners[0];
+		const Vector3f e2 = aCorners[2] - aCorners[0];
+		const Vector3f p = glm::cross(aDir, e2);
+		const float det = glm::dot(e1, p);
+
+		if (det == 0.0f)
+			return false;
+
+		const float inv = 1.0f / det;
+		const Vector3f s = aOrigin - aCorners[0];
+		const float u = glm::dot(s, p) * inv;
+		if (u < 0.0f || u > 1.0f)
+			return false;
+
+		const Vector3f q = glm::cross(s, e1);
+		const float v = glm::dot(aDir, q) * inv;
+		if (v < 0.0f || u + v > 1.0f)
+			return false;
+
+		const float t = glm::dot(e2, q) * inv;
+		if (t < 0.0f || t >= aTMax)
+			return false;
+
+		aT = t;
+		aU = u;
+		aV = v;
+
+		return true;
+	}
+
+	bool TriangleBvh::RayCast(const Ray_t& aRay, TriangleHit_t& aHit, const bool aAnyHit) const
+	{
+		if (mNodes.empty())
+			return false;
+
+		struct Entry_t
+		{
+			u32 node;
+			float t;
+		};
+
+		const Vector3f invDir = Ray_InvDir(aRay.dir);
+		Entry_t stack[kBvhMaxDepth + 2];
+		int sp = 0;
+		int hitSlot = -1;
+		float t;
+
+		if (!Aabb_IntersectRay(mNodes[0].bounds, aRay.origin, invDir, aHit.t, t))
+			return false;
+
+		stack[sp++] = { 0, t };
+
+		while (sp)
+		{
+			const Entry_t e = stack[--sp];
+			if (e.t > aHit.t)
+				continue;
+
+			const Node_t& n = mNodes[e.node];
+
+			if (n.count)
+			{
+				for (u32 slot = n.first; slot < n.first + n.count; ++slot)
+				{
+					if (TriangleBvh_Intersect(&mCorners[3 * slot], aRay.origin, aRay.dir, aHit.t, aHit.t, aHit.u, aHit.v))
+					{
+						hitSlot = int(slot);
+						if (aAnyHit)
+						{
+							sp = 0;
+							break;
+						}
+					}
+				}
+				continue;
+			}
+
+			// nearer child on top of the stack
+			float tl, tr;
+			const bool hitL = Aabb_IntersectRay(mNodes[n.first].bounds, aRay.origin, invDir, aHit.t, tl);
+			const bool hitR = Aabb_IntersectRay(mNodes[n.first + 1].bounds, aRay.origin, invDir, aHit.t, tr);
+
+			if (hitL && hitR)
+			{
+				if (tl <= tr)
+				{
+					stack[sp++] = { n.first + 1, tr };
+					stack[sp++] = { n.first, tl };
+				}
+				else
+				{
+					stack[sp++] = { n.first, tl };
+					stack[sp++] = { n.first + 1, tr };
+				}
+			}
+			else if (hitL)
+			{
+				stack[sp++] = { n.first, tl };
+			}
+			else if (hitR)
+			{
+				stack[sp++] = { n.first + 1, tr };
+			}
+		}
+
+		if (hitSlot < 0)
+			return false;
+
+		aHit.triangle = int(mTriangles[hitSlot]);
+
+		return true;
+	}
+
+#if defined(JSE_SIMD_X86)
+
+	int TriangleBvh::RayCastPacket(const Ray_t* aRays, TriangleHit_t* aHits) const
+	{
+		if (mNodes.empty())
+			return 0;
+
+		float tmp[kRayPacketSize][10];
+		for (int i = 0; i < kRayPacketSize; ++i)
+		{
+			const Vector3f invDir = Ray_InvDir(aRays[i].dir);
+			const float lane[] = { aRays[i].origin.x, aRays[i].origin.y, aRays[i].origin.z, aRays[i].dir.x, aRays[i].dir.y, aRays[i].dir.z, invDir.x, invDir.y, invDir.z, aHits[i].t };
+			std::copy(lane, lane + 10, tmp[i]);
+		}
+
+		// rays as structure of arrays, one lane per ray
+		__m128 r[10];
+		for (int k = 0; k < 10; ++k)
+		{
+			r[k] = _mm_setr_ps(tmp[0][k], tmp[1][k], tmp[2][k], tmp[3][k]);
+		}
+
+		const __m128 ox = r[0], oy = r[1], oz = r[2];
+		const __m128 dx = r[3], dy = r[4], dz = r[5];
+		const __m128 ix = r[6], iy = r[7], iz = r[8];
+		__m128 t = r[9];
+		__m128 u = _mm_setzero_ps();
+		__m128 v = _mm_setzero_ps();
+		__m128i slots = _mm_set1_epi32(-1);
+
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		u32 stack[kBvhMaxDepth + 2];
+		int sp = 0;
+		stack[sp++] = 0;
+
+		while (sp)
+		{
+			const Node_t& n = mNodes[stack[--sp]];
+
+			// slab test of the node against every lane, rays already past their closest hit drop out
+			const __m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.bounds.min.x), ox), ix);
+			const __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.bounds.max.x), ox), ix);
+			const __m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.bounds.min.y), oy), iy);
+			const __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.bounds.max.y), oy), iy);
+			const __m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.bounds.min.z), oz), iz);
+			const __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.bounds.max.z), oz), iz);
+
+			const __m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx0, tx1), _mm_min_ps(ty0, ty1)), _mm_max_ps(_mm_min_ps(tz0, tz1), zero));
+			const __m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx0, tx1), _mm_max_ps(ty0, ty1)), _mm_min_ps(_mm_max_ps(tz0, tz1), t));
+
+			if (!_mm_movemask_ps(_mm_cmple_ps(tNear, tFar)))
+				continue;
+
+			if (!n.count)
+			{
+				stack[sp++] = n.first + 1;
+				stack[sp++] = n.first;
+				continue;
+			}
+
+			for (u32 slot = n.first; slot < n.first + n.count; ++slot)
+			{
+				const Vector3f* c = &mCorners[3 * slot];
+				const __m128 e1x = _mm_set1_ps(c[1].x - c[0].x), e1y = _mm_set1_ps(c[1].y - c[0].y), e1z = _mm_set1_ps(c[1].z - c[0].z);
+				const __m128 e2x = _mm_set1_ps(c[2].x - c[0].x), e2y = _mm_set1_ps(c[2].y - c[0].y), e2z = _mm_set1_ps(c[2].z - c[0].z);
+
+				const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+				const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+				const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+				const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+				const __m128 inv = _mm_div_ps(one, det);
+
+				const __m128 sx = _mm_sub_ps(ox, _mm_set1_ps(c[0].x));
+				const __m128 sy = _mm_sub_ps(oy, _mm_set1_ps(c[0].y));
+				const __m128 sz = _mm_sub_ps(oz, _mm_set1_ps(c[0].z));
+				const __m128 hu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv);
+
+				const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+				const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+				const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+				const __m128 hv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv);
+				const __m128 ht = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv);
+
+				__m128 hit = _mm_cmpneq_ps(det, zero);
+				hit = _mm_and_ps(hit, _mm_cmpge_ps(hu, zero));
+				hit = _mm_and_ps(hit, _mm_cmpge_ps(hv, zero));
+				hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(hu, hv), one));
+				hit = _mm_and_ps(hit, _mm_cmpge_ps(ht, zero));
+				hit = _mm_and_ps(hit, _mm_cmplt_ps(ht, t));
+
+				if (!_mm_movemask_ps(hit))
+					continue;
+
+				t = _mm_or_ps(_mm_and_ps(hit, ht), _mm_andnot_ps(hit, t));
+				u = _mm_or_ps(_mm_and_ps(hit, hu), _mm_andnot_ps(hit, u));
+				v = _mm_or_ps(_mm_and_ps(hit, hv), _mm_andnot_ps(hit, v));
+
+				const __m128i hitI = _mm_castps_si128(hit);
+				slots = _mm_or_si128(_mm_and_si128(hitI, _mm_set1_epi32(int(slot))), _mm_andnot_si128(hitI, slots));
+			}
+		}
+
+		float outT[kRayPacketSize], outU[kRayPacketSize], outV[kRayPacketSize];
+		int outSlot[kRayPacketSize];
+		_mm_storeu_ps(outT, t);
+		_mm_storeu_ps(outU, u);
+		_mm_storeu_ps(outV, v);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(outSlot), slots);
+
+		int mask = 0;
+		for (int i = 0; i < kRayPacketSize; ++i)
+		{
+			if (outSlot[i] < 0)
+				continue;
+
+			aHits[i].t = outT[i];
+			aHits[i].u = outU[i];
+			aHits[i].v = outV[i];
+			aHits[i].triangle = int(mTriangles[outSlot[i]]);
+			mask |= 1 << i;
+		}
+
+		return mask;
+	}
+
+#else
+
+	int TriangleBvh::RayCastPacket(const Ray_t* aRays, TriangleHit_t* aHits) const
+	{
+		int mask = 0;
+
+		for (int i = 0; i < kRayPacketSize; ++i)
+		{
+			if (RayCast(aRays[i], aHits[i]))
+			{
+				mask |= 1 << i;
+			}
+		}
+
+		return mask;
+	}
+
+#endif
+
+	void TriangleBvh::QueryAabb(const Aabb_t& aBox, std::vector<int>& aTriangles) const
+	{
+		if (mNodes.empty())
+			return;
+
+		u32 stack[kBvhMaxDepth + 2];
+		int sp = 0;
+		stack[sp++] = 0;
+
+		while (sp)
+		{
+			const Node_t& n = mNodes[stack[--sp]];
+			if (!Aabb_Overlaps(n.bounds, aBox))
+				continue;
+
+			if (!n.count)
+			{
+				stack[sp++] = n.first + 1;
+				stack[sp++] = n.first;
+				continue;
+			}
+
+			for (u32 slot = n.first; slot < n.first + n.count; ++slot)
+			{
+				Aabb_t tri;
+				for (int k = 0; k < 3; ++k)
+				{
+					Aabb_Add(tri, mCorners[3 * slot + k]);
+				}
+
+				if (Aabb_Overlaps(tri, aBox))
+				{
+					aTriangles.push_back(int(mTriangles[slot]));
+				}
+			}
+		}
+	}
+
+	void TriangleBvh::GetTriangle(const int aTriangle, Vector3f* aCorners) const
+	{
+		const Vector3f* c = &mCorners[3 * size_t(mSlots[aTriangle])];
+
+		aCorners[0] = c[0];
+		aCorners[1] = c[1];
+		aCorners[2] = c[2];
+	}
+
+	bool TriangleBvh_OverlapsAabb(const Vector3f* aCorners, const Aabb_t& aBox)
+	{
+		const Vector3f center = (aBox.min + aBox.max) * 0.5f;
+		const Vector3f extent = (aBox.max - aBox.min) * 0.5f;
+		const Vector3f v[3] = { aCorners[0] - center, aCorners[1] - center, aCorners[2] - center };
+		const Vector3f e[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+
+		// box faces
+		for (int i = 0; i < 3; ++i)
+		{
+			if (std::min(std::min(v[0][i], v[1][i]), v[2][i]) > extent[i] || std::max(std::max(v[0][i], v[1][i]), v[2][i]) < -extent[i])
+				return false;
+		}
+
+		// triangle plane
+		const Vector3f n = glm::cross(e[0], e[1]);
+		if (std::abs(glm::dot(n, v[0])) > glm::dot(glm::abs(n), extent))
+			return false;
+
+		// box axes crossed with the triangle edges
+		for (int i = 0; i < 3; ++i)
+		{
+			Vector3f axis(0.0f);
+			axis[i] = 1.0f;
+
+			for (int k = 0; k < 3; ++k)
+			{
+				const Vector3f a = glm::cross(axis, e[k]);
+				const float p0 = glm::dot(a, v[0]);
+				const float p1 = glm::dot(a, v[1]);
+				const float p2 = glm::dot(a, v[2]);
+				const float r = glm::dot(glm::abs(a), extent);
+
+				if (std::min(std::min(p0, p1), p2) > r || std::max(std::max(p0, p1), p2) < -r)
+					return false;
+			}
+		}
+
+		return true;
+	}
+}
@@ -25,6 +25,25 @@ namespace jse {
 		mTicksPerSec = a0;
 	}
 
+	void Animation::Compress(const AnimationCompressParams_t& aParams)
+	{
+		for (auto& it : mTracks)
+		{
+			it.Compress(aParams);
+		}
+	}
+
+	size_t Animation::GetMemorySize() const
+	{
+		size_t bytes = 0;
+		for (const auto& it : mTracks)
+		{
+			bytes += it.GetMemorySize();
+		}
+
+		return bytes;
+	}
+
 	AnimationTrack& Animation::CreateTrack(const String& aName, const AnimationTrackType aType, Node3d* aNode)
 	{
 		mTracks.emplace_back(aName, this, aType);
@@ -55,12 +74,4 @@ namespace jse {
 
 		return nullptr;
 	}
-
-	void Animation::ApplyFrame(const float aTime)
-	{
-		for (auto& it : mTracks)
-		{
-			it.ApplyOnNode(aTime, 1.0f);
-		}
-	}
 }
@@ -0,0 +1,261 @@
+#include <cmath>
+#include <stack>
+#include <algorithm>
+#include <glm/gtc/quaternion.hpp>
+
+#include "scene/AnimationInstance.hpp"
+#include "scene/AnimationTrack.hpp"
+#include "scene/Node3d.hpp"
+
+namespace jse {
+
+	static Keyframe AnimationInstance_Lerp(const AnimationTrackType aType, const Keyframe& aA, const Keyframe& aB, const float aT)
+	{
+		Keyframe r = aB;
+
+		if (aType == AnimationTrackType_Rotation)
+		{
+			const Quat b = glm::dot(aA.q, aB.q) < 0.0f ? -aB.q : aB.q;
+			r.q = glm::normalize(aA.q * (1.0f - aT) + b * aT);
+		}
+		else
+		{
+			r.v = aA.v + (aB.v - aA.v) * aT;
+		}
+
+		return r;
+	}
+
+	static Node3d* AnimationInstance_FindNode(Node3d* aRoot, const String& aName)
+	{
+		std::stack<Node3d*> stk;
+		stk.push(aRoot);
+
+		while (!stk.empty())
+		{
+			Node3d* node = stk.top();
+			stk.pop();
+
+			if (node->GetName() == aName)
+				return node;
+
+			for (auto it : node->GetChildren())
+			{
+				stk.push(it);
+			}
+		}
+
+		return nullptr;
+	}
+
+	AnimationInstance::AnimationInstance(Animation* aClip, AnimationPose& aPose, Node3d* aRoot)
+	{
+		mClip = aClip;
+		mTime = 0.0f;
+		mSpeed = 1.0f;
+		mWeight = 1.0f;
+		mLoop = true;
+		mLodRate = 1;
+		mLodPhase = 0;
+		mLodStagger = 0;
+		mLodSnap = true;
+		mHasValues = false;
+
+		const size_t numTracks = aClip->GetTrackNum();
+
+		mSlots.assign(numTracks, -1);
+		mCursors.assign(numTracks, -1);
+		mValues.resize(numTracks);
+
+		for (size_t i = 0; i < numTracks; ++i)
+		{
+			const AnimationTrack& track = aClip->GetTrack(i);
+			Node3d* node = aRoot ? AnimationInstance_FindNode(aRoot, track.GetName()) : track.GetNode();
+
+			if (node && track.GetKeyframeNum() > 0)
+			{
+				mSlots[i] = track.GetType() == AnimationTrackType_Weight ? aPose.AddMorphWeight(node, track.GetMorphTarget()) : aPose.AddNode(node);
+
+				if (std::find(mNodes.begin(), mNodes.end(), node) == mNodes.end())
+				{
+					mNodes.push_back(node);
+				}
+			}
+		}
+	}
+
+	void AnimationInstance::SetTime(const float aTime)
+	{
+		mTime = aTime;
+	}
+
+	void AnimationInstance::Advance(const float aTimeStep)
+	{
+		const float length = mClip->GetLength();
+
+		mTime += aTimeStep * mClip->GetTicksPerSec() * mSpeed;
+
+		if (mLoop && length > 0.0f)
+		{
+			mTime = std::fmod(mTime, length);
+			if (mTime < 0.0f)
+			{
+				mTime += length;
+			}
+		}
+		else
+		{
+			mTime = mTime < 0.0f ? 0.0f : (mTime > length ? length : mTime);
+		}
+	}
+
+	void AnimationInstance::Sample(AnimationPose& aPose, const AnimationBlendMode aMode)
+	{
+		StepLod(1);
+		SampleTracks(0, mSlots.size(), aMode);
+		Accumulate(aPose);
+	}
+
+	void AnimationInstance::SampleTracks(const size_t aFirst, const size_t aEnd, const AnimationBlendMode aMode)
+	{
+		if (mWeight <= 0.0f)
+			return;
+
+		const bool history = mLodRate > 1;
+
+		for (size_t i = aFirst; i < aEnd; ++i)
+		{
+			if (mSlots[i] < 0)
+				continue;
+
+			const AnimationTrack& track = mClip->GetTrack(i);
+			Keyframe& value = mValues[i];
+
+			if (history && !mLodSnap)
+			{
+				mPrevValues[i] = value;
+			}
+
+			value = track.Sample(mTime, mCursors[i]);
+
+			if (aMode == AnimationBlendMode_Additive)
+			{
+				const Keyframe ref = track.GetKeyValue(0);
+
+				switch (track.GetType())
+				{
+				case AnimationTrackType_Position:
+				case AnimationTrackType_Weight:
+					value.v -= ref.v;
+					break;
+				case AnimationTrackType_Rotation:
+					value.q = glm::inverse(ref.q) * value.q;
+					break;
+				case AnimationTrackType_Scale:
+					// a zero reference scale has no relative change, that component stays as it is
+					for (int c = 0; c < 3; ++c)
+					{
+						value.v[c] = ref.v[c] != 0.0f ? value.v[c] / ref.v[c] : 1.0f;
+					}
+					break;
+				default:
+					break;
+				}
+			}
+
+			if (history && mLodSnap)
+			{
+				mPrevValues[i] = value;
+			}
+		}
+	}
+
+	void AnimationInstance::Accumulate(AnimationPose& aPose) const
+	{
+		if (mWeight <= 0.0f || !mHasValues)
+			return;
+
+		const float t = float(mLodPhase + 1) / float(std::max(mLodRate, 1));
+
+		for (size_t i = 0; i < mSlots.size(); ++i)
+		{
+			if (mSlots[i] < 0)
+				continue;
+
+			const AnimationTrackType type = mClip->GetTrack(i).GetType();
+
+			if (mLodRate > 1)
+			{
+				aPose.Accumulate(mSlots[i], type, AnimationInstance_Lerp(type, mPrevValues[i], mValues[i], t), mWeight);
+			}
+			else
+			{
+				aPose.Accumulate(mSlots[i], type, mValues[i], mWeight);
+			}
+		}
+	}
+
+	bool AnimationInstance::StepLod(const int aRate)
+	{
+		if (aRate <= 0)
+		{
+			mLodRate = 0;
+			return false;
+		}
+
+		// resuming from a freeze or the first sample: no history to interpolate from
+		mLodSnap = !mHasValues || mLodRate == 0;
+
+		if (aRate > 1 && mLodRate == 1 && !mLodSnap)
+		{
+			// full rate so far: the current values are the history
+			mPrevValues = mValues;
+			mLodPhase = mLodStagger % aRate;
+		}
+		else if (aRate > 1 && mPrevValues.size() != mValues.size())
+		{
+			mPrevValues.resize(mValues.size());
+		}
+
+		mLodRate = aRate;
+
+		if (mLodSnap)
+		{
+			// sample now, the following samples fall on this instance's staggered frames
+			mLodPhase = mLodStagger % aRate;
+			mHasValues = true;
+			return true;
+		}
+
+		mLodPhase = (mLodPhase + 1) % aRate;
+
+		if (mLodPhase == 0)
+		{
+			mHasValues = true;
+			return true;
+		}
+
+		return false;
+	}
+
+	bool AnimationInstance::GetBounds(Vector3f& aCenter, float& aRadius) const
+	{
+		if (mNodes.empty())
+			return false;
+
+		Vector3f lo = mNodes[0]->GetWorldPosition();
+		Vector3f hi = lo;
+
+		for (const Node3d* node : mNodes)
+		{
+			const Vector3f p = node->GetWorldPosition();
+			lo = glm::min(lo, p);
+			hi = glm::max(hi, p);
+		}
+
+		aCenter = (lo + hi) * 0.5f;
+		aRadius = glm::length(hi - lo) * 0.5f;
+
+		return true;
+	}
+}
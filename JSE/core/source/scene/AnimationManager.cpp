@@ -1,12 +1,19 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
 #include "scene/AnimationManager.hpp"
 
 namespace jse {
 
-	AnimationManager::AnimationManager()
+	AnimationManager::AnimationManager(ThreadPool& aPool) : mPool(aPool)
 	{
-		mFrame = 0.0;
-		mMaxFrameTime = 0.0f;
-		mTicksPerSec = 1.0f;
+		SetLodView(Matrix(1.0f), Matrix(1.0f));
+		mNumPlayed = 0;
+		mSampledTracks = 0;
+		mActiveTracks = 0;
+
+		AddLayer(AnimationBlendMode_Override, 1.0f);
 	}
 
 	AnimationManager::~AnimationManager()
@@ -16,23 +23,159 @@ namespace jse {
 	void AnimationManager::AddAnimation(Animation* aX)
 	{
 		mAnimVec.push_back(aX);
-		mMaxFrameTime = mMaxFrameTime < aX->GetLength() ? aX->GetLength() : mMaxFrameTime;
-		mTicksPerSec = aX->GetTicksPerSec();
+		Play(aX);
 	}
 
-	void AnimationManager::UpdateState(const float aFrameStep)
+	int AnimationManager::AddLayer(const AnimationBlendMode aMode, const float aWeight)
+	{
+		mLayers.emplace_back();
+
+		AnimationLayer_t& layer = mLayers.back();
+		layer.mode = aMode;
+		layer.weight = aWeight;
+
+		return int(mLayers.size()) - 1;
+	}
+
+	void AnimationManager::SetLayerWeight(const int aLayer, const float aWeight)
 	{
-		for (auto it : mAnimVec)
+		assert(aLayer >= 0 && aLayer < int(mLayers.size()));
+
+		mLayers[aLayer].weight = aWeight;
+	}
+
+	AnimationInstance* AnimationManager::Play(Animation* aClip, const int aLayer, const float aWeight, Node3d* aRoot)
+	{
+		assert(aLayer >= 0 && aLayer < int(mLayers.size()));
+
+		auto& instances = mLayers[aLayer].instances;
+
+		instances.push_back(std::make_unique<AnimationInstance>(aClip, mPose, aRoot));
+		instances.back()->SetWeight(aWeight);
+		instances.back()->SetLodStagger(mNumPlayed++);
+
+		return instances.back().get();
+	}
+
+	void AnimationManager::Stop(AnimationInstance* aInstance)
+	{
+		for (auto& layer : mLayers)
 		{
-			if (it->GetLength() >= mFrame) it->ApplyFrame(mFrame);
+			auto it = std::find_if(layer.instances.begin(), layer.instances.end(), [aInstance](const std::unique_ptr<AnimationInstance>& a) { return a.get() == aInstance; });
+			if (it != layer.instances.end())
+			{
+				layer.instances.erase(it);
+				return;
+			}
 		}
+	}
+
+	void AnimationManager::SetLodView(const Matrix& aView, const Matrix& aProj)
+	{
+		mLodFrustum.SetViewProj(aProj * aView);
+
+		mLodViewPos = Vector3f(glm::inverse(aView)[3]);
+		mLodProjScale = aProj[1][1];
+	}
+
+	int AnimationManager::GetLodRate(const AnimationInstance& aInstance) const
+	{
+		Vector3f center;
+		float radius;
+
+		if (!mLodParams.enabled || !aInstance.GetBounds(center, radius))
+			return 1;
 
-		mFrame += aFrameStep * mTicksPerSec;
+		radius += mLodParams.boundsPadding;
+
+		if (mLodParams.freezeOffscreen)
+		{
+			if (mLodFrustum.TestSphere(center, radius) == BoundingVolume::TEST_OUTSIDE)
+				return 0;
+		}
 
-		if (mFrame > mMaxFrameTime)
-			mFrame -= mMaxFrameTime;
+		const Vector3f d = center - mLodViewPos;
+		const float dist2 = glm::dot(d, d);
 
+		if (dist2 <= radius * radius)
+			return 1;
+
+		// fraction of the viewport height the bounds cover
+		const float size = radius * mLodProjScale / std::sqrt(dist2 - radius * radius);
+
+		int rate = 1;
+		for (int i = 0; i < 3 && size < mLodParams.screenSize[i]; ++i)
+		{
+			rate = 2 << i;
+		}
+
+		return rate;
 	}
 
+	void AnimationManager::UpdateState(const float aFrameStep)
+	{
+		mJobs.clear();
+		mSampledTracks = 0;
+		mActiveTracks = 0;
+
+		for (auto& layer : mLayers)
+		{
+			if (layer.weight <= 0.0f)
+				continue;
+
+			for (auto& it : layer.instances)
+			{
+				const size_t numTracks = it->GetTrackNum();
+
+				if (it->GetWeight() <= 0.0f)
+					continue;
+
+				mActiveTracks += numTracks;
+
+				if (!it->StepLod(GetLodRate(*it)))
+					continue;
+
+				mSampledTracks += numTracks;
 
+				for (size_t first = 0; first < numTracks; first += kAnimSampleBlock)
+				{
+					mJobs.push_back({ it.get(), first, std::min(first + kAnimSampleBlock, numTracks), layer.mode });
+				}
+			}
+		}
+
+		mPool.ParallelFor(mJobs.size(), [this](size_t aIdx) {
+			const SampleJob_t& job = mJobs[aIdx];
+			job.instance->SampleTracks(job.first, job.end, job.mode);
+		});
+
+		// merge: sampled values summed per layer, layers blended over the rest pose,
+		// then one compose per animated node
+		mPose.Reset();
+
+		for (auto& layer : mLayers)
+		{
+			if (layer.weight <= 0.0f || layer.instances.empty())
+				continue;
+
+			mPose.BeginLayer();
+
+			for (auto& it : layer.instances)
+			{
+				it->Accumulate(mPose);
+			}
+
+			mPose.EndLayer(layer.mode, layer.weight, mPool);
+		}
+
+		mPose.Apply();
+
+		for (auto& layer : mLayers)
+		{
+			for (auto& it : layer.instances)
+			{
+				it->Advance(aFrameStep);
+			}
+		}
+	}
 }
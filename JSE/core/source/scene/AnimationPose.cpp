@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <glm/gtx/matrix_decompose.hpp>
+
+#include "scene/AnimationPose.hpp"
+#include "scene/Node3d.hpp"
+
+namespace jse {
+
+	static Quat AnimationPose_Nlerp(const Quat& aA, const Quat& aB, const float aT)
+	{
+		// shortest arc
+		const Quat b = glm::dot(aA, aB) < 0.0f ? -aB : aB;
+
+		return glm::normalize(aA * (1.0f - aT) + b * aT);
+	}
+
+	int AnimationPose::AddNode(Node3d* aNode)
+	{
+		auto it = mSlotByNode.find(aNode);
+		if (it != mSlotByNode.end())
+			return it->second;
+
+		PoseTransform_t rest;
+		Vector3f skew;
+		Vector4f perspective;
+
+		glm::decompose(aNode->GetModelMatrix(), rest.scale, rest.rotation, rest.translation, skew, perspective);
+
+		const int slot = int(mNodes.size());
+
+		mNodes.push_back(aNode);
+		mRest.push_back(rest);
+		mTransforms.push_back(rest);
+		mWritten.push_back(0);
+		mLayer.push_back(rest);
+		mLayerWeights.push_back(Vector3f(0.0f));
+		mSlotByNode[aNode] = slot;
+
+		return slot;
+	}
+
+	int AnimationPose::AddMorphWeight(Node3d* aNode, const int aTarget)
+	{
+		const auto key = std::make_pair(static_cast<const Node3d*>(aNode), aTarget);
+
+		auto it = mWeightSlots.find(key);
+		if (it != mWeightSlots.end())
+			return it->second;
+
+		const int slot = int(mWeightNodes.size());
+		const float rest = aNode->GetMorphWeight(size_t(aTarget));
+
+		mWeightNodes.push_back(aNode);
+		mWeightTargets.push_back(aTarget);
+		mWeightRest.push_back(rest);
+		mWeights.push_back(rest);
+		mWeightWritten.push_back(0);
+		mWeightLayer.push_back(0.0f);
+		mWeightLayerSum.push_back(0.0f);
+		mWeightSlots[key] = slot;
+
+		return slot;
+	}
+
+	int AnimationPose::GetSlot(const Node3d* aNode) const
+	{
+		auto it = mSlotByNode.find(aNode);
+
+		return it != mSlotByNode.end() ? it->second : -1;
+	}
+
+	void AnimationPose::Reset()
+	{
+		mTransforms = mRest;
+		std::fill(mWritten.begin(), mWritten.end(), 0);
+		mWeights = mWeightRest;
+		std::fill(mWeightWritten.begin(), mWeightWritten.end(), 0);
+	}
+
+	void AnimationPose::BeginLayer()
+	{
+		const PoseTransform_t zero = { Vector3f(0.0f), Quat(0.0f, 0.0f, 0.0f, 0.0f), Vector3f(0.0f) };
+
+		std::fill(mLayer.begin(), mLayer.end(), zero);
+		std::fill(mLayerWeights.begin(), mLayerWeights.end(), Vector3f(0.0f));
+		std::fill(mWeightLayer.begin(), mWeightLayer.end(), 0.0f);
+		std::fill(mWeightLayerSum.begin(), mWeightLayerSum.end(), 0.0f);
+	}
+
+	void AnimationPose::Accumulate(const int aSlot, const AnimationTrackType aChannel, const Keyframe& aValue, const float aWeight)
+	{
+		if (aChannel == AnimationTrackType_Weight)
+		{
+			// aSlot is a weight slot
+			mWeightLayer[aSlot] += aValue.v.x * aWeight;
+			mWeightLayerSum[aSlot] += aWeight;
+			return;
+		}
+
+		PoseTransform_t& sum = mLayer[aSlot];
+		Vector3f& weights = mLayerWeights[aSlot];
+
+		switch (aChannel)
+		{
+		case AnimationTrackType_Position:
+			sum.translation += aValue.v * aWeight;
+			weights.x += aWeight;
+			break;
+		case AnimationTrackType_Rotation:
+			// same hemisphere as the sum so far, the normalize in EndLayer makes it an nlerp
+			sum.rotation += (glm::dot(sum.rotation, aValue.q) < 0.0f ? -aValue.q : aValue.q) * aWeight;
+			weights.y += aWeight;
+			break;
+		case AnimationTrackType_Scale:
+			sum.scale += aValue.v * aWeight;
+			weights.z += aWeight;
+			break;
+		default:
+			break;
+		}
+	}
+
+	void AnimationPose::BlendSlot(const size_t aSlot, const bool aAdditive, const float aWeight)
+	{
+		const Vector3f& weights = mLayerWeights[aSlot];
+
+		if (weights.x <= 0.0f && weights.y <= 0.0f && weights.z <= 0.0f)
+			return;
+
+		const PoseTransform_t& sum = mLayer[aSlot];
+		PoseTransform_t& pose = mTransforms[aSlot];
+
+		mWritten[aSlot] = 1;
+
+		if (weights.x > 0.0f)
+		{
+			const Vector3f t = sum.translation / weights.x;
+			const float f = aWeight * std::min(weights.x, 1.0f);
+
+			pose.translation = aAdditive ? pose.translation + t * f : glm::mix(pose.translation, t, f);
+		}
+
+		if (weights.y > 0.0f)
+		{
+			const Quat q = glm::normalize(sum.rotation);
+			const float f = aWeight * std::min(weights.y, 1.0f);
+
+			pose.rotation = aAdditive ? glm::normalize(pose.rotation * AnimationPose_Nlerp(Quat(1.0f, 0.0f, 0.0f, 0.0f), q, f)) : AnimationPose_Nlerp(pose.rotation, q, f);
+		}
+
+		if (weights.z > 0.0f)
+		{
+			const Vector3f s = sum.scale / weights.z;
+			const float f = aWeight * std::min(weights.z, 1.0f);
+
+			pose.scale = aAdditive ? pose.scale * glm::mix(Vector3f(1.0f), s, f) : glm::mix(pose.scale, s, f);
+		}
+	}
+
+	void AnimationPose::EndLayer(const AnimationBlendMode aMode, const float aWeight, ThreadPool& aPool)
+	{
+		const bool additive = aMode == AnimationBlendMode_Additive;
+		const size_t numBlocks = (mNodes.size() + kPoseBlendBlock - 1) / kPoseBlendBlock;
+
+		aPool.ParallelFor(numBlocks, [this, additive, aWeight](size_t aBlock) {
+			const size_t end = std::min(mNodes.size(), (aBlock + 1) * kPoseBlendBlock);
+
+			for (size_t i = aBlock * kPoseBlendBlock; i < end; ++i)
+			{
+				BlendSlot(i, additive, aWeight);
+			}
+		});
+
+		for (size_t i = 0; i < mWeightNodes.size(); ++i)
+		{
+			const float sum = mWeightLayerSum[i];
+
+			if (sum <= 0.0f)
+				continue;
+
+			const float w = mWeightLayer[i] / sum;
+			const float f = aWeight * std::min(sum, 1.0f);
+
+			mWeights[i] = additive ? mWeights[i] + w * f : mWeights[i] + (w - mWeights[i]) * f;
+			mWeightWritten[i] = 1;
+		}
+	}
+
+	void AnimationPose::Apply()
+	{
+		for (size_t i = 0; i < mNodes.size(); ++i)
+		{
+			if (!mWritten[i])
+				continue;
+
+			const PoseTransform_t& t = mTransforms[i];
+
+			mNodes[i]->SetLocalTransform(t.translation, t.rotation, t.scale);
+		}
+
+		for (size_t i = 0; i < mWeightNodes.size(); ++i)
+		{
+			if (mWeightWritten[i])
+			{
+				mWeightNodes[i]->SetMorphWeight(size_t(mWeightTargets[i]), mWeights[i]);
+			}
+		}
+	}
+}
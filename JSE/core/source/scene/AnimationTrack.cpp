@@ -1,5 +1,8 @@
 #include <glm/gtc/quaternion.hpp>
 #include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <random>
 #include "system/SystemTypes.hpp"
 #include "system/Logger.hpp"
 #include "graphics/GraphicsTypes.hpp"
@@ -19,11 +22,15 @@ namespace jse
 		mMaxFrameTime = 0.0f;
 		mUseLinearInterp = true;
 		mNode = nullptr;
+		mMorphTarget = 0;
+		mRangeMin = Vector3f(0.0f);
+		mRangeExtent = Vector3f(0.0f);
+		mQuantized = false;
 	}
 	
 	Keyframe& AnimationTrack::CreateKeyframe(const float aTime)
 	{
-		assert(mMaxFrameTime <= aTime);
+		assert(mMaxFrameTime <= aTime && !mQuantized);
 
 		Keyframe n;
 
@@ -31,6 +38,7 @@ namespace jse
 
 
 		mKeyframes.push_back(n);
+		mKeyTimes.push_back(aTime);
 		mMaxFrameTime = aTime;
 
 		return mKeyframes.back();
@@ -39,58 +47,277 @@ namespace jse
 	void AnimationTrack::Clear()
 	{
 		mKeyframes.clear();
+		mKeyTimes.clear();
+		mPacked.clear();
+		mQuantized = false;
 		mMaxFrameTime = 0.0;
 	}
 	Keyframe& AnimationTrack::GetKey(const int aIndex)
 	{
-		assert(aIndex >= 0 && aIndex < mKeyframes.size());
+		assert(aIndex >= 0 && aIndex < int(mKeyframes.size()) && !mQuantized);
 
 		return mKeyframes[aIndex];
 	}
 
-	void AnimationTrack::ApplyOnNode(const float aTime, const float aWeight, const bool aLoop)
+	// components of the smallest three are within +-1/sqrt(2)
+	static const float kQuatComponentScale = 1.41421356f;
+
+	static void AnimationTrack_PackQuat(const Quat& aQ, u16* aOut)
 	{
-		if (mKeyframes.empty() || !mNode)
-			return;
+		const Quat q = glm::normalize(aQ);
+		const float c[4] = { q.x, q.y, q.z, q.w };
 
-		Keyframe Frame = GetInterpolatedKeyframe(aTime, aLoop);
+		int largest = 0;
+		for (int i = 1; i < 4; ++i)
+		{
+			if (std::abs(c[i]) > std::abs(c[largest]))
+			{
+				largest = i;
+			}
+		}
 
-		//Quat rot = glm::normalize( glm::slerp(Quat(), Frame.rotation, aWeight) );
-		//Vector3f trans = aWeight * Frame.position;
+		// q and -q are the same rotation, the dropped component is always positive
+		const float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
 
-		if (mType == AnimationTrackType_Position)
+		u64 bits = u64(largest) << 45;
+		int shift = 30;
+		for (int i = 0; i < 4; ++i)
 		{
-			//mNode->SetPosition(Vector3f(0.0f));
-			mNode->SetPosition(Frame.v);
+			if (i == largest)
+				continue;
+
+			const float v = std::min(1.0f, std::max(-1.0f, c[i] * sign * kQuatComponentScale));
+			bits |= u64(std::lround((v * 0.5f + 0.5f) * 32767.0f)) << shift;
+			shift -= 15;
 		}
-		else if (mType == AnimationTrackType_Rotation)
+
+		aOut[0] = u16(bits >> 32);
+		aOut[1] = u16(bits >> 16);
+		aOut[2] = u16(bits);
+	}
+
+	static Quat AnimationTrack_UnpackQuat(const u16* aIn)
+	{
+		const u64 bits = u64(aIn[0]) << 32 | u64(aIn[1]) << 16 | u64(aIn[2]);
+		const int largest = int(bits >> 45) & 3;
+
+		float c[4];
+		float sum = 0.0f;
+		int shift = 30;
+		for (int i = 0; i < 4; ++i)
 		{
-			//mNode->SetRotation(Quat(1, 0, 0, 0));
-			mNode->AddRotation(Frame.q);
-			mNode->UpdateMatrix();
+			if (i == largest)
+				continue;
+
+			c[i] = (float((bits >> shift) & 0x7FFF) / 32767.0f * 2.0f - 1.0f) / kQuatComponentScale;
+			sum += c[i] * c[i];
+			shift -= 15;
 		}
-				
-		//Info("Time: %.2f, Pos: [%.2f,%.2f,%.2f]", aTime, Frame.position.x, Frame.position.y, Frame.position.z);
+
+		c[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+
+		return Quat(c[3], c[0], c[1], c[2]);
 	}
 
-	Keyframe AnimationTrack::GetInterpolatedKeyframe_Linear(const float aTime, bool aLoop)
+	Keyframe AnimationTrack::GetKeyValue(const int aIndex) const
 	{
+		assert(aIndex >= 0 && aIndex < int(mKeyTimes.size()));
+
+		if (!mQuantized)
+			return mKeyframes[aIndex];
+
 		Keyframe r;
-		r.time = aTime;
+		const u16* p = &mPacked[aIndex * 3];
 
-		Keyframe kA, kB;
-		int keyIndex = -1;
+		if (mType == AnimationTrackType_Rotation)
+		{
+			r.q = AnimationTrack_UnpackQuat(p);
+		}
+		else
+		{
+			r.v = mRangeMin + Vector3f(p[0], p[1], p[2]) * (mRangeExtent / 65535.0f);
+		}
+
+		r.time = mKeyTimes[aIndex];
+
+		return r;
+	}
+
+	static Keyframe AnimationTrack_Lerp(const AnimationTrackType aType, const Keyframe& aA, const Keyframe& aB, const float aT)
+	{
+		// same as the linear sampling path
+		Keyframe r;
+
+		if (aType == AnimationTrackType_Rotation)
+		{
+			r.q = glm::normalize(glm::slerp(aA.q, aB.q, aT));
+		}
+		else
+		{
+			r.v = LinearInterp(aA.v, aB.v, aT);
+		}
 
-		const float T = GetKeyframesAtTime(aTime, kA, kB, keyIndex, aLoop);
+		return r;
+	}
 
-		if (mType == AnimationTrackType_Position)
+	float AnimationTrack_GetError(const AnimationTrackType aType, const Keyframe& aA, const Keyframe& aB)
+	{
+		if (aType == AnimationTrackType_Rotation)
 		{
-			if (mKeyframes.empty())
+			// acos of the dot product has no precision left for small angles
+			const Quat d = glm::inverse(glm::normalize(aA.q)) * glm::normalize(aB.q);
+
+			return 2.0f * std::atan2(glm::length(Vector3f(d.x, d.y, d.z)), std::abs(d.w));
+		}
+
+		return glm::length(aA.v - aB.v);
+	}
+
+	void AnimationTrack::Reduce(const float aMaxError)
+	{
+		assert(!mQuantized);
+
+		const size_t numKeys = mKeyframes.size();
+		if (numKeys < 3)
+			return;
+
+		// every key between aFirst and aLast within aMaxError of the segment. Keys sharing
+		// their time with a neighbour (STEP exports, discontinuities) cannot be measured and are kept
+		auto reproduces = [this, aMaxError](const size_t aFirst, const size_t aLast) {
+			const Keyframe& a = mKeyframes[aFirst];
+			const Keyframe& b = mKeyframes[aLast];
+			const float dt = b.time - a.time;
+
+			if (dt <= 0.0f)
+				return false;
+
+			for (size_t k = aFirst + 1; k < aLast; ++k)
+			{
+				if (mKeyframes[k].time <= mKeyframes[k - 1].time || mKeyframes[k + 1].time <= mKeyframes[k].time)
+					return false;
+
+				const float t = (mKeyframes[k].time - a.time) / dt;
+
+				if (AnimationTrack_GetError(mType, AnimationTrack_Lerp(mType, a, b, t), mKeyframes[k]) > aMaxError)
+					return false;
+			}
+
+			return true;
+		};
+
+		tKeyframeVec kept;
+		kept.push_back(mKeyframes[0]);
+
+		size_t first = 0;
+		while (first < numKeys - 1)
+		{
+			size_t last = first + 1;
+			while (last + 1 < numKeys && last + 1 - first <= size_t(kMaxReduceSpan) && reproduces(first, last + 1))
+			{
+				last++;
+			}
+
+			kept.push_back(mKeyframes[last]);
+			first = last;
+		}
+
+		mKeyframes.swap(kept);
+		mKeyframes.shrink_to_fit();
+
+		mKeyTimes.resize(mKeyframes.size());
+		for (size_t i = 0; i < mKeyframes.size(); ++i)
+		{
+			mKeyTimes[i] = mKeyframes[i].time;
+		}
+		mKeyTimes.shrink_to_fit();
+	}
+
+	void AnimationTrack::Quantize()
+	{
+		if (mQuantized || mKeyframes.empty())
+			return;
+
+		mPacked.resize(mKeyframes.size() * 3);
+
+		if (mType == AnimationTrackType_Rotation)
+		{
+			for (size_t i = 0; i < mKeyframes.size(); ++i)
 			{
-				r.v = vec3(0.f);
-				return r;
+				AnimationTrack_PackQuat(mKeyframes[i].q, &mPacked[i * 3]);
+			}
+		}
+		else
+		{
+			Vector3f minValue = mKeyframes[0].v;
+			Vector3f maxValue = mKeyframes[0].v;
+			for (const auto& k : mKeyframes)
+			{
+				minValue = glm::min(minValue, k.v);
+				maxValue = glm::max(maxValue, k.v);
+			}
+
+			mRangeMin = minValue;
+			mRangeExtent = maxValue - minValue;
+
+			for (size_t i = 0; i < mKeyframes.size(); ++i)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					const float n = mRangeExtent[c] > 0.0f ? (mKeyframes[i].v[c] - minValue[c]) / mRangeExtent[c] : 0.0f;
+					mPacked[i * 3 + c] = u16(std::lround(n * 65535.0f));
+				}
 			}
+		}
+
+		tKeyframeVec().swap(mKeyframes);
+		mQuantized = true;
+	}
+
+	void AnimationTrack::Compress(const AnimationCompressParams_t& aParams)
+	{
+		if (aParams.reduce && !mQuantized)
+		{
+			static_assert(AnimationTrackType_LastEnum == 4, "error bound per track type");
+			const float maxError[] = { aParams.maxPositionError, aParams.maxRotationError, aParams.maxScaleError, aParams.maxWeightError };
 
+			Reduce(maxError[mType]);
+		}
+
+		if (aParams.quantize)
+		{
+			Quantize();
+		}
+	}
+
+	size_t AnimationTrack::GetMemorySize() const
+	{
+		return mKeyTimes.capacity() * sizeof(float) + mKeyframes.capacity() * sizeof(Keyframe) + mPacked.capacity() * sizeof(u16);
+	}
+
+	Keyframe AnimationTrack::Sample(const float aTime, int& aCursor) const
+	{
+		return GetInterpolatedKeyframe(aTime, aCursor);
+	}
+
+	Keyframe AnimationTrack::GetInterpolatedKeyframe_Linear(const float aTime, int& aCursor) const
+	{
+		Keyframe r;
+		r.time = aTime;
+
+		if (mKeyTimes.empty())
+		{
+			r.v = vec3(0.f);
+			return r;
+		}
+
+		int indexA, indexB;
+		const float T = GetKeyframesAtTime(aTime, indexA, indexB, aCursor);
+
+		const Keyframe kA = GetKeyValue(indexA);
+		const Keyframe kB = GetKeyValue(indexB);
+
+		if (mType != AnimationTrackType_Rotation)
+		{
 			if (T == 0.0f)
 			{
 				r.v = kA.v;
@@ -100,7 +327,7 @@ namespace jse
 				r.v = LinearInterp(kA.v, kB.v, T);
 			}
 		}
-		else if (mType == AnimationTrackType_Rotation)
+		else
 		{
 			//Info("T != 0.0 (%.4f)", T);
 			if (T == 0.0f)
@@ -115,27 +342,31 @@ namespace jse
 		return r;
 	}
 
-	Keyframe AnimationTrack::GetInterpolatedKeyframe(const float aTime, bool aLoop)
+	Keyframe AnimationTrack::GetInterpolatedKeyframe(const float aTime, int& aCursor) const
 	{
 		if (mUseLinearInterp)
-			return GetInterpolatedKeyframe_Linear(aTime, aLoop);
+			return GetInterpolatedKeyframe_Linear(aTime, aCursor);
 
 		Keyframe r;
 		r.time = aTime;
 
-		Keyframe kA, kB;
-		int keyIndex = -1;
+		if (mKeyTimes.empty())
+		{
+			r.v = vec3(0.f);
+			return r;
+		}
 
-		const float T = GetKeyframesAtTime(aTime, kA, kB, keyIndex, aLoop);
+		int indexA, indexB;
+		const float T = GetKeyframesAtTime(aTime, indexA, indexB, aCursor);
 
-		if (mType == AnimationTrackType_Position)
-		{
-			if (mKeyframes.empty())
-			{
-				r.v = vec3(0.f);
-				return r;
-			}
+		const Keyframe kA = GetKeyValue(indexA);
+		const Keyframe kB = GetKeyValue(indexB);
+
+		// outer keys of the Hermite segment, linear on the first and last segment
+		const bool linear = indexA == 0 || indexB == int(mKeyTimes.size()) - 1;
 
+		if (mType != AnimationTrackType_Rotation)
+		{
 			if (T == 0.0f)
 			{
 				r.v = kA.v;
@@ -143,17 +374,17 @@ namespace jse
 			else
 			{
 				//Info("T != 0.0 (%.4f)", T);
-				if (keyIndex == 0 || keyIndex == mKeyframes.size() - 1)
+				if (linear)
 				{
 					r.v = LinearInterp(kA.v, kB.v, T);
 				}
 				else
 				{
-					r.v = HermiteInterp(mKeyframes[keyIndex - 1].v, kA.v, kB.v, mKeyframes[keyIndex + 1].v, T, 0.f, 0.f);
+					r.v = HermiteInterp(GetKeyValue(indexA - 1).v, kA.v, kB.v, GetKeyValue(indexB + 1).v, T, 0.f, 0.f);
 				}
 			}
 		}
-		else if (mType == AnimationTrackType_Rotation)
+		else
 		{
 			//Info("T != 0.0 (%.4f)", T);
 			if (T == 0.0f)
@@ -162,13 +393,13 @@ namespace jse
 			}
 			else
 			{
-				if (keyIndex == 0 || keyIndex == mKeyframes.size() - 1)
+				if (linear)
 				{
 					r.q = glm::slerp(kA.q, kB.q, T);
 				}
 				else
 				{
-					r.q = HermiteInterp(mKeyframes[keyIndex - 1].q, kA.q, kB.q, mKeyframes[keyIndex + 1].q, T, 0.f, 0.f);
+					r.q = HermiteInterp(GetKeyValue(indexA - 1).q, kA.q, kB.q, GetKeyValue(indexB + 1).q, T, 0.f, 0.f);
 				}
 
 				r.q = glm::normalize(r.q);
@@ -178,7 +409,29 @@ namespace jse
 		return r;
 	}
 
-	float AnimationTrack::GetKeyframesAtTime(const float aTime, Keyframe& aKeyframeA, Keyframe& aKeyframeB, int& aIndex, const bool aLoop)
+	int AnimationTrack::FindKey(const float aTime, int& aCursor) const
+	{
+		const int numKeys = int(mKeyTimes.size());
+		const int cursor = aCursor;
+
+		// playback moves forward by at most a segment per frame
+		if (cursor >= 0 && cursor < numKeys - 1 && mKeyTimes[cursor] <= aTime)
+		{
+			if (aTime < mKeyTimes[cursor + 1])
+				return cursor;
+
+			if (cursor + 2 < numKeys && aTime < mKeyTimes[cursor + 2])
+				return aCursor = cursor + 1;
+		}
+
+		// last key at or before aTime, -1 before the first one
+		const auto it = std::upper_bound(mKeyTimes.begin(), mKeyTimes.end(), aTime);
+		aCursor = int(it - mKeyTimes.begin()) - 1;
+
+		return aCursor;
+	}
+
+	float AnimationTrack::GetKeyframesAtTime(const float aTime, int& aIndexA, int& aIndexB, int& aCursor) const
 	{
 		const float animLength = mParent->GetLength();
 
@@ -186,42 +439,115 @@ namespace jse
 
 		if (time >= mMaxFrameTime)
 		{
-			aKeyframeA = mKeyframes[mKeyframes.size() - 1];
-			aKeyframeB = mKeyframes[0];
-			aIndex = mKeyframes.size();
+			aIndexA = int(mKeyTimes.size()) - 1;
+			aIndexB = 0;
 			return 0.0f;
+		}
+
+		const int key = FindKey(time, aCursor);
 
+		if (key < 0)
+		{
+			aIndexA = 0;
+			aIndexB = 0;
+			return 0.0f;
 		}
 
-		const size_t lsize = mKeyframes.size();
-		int idxB = -1;
-		for (int i = 0; i < lsize; i++)
+		aIndexA = key;
+		aIndexB = key + 1;
+
+		const float dt = mKeyTimes[aIndexB] - mKeyTimes[aIndexA];
+
+		return (time - mKeyTimes[aIndexA]) / dt;
+	}
+
+	// the lookup before the key time array, kept as the benchmark reference
+	static int AnimationTrack_LinearFindKey(const std::vector<float>& aTimes, const float aTime)
+	{
+		for (size_t i = 0; i < aTimes.size(); ++i)
 		{
-			if (time < mKeyframes[i].time)
-			{
-				idxB = i;
-				break;
-			}
+			if (aTime < aTimes[i])
+				return int(i) - 1;
 		}
 
-		assert(idxB >= 0);
+		return int(aTimes.size()) - 1;
+	}
+
+	void AnimationTrack_Benchmark(const int aNumKeys, const int aIterations)
+	{
+		// baked at 30 keys per second, times in ms like the glTF importer
+		const float keyStep = 1000.0f / 30.0f;
+
+		Animation anim("benchmark");
+		AnimationTrack& track = anim.CreateTrack("benchmark", AnimationTrackType_Position, nullptr);
 
-		if (idxB == 0)
+		for (int k = 0; k < aNumKeys; ++k)
 		{
-			aIndex = 0;
-			aKeyframeA = mKeyframes[0];
-			aKeyframeB = mKeyframes[0];
+			Keyframe& kf = track.CreateKeyframe(k * keyStep);
+			kf.v = Vector3f(float(k));
+		}
 
-			return 0.0f;
+		const float length = track.GetKeyTimes().back();
+		anim.SetLength(length);
+
+		// playback at 120Hz and uniformly random seeks over the clip
+		std::vector<float> samples[2];
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> dist(0.0f, length);
+
+		for (float t = 0.0f; t < length; t += 1000.0f / 120.0f)
+		{
+			samples[0].push_back(t);
+			samples[1].push_back(dist(rng));
 		}
 
-		aIndex = idxB - 1;
-		aKeyframeA = mKeyframes[aIndex];
-		aKeyframeB = mKeyframes[idxB];
+		static const char* const sampleNames[] = { "sequential", "random" };
+
+		for (int set = 0; set < 2; ++set)
+		{
+			const std::vector<float>& times = samples[set];
+
+			int mismatches = 0;
+			int cursor = -1;
+			for (const float t : times)
+			{
+				int a, b;
+				track.GetKeyframesAtTime(t, a, b, cursor);
+
+				if (a != std::max(0, AnimationTrack_LinearFindKey(track.GetKeyTimes(), t)))
+				{
+					mismatches++;
+				}
+			}
+
+			double linearMs = 0.0;
+			double lookupMs = 0.0;
+			volatile int sink = 0;
+
+			for (int i = 0; i < aIterations; ++i)
+			{
+				auto start = std::chrono::steady_clock::now();
+				for (const float t : times)
+				{
+					sink = sink + AnimationTrack_LinearFindKey(track.GetKeyTimes(), t);
+				}
+				linearMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-		const float dt = aKeyframeB.time - aKeyframeA.time;
+				cursor = -1;
+				start = std::chrono::steady_clock::now();
+				for (const float t : times)
+				{
+					int a, b;
+					track.GetKeyframesAtTime(t, a, b, cursor);
+					sink = sink + a;
+				}
+				lookupMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			}
 
+			const double lookups = double(times.size()) * aIterations;
 
-		return (time - aKeyframeA.time) / dt;
+			Info("%d keys, %s: linear %.1fns, cursor/binary search %.1fns per lookup (%.1fx), %d mismatches",
+				aNumKeys, sampleNames[set], linearMs * 1e6 / lookups, lookupMs * 1e6 / lookups, linearMs / std::max(lookupMs, 1e-9), mismatches);
+		}
 	}
 }
@@ -0,0 +1,363 @@
+#include <cstring>
+#include <algorithm>
+
+#include "scene/BinarySceneLoader.hpp"
+#include "scene/Scene.hpp"
+#include "scene/Mesh3d.hpp"
+#include "scene/Node3d.hpp"
+#include "scene/Light.hpp"
+#include "scene/Animation.hpp"
+#include "scene/AnimationTrack.hpp"
+#include "scene/Skin.hpp"
+#include "system/Logger.hpp"
+#include "system/Timer.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+namespace jse {
+
+	static const size_t BinarySceneLoader_RecordSize[SceneFileSection_LastEnum] = {
+		sizeof(char),
+		sizeof(SceneFileNode_t),
+		sizeof(u32),
+		sizeof(SceneFileMesh_t),
+		sizeof(SceneFileMaterial_t),
+		sizeof(SceneFileLight_t),
+		sizeof(SceneFileAnimation_t),
+		sizeof(SceneFileTrack_t),
+		sizeof(SceneFileKey_t),
+		sizeof(SceneFileSkin_t),
+		sizeof(SceneFileSkinJoint_t),
+		sizeof(SceneFileMorphTarget_t),
+		sizeof(SceneFileMorphDelta_t),
+		sizeof(float),
+		sizeof(VertexData),
+		sizeof(unsigned short)
+	};
+
+	// Morph targets of the meshes a node draws, the range of its weight track targets
+	static size_t BinarySceneLoader_GetMorphTargetNum(const Node3d* aNode)
+	{
+		size_t result = 0;
+
+		for (const auto& r : aNode->GetRenderables())
+		{
+			if (r->GetType() == RenderableType::Mesh)
+			{
+				result = std::max(result, reinterpret_cast<const Mesh3d*>(r.get())->GetMorphTargets().size());
+			}
+		}
+
+		return result;
+	}
+
+	template<class T>
+	const T* BinarySceneLoader::GetSection(const SceneFileSection aSection) const
+	{
+		return reinterpret_cast<const T*>(mFile->GetData() + mHeader->sections[aSection].offset);
+	}
+
+	const char* BinarySceneLoader::GetString(const u32 aOffset) const
+	{
+		if (aOffset >= mHeader->sections[SceneFileSection_Strings].size)
+			return "";
+
+		return GetSection<char>(SceneFileSection_Strings) + aOffset;
+	}
+
+	bool BinarySceneLoader::ValidateHeader() const
+	{
+		if (mFile->GetSize() < sizeof(SceneFileHeader_t))
+		{
+			Error("Scene file %s is truncated", mFile->GetFileName().c_str());
+			return false;
+		}
+
+		if (mHeader->magic != kSceneFileMagic)
+		{
+			Error("%s is not a scene file", mFile->GetFileName().c_str());
+			return false;
+		}
+
+		if (mHeader->version != kSceneFileVersion || mHeader->numSections != SceneFileSection_LastEnum)
+		{
+			Error("Scene file %s has version %d, expected %d, re-export it", mFile->GetFileName().c_str(), mHeader->version, kSceneFileVersion);
+			return false;
+		}
+
+		if (mHeader->vertexSize != kVertexDataSize)
+		{
+			Error("Scene file %s vertex layout mismatch (%d != %d)", mFile->GetFileName().c_str(), mHeader->vertexSize, kVertexDataSize);
+			return false;
+		}
+
+		for (int i = 0; i < SceneFileSection_LastEnum; ++i)
+		{
+			const SceneFileSection_t& s = mHeader->sections[i];
+
+			if (s.offset % kSceneFileAlign != 0 || s.offset + s.size > mFile->GetSize() || s.size < u64(s.count) * BinarySceneLoader_RecordSize[i])
+			{
+				Error("Scene file %s: section %d is corrupt", mFile->GetFileName().c_str(), i);
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	int BinarySceneLoader::LoadScene(const String& aFilename)
+	{
+		SimpleTimer timer;
+
+		mFile = std::make_shared<MappedFile>();
+		if (!mFile->Open(aFilename))
+		{
+			return -1;
+		}
+
+		mHeader = reinterpret_cast<const SceneFileHeader_t*>(mFile->GetData());
+
+		if (!ValidateHeader())
+		{
+			return -1;
+		}
+
+		const SceneFileSection_t* sec = mHeader->sections;
+		const u8* vertexBase = mFile->GetData() + sec[SceneFileSection_Vertices].offset;
+		const u8* indexBase = mFile->GetData() + sec[SceneFileSection_Indices].offset;
+
+		/* Meshes reference the mapped vertex and index regions directly */
+
+		const SceneFileMesh_t* fmeshes = GetSection<SceneFileMesh_t>(SceneFileSection_Meshes);
+		const SceneFileMaterial_t* fmats = GetSection<SceneFileMaterial_t>(SceneFileSection_Materials);
+		const SceneFileMorphTarget_t* ftargets = GetSection<SceneFileMorphTarget_t>(SceneFileSection_MorphTargets);
+		const SceneFileMorphDelta_t* fdeltas = GetSection<SceneFileMorphDelta_t>(SceneFileSection_MorphDeltas);
+		const size_t meshBase = mScene.mMeshes.size();
+
+		for (u32 i = 0; i < sec[SceneFileSection_Meshes].count; ++i)
+		{
+			const SceneFileMesh_t& fm = fmeshes[i];
+
+			if (fm.vertexOffset + u64(fm.numVertices) * kVertexDataSize > sec[SceneFileSection_Vertices].size ||
+				fm.indexOffset + u64(fm.numIndices) * sizeof(unsigned short) > sec[SceneFileSection_Indices].size ||
+				fm.material >= sec[SceneFileSection_Materials].count ||
+				u64(fm.firstMorphTarget) + fm.numMorphTargets > sec[SceneFileSection_MorphTargets].count)
+			{
+				Error("Scene file %s: mesh %d is corrupt", aFilename.c_str(), i);
+				return -1;
+			}
+
+			Mesh3d dst(GetString(fm.name));
+
+			const SceneFileMaterial_t& fmat = fmats[fm.material];
+			Material xm;
+			xm.type = MaterialType(fmat.type);
+			xm.ambient = glm::make_vec3(fmat.ambient);
+			xm.diffuse = glm::make_vec3(fmat.diffuse);
+			xm.specular = glm::make_vec3(fmat.specular);
+			xm.specularIntesity = fmat.specularIntensity;
+			xm.alpha = fmat.alpha;
+			dst.SetMaterial(xm);
+
+			dst.SetExternalData(mFile,
+				reinterpret_cast<const VertexData*>(vertexBase + fm.vertexOffset), fm.numVertices,
+				reinterpret_cast<const unsigned short*>(indexBase + fm.indexOffset), fm.numIndices);
+
+			// deltas are small next to the vertices, they are copied out of the mapping
+			for (u32 t = fm.firstMorphTarget; t < fm.firstMorphTarget + fm.numMorphTargets; ++t)
+			{
+				const SceneFileMorphTarget_t& ft = ftargets[t];
+				if (u64(ft.firstDelta) + ft.numDeltas > sec[SceneFileSection_MorphDeltas].count)
+				{
+					Error("Scene file %s: mesh %d is corrupt", aFilename.c_str(), i);
+					return -1;
+				}
+
+				MorphTarget_t target;
+				target.deltas.resize(ft.numDeltas);
+				if (ft.numDeltas) std::memcpy(target.deltas.data(), fdeltas + ft.firstDelta, ft.numDeltas * sizeof(MorphDelta_t));
+
+				for (const auto& d : target.deltas)
+				{
+					if (d.vertex >= fm.numVertices)
+					{
+						Error("Scene file %s: mesh %d is corrupt", aFilename.c_str(), i);
+						return -1;
+					}
+				}
+
+				dst.AddMorphTarget(std::move(target));
+			}
+
+			mScene.AddMesh(std::move(dst));
+		}
+
+		/* Nodes, parents are always stored before their children */
+
+		const SceneFileNode_t* fnodes = GetSection<SceneFileNode_t>(SceneFileSection_Nodes);
+		const u32* meshRefs = GetSection<u32>(SceneFileSection_NodeMeshRefs);
+		const SceneFileLight_t* flights = GetSection<SceneFileLight_t>(SceneFileSection_Lights);
+		const float* fweights = GetSection<float>(SceneFileSection_MorphWeights);
+		std::vector<Node3d*> nodes(sec[SceneFileSection_Nodes].count, nullptr);
+
+		for (u32 i = 0; i < sec[SceneFileSection_Nodes].count; ++i)
+		{
+			const SceneFileNode_t& fn = fnodes[i];
+
+			if ((fn.parent != kSceneFileNoIndex && fn.parent >= i) ||
+				u64(fn.firstMeshRef) + fn.numMeshRefs > sec[SceneFileSection_NodeMeshRefs].count ||
+				u64(fn.firstMorphWeight) + fn.numMorphWeights > sec[SceneFileSection_MorphWeights].count)
+			{
+				Error("Scene file %s: node %d is corrupt", aFilename.c_str(), i);
+				return -1;
+			}
+
+			const String name = GetString(fn.name);
+			Node3d* nNode = new Node3d(name);
+			nNode->SetVisible((fn.flags & SceneFileNodeFlag_Visible) != 0);
+			nNode->SetTransform(glm::make_mat4(fn.transform), true);
+			if (fn.numMorphWeights)
+			{
+				nNode->SetMorphWeights(std::vector<float>(fweights + fn.firstMorphWeight, fweights + fn.firstMorphWeight + fn.numMorphWeights));
+			}
+			mScene.mNodeByName.insert(Scene::tNodeByNamePair(name, nNode));
+
+			for (u32 j = 0; j < fn.numMeshRefs; ++j)
+			{
+				nNode->AddRenderable(mScene.GetMeshByIndex(int(meshBase + meshRefs[fn.firstMeshRef + j])));
+			}
+
+			if (fn.light < sec[SceneFileSection_Lights].count)
+			{
+				const SceneFileLight_t& fl = flights[fn.light];
+
+				auto p = std::make_shared<PointLight>(
+					GetString(fl.name),
+					nNode,
+					vec3(0.0f),
+					glm::make_vec3(fl.diffuse), glm::make_vec3(fl.specular),
+					fl.linearAtt, fl.quadraticAtt, fl.cutoff);
+
+				nNode->AddRenderable(p);
+			}
+
+			mScene.AddNode(nNode, fn.parent == kSceneFileNoIndex ? nullptr : nodes[fn.parent]);
+			nodes[i] = nNode;
+		}
+
+		for (auto n : nodes)
+		{
+			n->UpdateWorldTransform();
+		}
+
+		/* Skins, set on the nodes once all joints exist */
+
+		const SceneFileSkin_t* fskins = GetSection<SceneFileSkin_t>(SceneFileSection_Skins);
+		const SceneFileSkinJoint_t* fjoints = GetSection<SceneFileSkinJoint_t>(SceneFileSection_SkinJoints);
+		const size_t skinBase = mScene.mSkins.size();
+
+		for (u32 i = 0; i < sec[SceneFileSection_Skins].count; ++i)
+		{
+			const SceneFileSkin_t& fs = fskins[i];
+
+			if (fs.numJoints > u32(kMaxSkinJoints) || u64(fs.firstJoint) + fs.numJoints > sec[SceneFileSection_SkinJoints].count)
+			{
+				Error("Scene file %s: skin %d is corrupt", aFilename.c_str(), i);
+				return -1;
+			}
+
+			auto skin = std::make_unique<Skin>(GetString(fs.name));
+
+			for (u32 j = fs.firstJoint; j < fs.firstJoint + fs.numJoints; ++j)
+			{
+				if (fjoints[j].node >= nodes.size())
+				{
+					Error("Scene file %s: skin %d is corrupt", aFilename.c_str(), i);
+					return -1;
+				}
+
+				skin->AddJoint(nodes[fjoints[j].node], glm::make_mat4(fjoints[j].inverseBind));
+			}
+
+			mScene.mSkins.push_back(std::move(skin));
+		}
+
+		for (u32 i = 0; i < sec[SceneFileSection_Nodes].count; ++i)
+		{
+			const u32 skin = fnodes[i].skin;
+			if (skin == kSceneFileNoIndex)
+				continue;
+
+			if (skin >= sec[SceneFileSection_Skins].count)
+			{
+				Error("Scene file %s: node %d is corrupt", aFilename.c_str(), i);
+				return -1;
+			}
+
+			for (const auto& r : nodes[i]->GetRenderables())
+			{
+				if (r->GetType() == RenderableType::Mesh && !mScene.mSkins[skinBase + skin]->CanDeform(*reinterpret_cast<const Mesh3d*>(r.get())))
+				{
+					Error("Scene file %s: node %d references joints its skin does not have", aFilename.c_str(), i);
+					return -1;
+				}
+			}
+
+			nodes[i]->SetSkin(mScene.mSkins[skinBase + skin].get());
+		}
+
+		/* Animations */
+
+		const SceneFileAnimation_t* fanims = GetSection<SceneFileAnimation_t>(SceneFileSection_Animations);
+		const SceneFileTrack_t* ftracks = GetSection<SceneFileTrack_t>(SceneFileSection_Tracks);
+		const SceneFileKey_t* fkeys = GetSection<SceneFileKey_t>(SceneFileSection_Keys);
+
+		for (u32 i = 0; i < sec[SceneFileSection_Animations].count; ++i)
+		{
+			const SceneFileAnimation_t& fa = fanims[i];
+
+			if (u64(fa.firstTrack) + fa.numTracks > sec[SceneFileSection_Tracks].count)
+			{
+				Error("Scene file %s: animation %d is corrupt", aFilename.c_str(), i);
+				return -1;
+			}
+
+			Animation* myAnim = new Animation(GetString(fa.name));
+			myAnim->SetTicksPerSec(fa.ticksPerSec);
+			myAnim->SetLength(fa.length);
+
+			for (u32 t = fa.firstTrack; t < fa.firstTrack + fa.numTracks; ++t)
+			{
+				const SceneFileTrack_t& ft = ftracks[t];
+
+				if (ft.node >= nodes.size() || ft.type >= AnimationTrackType_LastEnum ||
+					u64(ft.firstKey) + ft.numKeys > sec[SceneFileSection_Keys].count ||
+					(ft.type == AnimationTrackType_Weight && ft.morphTarget >= BinarySceneLoader_GetMorphTargetNum(nodes[ft.node])))
+				{
+					Error("Scene file %s: track %d is corrupt", aFilename.c_str(), t);
+					delete myAnim;
+					return -1;
+				}
+
+				AnimationTrack& track = myAnim->CreateTrack(GetString(ft.name), AnimationTrackType(ft.type), nodes[ft.node]);
+				track.SetMorphTarget(int(ft.morphTarget));
+
+				for (u32 k = ft.firstKey; k < ft.firstKey + ft.numKeys; ++k)
+				{
+					Keyframe& kf = track.CreateKeyframe(fkeys[k].time);
+					std::memcpy(kf.value, fkeys[k].value, sizeof(kf.value));
+				}
+			}
+
+			AnimationCompressParams_t compress = mScene.mAnimCompress;
+			compress.reduce = false;
+
+			myAnim->Compress(compress);
+			mScene.mAnimMgr.AddAnimation(myAnim);
+		}
+
+		timer.PrintElapsedTime("Binary scene " + aFilename + " loaded in");
+
+		return 0;
+	}
+}
@@ -2,6 +2,8 @@
 #include "scene/GltfLoader.hpp"
 #include "scene/Mesh3d.hpp"
 #include "scene/Scene.hpp"
+#include "scene/Skin.hpp"
+#include "system/ThreadPool.hpp"
 #include <tiny_gltf.h>
 
 #include <algorithm>
@@ -69,8 +71,68 @@ namespace jse {
 		return size;
 	}
 
+	static unsigned GltfLoader_GetUInt(const uint8_t* aPtr, const int aComponentType)
+	{
+		switch (aComponentType)
+		{
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:		return *aPtr;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:	return *reinterpret_cast<const uint16_t*>(aPtr);
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:		return *reinterpret_cast<const uint32_t*>(aPtr);
+		default:
+			return 0;
+		}
+	}
+
+	// float or normalized unsigned integer
+	static float GltfLoader_GetUnorm(const uint8_t* aPtr, const int aComponentType)
+	{
+		switch (aComponentType)
+		{
+		case TINYGLTF_COMPONENT_TYPE_FLOAT:				return *reinterpret_cast<const float*>(aPtr);
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:		return float(*aPtr) / 255.0f;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:	return float(*reinterpret_cast<const uint16_t*>(aPtr)) / 65535.0f;
+		default:
+			return 0.0f;
+		}
+	}
+
+	// 4 weights to u8 summing to 255, the rounding error goes to the largest one
+	static void GltfLoader_QuantizeWeights(const unsigned* aJoints, const float* aWeights, u8* aDstJoints, u8* aDstWeights)
+	{
+		float sum = 0.0f;
+		for (int k = 0; k < 4; ++k)
+		{
+			sum += aJoints[k] < unsigned(kMaxSkinJoints) ? std::max(aWeights[k], 0.0f) : 0.0f;
+		}
+
+		if (sum <= 0.0f)
+		{
+			std::memset(aDstJoints, 0, 4);
+			std::memset(aDstWeights, 0, 4);
+			aDstWeights[0] = 255;
+			return;
+		}
+
+		int total = 0;
+		int largest = 0;
+		for (int k = 0; k < 4; ++k)
+		{
+			const bool valid = aJoints[k] < unsigned(kMaxSkinJoints);
+			const int q = valid ? int(std::max(aWeights[k], 0.0f) / sum * 255.0f + 0.5f) : 0;
+
+			aDstJoints[k] = valid ? u8(aJoints[k]) : 0;
+			aDstWeights[k] = u8(q);
+			total += q;
+
+			if (aDstWeights[k] > aDstWeights[largest])
+				largest = k;
+		}
+
+		aDstWeights[largest] = u8(int(aDstWeights[largest]) + 255 - total);
+	}
+
 	template<class T>
-	void GltfLoader::ExtractData(const tinygltf::Accessor& aAccessor, std::unique_ptr<T>& aDest)
+	void GltfLoader::ExtractData(const tinygltf::Accessor& aAccessor, std::unique_ptr<T>& aDest) const
 	{
 		const tinygltf::BufferView& view = mModel.bufferViews[aAccessor.bufferView];
 		const tinygltf::Buffer& buf = mModel.buffers[view.buffer];
@@ -134,11 +196,15 @@ namespace jse {
 
 		tinygltf::Scene& scene = mModel.scenes[mModel.defaultScene];
 
+		mNodes.assign(mModel.nodes.size(), nullptr);
+
 		Info("Number of meshes: %d", mModel.meshes.size());
 
 		meshOffsets.clear();
 		unsigned int k = 0;
 
+		std::vector<std::pair<unsigned, unsigned>> primRefs;
+
 		for (unsigned int i = 0; i < mModel.meshes.size(); ++i)
 		{
 			const tinygltf::Mesh& m = mModel.meshes[i];
@@ -147,97 +213,32 @@ namespace jse {
 
 			for (unsigned int j = 0; j < m.primitives.size(); j++)
 			{
-				Mesh3d dst(m.name);
-
-				tinygltf::Primitive p = m.primitives[j];
-				tinygltf::Accessor indexAccessor = mModel.accessors[p.indices];
-
-				tinygltf::BufferView& ibv = mModel.bufferViews[indexAccessor.bufferView];
-				tinygltf::Buffer& ibuf = mModel.buffers[ibv.buffer];
-
-				if (p.mode != TINYGLTF_MODE_TRIANGLES)
-				{
-					Warning("GLTF-WARN: Only TRIANGLES mode is supported!");
-					return -1;
-				}
-
-				if (indexAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
-				{
-					std::unique_ptr<unsigned short> lPtr;
-					ExtractData(indexAccessor, lPtr);
-					dst.AddIndices(lPtr.get(), indexAccessor.count);
-				}
-				else if (indexAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT)
-				{
-					std::unique_ptr<unsigned int> lPtr;
-					ExtractData(indexAccessor, lPtr);
-					for (unsigned _x = 0; _x < indexAccessor.count; ++_x)
-					{
-						dst.AddIndex(*(lPtr.get() + _x));
-					}
-				}
-
-
-
-				auto findPos = p.attributes.find("POSITION");
-				if (findPos == p.attributes.end())
-				{
-					Warning("GLTF-WARN: POSITION attributes missing !");
-					return -1;
-				}
-
-				/* Copy position data */
+				primRefs.emplace_back(i, j);
+			}
+		}
+		meshOffsets.push_back(k);
 
-				tinygltf::Accessor& posAccessor = mModel.accessors[findPos->second];
-				const size_t numPrimitives = posAccessor.count;
+		/* Decode primitives in parallel, slot index == final mesh index */
 
-				std::unique_ptr<vec3> v_pos;
-				std::unique_ptr<vec3> v_norm;
-				std::unique_ptr<vec4> v_tan;
-				std::unique_ptr<vec2> v_tex;
+		std::vector<std::unique_ptr<Mesh3d>> slots(primRefs.size());
+		std::vector<char> slotOk(primRefs.size(), 0);
 
-				ExtractData(posAccessor, v_pos);
+		GetDefaultThreadPool().ParallelFor(primRefs.size(), [&](size_t aIdx) {
+			const tinygltf::Mesh& m = mModel.meshes[primRefs[aIdx].first];
 
-				{
-					auto f = p.attributes.find("NORMAL");
-					if (f != p.attributes.end())
-					{
-						ExtractData(mModel.accessors[f->second], v_norm);
-					}
-				}
-				{
-					auto f = p.attributes.find("TEXCOORD_0");
-					if (f != p.attributes.end())
-					{
-						ExtractData(mModel.accessors[f->second], v_tex);
-					}
-				}
-				{
-					auto f = p.attributes.find("TANGENT");
-					if (f != p.attributes.end())
-					{
-						ExtractData(mModel.accessors[f->second], v_tan);
-					}
-				}
+			slots[aIdx] = std::make_unique<Mesh3d>(m.name);
+			slotOk[aIdx] = DecodePrimitive(m.primitives[primRefs[aIdx].second], *slots[aIdx]) ? 1 : 0;
+		});
 
-				dst.SetData(v_pos.get(), v_norm.get(), v_tan.get(), v_tex.get(), numPrimitives);
-				dst.CompileFromData();
+		if (std::find(slotOk.begin(), slotOk.end(), 0) != slotOk.end())
+		{
+			return -1;
+		}
 
-				if (p.material > -1)
-				{
-					tinygltf::Material mat = mModel.materials[p.material];
-					Material xm;
-					xm.type = MaterialType_Specular;
-					xm.diffuse = Color3(mat.pbrMetallicRoughness.baseColorFactor[0], mat.pbrMetallicRoughness.baseColorFactor[1], mat.pbrMetallicRoughness.baseColorFactor[2]);
-					xm.specular = Color3(0.2f);
-					xm.specularIntesity = float(mat.pbrMetallicRoughness.roughnessFactor * 100.0);
-					xm.ambient = Color3(.0001f);
-					dst.SetMaterial(xm);
-				}
-				mScene.AddMesh(dst);
-			}
+		for (auto& it : slots)
+		{
+			mScene.AddMesh(std::move(*it));
 		}
-		meshOffsets.push_back(k);
 
 		for (size_t i : scene.nodes)
 		{
@@ -252,6 +253,8 @@ namespace jse {
 			
 		}
 
+		ImportSkins();
+
 		for (auto anim : mModel.animations)
 		{
 			Info("Animation: %s", anim.name.c_str());
@@ -288,13 +291,19 @@ namespace jse {
 				{
 					trackType = AnimationTrackType_Rotation;
 				}
+				else if (channel.target_path == "scale")
+				{
+					trackType = AnimationTrackType_Scale;
+				}
+				else if (channel.target_path == "weights")
+				{
+					trackType = AnimationTrackType_Weight;
+				}
 				else 
 				{
 					continue;
 				}
 
-				AnimationTrack& track = myAnim->CreateTrack(target.name, trackType, myNode);
-
 				const tinygltf::BufferView inbv = mModel.bufferViews[input.bufferView];
 				const tinygltf::Buffer inbuf = mModel.buffers[inbv.buffer];
 
@@ -305,25 +314,35 @@ namespace jse {
 
 				const float* values = reinterpret_cast<float const*>(outbv.byteOffset + output.byteOffset + outbuf.data.data());
 
-				for (unsigned i = 0; i < input.count; ++i)
+				if (trackType == AnimationTrackType_Weight)
+				{
+					ImportMorphWeights(target, myNode, sampler, input.count, output.count, timestamps, values, *myAnim);
+				}
+				else if (input.count)
 				{
-					Keyframe& kf = track.CreateKeyframe(timestamps[i] * 1000.f);
+					AnimationTrack& track = myAnim->CreateTrack(target.name, trackType, myNode);
 
-					if (trackType == AnimationTrackType_Position)
+					for (unsigned i = 0; i < input.count; ++i)
 					{
-						kf.v = glm::make_vec3(&values[i * 3]);
-					}
-					else 
-					{
-						kf.q = Quat(values[i * 4 + 3], values[i * 4 + 0], values[i * 4 + 1], values[i * 4 + 2]);
+						Keyframe& kf = track.CreateKeyframe(timestamps[i] * 1000.f);
+
+						if (trackType != AnimationTrackType_Rotation)
+						{
+							kf.v = glm::make_vec3(&values[i * 3]);
+						}
+						else 
+						{
+							kf.q = Quat(values[i * 4 + 3], values[i * 4 + 0], values[i * 4 + 1], values[i * 4 + 2]);
+						}
 					}
 				}
-				if (length < timestamps[input.count - 1])
+				if (input.count && length < timestamps[input.count - 1])
 				{
 					length = timestamps[input.count - 1];
 				}
 			}
 			myAnim->SetLength(1000.f * length);
+			myAnim->Compress(mScene.mAnimCompress);
 			mScene.mAnimMgr.AddAnimation(myAnim);
 			
 		}
@@ -331,6 +350,327 @@ namespace jse {
 		return 0;
 	}
 
+	bool GltfLoader::DecodePrimitive(const tinygltf::Primitive& aPrim, Mesh3d& aDst) const
+	{
+		const tinygltf::Primitive& p = aPrim;
+
+		if (p.mode != TINYGLTF_MODE_TRIANGLES)
+		{
+			Warning("GLTF-WARN: Only TRIANGLES mode is supported!");
+			return false;
+		}
+
+		const tinygltf::Accessor& indexAccessor = mModel.accessors[p.indices];
+
+		if (indexAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
+		{
+			std::unique_ptr<unsigned short> lPtr;
+			ExtractData(indexAccessor, lPtr);
+			aDst.AddIndices(lPtr.get(), unsigned(indexAccessor.count));
+		}
+		else if (indexAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT)
+		{
+			std::unique_ptr<unsigned int> lPtr;
+			ExtractData(indexAccessor, lPtr);
+			for (unsigned _x = 0; _x < indexAccessor.count; ++_x)
+			{
+				aDst.AddIndex(*(lPtr.get() + _x));
+			}
+		}
+
+		auto findPos = p.attributes.find("POSITION");
+		if (findPos == p.attributes.end())
+		{
+			Warning("GLTF-WARN: POSITION attributes missing !");
+			return false;
+		}
+
+		/* Copy position data */
+
+		const tinygltf::Accessor& posAccessor = mModel.accessors[findPos->second];
+		const size_t numPrimitives = posAccessor.count;
+
+		std::unique_ptr<vec3> v_pos;
+		std::unique_ptr<vec3> v_norm;
+		std::unique_ptr<vec4> v_tan;
+		std::unique_ptr<vec2> v_tex;
+
+		ExtractData(posAccessor, v_pos);
+
+		{
+			auto f = p.attributes.find("NORMAL");
+			if (f != p.attributes.end())
+			{
+				ExtractData(mModel.accessors[f->second], v_norm);
+			}
+		}
+		{
+			auto f = p.attributes.find("TEXCOORD_0");
+			if (f != p.attributes.end())
+			{
+				ExtractData(mModel.accessors[f->second], v_tex);
+			}
+		}
+		{
+			auto f = p.attributes.find("TANGENT");
+			if (f != p.attributes.end())
+			{
+				ExtractData(mModel.accessors[f->second], v_tan);
+			}
+		}
+
+		aDst.SetData(v_pos.get(), v_norm.get(), v_tan.get(), v_tex.get(), numPrimitives);
+
+		if (!DecodeSkinData(p, numPrimitives, aDst) || !DecodeMorphTargets(p, numPrimitives, aDst))
+		{
+			aDst.ClearData();
+			return false;
+		}
+
+		aDst.CompileFromData();
+
+		if (p.material > -1)
+		{
+			const tinygltf::Material& mat = mModel.materials[p.material];
+			Material xm;
+			xm.type = MaterialType_Specular;
+			xm.diffuse = Color3(mat.pbrMetallicRoughness.baseColorFactor[0], mat.pbrMetallicRoughness.baseColorFactor[1], mat.pbrMetallicRoughness.baseColorFactor[2]);
+			xm.specular = Color3(0.2f);
+			xm.specularIntesity = float(mat.pbrMetallicRoughness.roughnessFactor * 100.0);
+			xm.ambient = Color3(.0001f);
+			aDst.SetMaterial(xm);
+		}
+
+		return true;
+	}
+
+	bool GltfLoader::DecodeSkinData(const tinygltf::Primitive& aPrim, const size_t aCount, Mesh3d& aDst) const
+	{
+		auto fj = aPrim.attributes.find("JOINTS_0");
+		auto fw = aPrim.attributes.find("WEIGHTS_0");
+		if (fj == aPrim.attributes.end() || fw == aPrim.attributes.end())
+			return true;
+
+		const tinygltf::Accessor& ja = mModel.accessors[fj->second];
+		const tinygltf::Accessor& wa = mModel.accessors[fw->second];
+
+		if (ja.count != aCount || wa.count != aCount || ja.type != TINYGLTF_TYPE_VEC4 || wa.type != TINYGLTF_TYPE_VEC4 || ja.bufferView < 0 || wa.bufferView < 0)
+		{
+			Warning("GLTF-WARN: malformed JOINTS_0 / WEIGHTS_0 attributes !");
+			return false;
+		}
+
+		const tinygltf::BufferView& jv = mModel.bufferViews[ja.bufferView];
+		const tinygltf::BufferView& wv = mModel.bufferViews[wa.bufferView];
+		const uint8_t* jdata = mModel.buffers[jv.buffer].data.data() + jv.byteOffset + ja.byteOffset;
+		const uint8_t* wdata = mModel.buffers[wv.buffer].data.data() + wv.byteOffset + wa.byteOffset;
+		const size_t jstride = ja.ByteStride(jv);
+		const size_t wstride = wa.ByteStride(wv);
+		const unsigned jsize = GltfLoader_GetComponentSize(ja.componentType);
+		const unsigned wsize = GltfLoader_GetComponentSize(wa.componentType);
+
+		std::vector<u8> joints(4 * aCount);
+		std::vector<u8> weights(4 * aCount);
+
+		for (size_t i = 0; i < aCount; ++i)
+		{
+			unsigned j[4];
+			float w[4];
+
+			for (int k = 0; k < 4; ++k)
+			{
+				j[k] = GltfLoader_GetUInt(jdata + i * jstride + k * jsize, ja.componentType);
+				w[k] = GltfLoader_GetUnorm(wdata + i * wstride + k * wsize, wa.componentType);
+			}
+
+			GltfLoader_QuantizeWeights(j, w, &joints[4 * i], &weights[4 * i]);
+		}
+
+		aDst.SetSkinData(joints.data(), weights.data());
+
+		return true;
+	}
+
+	bool GltfLoader::DecodeMorphTargets(const tinygltf::Primitive& aPrim, const size_t aCount, Mesh3d& aDst) const
+	{
+		std::vector<vec3> pos;
+		std::vector<vec3> norm;
+
+		for (const auto& target : aPrim.targets)
+		{
+			auto fp = target.find("POSITION");
+			auto fn = target.find("NORMAL");
+
+			pos.assign(aCount, vec3(0.0f));
+			norm.assign(aCount, vec3(0.0f));
+
+			if ((fp != target.end() && !ReadVec3(mModel.accessors[fp->second], aCount, pos)) ||
+				(fn != target.end() && !ReadVec3(mModel.accessors[fn->second], aCount, norm)))
+			{
+				Warning("GLTF-WARN: malformed morph target !");
+				return false;
+			}
+
+			// keep the vertices the target moves, in vertex order
+			MorphTarget_t dst;
+			for (size_t i = 0; i < aCount; ++i)
+			{
+				if (pos[i] != vec3(0.0f) || norm[i] != vec3(0.0f))
+				{
+					MorphDelta_t d;
+					d.position = pos[i];
+					d.vertex = u32(i);
+					d.normal = norm[i];
+					d.pad = 0.0f;
+					dst.deltas.push_back(d);
+				}
+			}
+
+			aDst.AddMorphTarget(std::move(dst));
+		}
+
+		return true;
+	}
+
+	bool GltfLoader::ReadVec3(const tinygltf::Accessor& aAccessor, const size_t aCount, std::vector<vec3>& aDst) const
+	{
+		if (aAccessor.type != TINYGLTF_TYPE_VEC3 || aAccessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT || aAccessor.count != aCount)
+			return false;
+
+		// no buffer view: zeros, the sparse values below (if any) replace them
+		if (aAccessor.bufferView >= 0)
+		{
+			std::unique_ptr<vec3> data;
+			ExtractData(aAccessor, data);
+			std::copy(data.get(), data.get() + aCount, aDst.begin());
+		}
+
+		if (!aAccessor.sparse.isSparse)
+			return true;
+
+		const auto& sparse = aAccessor.sparse;
+		if (sparse.indices.bufferView < 0 || sparse.values.bufferView < 0)
+			return false;
+
+		const tinygltf::BufferView& iv = mModel.bufferViews[sparse.indices.bufferView];
+		const tinygltf::BufferView& vv = mModel.bufferViews[sparse.values.bufferView];
+		const uint8_t* idata = mModel.buffers[iv.buffer].data.data() + iv.byteOffset + sparse.indices.byteOffset;
+		const float* vdata = reinterpret_cast<const float*>(mModel.buffers[vv.buffer].data.data() + vv.byteOffset + sparse.values.byteOffset);
+		const unsigned isize = GltfLoader_GetComponentSize(sparse.indices.componentType);
+
+		for (int i = 0; i < sparse.count; ++i)
+		{
+			const unsigned idx = GltfLoader_GetUInt(idata + i * isize, sparse.indices.componentType);
+			if (idx >= aCount)
+				return false;
+
+			aDst[idx] = glm::make_vec3(vdata + 3 * i);
+		}
+
+		return true;
+	}
+
+	void GltfLoader::ImportMorphWeights(const tinygltf::Node& aTarget, Node3d* aNode, const tinygltf::AnimationSampler& aSampler, const size_t aNumKeys, const size_t aNumValues, const float* aTimes, const float* aValues, Animation& aAnim) const
+	{
+		const size_t numTargets = aTarget.mesh >= 0 ? mModel.meshes[aTarget.mesh].primitives[0].targets.size() : 0;
+
+		// cubic spline outputs are (in tangent, value, out tangent) per key, only the values are kept
+		const bool cubic = aSampler.interpolation == "CUBICSPLINE";
+		const size_t stride = numTargets * (cubic ? 3 : 1);
+		const size_t offset = cubic ? numTargets : 0;
+
+		if (!numTargets || aNumValues != aNumKeys * (cubic ? 3 : 1) * numTargets)
+		{
+			Warning("GLTF-WARN: weights channel of %s does not match its morph targets !", aTarget.name.c_str());
+			return;
+		}
+
+		for (size_t t = 0; t < numTargets; ++t)
+		{
+			AnimationTrack& track = aAnim.CreateTrack(aTarget.name, AnimationTrackType_Weight, aNode);
+			track.SetMorphTarget(int(t));
+
+			for (size_t i = 0; i < aNumKeys; ++i)
+			{
+				Keyframe& kf = track.CreateKeyframe(aTimes[i] * 1000.f);
+				kf.v = vec3(aValues[i * stride + offset + t], 0.0f, 0.0f);
+			}
+		}
+	}
+
+	void GltfLoader::ImportSkins()
+	{
+		std::vector<Skin*> skins(mModel.skins.size(), nullptr);
+
+		for (size_t i = 0; i < mModel.skins.size(); ++i)
+		{
+			const tinygltf::Skin& xskin = mModel.skins[i];
+
+			if (xskin.joints.size() > size_t(kMaxSkinJoints))
+			{
+				Warning("GLTF-WARN: skin %s has %d joints, at most %d are supported !", xskin.name.c_str(), int(xskin.joints.size()), kMaxSkinJoints);
+				continue;
+			}
+
+			std::unique_ptr<Matrix> inverseBind;
+			if (xskin.inverseBindMatrices >= 0)
+			{
+				const tinygltf::Accessor& a = mModel.accessors[xskin.inverseBindMatrices];
+				if (a.type == TINYGLTF_TYPE_MAT4 && a.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT && a.count >= xskin.joints.size() && a.bufferView >= 0)
+				{
+					ExtractData(a, inverseBind);
+				}
+			}
+
+			auto skin = std::make_unique<Skin>(xskin.name);
+			bool ok = true;
+
+			for (size_t j = 0; j < xskin.joints.size(); ++j)
+			{
+				const int idx = xskin.joints[j];
+				Node3d* joint = idx >= 0 && size_t(idx) < mNodes.size() ? mNodes[idx] : nullptr;
+
+				ok = ok && joint != nullptr;
+				skin->AddJoint(joint, inverseBind ? inverseBind.get()[j] : Matrix(1.0f));
+			}
+
+			if (!ok)
+			{
+				Warning("GLTF-WARN: skin %s has joints outside of the scene !", xskin.name.c_str());
+				continue;
+			}
+
+			Info("Skin: %s, %d joints", xskin.name.c_str(), int(xskin.joints.size()));
+
+			skins[i] = skin.get();
+			mScene.mSkins.push_back(std::move(skin));
+		}
+
+		for (size_t i = 0; i < mModel.nodes.size(); ++i)
+		{
+			const int s = mModel.nodes[i].skin;
+			if (s < 0 || size_t(s) >= skins.size() || !skins[s] || !mNodes[i])
+				continue;
+
+			bool ok = true;
+			for (const auto& r : mNodes[i]->GetRenderables())
+			{
+				if (r->GetType() == RenderableType::Mesh)
+				{
+					ok = ok && skins[s]->CanDeform(*reinterpret_cast<const Mesh3d*>(r.get()));
+				}
+			}
+
+			if (!ok)
+			{
+				Warning("GLTF-WARN: node %s references joints its skin does not have !", mNodes[i]->GetName().c_str());
+				continue;
+			}
+
+			mNodes[i]->SetSkin(skins[s]);
+		}
+	}
+
 	Node3d* GltfLoader::ImportNode(const tinygltf::Node& aNode, unsigned aLevel)
 	{
 		String name = aNode.name;
@@ -364,6 +704,7 @@ namespace jse {
 		// create node
 		Node3d* nNode = new Node3d(name);
 		nNode->SetVisible(visible);
+		mNodes[&aNode - mModel.nodes.data()] = nNode;
 		mScene.mNodeByName.insert(Scene::tNodeByNamePair(name, nNode));
 
 		/* Get node transform */
@@ -433,6 +774,13 @@ namespace jse {
 			for (unsigned int j = meshOffsets[mesh_idx]; j < meshOffsets[mesh_idx + 1]; ++j) {
 				nNode->AddRenderable(mScene.GetMeshByIndex(j));
 			}
+
+			// default morph weights, the node ones override the mesh ones
+			const std::vector<double>& weights = aNode.weights.empty() ? mModel.meshes[mesh_idx].weights : aNode.weights;
+			if (!weights.empty())
+			{
+				nNode->SetMorphWeights(std::vector<float>(weights.begin(), weights.end()));
+			}
 		}
 		else if (light > -1)
 		{
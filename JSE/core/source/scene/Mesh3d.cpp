@@ -1,6 +1,12 @@
 #include "scene/Mesh3d.hpp"
 #include "scene/Node3d.hpp"
+#include "scene/MeshOptimizer.hpp"
+#include "math/TriangleBvh.hpp"
 #include "system/Logger.hpp"
+#include "system/Cpu.hpp"
+
+#include <algorithm>
+#include <cmath>
 
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/glm.hpp>
@@ -10,6 +16,8 @@ namespace jse {
 
 	VertexData::VertexData()
 	{
+		std::memset(joints, 0, sizeof(joints));
+		std::memset(weights, 0, sizeof(weights));
 	}
 
 	void VertexData::SetPosition(const float* a0)
@@ -98,11 +106,15 @@ namespace jse {
 		if (mNormalData) delete[] mNormalData;
 		if (mTexcoordData) delete[] mTexcoordData;
 		if (mTangentData) delete[] mTangentData;
+		if (mJointData) delete[] mJointData;
+		if (mWeightData) delete[] mWeightData;
 
 		mPositionData = nullptr; 
 		mNormalData = nullptr; 
 		mTexcoordData = nullptr;
 		mTangentData = nullptr;
+		mJointData = nullptr;
+		mWeightData = nullptr;
 	}
 
 	void Mesh3d::SetName(const String& aName)
@@ -153,6 +165,29 @@ namespace jse {
 		}
 	}
 
+	void Mesh3d::SetSkinData(const u8* aJoints, const u8* aWeights)
+	{
+		if (mJointData) delete[] mJointData;
+		if (mWeightData) delete[] mWeightData;
+
+		mJointData = new u8[4 * mDataCount];
+		mWeightData = new u8[4 * mDataCount];
+		std::memcpy(mJointData, aJoints, 4 * mDataCount);
+		std::memcpy(mWeightData, aWeights, 4 * mDataCount);
+	}
+
+	void Mesh3d::SetExternalData(std::shared_ptr<const void> aOwner, const VertexData* aVertices, const size_t aNumVertices, const unsigned short* aIndices, const size_t aNumIndices)
+	{
+		vertices.clear();
+		indices.clear();
+
+		mExternalOwner = aOwner;
+		mExternalVertices = aVertices;
+		mExternalNumVertices = aNumVertices;
+		mExternalIndices = aIndices;
+		mExternalNumIndices = aNumIndices;
+	}
+
 	void Mesh3d::CompileFromData()
 	{
 		vertices.resize(0);
@@ -167,10 +202,96 @@ namespace jse {
 				v.tangent	= mTangentData[i];
 				v.bitangent	= glm::cross(v.normal, v.tangent) * mTangentData[i].w;
 			}
+			if (mJointData)
+			{
+				std::memcpy(v.joints, mJointData + 4 * i, 4);
+				std::memcpy(v.weights, mWeightData + 4 * i, 4);
+			}
 			vertices.push_back(v);
 		}
 
 		ClearData();
 	}
 
-}
\ No newline at end of file
+	void Mesh3d::BuildBvh()
+	{
+		auto bvh = std::make_shared<TriangleBvh>();
+		bvh->Build(GetVertexData(), GetVertexCount(), GetIndexData(), GetIndexCount());
+
+		mBvh = std::move(bvh);
+	}
+
+	void Mesh3d::Optimize()
+	{
+		if (mExternalVertices || indices.empty())
+			return;
+
+		MeshOpt_OptimizeVertexCache(indices, vertices.size());
+
+		std::vector<unsigned> remap;
+		MeshOpt_OptimizeVertexFetch(vertices, indices, &remap);
+
+		// deltas follow their vertex, the ones of dropped vertices go
+		for (auto& target : mMorphTargets)
+		{
+			std::vector<MorphDelta_t> deltas;
+			deltas.reserve(target.deltas.size());
+
+			for (const auto& d : target.deltas)
+			{
+				if (remap[d.vertex] != kMeshOptimizerUnused)
+				{
+					deltas.push_back(d);
+					deltas.back().vertex = remap[d.vertex];
+				}
+			}
+
+			std::sort(deltas.begin(), deltas.end(), [](const MorphDelta_t& a, const MorphDelta_t& b) { return a.vertex < b.vertex; });
+			target.deltas.swap(deltas);
+		}
+	}
+
+	void Mesh3d::AddMorphTarget(MorphTarget_t&& aTarget)
+	{
+		mMorphTargets.push_back(std::move(aTarget));
+	}
+
+	void Mesh3d_ApplyMorphTargets(const Mesh3d& aMesh, const float* aWeights, const size_t aNumWeights, VertexData* aDst)
+	{
+		const std::vector<MorphTarget_t>& targets = aMesh.GetMorphTargets();
+		const size_t numTargets = std::min(aNumWeights, targets.size());
+
+		std::memcpy(aDst, aMesh.GetVertexData(), aMesh.GetVertexCount() * kVertexDataSize);
+
+		for (size_t t = 0; t < numTargets; ++t)
+		{
+			const float w = aWeights[t];
+			if (std::abs(w) < kMorphMinWeight)
+				continue;
+
+			const std::vector<MorphDelta_t>& deltas = targets[t].deltas;
+
+#if defined(JSE_SIMD_X86)
+			// xyz of a row, the 4th lane (vertex index, pad) adds 0 to the next field of the vertex
+			const __m128 mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+			const __m128 vw = _mm_set1_ps(w);
+
+			for (const MorphDelta_t& d : deltas)
+			{
+				float* p = &aDst[d.vertex].position.x;
+				float* n = &aDst[d.vertex].normal.x;
+
+				_mm_storeu_ps(p, _mm_add_ps(_mm_loadu_ps(p), _mm_mul_ps(_mm_and_ps(_mm_loadu_ps(&d.position.x), mask), vw)));
+				_mm_storeu_ps(n, _mm_add_ps(_mm_loadu_ps(n), _mm_mul_ps(_mm_and_ps(_mm_loadu_ps(&d.normal.x), mask), vw)));
+			}
+#else
+			for (const MorphDelta_t& d : deltas)
+			{
+				aDst[d.vertex].position += d.position * w;
+				aDst[d.vertex].normal += d.normal * w;
+			}
+#endif
+		}
+	}
+
+}
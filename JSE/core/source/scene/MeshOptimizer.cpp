@@ -0,0 +1,182 @@
+#include <vector>
+#include <algorithm>
+
+#include "scene/MeshOptimizer.hpp"
+
+namespace jse {
+
+	static int MeshOpt_SkipDeadEnd(const std::vector<unsigned>& aLiveTris, std::vector<unsigned>& aDeadEnd, int& aCursor, const int aNumVertices)
+	{
+		while (!aDeadEnd.empty())
+		{
+			const unsigned d = aDeadEnd.back();
+			aDeadEnd.pop_back();
+
+			if (aLiveTris[d] > 0)
+				return int(d);
+		}
+
+		while (aCursor + 1 < aNumVertices)
+		{
+			aCursor++;
+			if (aLiveTris[aCursor] > 0)
+				return aCursor;
+		}
+
+		return -1;
+	}
+
+	void MeshOpt_OptimizeVertexCache(ShortPrimitiveIndices& aIndices, const size_t aNumVertices, const unsigned aCacheSize)
+	{
+		const size_t numTris = aIndices.size() / 3;
+		if (numTris == 0 || aNumVertices == 0)
+			return;
+
+		/* vertex -> triangle adjacency */
+
+		std::vector<unsigned> liveTris(aNumVertices, 0);
+		for (size_t i = 0; i < numTris * 3; ++i)
+		{
+			liveTris[aIndices[i]]++;
+		}
+
+		std::vector<unsigned> adjOffset(aNumVertices + 1, 0);
+		for (size_t v = 0; v < aNumVertices; ++v)
+		{
+			adjOffset[v + 1] = adjOffset[v] + liveTris[v];
+		}
+
+		std::vector<unsigned> adjacency(numTris * 3);
+		{
+			std::vector<unsigned> fill(adjOffset.begin(), adjOffset.end() - 1);
+			for (size_t t = 0; t < numTris; ++t)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					const unsigned v = aIndices[t * 3 + c];
+					adjacency[fill[v]++] = unsigned(t);
+				}
+			}
+		}
+
+		std::vector<unsigned> cacheTime(aNumVertices, 0);
+		std::vector<char> emitted(numTris, 0);
+		std::vector<unsigned> deadEnd;
+		std::vector<unsigned> candidates;
+		ShortPrimitiveIndices result;
+		result.reserve(numTris * 3);
+
+		const int numVerts = int(aNumVertices);
+		unsigned timeStamp = aCacheSize + 1;
+		int cursor = 0;
+		int fanning = 0;
+
+		while (fanning >= 0)
+		{
+			candidates.clear();
+
+			for (unsigned a = adjOffset[fanning]; a < adjOffset[fanning + 1]; ++a)
+			{
+				const unsigned t = adjacency[a];
+				if (emitted[t])
+					continue;
+
+				for (int c = 0; c < 3; ++c)
+				{
+					const unsigned short v = aIndices[t * 3 + c];
+					result.push_back(v);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					liveTris[v]--;
+
+					if (timeStamp - cacheTime[v] > aCacheSize)
+					{
+						cacheTime[v] = timeStamp++;
+					}
+				}
+
+				emitted[t] = 1;
+			}
+
+			/* pick the next fanning vertex */
+
+			int best = -1;
+			int bestPriority = -1;
+
+			for (const unsigned v : candidates)
+			{
+				if (liveTris[v] == 0)
+					continue;
+
+				int priority = 0;
+				if (timeStamp - cacheTime[v] + 2 * liveTris[v] <= aCacheSize)
+				{
+					priority = int(timeStamp - cacheTime[v]);
+				}
+
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					best = int(v);
+				}
+			}
+
+			if (best == -1)
+			{
+				best = MeshOpt_SkipDeadEnd(liveTris, deadEnd, cursor, numVerts);
+			}
+
+			fanning = best;
+		}
+
+		aIndices.swap(result);
+	}
+
+	void MeshOpt_OptimizeVertexFetch(VertexDataVec& aVertices, ShortPrimitiveIndices& aIndices, std::vector<unsigned>* aRemap)
+	{
+		const unsigned kUnused = kMeshOptimizerUnused;
+		std::vector<unsigned> remap(aVertices.size(), kUnused);
+
+		VertexDataVec result;
+		result.reserve(aVertices.size());
+
+		for (auto& idx : aIndices)
+		{
+			if (remap[idx] == kUnused)
+			{
+				remap[idx] = unsigned(result.size());
+				result.push_back(aVertices[idx]);
+			}
+
+			idx = static_cast<unsigned short>(remap[idx]);
+		}
+
+		aVertices.swap(result);
+
+		if (aRemap)
+		{
+			aRemap->swap(remap);
+		}
+	}
+
+	float MeshOpt_GetACMR(const ShortPrimitiveIndices& aIndices, const size_t aNumVertices, const unsigned aCacheSize)
+	{
+		if (aIndices.size() < 3)
+			return 0.0f;
+
+		// FIFO cache emulated with insertion timestamps
+		std::vector<size_t> insertedAt(aNumVertices, 0);
+		size_t misses = 0;
+
+		for (const unsigned short v : aIndices)
+		{
+			if (insertedAt[v] == 0 || misses + 1 - insertedAt[v] >= aCacheSize + 1)
+			{
+				misses++;
+				insertedAt[v] = misses;
+			}
+		}
+
+		return float(misses) / float(aIndices.size() / 3);
+	}
+}
@@ -1,15 +1,20 @@
 #include "system/SystemTypes.hpp"
 #include "scene/Node3d.hpp"
 #include "scene/Animation.hpp"
+#include "math/Mat4.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/matrix_decompose.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <algorithm>
+#include <cmath>
 
 namespace jse {
 
+	// bumped by SetVisible, scenes rebuild their bounds when it changes
+	static u32 sNode3dVisibilityRevision = 0;
+
 	Node3d::Node3d() : Node3d("unknown")
 	{
 	}
@@ -67,6 +72,18 @@ namespace jse {
 			SetTransformUpdated();
 	}
 
+	void Node3d::SetLocalTransform(const Vector3f& aTranslation, const Quat& aRotation, const Vector3f& aScale)
+	{
+		Matrix mtxModel = glm::mat4_cast(aRotation);
+
+		mtxModel[0] *= aScale.x;
+		mtxModel[1] *= aScale.y;
+		mtxModel[2] *= aScale.z;
+		mtxModel[3] = vec4(aTranslation, 1.0f);
+
+		SetTransform(mtxModel, true);
+	}
+
 	void Node3d::UpdateRTS()
 	{
 		vec3 tmp1;
@@ -75,9 +92,44 @@ namespace jse {
 		glm::decompose(m_mtxModel, mScale, mRotation, mPosition, tmp1, tmp2);
 	}
 
+	void Node3d::SetMorphWeights(const std::vector<float>& aWeights)
+	{
+		mMorphWeights = aWeights;
+	}
+
+	void Node3d::SetMorphWeight(const size_t aTarget, const float aWeight)
+	{
+		if (aTarget >= mMorphWeights.size())
+		{
+			mMorphWeights.resize(aTarget + 1, 0.0f);
+		}
+
+		mMorphWeights[aTarget] = aWeight;
+	}
+
+	bool Node3d::HasActiveMorph() const
+	{
+		for (const float w : mMorphWeights)
+		{
+			if (std::abs(w) >= kMorphMinWeight)
+				return true;
+		}
+
+		return false;
+	}
+
 	void Node3d::SetVisible(const bool a0)
 	{
-		mVisible = a0;
+		if (mVisible != a0)
+		{
+			mVisible = a0;
+			++sNode3dVisibilityRevision;
+		}
+	}
+
+	u32 Node3d::GetVisibilityRevision()
+	{
+		return sNode3dVisibilityRevision;
 	}
 	
 	const Matrix& Node3d::GetModelMatrix() const
@@ -107,9 +159,12 @@ namespace jse {
 		if (mTransformUpdated)
 		{
 			mTransformUpdated = false;
+			++mWorldRevision;
 			if (mParentNode)
 			{
-				m_mtxWorld = mParentNode->GetWorldMatrix() * m_mtxModel;
+				// flags are set down the hierarchy, a flagged parent is brought up to date first
+				mParentNode->UpdateWorldTransform();
+				Mat4_Mul(mParentNode->GetWorldMatrix(), m_mtxModel, m_mtxWorld);
 			}
 			else
 			{
@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <vector>
 #include <stack>
+#include <set>
 #include <memory>
 #include <functional>
 
@@ -14,21 +15,68 @@
 #include "scene/Animation.hpp"
 #include "scene/AnimationTrack.hpp"
 #include "scene/GltfLoader.hpp"
+#include "scene/BinarySceneLoader.hpp"
+#include "scene/SceneFile.hpp"
+#include "scene/Skin.hpp"
+#include "math/Mat4.hpp"
 #include "system/Logger.hpp"
 #include "system/Strings.hpp"
 
 #include "graphics/GraphicsDriver.hpp"
 #include "graphics/GpuShader.hpp"
 #include "graphics/Renderable.hpp"
+#include "graphics/TextureArray.hpp"
 
 #define SCENE_ALIGN16(x) (((x) + 15) & ~15)
 
 namespace jse {
 
 
+	// UniformLight against the LightBuffer block of lights.glsl, element 1 checks the array stride
+	static const UniformLayoutMember_t kLightBufferLayout[] = {
+		{ "lights[0].position", ShaderDataType_Vec4, offsetof(UniformLight, position) },
+		{ "lights[0].diffuse", ShaderDataType_Vec4, offsetof(UniformLight, diffuse) },
+		{ "lights[0].specular", ShaderDataType_Vec4, offsetof(UniformLight, specular) },
+		{ "lights[0].kl", ShaderDataType_Float, offsetof(UniformLight, kl) },
+		{ "lights[0].kq", ShaderDataType_Float, offsetof(UniformLight, kq) },
+		{ "lights[0].cutoff", ShaderDataType_Float, offsetof(UniformLight, cutoff) },
+		{ "lights[1].position", ShaderDataType_Vec4, sizeof(UniformLight) + offsetof(UniformLight, position) }
+	};
+
+	// Skin palettes, element 1 checks the array stride
+	static const UniformLayoutMember_t kJointBufferLayout[] = {
+		{ "joints[0]", ShaderDataType_Mat4, 0 },
+		{ "joints[1]", ShaderDataType_Mat4, sizeof(Matrix) }
+	};
+
 	bool Scene_MeshOrderComparator(const DrawEntityDef_t& a0, const DrawEntityDef_t& a1)
 	{
-		return a0.mMaterial < a1.mMaterial;
+		// texture arrays inside a material bucket, one bind per array
+		if (a0.mMaterial != a1.mMaterial)
+			return a0.mMaterial < a1.mMaterial;
+
+		if (a0.mTextureArray != a1.mTextureArray)
+			return a0.mTextureArray < a1.mTextureArray;
+
+		// skinned draws last, the shader variant or the vertex array changes once
+		if ((a0.mPalette >= 0) != (a1.mPalette >= 0))
+			return a1.mPalette >= 0;
+
+		return a0.mDynamicBase < a1.mDynamicBase;
+	}
+
+	static VertexArrayAttributes Scene_GetVertexAttributes(const BufferObject* aVb)
+	{
+		VertexArrayAttributes vAttr;
+		vAttr.AddVertexAttrib(VertexBufferElement_Position,	VtxAttribType_Float, 3, kVertexDataSize, 0, aVb);
+		vAttr.AddVertexAttrib(VertexBufferElement_Normal,	VtxAttribType_Float, 3, kVertexDataSize, 0, aVb);
+		vAttr.AddVertexAttrib(VertexBufferElement_Tangent,	VtxAttribType_Float, 3, kVertexDataSize, 0, aVb);
+		vAttr.AddVertexAttrib(VertexBufferElement_BiTangent,VtxAttribType_Float, 3, kVertexDataSize, 0, aVb);
+		vAttr.AddVertexAttrib(VertexBufferElement_Texture0,	VtxAttribType_Float, 2, kVertexDataSize, 0, aVb);
+		vAttr.AddVertexAttrib(VertexBufferElement_User0,	VtxAttribType_UByteInt, 4, kVertexDataSize, 0, aVb);	// joints
+		vAttr.AddVertexAttrib(VertexBufferElement_User1,	VtxAttribType_UByte, 4, kVertexDataSize, 0, aVb);		// weights
+
+		return vAttr;
 	}
 
 
@@ -41,18 +89,42 @@ namespace jse {
 		mRootNode = Node3d("ROOT");
 		mRootNode.SetVisible(true);
 		mCurrentShader = nullptr;
+		mTextureArrays = nullptr;
 		mSm = aShaderManager;
+		mVA = nullptr;
+		mBuffers[0] = mBuffers[1] = nullptr;
+		mLightsBuffer = nullptr;
+		mJointsBuffer = nullptr;
+		mDynamicVB = nullptr;
+		mDynamicVA = nullptr;
+		mPaletteAlign = 1;
+		mCpuSkinning = false;
+		mBoundsDirty = true;
+		mVisibilityRevision = 0;
 		mDefaultLightRadius = 1.0;
 		mDefaultLightRadius2 = 1.0;
 
 		mV = mP = mVP = mMVP = Matrix(1.0f);
 
+		// programs built before this are checked now, the others when they link
+		if (mSm && !mSm->RegisterUniformLayout("LightBuffer", kLightBufferLayout, sizeof(kLightBufferLayout) / sizeof(kLightBufferLayout[0])))
+		{
+			Error("Scene %s: UniformLight does not match LightBuffer, the programs using it are disabled", mName.c_str());
+		}
+		if (mSm && !mSm->RegisterUniformLayout("JointBuffer", kJointBufferLayout, sizeof(kJointBufferLayout) / sizeof(kJointBufferLayout[0])))
+		{
+			Error("Scene %s: the joint palette does not match JointBuffer, the programs using it are disabled", mName.c_str());
+		}
+
 		Init();
 	}
 
 	Scene::~Scene()
 	{
 		delete mLightsBuffer;
+		delete mJointsBuffer;
+		delete mDynamicVA;
+		delete mDynamicVB;
 		if (mBuffers[0]) delete mBuffers[0];
 		if (mBuffers[1]) delete mBuffers[1];
 		if (mVA) delete mVA;
@@ -93,7 +165,12 @@ namespace jse {
 			}
 		});
 
-		mLightsBuffer->BindToIndex(0);
+		// scenes loaded without a driver (offline tools) have no GPU side
+		if (!mLightsBuffer)
+			return;
+
+		const int binding = mSm ? mSm->GetUniformBlockBinding("LightBuffer") : -1;
+		mLightsBuffer->BindToIndex(binding >= 0 ? binding : 0);
 		mLightsBuffer->Reset();
 		mLightsBuffer->Alloc(mUniformLights.size() * sizeof(UniformLight), mUniformLights.data());
 	}
@@ -117,6 +194,8 @@ namespace jse {
 			aParent->AddChildNode(aNode);
 		else
 			mRootNode.AddChildNode(aNode);
+
+		mBoundsDirty = true;
 	}
 
 	size_t Scene::AddMesh(const Mesh3d& aSrc)
@@ -125,6 +204,31 @@ namespace jse {
 		newMesh->vertices = aSrc.vertices;
 		newMesh->indices = aSrc.indices;
 		newMesh->mMaterial = aSrc.mMaterial;
+		newMesh->mMorphTargets = aSrc.mMorphTargets;
+		if (aSrc.mExternalVertices)
+		{
+			newMesh->SetExternalData(aSrc.mExternalOwner, aSrc.mExternalVertices, aSrc.mExternalNumVertices, aSrc.mExternalIndices, aSrc.mExternalNumIndices);
+		}
+
+		const size_t res = mMeshes.size();
+		newMesh->SetIndex(res);
+
+		mMeshes.push_back(newMesh);
+
+		return res;
+	}
+
+	size_t Scene::AddMesh(Mesh3d&& aSrc)
+	{
+		auto newMesh = std::make_shared<Mesh3d>(aSrc.mName);
+		newMesh->vertices = std::move(aSrc.vertices);
+		newMesh->indices = std::move(aSrc.indices);
+		newMesh->mMaterial = aSrc.mMaterial;
+		newMesh->mMorphTargets = std::move(aSrc.mMorphTargets);
+		if (aSrc.mExternalVertices)
+		{
+			newMesh->SetExternalData(std::move(aSrc.mExternalOwner), aSrc.mExternalVertices, aSrc.mExternalNumVertices, aSrc.mExternalIndices, aSrc.mExternalNumIndices);
+		}
 
 		const size_t res = mMeshes.size();
 		newMesh->SetIndex(res);
@@ -146,24 +250,65 @@ namespace jse {
 
 	bool Scene::LoadScene(const String& aFileName, const bool aToYUp)
 	{
-		std::unique_ptr<SceneLoader> loader = std::make_unique<GltfLoader>(*this);
-
-		int res = loader->LoadScene(aFileName);
-		if (res != 0) return res;
+		if (!LoadSceneData(aFileName))
+			return false;
 
-		
 		UpdateLights();
 
 		Info("Scene loaded!");
+
+		return true;
+	}
+
+	bool Scene::LoadSceneData(const String& aFileName)
+	{
+		std::unique_ptr<SceneLoader> loader;
+
+		const String ext = kSceneFileExt;
+		if (aFileName.size() > ext.size() && aFileName.compare(aFileName.size() - ext.size(), ext.size(), ext) == 0)
+		{
+			loader = std::make_unique<BinarySceneLoader>(*this);
+		}
+		else
+		{
+			loader = std::make_unique<GltfLoader>(*this);
+		}
+
+		int res = loader->LoadScene(aFileName);
+
+		return res == 0;
+	}
+
+	bool Scene::SaveScene(const String& aFileName)
+	{
+		SceneFileWriter writer(*this);
+
+		return writer.Write(aFileName);
 	}
 
 	bool Scene::Compile()
+	{
+		if (!BeginCompile())
+			return false;
+
+		for (size_t i = 0; i < mMeshes.size(); i++)
+		{
+			UploadMesh(i);
+		}
+
+		return EndCompile();
+	}
+
+	bool Scene::BeginCompile()
 	{
 		if (mCompiled)
 		{
 			delete mVA;
 			delete mBuffers[0];
 			delete mBuffers[1];
+			delete mDynamicVA;
+			mVA = nullptr;
+			mDynamicVA = nullptr;
 			mIndexBufferHandles.clear();
 			mVertexBufferHandles.clear();
 		}
@@ -177,70 +322,137 @@ namespace jse {
 
 		for (unsigned int i = 0; i < mMeshes.size(); i++)
 		{
-			l_requiredVertexBufferSize += (mMeshes[i]->vertices.size() * kVertexDataSize);
-			l_requiredIndexBufferSize += SCENE_ALIGN16(mMeshes[i]->indices.size() * sizeof(unsigned short));
+			FlatBufferHandle_t vtxH, idxH;
+
+			vtxH.size = mMeshes[i]->GetVertexCount() * kVertexDataSize;
+			vtxH.offset = l_requiredVertexBufferSize;
+			idxH.size = SCENE_ALIGN16(mMeshes[i]->GetIndexCount() * sizeof(unsigned short));
+			idxH.offset = l_requiredIndexBufferSize;
+
+			l_requiredVertexBufferSize += vtxH.size;
+			l_requiredIndexBufferSize += idxH.size;
+
+			mVertexBufferHandles.push_back(vtxH);
+			mIndexBufferHandles.push_back(idxH);
 		}
 
 		mBuffers[0] = mGd->CreateBuffer(BufferTarget_Vertex, BufferUsage_StaticDraw, l_requiredVertexBufferSize);
 		mBuffers[1] = mGd->CreateBuffer(BufferTarget_Index, BufferUsage_StaticDraw, l_requiredIndexBufferSize);
 
-		BufferObject* vb = mBuffers[0];
-		BufferObject* ib = mBuffers[1];
+		// reserve the whole range, meshes are filled in by UploadMesh
+		mBuffers[0]->Alloc(int(l_requiredVertexBufferSize), nullptr);
+		mBuffers[1]->Alloc(int(l_requiredIndexBufferSize), nullptr);
+
+		return true;
+	}
 
-		vb->Bind();
-		ib->Bind();
+	size_t Scene::UploadMesh(const size_t aIndex)
+	{
+		Mesh3d* m = mMeshes[aIndex].get();
+		const FlatBufferHandle_t& vtxH = mVertexBufferHandles[aIndex];
+		const FlatBufferHandle_t& idxH = mIndexBufferHandles[aIndex];
+		const size_t idxBytes = m->GetIndexCount() * sizeof(unsigned short);
 
-		for (int i = 0; i < mMeshes.size(); i++)
-		{
-			auto m = mMeshes[i];
-			FlatBufferHandle_t vtxH, idxH;
+		m->BuildBvh();
 
-			vtxH.size = m->vertices.size() * kVertexDataSize;
-			vtxH.offset = vb->GetAlloced();
-			vb->Alloc(vtxH.size, m->vertices.data());
+		// may run between frames, keep the vertex array of the scene being drawn intact
+		if (mVA) mVA->UnBind();
 
-			idxH.size = SCENE_ALIGN16( m->indices.size() * sizeof(unsigned short) );
-			idxH.offset = ib->GetAlloced();
-			ib->Alloc(idxH.size, nullptr);
-			ib->UpdateData(idxH.offset, m->indices.size() * sizeof(unsigned short), m->indices.data());
+		if (vtxH.size)
+		{
+			mBuffers[0]->Bind();
+			mBuffers[0]->UpdateData(vtxH.offset, int(vtxH.size), m->GetVertexData());
+		}
 
-			mIndexBufferHandles.push_back(idxH);
-			mVertexBufferHandles.push_back(vtxH);
+		if (idxBytes)
+		{
+			mBuffers[1]->Bind();
+			mBuffers[1]->UpdateData(idxH.offset, int(idxBytes), m->GetIndexData());
 		}
 
-		
+		return vtxH.size + idxBytes;
+	}
+
+	bool Scene::EndCompile()
+	{
+		BufferObject* vb = mBuffers[0];
+		BufferObject* ib = mBuffers[1];
+
 		// Create Vertex array
-		VertexArrayAttributes vAttr;
-		vAttr.AddVertexAttrib(VertexBufferElement_Position,	VtxAttribType_Float, 3, kVertexDataSize, 0, vb);
-		vAttr.AddVertexAttrib(VertexBufferElement_Normal,	VtxAttribType_Float, 3, kVertexDataSize, 0, vb);
-		vAttr.AddVertexAttrib(VertexBufferElement_Tangent,	VtxAttribType_Float, 3, kVertexDataSize, 0, vb);
-		vAttr.AddVertexAttrib(VertexBufferElement_BiTangent,VtxAttribType_Float, 3, kVertexDataSize, 0, vb);
-		vAttr.AddVertexAttrib(VertexBufferElement_Texture0,	VtxAttribType_Float, 2, kVertexDataSize, 0, vb);
-		mVA = mGd->CreateVertexArray(ib, vAttr);
+		mVA = mGd->CreateVertexArray(ib, Scene_GetVertexAttributes(vb));
 
 		mVA->Compile();
 
+		PrepareShaders();
 
 		mCompiled = true;
 
 		return true;
 	}
 
+	void Scene::PrepareShaders()
+	{
+		if (!mSm)
+			return;
+
+		// the variants DrawList asks for: (material, features) of every mesh in both passes
+		std::set<std::pair<MaterialType, ShaderFeatures>> variants;
+		size_t numLights = 0;
+
+		WalkNodeHiearchy([&](Node3d* n) {
+			const Skin* skin = n->GetSkin();
+			const ShaderFeatures skinning = skin && skin->GetJointNum() && !mCpuSkinning ? ShaderFeatures_Skinning : ShaderFeatures_None;
+
+			for (const auto& r : n->GetRenderables())
+			{
+				if (r->GetType() == RenderableType::Light)
+				{
+					numLights++;
+					continue;
+				}
+
+				if (r->GetType() != RenderableType::Mesh)
+					continue;
+
+				const Mesh3d* mesh = reinterpret_cast<const Mesh3d*>(r.get());
+				const bool textureArray = mTextureArrays && mesh->mMaterial.textureArray >= 0;
+
+				variants.insert(std::make_pair(MaterialType_ZPass, skinning));
+				variants.insert(std::make_pair(mesh->mMaterial.type, skinning | ShaderFeatures_Fog | (textureArray ? ShaderFeatures_DiffuseArray : ShaderFeatures_None)));
+			}
+		});
+
+		const int maxLights = ShaderManager::GetVariantLights(numLights);
+
+		for (const auto& it : variants)
+		{
+			mSm->PrepareVariant(it.first, it.second, it.first == MaterialType_ZPass ? kMaxShaderLights : maxLights);
+		}
+	}
+
 	void Scene::Draw()
 	{
 
-		//if (m_sampleCount++ > 100) {
-		//	Info("m_drawCallsPerFrame: %d, m_stateChangePerFrame: %d", m_drawCallsPerFrame, m_stateChangePerFrame);
-		//	m_sampleCount = 0;
-		//}
+		// stats of the previous frame
+		if (mStatsLogInterval > 0 && ++m_sampleCount >= mStatsLogInterval)
+		{
+			const SceneFrameStats_t stats = GetFrameStats();
+			Info("Scene %s: %d draw calls, %d state changes, %d of %d animation tracks sampled", mName.c_str(), stats.drawCalls, stats.stateChanges,
+				int(stats.sampledTracks), int(stats.activeTracks));
+			m_sampleCount = 0;
+		}
 
 		m_drawCallsPerFrame = 0;
 		m_stateChangePerFrame = 0;
 
 		mDrawList.clear();
-		BuildDrawList(&mRootNode);
+		mPalettes.clear();
+		mDynamicVertices.clear();
+		BuildDrawList();
 		std::sort(mDrawList.begin(), mDrawList.end(), Scene_MeshOrderComparator);
 
+		UploadDynamicData();
+
 
 		/************************************
 		Render Z-Pass
@@ -273,9 +485,15 @@ namespace jse {
 		DrawList();
 
 		mGd->UseShader(NULL);
+		mVA->UnBind();
 
 	}
 
+	SceneFrameStats_t Scene::GetFrameStats() const
+	{
+		return SceneFrameStats_t{ m_drawCallsPerFrame, m_stateChangePerFrame, mAnimMgr.GetSampledTrackNum(), mAnimMgr.GetActiveTrackNum() };
+	}
+
 	float Scene::SetDefaultLightRadius(const float a0)
 	{
 		float prev = mDefaultLightRadius;
@@ -320,8 +538,11 @@ namespace jse {
 
 	void Scene::UpdateAnimation(const float aFrameStep)
 	{
+		// level of detail from the last camera update
+		mAnimMgr.SetLodView(mV, mP);
 		mAnimMgr.UpdateState(aFrameStep);
 		UpdateLights();
+		UpdateBounds();
 	}
 
 	MeshQueryResult Scene::GetMeshByName(const String& aName)
@@ -335,6 +556,301 @@ namespace jse {
 		return MeshQueryResult(nullptr, -1);
 	}
 
+	void Scene::CollectBoundsNodes(Node3d* aNode)
+	{
+		// hidden subtrees are left out like in CollectDrawNodes
+		if (!aNode->IsVisible())
+			return;
+
+		aNode->UpdateWorldTransform();
+
+		for (auto& r : aNode->GetRenderables())
+		{
+			if (r->GetType() != RenderableType::Mesh)
+				continue;
+
+			// meshes of scenes that were never compiled get their BVH here
+			Mesh3d* mesh = reinterpret_cast<Mesh3d*>(r.get());
+			if (!mesh->GetBvh())
+			{
+				mesh->BuildBvh();
+			}
+
+			if (!mesh->GetBvh()->IsEmpty())
+			{
+				mBounds.push_back({ aNode, mesh, AabbTree::kNull, 0, Aabb_t(), Matrix(1.0f) });
+			}
+		}
+
+		for (auto& it : aNode->GetChildren())
+		{
+			CollectBoundsNodes(it);
+		}
+	}
+
+	void Scene::UpdateBounds()
+	{
+		if (IsBoundsDirty())
+		{
+			mBoundsDirty = false;
+			mVisibilityRevision = Node3d::GetVisibilityRevision();
+			mBoundsTree.Clear();
+			mBounds.clear();
+
+			CollectBoundsNodes(&mRootNode);
+		}
+
+		// refit the nodes whose world matrix changed, the tree only moves the ones leaving their margin
+		for (size_t i = 0; i < mBounds.size(); ++i)
+		{
+			SceneBounds_t& b = mBounds[i];
+			b.node->UpdateWorldTransform();
+			if (b.proxy != AabbTree::kNull && b.revision == b.node->GetWorldRevision())
+				continue;
+
+			const Matrix& world = b.node->GetWorldMatrix();
+			b.bounds = Aabb_Transform(b.mesh->GetBvh()->GetBounds(), world);
+			b.revision = b.node->GetWorldRevision();
+			Mat4_AffineInverse(world, b.invWorld);
+
+			if (b.proxy == AabbTree::kNull)
+			{
+				b.proxy = mBoundsTree.CreateProxy(b.bounds, int(i));
+			}
+			else
+			{
+				mBoundsTree.MoveProxy(b.proxy, b.bounds);
+			}
+		}
+	}
+
+	static Ray_t Scene_LocalRay(const Ray_t& aRay, const Matrix& aInvWorld, const float aTMax)
+	{
+		// same t in both spaces, dir keeps the scale of the transform
+		Ray_t local;
+		local.origin = Vector3f(aInvWorld * Vector4f(aRay.origin, 1.0f));
+		local.dir = Matrix3x3(aInvWorld) * aRay.dir;
+		local.tMax = aTMax;
+
+		return local;
+	}
+
+	void Scene::FillRayHit(const SceneBounds_t& aEntry, const Ray_t& aRay, const TriangleHit_t& aTriHit, SceneRayHit_t& aHit) const
+	{
+		Vector3f c[3];
+		aEntry.mesh->GetBvh()->GetTriangle(aTriHit.triangle, c);
+
+		// normals transform with the inverse transpose
+		Vector3f normal = glm::transpose(Matrix3x3(aEntry.invWorld)) * glm::cross(c[1] - c[0], c[2] - c[0]);
+		const float len = glm::length(normal);
+		normal = len > 0.0f ? normal / len : Vector3f(0.0f);
+
+		aHit.node = aEntry.node;
+		aHit.mesh = aEntry.mesh;
+		aHit.triangle = aTriHit.triangle;
+		aHit.t = aTriHit.t;
+		aHit.position = aRay.origin + aTriHit.t * aRay.dir;
+		aHit.normal = glm::dot(normal, aRay.dir) > 0.0f ? -normal : normal;
+	}
+
+	bool Scene::TraceRay(const Ray_t& aRay, SceneRayHit_t& aHit, const bool aAnyHit)
+	{
+		// refits the nodes that moved since the last frame
+		UpdateBounds();
+
+		int hitEntry = -1;
+		TriangleHit_t hit;
+
+		mBoundsTree.RayCast(aRay, [&](const int aProxy, const float aTMax) {
+			const int entry = mBoundsTree.GetUser(aProxy);
+			const SceneBounds_t& b = mBounds[entry];
+
+			TriangleHit_t th;
+			th.t = aTMax;
+			if (!b.mesh->GetBvh()->RayCast(Scene_LocalRay(aRay, b.invWorld, aTMax), th, aAnyHit))
+				return aTMax;
+
+			hitEntry = entry;
+			hit = th;
+
+			return aAnyHit ? 0.0f : th.t;
+		});
+
+		aHit = SceneRayHit_t();
+		if (hitEntry < 0)
+			return false;
+
+		FillRayHit(mBounds[hitEntry], aRay, hit, aHit);
+
+		return true;
+	}
+
+	bool Scene::RayCast(const Ray_t& aRay, SceneRayHit_t& aHit)
+	{
+		return TraceRay(aRay, aHit, false);
+	}
+
+	bool Scene::SegmentCast(const Vector3f& aFrom, const Vector3f& aTo, SceneRayHit_t& aHit)
+	{
+		Ray_t ray;
+		ray.origin = aFrom;
+		ray.dir = aTo - aFrom;
+		ray.tMax = 1.0f;
+
+		return TraceRay(ray, aHit, false);
+	}
+
+	bool Scene::LineOfSight(const Vector3f& aFrom, const Vector3f& aTo)
+	{
+		Ray_t ray;
+		ray.origin = aFrom;
+		ray.dir = aTo - aFrom;
+		ray.tMax = 1.0f;
+
+		SceneRayHit_t hit;
+
+		return !TraceRay(ray, hit, true);
+	}
+
+	size_t Scene::RayCastBatch(const Ray_t* aRays, const size_t aCount, SceneRayHit_t* aHits)
+	{
+		// refits the nodes that moved since the last frame
+		UpdateBounds();
+
+		size_t numHits = 0;
+
+		for (size_t first = 0; first < aCount; first += kRayPacketSize)
+		{
+			const size_t num = std::min(aCount - first, size_t(kRayPacketSize));
+			Ray_t rays[kRayPacketSize];
+			TriangleHit_t hits[kRayPacketSize];
+			int entries[kRayPacketSize];
+
+			// the lanes past the end of a short packet repeat a ray with a negative end, which never hits
+			for (size_t i = 0; i < kRayPacketSize; ++i)
+			{
+				rays[i] = aRays[first + std::min(i, num - 1)];
+				if (i >= num)
+				{
+					rays[i].tMax = -1.0f;
+				}
+				entries[i] = -1;
+			}
+
+			mBoundsTree.RayCastPacket(rays, [&](const int aProxy, const int aMask, float* aEnds) {
+				const int entry = mBoundsTree.GetUser(aProxy);
+				const SceneBounds_t& b = mBounds[entry];
+
+				Ray_t local[kRayPacketSize];
+				TriangleHit_t th[kRayPacketSize];
+				for (int i = 0; i < kRayPacketSize; ++i)
+				{
+					th[i].t = (aMask >> i) & 1 ? aEnds[i] : -1.0f;
+					local[i] = Scene_LocalRay(rays[i], b.invWorld, th[i].t);
+				}
+
+				const int hitMask = b.mesh->GetBvh()->RayCastPacket(local, th);
+
+				for (int i = 0; i < kRayPacketSize; ++i)
+				{
+					if ((hitMask >> i) & 1)
+					{
+						hits[i] = th[i];
+						entries[i] = entry;
+						aEnds[i] = th[i].t;
+					}
+				}
+			});
+
+			for (size_t i = 0; i < num; ++i)
+			{
+				aHits[first + i] = SceneRayHit_t();
+
+				if (entries[i] >= 0)
+				{
+					FillRayHit(mBounds[entries[i]], rays[i], hits[i], aHits[first + i]);
+					++numHits;
+				}
+			}
+		}
+
+		return numHits;
+	}
+
+	void Scene::QueryAabb(const Aabb_t& aBox, std::vector<SceneOverlap_t>& aResults, const bool aTriangles)
+	{
+		// refits the nodes that moved since the last frame
+		UpdateBounds();
+
+		std::vector<int> triangles;
+
+		mBoundsTree.QueryAabb(aBox, [&](const int aProxy) {
+			const SceneBounds_t& b = mBounds[mBoundsTree.GetUser(aProxy)];
+
+			// the tree holds the bounds with the margin
+			if (!Aabb_Overlaps(b.bounds, aBox))
+				return true;
+
+			if (!aTriangles)
+			{
+				aResults.push_back({ b.node, b.mesh, -1 });
+				return true;
+			}
+
+			// candidates from the box in mesh space, exact test in world space
+			const Matrix& world = b.node->GetWorldMatrix();
+			triangles.clear();
+			b.mesh->GetBvh()->QueryAabb(Aabb_Transform(aBox, b.invWorld), triangles);
+
+			for (const int tri : triangles)
+			{
+				Vector3f c[3];
+				b.mesh->GetBvh()->GetTriangle(tri, c);
+
+				for (auto& p : c)
+				{
+					p = Vector3f(world * Vector4f(p, 1.0f));
+				}
+
+				if (TriangleBvh_OverlapsAabb(c, aBox))
+				{
+					aResults.push_back({ b.node, b.mesh, tri });
+				}
+			}
+
+			return true;
+		});
+	}
+
+	void Scene::QueryFrustum(const Frustum& aFrustum, std::vector<SceneOverlap_t>& aResults)
+	{
+		// refits the nodes that moved since the last frame
+		UpdateBounds();
+
+		mBoundsTree.QueryFrustum(aFrustum, [&](const int aProxy, const bool aInside) {
+			const SceneBounds_t& b = mBounds[mBoundsTree.GetUser(aProxy)];
+
+			if (aInside || aFrustum.TestAabb(b.bounds) != BoundingVolume::TEST_OUTSIDE)
+			{
+				aResults.push_back({ b.node, b.mesh, -1 });
+			}
+		});
+	}
+
+	Ray_t Scene::GetPickRay(const Vector2f& aNdc) const
+	{
+		const Matrix inv = glm::inverse(mVP);
+		const Vector4f nearPoint = inv * Vector4f(aNdc, -1.0f, 1.0f);
+		const Vector4f farPoint = inv * Vector4f(aNdc, 1.0f, 1.0f);
+
+		Ray_t ray;
+		ray.origin = Vector3f(nearPoint) / nearPoint.w;
+		ray.dir = Vector3f(farPoint) / farPoint.w - ray.origin;
+		ray.tMax = 1.0f;
+
+		return ray;
+	}
+
 	void Scene::WalkNodeHiearchy(std::function<void(Node3d*)> func)
 	{
 		std::stack<Node3d*> stk;
@@ -357,7 +873,7 @@ namespace jse {
 	}
 
 
-	void Scene::BuildDrawList(Node3d* node)
+	void Scene::CollectDrawNodes(Node3d* node)
 	{
 		if (!node->IsVisible())
 			return;
@@ -368,58 +884,205 @@ namespace jse {
 		{
 			for (auto& it : node->GetChildren())
 			{
-				BuildDrawList(it);
+				CollectDrawNodes(it);
 			}
 		}
 
-		const Matrix& M = node->GetWorldMatrix();
-		const Matrix NM = Matrix3x3(glm::transpose(glm::inverse(M)));
-		const Matrix MVP = mP * mV * M;
+		if (!node->GetRenderables().empty())
+		{
+			mDrawNodes.push_back(node);
+		}
+	}
+
+	void Scene::BuildDrawList()
+	{
+		mDrawNodes.clear();
+		CollectDrawNodes(&mRootNode);
+
+		// per node matrices in batches, MVP from the cached view projection
+		const size_t count = mDrawNodes.size();
+		mDrawWorld.resize(count);
+		mDrawNormal.resize(count);
+		mDrawMVP.resize(count);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			mDrawWorld[i] = mDrawNodes[i]->GetWorldMatrix();
+		}
+
+		Mat4_MulBatch(mVP, mDrawWorld.data(), mDrawMVP.data(), count);
+		Mat4_NormalMatrixBatch(mDrawWorld.data(), mDrawNormal.data(), count);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			AddMeshEntities(mDrawNodes[i], mDrawNormal[i], mDrawWorld[i], mDrawMVP[i]);
+		}
+
+		UpdateBounds();
+	}
+
+	void Scene::AddMeshEntities(Node3d* aNode, const Matrix& aNormalTrans, const Matrix& aModelTrans, const Matrix& aMVP)
+	{
+		const Skin* skin = aNode->GetSkin();
+		const bool morph = aNode->HasActiveMorph();
+		int palette = -1;
+
+		if (skin && skin->GetJointNum())
+		{
+			// joint world transforms are the ones of the last UpdateAnimation / UpdateLights
+			palette = int((mPalettes.size() + mPaletteAlign - 1) / mPaletteAlign * mPaletteAlign);
+			mPalettes.resize(palette + skin->GetJointNum());
+			skin->ComputePalette(aModelTrans, &mPalettes[palette]);
+		}
 
-		for (auto renderable : node->GetRenderables())
+		for (auto renderable : aNode->GetRenderables())
 		{
 			if (renderable->GetType() != RenderableType::Mesh)
 				continue;
 
 			Mesh3d* mesh = reinterpret_cast<Mesh3d*>(renderable.get());
+			const int textureArray = mTextureArrays ? mesh->mMaterial.textureArray : -1;
+			const bool morphed = morph && mesh->HasMorphTargets();
+			const bool cpuSkinned = palette >= 0 && mCpuSkinning;
+			int base = -1;
+
+			// morphed and CPU skinned vertices go to the dynamic buffer, morph first
+			if (morphed || cpuSkinned)
+			{
+				base = int(mDynamicVertices.size());
+				mDynamicVertices.resize(base + mesh->GetVertexCount());
+
+				VertexData* dst = &mDynamicVertices[base];
+
+				if (morphed)
+				{
+					Mesh3d_ApplyMorphTargets(*mesh, aNode->GetMorphWeights().data(), aNode->GetMorphWeights().size(), dst);
+				}
+				if (cpuSkinned)
+				{
+					Skin_SkinVertices(morphed ? dst : mesh->GetVertexData(), mesh->GetVertexCount(), &mPalettes[palette], dst);
+				}
+			}
 
-			mDrawList.emplace_back(mesh, mesh->mMaterial.type, NM, M, MVP);
+			mDrawList.emplace_back(mesh, mesh->mMaterial.type, textureArray, aNormalTrans, aModelTrans, aMVP, cpuSkinned ? -1 : palette, base);
 		}
 	}
 
-	void Scene::DrawList()
+	void Scene::UploadDynamicData()
 	{
-		MaterialType mtCurrent = mRPass == RenderPass_Z ? MaterialType_ZPass : MaterialType_LastEnum;
-		mCurrentShader = nullptr; 
+		if (!mCpuSkinning && !mPalettes.empty())
+		{
+			// the bound range always spans a whole JointBuffer block, keep that much behind the last palette
+			const size_t bytes = (mPalettes.size() + kMaxSkinJoints) * sizeof(Matrix);
 
-		const Vector3f cBlack(0.0f);
+			if (!mJointsBuffer || mJointsBuffer->Size() < bytes)
+			{
+				delete mJointsBuffer;
+				mJointsBuffer = mGd->CreateBuffer(BufferTarget_Uniform, BufferUsage_DynaDraw, bytes * 2);
+			}
+
+			mJointsBuffer->Bind();
+			mJointsBuffer->Orphan();
+			mJointsBuffer->Reset();
+			mJointsBuffer->Alloc(int(mPalettes.size() * sizeof(Matrix)), mPalettes.data());
+		}
 
-		if (mRPass == RenderPass_Z)
+		if (!mDynamicVertices.empty())
 		{
-			mCurrentShader = mSm->GetShaderByMaterial(mtCurrent);
-			mCurrentShader->Use();
-			mCurrentShader->SetInt("numLights", 0);
-			mCurrentShader->SetVector3("viewPos", &mViewPos[0]);
+			const size_t bytes = mDynamicVertices.size() * kVertexDataSize;
+
+			if (!mDynamicVB || mDynamicVB->Size() < bytes)
+			{
+				delete mDynamicVA;
+				delete mDynamicVB;
+				mDynamicVB = mGd->CreateBuffer(BufferTarget_Vertex, BufferUsage_DynaDraw, bytes * 2);
+				mDynamicVA = nullptr;
+			}
+
+			if (!mDynamicVA)
+			{
+				mDynamicVA = mGd->CreateVertexArray(mBuffers[1], Scene_GetVertexAttributes(mDynamicVB));
+				mDynamicVA->Compile();
+			}
+
+			mDynamicVB->Bind();
+			mDynamicVB->Orphan();
+			mDynamicVB->Reset();
+			mDynamicVB->Alloc(int(bytes), mDynamicVertices.data());
 		}
+	}
+
+	void Scene::DrawList()
+	{
+		MaterialType mtCurrent = MaterialType_LastEnum;
+		int arrayCurrent = -1;
+		int paletteCurrent = -1;
+		VertexArray* vaCurrent = nullptr;
+		ShaderFeatures featuresCurrent = ShaderFeatures_None;
+		mCurrentShader = nullptr; 
+
+		const int jointBinding = mSm->GetUniformBlockBinding("JointBuffer");
+
+		// light loop sized to the lights in the scene, the variants were prepared by EndCompile
+		const int maxLights = ShaderManager::GetVariantLights(mUniformLights.size());
+
+		const Vector3f cBlack(0.0f);
 
 		for (auto it = mDrawList.begin(); it != mDrawList.end(); it++)
 		{
 			DrawEntityDef_t ent = *it;
-			
-			if (mtCurrent != ent.mMaterial && mtCurrent != MaterialType_ZPass)
+
+			// the Z pass draws everything with the zpass program, skinned or not
+			const MaterialType material = mRPass == RenderPass_Z ? MaterialType_ZPass : ent.mMaterial;
+			ShaderFeatures features = ent.mPalette >= 0 ? ShaderFeatures_Skinning : ShaderFeatures_None;
+			if (mRPass != RenderPass_Z)
 			{
-				m_stateChangePerFrame++;
+				features |= ShaderFeatures_Fog | (ent.mTextureArray >= 0 ? ShaderFeatures_DiffuseArray : ShaderFeatures_None);
+			}
 
-				mtCurrent = ent.mMaterial;
-				mCurrentShader = mSm->GetShaderByMaterial(mtCurrent);
-				mCurrentShader->Use();
-				mCurrentShader->SetVector3("viewPos", &mViewPos[0]);
-				mCurrentShader->BindUniformBlock("LightBuffer", 0);
+			if (mtCurrent != material || features != featuresCurrent)
+			{
+				m_stateChangePerFrame++;
 
-				if (mRPass == RenderPass_Light)
+				mtCurrent = material;
+				featuresCurrent = features;
+				mCurrentShader = mSm->GetShaderByMaterial(mtCurrent, features, mRPass == RenderPass_Z ? kMaxShaderLights : maxLights);
+				if (!mCurrentShader)
 				{
-					mCurrentShader->SetInt("numLights", mUniformLights.size());
+					mCurrentShader = mSm->GetShaderByMaterial(mtCurrent);
 				}
+				if (mCurrentShader)
+				{
+					mCurrentShader->Use();
+					mCurrentShader->SetVector3("viewPos", &mViewPos[0]);
+					mCurrentShader->SetInt("numLights", mRPass == RenderPass_Light ? int(mUniformLights.size()) : 0);
+				}
+			}
+
+			// failed programs (compile, link or uniform layout) draw nothing
+			if (!mCurrentShader)
+				continue;
+
+			VertexArray* va = ent.mDynamicBase >= 0 ? mDynamicVA : mVA;
+			if (va != vaCurrent)
+			{
+				vaCurrent = va;
+				vaCurrent->Bind();
+			}
+
+			if (ent.mPalette >= 0 && ent.mPalette != paletteCurrent && jointBinding >= 0)
+			{
+				paletteCurrent = ent.mPalette;
+				mJointsBuffer->BindToIndexRange(jointBinding, unsigned(ent.mPalette * sizeof(Matrix)), kMaxSkinJoints * sizeof(Matrix));
+			}
+
+			if (ent.mTextureArray != arrayCurrent && mRPass != RenderPass_Z && ent.mTextureArray >= 0)
+			{
+				arrayCurrent = ent.mTextureArray;
+
+				Texture* array = mTextureArrays->GetArray(arrayCurrent);
+				array->SetTextureUnit(TextureUnit_0);
+				array->Bind();
 			}
 
 			mCurrentShader->SetMatrix("M", &ent.mModelTrans[0][0]);
@@ -427,18 +1090,18 @@ namespace jse {
 			mCurrentShader->SetMatrix("MVP", &ent.mMVP[0][0]);
 
 
-			DrawMesh(ent.mPtr);
+			DrawMesh(ent.mPtr, ent.mDynamicBase);
 		}
 	}
 
-	void Scene::DrawMesh(const Mesh3d* aMesh)
+	void Scene::DrawMesh(const Mesh3d* aMesh, const int aBaseVertex)
 	{
 		const Mesh3d* m = aMesh;
 		const Vector3f kBlack(0.0f);
 
 		FlatBufferHandle_t vtxH = mVertexBufferHandles[aMesh->GetIndex()];
 		FlatBufferHandle_t idxH = mIndexBufferHandles[aMesh->GetIndex()];
-		size_t baseVert = vtxH.offset / sizeof(VertexData);
+		size_t baseVert = aBaseVertex >= 0 ? size_t(aBaseVertex) : vtxH.offset / sizeof(VertexData);
 
 		if (mRPass == RenderPass_Light)
 		{
@@ -446,6 +1109,13 @@ namespace jse {
 			mCurrentShader->SetVector3("material.diffuse", &m->mMaterial.diffuse[0]);
 			mCurrentShader->SetVector3("material.specular", &m->mMaterial.specular[0]);
 			mCurrentShader->SetFloat("material.shininess", m->mMaterial.specularIntesity);
+
+			if (m->mMaterial.textureArray >= 0 && mTextureArrays)
+			{
+				// cached by state, a bind only when the material samples differently
+				mGd->BindSampler(TextureUnit_0, m->mMaterial.sampler);
+				mCurrentShader->SetInt("material.layer", m->mMaterial.textureLayer);
+			}
 		}
 		else
 		{
@@ -457,11 +1127,17 @@ namespace jse {
 
 		m_drawCallsPerFrame++;
 
-		mGd->DrawPrimitivesWithBase(PrimitiveType_Triangles, m->indices.size(), idxH.offset, baseVert);
+		mGd->DrawPrimitivesWithBase(PrimitiveType_Triangles, m->GetIndexCount(), idxH.offset, baseVert);
 	}
 
 	void Scene::Init()
 	{
+		if (!mGd)
+			return;
+
 		mLightsBuffer = mGd->CreateBuffer(BufferTarget_Uniform, BufferUsage_DynaDraw, 256ULL*64);
+
+		const int align = mGd->GetCaps(GraphicsCaps_UniformBufferOffsetAlignment);
+		mPaletteAlign = std::max(1, (align + int(sizeof(Matrix)) - 1) / int(sizeof(Matrix)));
 	}
 }
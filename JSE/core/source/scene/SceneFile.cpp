@@ -0,0 +1,349 @@
+#include <fstream>
+#include <map>
+#include <stack>
+#include <cstring>
+
+#include "scene/SceneFile.hpp"
+#include "scene/Scene.hpp"
+#include "scene/Mesh3d.hpp"
+#include "scene/Node3d.hpp"
+#include "scene/Light.hpp"
+#include "scene/Animation.hpp"
+#include "scene/AnimationTrack.hpp"
+#include "scene/Skin.hpp"
+#include "system/Logger.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+namespace jse {
+
+	static size_t SceneFile_Align(const size_t aValue, const size_t aAlign)
+	{
+		return (aValue + aAlign - 1) & ~(aAlign - 1);
+	}
+
+	class SceneFile_StringTable
+	{
+	public:
+		u32 Add(const String& aStr)
+		{
+			auto it = mOffsets.find(aStr);
+			if (it != mOffsets.end())
+				return it->second;
+
+			const u32 offset = u32(mData.size());
+			mData.insert(mData.end(), aStr.begin(), aStr.end());
+			mData.push_back(0);
+			mOffsets.insert(std::make_pair(aStr, offset));
+
+			return offset;
+		}
+
+		const ByteVector& GetData() const { return mData; }
+
+	private:
+		ByteVector mData;
+		std::map<String, u32> mOffsets;
+	};
+
+	// morph deltas are copied as is in both directions
+	static_assert(sizeof(SceneFileMorphDelta_t) == sizeof(MorphDelta_t), "SceneFileMorphDelta_t must match MorphDelta_t");
+
+	template<class T>
+	static void SceneFile_SetSection(SceneFileHeader_t& aHeader, const SceneFileSection aSection, const std::vector<T>& aVec)
+	{
+		aHeader.sections[aSection].size = aVec.size() * sizeof(T);
+		aHeader.sections[aSection].count = u32(aVec.size());
+	}
+
+	bool SceneFileWriter::Write(const String& aFileName)
+	{
+		SceneFile_StringTable strings;
+		std::vector<SceneFileNode_t> nodes;
+		std::vector<u32> meshRefs;
+		std::vector<SceneFileMesh_t> meshes;
+		std::vector<SceneFileMaterial_t> materials;
+		std::vector<SceneFileLight_t> lights;
+		std::vector<SceneFileAnimation_t> anims;
+		std::vector<SceneFileTrack_t> tracks;
+		std::vector<SceneFileKey_t> keys;
+		std::vector<SceneFileSkin_t> skins;
+		std::vector<SceneFileSkinJoint_t> skinJoints;
+		std::vector<SceneFileMorphTarget_t> morphTargets;
+		std::vector<SceneFileMorphDelta_t> morphDeltas;
+		std::vector<float> morphWeights;
+		ByteVector vertexBlob;
+		ByteVector indexBlob;
+
+		/* Meshes, one material record per mesh */
+
+		for (const auto& m : mScene.mMeshes)
+		{
+			SceneFileMesh_t fm{};
+			fm.name = strings.Add(m->GetName());
+			fm.material = u32(materials.size());
+			fm.numVertices = u32(m->GetVertexCount());
+			fm.numIndices = u32(m->GetIndexCount());
+			fm.firstMorphTarget = u32(morphTargets.size());
+			fm.numMorphTargets = u32(m->GetMorphTargets().size());
+
+			for (const auto& target : m->GetMorphTargets())
+			{
+				SceneFileMorphTarget_t ft{};
+				ft.firstDelta = u32(morphDeltas.size());
+				ft.numDeltas = u32(target.deltas.size());
+				morphTargets.push_back(ft);
+
+				morphDeltas.resize(morphDeltas.size() + target.deltas.size());
+				if (ft.numDeltas) std::memcpy(&morphDeltas[ft.firstDelta], target.deltas.data(), ft.numDeltas * sizeof(SceneFileMorphDelta_t));
+			}
+
+			// same alignment rules as Scene::Compile
+			fm.vertexOffset = vertexBlob.size();
+			const size_t vtxBytes = m->GetVertexCount() * kVertexDataSize;
+			vertexBlob.resize(vertexBlob.size() + vtxBytes);
+			if (vtxBytes) std::memcpy(vertexBlob.data() + fm.vertexOffset, m->GetVertexData(), vtxBytes);
+
+			fm.indexOffset = indexBlob.size();
+			const size_t idxBytes = m->GetIndexCount() * sizeof(unsigned short);
+			indexBlob.resize(SceneFile_Align(indexBlob.size() + idxBytes, 16), 0);
+			if (idxBytes) std::memcpy(indexBlob.data() + fm.indexOffset, m->GetIndexData(), idxBytes);
+
+			const Material& mat = m->GetMaterial();
+			SceneFileMaterial_t fmat{};
+			fmat.type = u32(mat.type);
+			std::memcpy(fmat.ambient, &mat.ambient[0], sizeof(fmat.ambient));
+			std::memcpy(fmat.diffuse, &mat.diffuse[0], sizeof(fmat.diffuse));
+			std::memcpy(fmat.specular, &mat.specular[0], sizeof(fmat.specular));
+			fmat.specularIntensity = mat.specularIntesity;
+			fmat.alpha = mat.alpha;
+
+			materials.push_back(fmat);
+			meshes.push_back(fm);
+		}
+
+		/* Node hierarchy, parents first */
+
+		std::map<const Node3d*, u32> nodeIndex;
+		std::map<const Skin*, u32> skinIndex;
+
+		for (size_t i = 0; i < mScene.mSkins.size(); ++i)
+		{
+			skinIndex.insert(std::make_pair(mScene.mSkins[i].get(), u32(i)));
+		}
+		std::stack<std::pair<const Node3d*, u32>> stk;
+
+		for (auto it = mScene.mRootNode.GetChildren().rbegin(); it != mScene.mRootNode.GetChildren().rend(); ++it)
+		{
+			stk.push(std::make_pair(*it, kSceneFileNoIndex));
+		}
+
+		while (!stk.empty())
+		{
+			const Node3d* n = stk.top().first;
+			const u32 parent = stk.top().second;
+			stk.pop();
+
+			SceneFileNode_t fn{};
+			fn.name = strings.Add(n->GetName());
+			fn.parent = parent;
+			fn.flags = n->IsVisible() ? SceneFileNodeFlag_Visible : 0;
+			fn.firstMeshRef = u32(meshRefs.size());
+			fn.light = kSceneFileNoIndex;
+			fn.skin = n->GetSkin() ? skinIndex[n->GetSkin()] : kSceneFileNoIndex;
+			fn.firstMorphWeight = u32(morphWeights.size());
+			fn.numMorphWeights = u32(n->GetMorphWeights().size());
+			morphWeights.insert(morphWeights.end(), n->GetMorphWeights().begin(), n->GetMorphWeights().end());
+			std::memcpy(fn.transform, glm::value_ptr(n->GetModelMatrix()), sizeof(fn.transform));
+
+			for (const auto& r : n->GetRenderables())
+			{
+				if (r->GetType() == RenderableType::Mesh)
+				{
+					meshRefs.push_back(reinterpret_cast<const Mesh3d*>(r.get())->GetIndex());
+				}
+				else if (r->GetType() == RenderableType::Light && fn.light == kSceneFileNoIndex)
+				{
+					const PointLight* pl = reinterpret_cast<const PointLight*>(r.get());
+
+					SceneFileLight_t fl{};
+					fl.name = strings.Add(pl->GetName());
+					fl.type = u32(pl->GetLightType());
+					std::memcpy(fl.diffuse, &pl->GetDiffuse()[0], sizeof(fl.diffuse));
+					std::memcpy(fl.specular, &pl->GetSpecular()[0], sizeof(fl.specular));
+					fl.linearAtt = pl->GetLinearAtt();
+					fl.quadraticAtt = pl->GetQuadraticAtt();
+					fl.cutoff = pl->GetCutOff();
+
+					fn.light = u32(lights.size());
+					lights.push_back(fl);
+				}
+			}
+
+			fn.numMeshRefs = u32(meshRefs.size()) - fn.firstMeshRef;
+
+			const u32 myIndex = u32(nodes.size());
+			nodeIndex.insert(std::make_pair(n, myIndex));
+			nodes.push_back(fn);
+
+			for (auto it = n->GetChildren().rbegin(); it != n->GetChildren().rend(); ++it)
+			{
+				stk.push(std::make_pair(*it, myIndex));
+			}
+		}
+
+		/* Skins, joints refer to nodes */
+
+		for (const auto& skin : mScene.mSkins)
+		{
+			SceneFileSkin_t fs{};
+			fs.name = strings.Add(skin->GetName());
+			fs.firstJoint = u32(skinJoints.size());
+			fs.numJoints = u32(skin->GetJointNum());
+
+			for (size_t j = 0; j < skin->GetJointNum(); ++j)
+			{
+				auto search = nodeIndex.find(skin->GetJoint(j));
+
+				SceneFileSkinJoint_t fj{};
+				fj.node = search != nodeIndex.end() ? search->second : kSceneFileNoIndex;
+				std::memcpy(fj.inverseBind, glm::value_ptr(skin->GetInverseBind(j)), sizeof(fj.inverseBind));
+				skinJoints.push_back(fj);
+			}
+
+			skins.push_back(fs);
+		}
+
+		/* Animations */
+
+		for (size_t i = 0; i < mScene.mAnimMgr.GetAnimationNum(); ++i)
+		{
+			Animation* anim = mScene.mAnimMgr.GetAnimation(i);
+
+			SceneFileAnimation_t fa{};
+			fa.name = strings.Add(anim->GetName());
+			fa.firstTrack = u32(tracks.size());
+			fa.length = anim->GetLength();
+			fa.ticksPerSec = anim->GetTicksPerSec();
+
+			for (size_t t = 0; t < anim->GetTrackNum(); ++t)
+			{
+				const AnimationTrack& track = anim->GetTrack(t);
+				auto search = nodeIndex.find(track.GetNode());
+				if (search == nodeIndex.end())
+					continue;
+
+				SceneFileTrack_t ft{};
+				ft.name = strings.Add(track.GetName());
+				ft.type = u32(track.GetType());
+				ft.node = search->second;
+				ft.firstKey = u32(keys.size());
+				ft.numKeys = u32(track.GetKeyframeNum());
+				ft.morphTarget = u32(track.GetMorphTarget());
+
+				for (u32 k = 0; k < ft.numKeys; ++k)
+				{
+					const Keyframe key = track.GetKeyValue(int(k));
+
+					SceneFileKey_t fk{};
+					fk.time = key.time;
+					std::memcpy(fk.value, key.value, sizeof(fk.value));
+					keys.push_back(fk);
+				}
+
+				tracks.push_back(ft);
+			}
+
+			fa.numTracks = u32(tracks.size()) - fa.firstTrack;
+			anims.push_back(fa);
+		}
+
+		/* Layout */
+
+		SceneFileHeader_t header{};
+		header.magic = kSceneFileMagic;
+		header.version = kSceneFileVersion;
+		header.vertexSize = kVertexDataSize;
+		header.numSections = SceneFileSection_LastEnum;
+
+		header.sections[SceneFileSection_Strings].size = strings.GetData().size();
+		header.sections[SceneFileSection_Strings].count = u32(strings.GetData().size());
+		SceneFile_SetSection(header, SceneFileSection_Nodes, nodes);
+		SceneFile_SetSection(header, SceneFileSection_NodeMeshRefs, meshRefs);
+		SceneFile_SetSection(header, SceneFileSection_Meshes, meshes);
+		SceneFile_SetSection(header, SceneFileSection_Materials, materials);
+		SceneFile_SetSection(header, SceneFileSection_Lights, lights);
+		SceneFile_SetSection(header, SceneFileSection_Animations, anims);
+		SceneFile_SetSection(header, SceneFileSection_Tracks, tracks);
+		SceneFile_SetSection(header, SceneFileSection_Keys, keys);
+		SceneFile_SetSection(header, SceneFileSection_Skins, skins);
+		SceneFile_SetSection(header, SceneFileSection_SkinJoints, skinJoints);
+		SceneFile_SetSection(header, SceneFileSection_MorphTargets, morphTargets);
+		SceneFile_SetSection(header, SceneFileSection_MorphDeltas, morphDeltas);
+		SceneFile_SetSection(header, SceneFileSection_MorphWeights, morphWeights);
+		header.sections[SceneFileSection_Vertices].size = vertexBlob.size();
+		header.sections[SceneFileSection_Vertices].count = u32(vertexBlob.size() / kVertexDataSize);
+		header.sections[SceneFileSection_Indices].size = indexBlob.size();
+		header.sections[SceneFileSection_Indices].count = u32(indexBlob.size() / sizeof(unsigned short));
+
+		size_t offset = SceneFile_Align(sizeof(SceneFileHeader_t), kSceneFileAlign);
+		for (int i = 0; i < SceneFileSection_LastEnum; ++i)
+		{
+			header.sections[i].offset = offset;
+			offset = SceneFile_Align(offset + header.sections[i].size, kSceneFileAlign);
+		}
+
+		const void* sectionData[SceneFileSection_LastEnum] = {
+			strings.GetData().data(),
+			nodes.data(),
+			meshRefs.data(),
+			meshes.data(),
+			materials.data(),
+			lights.data(),
+			anims.data(),
+			tracks.data(),
+			keys.data(),
+			skins.data(),
+			skinJoints.data(),
+			morphTargets.data(),
+			morphDeltas.data(),
+			morphWeights.data(),
+			vertexBlob.data(),
+			indexBlob.data()
+		};
+
+		std::ofstream out(aFileName, std::ios::binary | std::ios::trunc);
+		if (!out.good())
+		{
+			Error("Cannot write scene file %s", aFileName.c_str());
+			return false;
+		}
+
+		const char zeros[kSceneFileAlign] = {};
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		size_t written = sizeof(header);
+
+		for (int i = 0; i < SceneFileSection_LastEnum; ++i)
+		{
+			out.write(zeros, header.sections[i].offset - written);
+			if (header.sections[i].size)
+			{
+				out.write(reinterpret_cast<const char*>(sectionData[i]), header.sections[i].size);
+			}
+			written = header.sections[i].offset + header.sections[i].size;
+		}
+
+		out.write(zeros, offset - written);
+
+		if (!out.good())
+		{
+			Error("Write error on scene file %s", aFileName.c_str());
+			return false;
+		}
+
+		Info("Scene file %s written: %d nodes, %d meshes, %d skins, %d animations, %d bytes", aFileName.c_str(), int(nodes.size()), int(meshes.size()), int(skins.size()), int(anims.size()), int(offset));
+
+		return true;
+	}
+}
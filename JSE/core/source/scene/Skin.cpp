@@ -0,0 +1,126 @@
+#include "scene/Skin.hpp"
+#include "scene/Node3d.hpp"
+#include "scene/Mesh3d.hpp"
+#include "math/Mat4.hpp"
+#include "system/Cpu.hpp"
+
+namespace jse {
+
+	Skin::Skin(const String& aName) : mName(aName)
+	{
+	}
+
+	void Skin::AddJoint(Node3d* aJoint, const Matrix& aInverseBind)
+	{
+		mJoints.push_back(aJoint);
+		mInverseBind.push_back(aInverseBind);
+	}
+
+	bool Skin::CanDeform(const Mesh3d& aMesh) const
+	{
+		const VertexData* v = aMesh.GetVertexData();
+
+		for (size_t i = 0; i < aMesh.GetVertexCount(); ++i)
+		{
+			for (int k = 0; k < 4; ++k)
+			{
+				if (v[i].weights[k] && v[i].joints[k] >= mJoints.size())
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	void Skin::ComputePalette(const Matrix& aMeshWorld, Matrix* aPalette) const
+	{
+		Matrix invMesh;
+		Mat4_AffineInverse(aMeshWorld, invMesh);
+
+		for (size_t j = 0; j < mJoints.size(); ++j)
+		{
+			Mat4_Mul(invMesh, mJoints[j]->GetWorldMatrix(), aPalette[j]);
+			Mat4_Mul(aPalette[j], mInverseBind[j], aPalette[j]);
+		}
+	}
+
+#if defined(JSE_SIMD_X86)
+
+	static inline void Skin_Store3(const __m128 aValue, Vector3f& aDst)
+	{
+		float tmp[4];
+		_mm_storeu_ps(tmp, aValue);
+		aDst = Vector3f(tmp[0], tmp[1], tmp[2]);
+	}
+
+	static inline __m128 Skin_MulVector(const __m128* aCols, const Vector3f& aV, const __m128 aW)
+	{
+		__m128 r = _mm_mul_ps(aCols[0], _mm_set1_ps(aV.x));
+		r = _mm_add_ps(r, _mm_mul_ps(aCols[1], _mm_set1_ps(aV.y)));
+		r = _mm_add_ps(r, _mm_mul_ps(aCols[2], _mm_set1_ps(aV.z)));
+
+		return _mm_add_ps(r, _mm_mul_ps(aCols[3], aW));
+	}
+
+	void Skin_SkinVertices(const VertexData* aSrc, const size_t aCount, const Matrix* aPalette, VertexData* aDst)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const float kWeightScale = 1.0f / 255.0f;
+
+		for (size_t i = 0; i < aCount; ++i)
+		{
+			const VertexData& s = aSrc[i];
+			__m128 cols[4] = { zero, zero, zero, zero };
+
+			for (int k = 0; k < 4; ++k)
+			{
+				if (!s.weights[k])
+					continue;
+
+				const float* m = &aPalette[s.joints[k]][0][0];
+				const __m128 w = _mm_set1_ps(float(s.weights[k]) * kWeightScale);
+
+				for (int c = 0; c < 4; ++c)
+				{
+					cols[c] = _mm_add_ps(cols[c], _mm_mul_ps(_mm_loadu_ps(m + 4 * c), w));
+				}
+			}
+
+			VertexData& d = aDst[i];
+			d = s;
+			Skin_Store3(Skin_MulVector(cols, s.position, one), d.position);
+			Skin_Store3(Skin_MulVector(cols, s.normal, zero), d.normal);
+			Skin_Store3(Skin_MulVector(cols, s.tangent, zero), d.tangent);
+			Skin_Store3(Skin_MulVector(cols, s.bitangent, zero), d.bitangent);
+		}
+	}
+
+#else
+
+	void Skin_SkinVertices(const VertexData* aSrc, const size_t aCount, const Matrix* aPalette, VertexData* aDst)
+	{
+		for (size_t i = 0; i < aCount; ++i)
+		{
+			const VertexData& s = aSrc[i];
+			Matrix m(0.0f);
+
+			for (int k = 0; k < 4; ++k)
+			{
+				if (s.weights[k])
+				{
+					m += aPalette[s.joints[k]] * (float(s.weights[k]) / 255.0f);
+				}
+			}
+
+			VertexData& d = aDst[i];
+			d = s;
+			d.position = Vector3f(m * vec4(s.position, 1.0f));
+			d.normal = Vector3f(m * vec4(s.normal, 0.0f));
+			d.tangent = Vector3f(m * vec4(s.tangent, 0.0f));
+			d.bitangent = Vector3f(m * vec4(s.bitangent, 0.0f));
+		}
+	}
+
+#endif
+}
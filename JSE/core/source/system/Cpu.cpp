@@ -0,0 +1,81 @@
+#include "system/Cpu.hpp"
+
+#if defined(JSE_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace jse {
+
+#if defined(JSE_SIMD_X86) && defined(_MSC_VER)
+
+	static bool Cpu_DetectSSE41()
+	{
+		int info[4];
+		__cpuid(info, 1);
+
+		return (info[2] & (1 << 19)) != 0;
+	}
+
+	static bool Cpu_DetectAVX2()
+	{
+		int info[4];
+		__cpuid(info, 1);
+
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		if (!osxsave || !fma || (_xgetbv(0) & 6) != 6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+
+		return (info[1] & (1 << 5)) != 0;
+	}
+
+#elif defined(JSE_SIMD_X86)
+
+	static bool Cpu_DetectSSE41()
+	{
+		return __builtin_cpu_supports("sse4.1");
+	}
+
+	static bool Cpu_DetectAVX2()
+	{
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	}
+
+#else
+
+	static bool Cpu_DetectSSE41() { return false; }
+	static bool Cpu_DetectAVX2() { return false; }
+
+#endif
+
+	bool Cpu_HasSSE41()
+	{
+		static const bool sHas = Cpu_DetectSSE41();
+
+		return sHas;
+	}
+
+	bool Cpu_HasAVX2()
+	{
+		static const bool sHas = Cpu_DetectAVX2();
+
+		return sHas;
+	}
+
+	SimdLevel Cpu_GetSimdLevel()
+	{
+		if (Cpu_HasAVX2()) return SimdLevel_AVX2;
+		if (Cpu_HasSSE41()) return SimdLevel_SSE;
+
+		return SimdLevel_Scalar;
+	}
+
+	const char* Cpu_GetSimdLevelName(const SimdLevel aLevel)
+	{
+		static const char* const names[] = { "scalar", "SSE4.1", "AVX2" };
+
+		return aLevel < SimdLevel_LastEnum ? names[aLevel] : "unknown";
+	}
+}
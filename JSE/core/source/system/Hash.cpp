@@ -0,0 +1,119 @@
+#include <cstring>
+#include <cstdio>
+
+#include "system/Hash.hpp"
+
+namespace jse {
+
+	static const u64 kPrime64_1 = 0x9E3779B185EBCA87ULL;
+	static const u64 kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+	static const u64 kPrime64_3 = 0x165667B19E3779F9ULL;
+	static const u64 kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+	static const u64 kPrime64_5 = 0x27D4EB2F165667C5ULL;
+
+	static inline u64 Hash_Rotl64(const u64 aX, const int aR)
+	{
+		return (aX << aR) | (aX >> (64 - aR));
+	}
+
+	static inline u64 Hash_Read64(const u8* aPtr)
+	{
+		u64 v;
+		std::memcpy(&v, aPtr, sizeof(v));
+		return v;
+	}
+
+	static inline u32 Hash_Read32(const u8* aPtr)
+	{
+		u32 v;
+		std::memcpy(&v, aPtr, sizeof(v));
+		return v;
+	}
+
+	static inline u64 Hash_Round(u64 aAcc, const u64 aInput)
+	{
+		aAcc += aInput * kPrime64_2;
+		aAcc = Hash_Rotl64(aAcc, 31);
+		aAcc *= kPrime64_1;
+		return aAcc;
+	}
+
+	static inline u64 Hash_MergeRound(u64 aAcc, const u64 aVal)
+	{
+		aAcc ^= Hash_Round(0, aVal);
+		aAcc = aAcc * kPrime64_1 + kPrime64_4;
+		return aAcc;
+	}
+
+	u64 Hash64(const void* aData, const size_t aSize, const u64 aSeed)
+	{
+		const u8* p = reinterpret_cast<const u8*>(aData);
+		const u8* const end = p + aSize;
+		u64 h;
+
+		if (aSize >= 32)
+		{
+			const u8* const limit = end - 32;
+			u64 v1 = aSeed + kPrime64_1 + kPrime64_2;
+			u64 v2 = aSeed + kPrime64_2;
+			u64 v3 = aSeed;
+			u64 v4 = aSeed - kPrime64_1;
+
+			do {
+				v1 = Hash_Round(v1, Hash_Read64(p)); p += 8;
+				v2 = Hash_Round(v2, Hash_Read64(p)); p += 8;
+				v3 = Hash_Round(v3, Hash_Read64(p)); p += 8;
+				v4 = Hash_Round(v4, Hash_Read64(p)); p += 8;
+			} while (p <= limit);
+
+			h = Hash_Rotl64(v1, 1) + Hash_Rotl64(v2, 7) + Hash_Rotl64(v3, 12) + Hash_Rotl64(v4, 18);
+			h = Hash_MergeRound(h, v1);
+			h = Hash_MergeRound(h, v2);
+			h = Hash_MergeRound(h, v3);
+			h = Hash_MergeRound(h, v4);
+		}
+		else
+		{
+			h = aSeed + kPrime64_5;
+		}
+
+		h += u64(aSize);
+
+		while (p + 8 <= end)
+		{
+			h ^= Hash_Round(0, Hash_Read64(p));
+			h = Hash_Rotl64(h, 27) * kPrime64_1 + kPrime64_4;
+			p += 8;
+		}
+
+		if (p + 4 <= end)
+		{
+			h ^= u64(Hash_Read32(p)) * kPrime64_1;
+			h = Hash_Rotl64(h, 23) * kPrime64_2 + kPrime64_3;
+			p += 4;
+		}
+
+		while (p < end)
+		{
+			h ^= (*p) * kPrime64_5;
+			h = Hash_Rotl64(h, 11) * kPrime64_1;
+			p++;
+		}
+
+		h ^= h >> 33;
+		h *= kPrime64_2;
+		h ^= h >> 29;
+		h *= kPrime64_3;
+		h ^= h >> 32;
+
+		return h;
+	}
+
+	String HashToString(const u64 aHash)
+	{
+		char buf[17];
+		snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(aHash));
+
+		return String(buf);
+	}
+}
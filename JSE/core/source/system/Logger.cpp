@@ -13,6 +13,8 @@ namespace jse
 
 	void LogWriter::Write(const std::string& msg)
 	{
+		std::lock_guard<std::mutex> lck(mtx);
+
 		if (!file) ReopenFile();
 		if (file)
 		{
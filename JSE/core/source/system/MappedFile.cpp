@@ -0,0 +1,152 @@
+#include "system/MappedFile.hpp"
+#include "system/Logger.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace jse {
+
+	MappedFile::MappedFile()
+	{
+		mData = nullptr;
+		mSize = 0;
+#ifdef _WIN32
+		mFileHandle = INVALID_HANDLE_VALUE;
+		mMappingHandle = NULL;
+#else
+		mFd = -1;
+#endif
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+#ifdef _WIN32
+
+	bool MappedFile::Open(const String& aFileName)
+	{
+		Close();
+
+		mFileHandle = CreateFileA(aFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (mFileHandle == INVALID_HANDLE_VALUE)
+		{
+			Error("Cannot open file %s", aFileName.c_str());
+			return false;
+		}
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(mFileHandle, &size) || size.QuadPart == 0)
+		{
+			Error("Cannot map empty file %s", aFileName.c_str());
+			Close();
+			return false;
+		}
+
+		mMappingHandle = CreateFileMappingA(mFileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mMappingHandle == NULL)
+		{
+			Error("CreateFileMapping failed for %s", aFileName.c_str());
+			Close();
+			return false;
+		}
+
+		mData = reinterpret_cast<const u8*>(MapViewOfFile(mMappingHandle, FILE_MAP_READ, 0, 0, 0));
+		if (mData == nullptr)
+		{
+			Error("MapViewOfFile failed for %s", aFileName.c_str());
+			Close();
+			return false;
+		}
+
+		mSize = size_t(size.QuadPart);
+		mFileName = aFileName;
+
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (mData)
+		{
+			UnmapViewOfFile(mData);
+		}
+		if (mMappingHandle)
+		{
+			CloseHandle(mMappingHandle);
+		}
+		if (mFileHandle != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(mFileHandle);
+		}
+
+		mData = nullptr;
+		mSize = 0;
+		mMappingHandle = NULL;
+		mFileHandle = INVALID_HANDLE_VALUE;
+	}
+
+#else
+
+	bool MappedFile::Open(const String& aFileName)
+	{
+		Close();
+
+		mFd = open(aFileName.c_str(), O_RDONLY);
+		if (mFd < 0)
+		{
+			Error("Cannot open file %s", aFileName.c_str());
+			return false;
+		}
+
+		struct stat st;
+		if (fstat(mFd, &st) != 0 || st.st_size == 0)
+		{
+			Error("Cannot map empty file %s", aFileName.c_str());
+			Close();
+			return false;
+		}
+
+		void* ptr = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, mFd, 0);
+		if (ptr == MAP_FAILED)
+		{
+			Error("mmap failed for %s", aFileName.c_str());
+			Close();
+			return false;
+		}
+
+		// the whole file is consumed right after mapping, start read-ahead now
+		madvise(ptr, size_t(st.st_size), MADV_WILLNEED);
+
+		mData = reinterpret_cast<const u8*>(ptr);
+		mSize = size_t(st.st_size);
+		mFileName = aFileName;
+
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (mData)
+		{
+			munmap(const_cast<u8*>(mData), mSize);
+		}
+		if (mFd >= 0)
+		{
+			close(mFd);
+		}
+
+		mData = nullptr;
+		mSize = 0;
+		mFd = -1;
+	}
+
+#endif
+}
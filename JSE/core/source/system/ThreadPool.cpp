@@ -0,0 +1,147 @@
+#include <atomic>
+#include <algorithm>
+
+#include "system/ThreadPool.hpp"
+#include "system/Logger.hpp"
+
+namespace jse {
+
+	struct ParallelForState_t
+	{
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+		size_t count{};
+		size_t grain{};
+		ParallelForFunc func;
+		std::mutex mtx;
+		std::condition_variable cv;
+	};
+
+	static void ThreadPool_RunChunks(ParallelForState_t& aState)
+	{
+		for (;;)
+		{
+			const size_t begin = aState.next.fetch_add(aState.grain);
+			if (begin >= aState.count)
+				break;
+
+			const size_t end = std::min(begin + aState.grain, aState.count);
+			for (size_t i = begin; i < end; ++i)
+			{
+				aState.func(i);
+			}
+
+			if (aState.done.fetch_add(end - begin) + (end - begin) == aState.count)
+			{
+				std::lock_guard<std::mutex> lck(aState.mtx);
+				aState.cv.notify_all();
+			}
+		}
+	}
+
+	ThreadPool::ThreadPool(const unsigned aNumThreads)
+	{
+		mStop = false;
+
+		unsigned n = aNumThreads;
+		if (n == 0)
+		{
+			n = std::max(1U, std::thread::hardware_concurrency());
+		}
+
+		mWorkers.reserve(n);
+		for (unsigned i = 0; i < n; ++i)
+		{
+			mWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+		}
+
+		Info("ThreadPool: %d worker threads", n);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lck(mMutex);
+			mStop = true;
+		}
+
+		mCondition.notify_all();
+
+		for (auto& it : mWorkers)
+		{
+			it.join();
+		}
+	}
+
+	void ThreadPool::Enqueue(JobFunc aJob)
+	{
+		{
+			std::lock_guard<std::mutex> lck(mMutex);
+			mJobs.push_back(std::move(aJob));
+		}
+
+		mCondition.notify_one();
+	}
+
+	void ThreadPool::ParallelFor(const size_t aCount, const ParallelForFunc& aFunc, const size_t aGrainSize)
+	{
+		if (aCount == 0)
+			return;
+
+		const size_t grain = std::max<size_t>(1, aGrainSize);
+
+		if (aCount <= grain || mWorkers.empty())
+		{
+			for (size_t i = 0; i < aCount; ++i)
+				aFunc(i);
+
+			return;
+		}
+
+		// helpers may start after we returned, so the state is shared
+		auto state = std::make_shared<ParallelForState_t>();
+		state->count = aCount;
+		state->grain = grain;
+		state->func = aFunc;
+
+		const size_t numChunks = (aCount + grain - 1) / grain;
+		const size_t numHelpers = std::min<size_t>(mWorkers.size(), numChunks - 1);
+
+		for (size_t i = 0; i < numHelpers; ++i)
+		{
+			Enqueue([state]() { ThreadPool_RunChunks(*state); });
+		}
+
+		ThreadPool_RunChunks(*state);
+
+		std::unique_lock<std::mutex> lck(state->mtx);
+		state->cv.wait(lck, [&state]() { return state->done.load() == state->count; });
+	}
+
+	void ThreadPool::WorkerLoop()
+	{
+		for (;;)
+		{
+			JobFunc job;
+			{
+				std::unique_lock<std::mutex> lck(mMutex);
+				mCondition.wait(lck, [this]() { return mStop || !mJobs.empty(); });
+
+				if (mStop && mJobs.empty())
+					return;
+
+				job = std::move(mJobs.front());
+				mJobs.pop_front();
+			}
+
+			job();
+		}
+	}
+
+	ThreadPool& GetDefaultThreadPool()
+	{
+		static ThreadPool sPool;
+
+		return sPool;
+	}
+}
@@ -0,0 +1,23 @@
+// Point lights of the scene, see UniformLight in Scene.hpp
+
+#ifndef MAX_LIGHTS
+#define MAX_LIGHTS 256
+#endif
+
+struct Light {
+    vec4 position;
+    vec4 diffuse;
+    vec4 specular;
+
+    float kl;
+    float kq;
+    float cutoff;
+    float pad0;
+}; 
+// 4*16 = 64
+
+uniform int numLights;
+
+layout(std140) uniform LightBuffer {
+    Light lights[MAX_LIGHTS];
+};
@@ -0,0 +1,21 @@
+// Joint palette of the skinned node, see Skin.hpp
+
+#ifndef MAX_JOINTS
+#define MAX_JOINTS 256
+#endif
+
+layout(location = 11) in uvec4 va_Joints;
+layout(location = 12) in vec4 va_Weights;
+
+layout(std140) uniform JointBuffer {
+    mat4 joints[MAX_JOINTS];
+};
+
+// mesh space bind pose to mesh space current pose
+mat4 GetSkinMatrix()
+{
+    return joints[va_Joints.x] * va_Weights.x +
+           joints[va_Joints.y] * va_Weights.y +
+           joints[va_Joints.z] * va_Weights.z +
+           joints[va_Joints.w] * va_Weights.w;
+}
@@ -16,30 +16,20 @@ struct Material {
     vec3 diffuse;
     vec3 specular;
     float shininess;
+    int layer;
 };
 
-struct Light {
-    vec4 position;
-    vec4 diffuse;
-    vec4 specular;
+#include "lights.glsl"
 
-    float kl;
-    float kq;
-    float cutoff;
-    float pad0;
-}; 
-// 4*16 = 64
-
-uniform int numLights;
-
-layout(std140) uniform LightBuffer {
-    Light lights[256];
-};
+#ifdef HAS_DIFFUSE_ARRAY
+uniform sampler2DArray diffuseArray;
+#endif
 
 uniform vec3 viewPos;
 uniform Material material;
 
 vec3 N,E;
+vec3 albedo;
 const float gamma = 2.2;
 const vec3 fogColor = vec3(0.5, 0.5, 1.0);
 float depth;
@@ -71,13 +61,14 @@ vec3 calcPointLight(Light light)
         vec3 H = normalize(L + E);
         //float spec = pow(max(dot(E, R), 0), material.shininess);
         float spec = pow(max(dot(N, H), 0), material.shininess);
-        vec3 diffuse = material.diffuse * light.diffuse.rgb * diff * attenuation;
+        vec3 diffuse = albedo * light.diffuse.rgb * diff * attenuation;
         vec3 specular = material.specular * light.specular.rgb * spec * attenuation;
 
         return diffuse + specular;
         
 }
 
+#ifdef FOG
 float getFogFactor(float d)
 {
     const float FogMax = 30.0;
@@ -88,6 +79,7 @@ float getFogFactor(float d)
 
     return 1 - (FogMax - d) / (FogMax - FogMin);
 }
+#endif
 
 void main() {
 
@@ -95,16 +87,27 @@ void main() {
     E = normalize(viewPos - vofi.worldPosition);
     vec3 result = material.ambient;
 
+    albedo = material.diffuse;
+#ifdef HAS_DIFFUSE_ARRAY
+    albedo *= texture(diffuseArray, vec3(vofi.TexCoord, float(material.layer))).rgb;
+#endif
+
     //result = pow(result, vec3(1.0/gamma));
 
-    for(int i=0; i<numLights; ++i)
+    // constant bound, the compiler can unroll small variants
+    for(int i=0; i<MAX_LIGHTS; ++i)
     {
+        if (i >= numLights) break;
         result += calcPointLight(lights[i]);
     }
 
+#ifdef FOG
     float d = distance(viewPos, vofi.worldPosition);
     float alpha = getFogFactor(d);
 
     FragColor = vec4(mix(result, fogColor, alpha), 1);
+#else
+    FragColor = vec4(result, 1);
+#endif
 
 }
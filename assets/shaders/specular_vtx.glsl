@@ -8,6 +8,10 @@ layout(location = 2) in vec3 va_Tangent;
 layout(location = 3) in vec3 va_Bitangent;
 layout(location = 4) in vec2 va_TexCoord;
 
+#ifdef SKINNING
+#include "skinning.glsl"
+#endif
+
 
 out VertexData {
 	vec2 TexCoord;
@@ -23,12 +27,25 @@ uniform mat4 NM;
 
 void main(){
 
+#ifdef SKINNING
+	mat4 skin = GetSkinMatrix();
+	vec4 position = skin * vec4(va_Position, 1.0);
+	vec3 normal = mat3(skin) * va_Normal;
+	vec3 tangent = mat3(skin) * va_Tangent;
+	vec3 bitangent = mat3(skin) * va_Bitangent;
+#else
+	vec4 position = vec4(va_Position, 1.0);
+	vec3 normal = va_Normal;
+	vec3 tangent = va_Tangent;
+	vec3 bitangent = va_Bitangent;
+#endif
+
 	// Output position of the vertex, in clip space : MVP * position
-	gl_Position = MVP * vec4(va_Position, 1.0);
+	gl_Position = MVP * position;
 
 	vofi.TexCoord = va_TexCoord;
-	vofi.Tangent = va_Tangent;
-	vofi.Bitangent = va_Bitangent;
-	vofi.worldPosition = vec3(M * vec4(va_Position, 1.0));
-	vofi.normal = (NM * vec4(va_Normal, 0.0)).xyz;
+	vofi.Tangent = tangent;
+	vofi.Bitangent = bitangent;
+	vofi.worldPosition = vec3(M * position);
+	vofi.normal = (NM * vec4(normal, 0.0)).xyz;
 }
@@ -2,9 +2,17 @@
 
 layout(location = 0) in vec3 va_Position;
 
+#ifdef SKINNING
+#include "skinning.glsl"
+#endif
+
 uniform mat4 MVP;
 
 void main()
 {
+#ifdef SKINNING
+  gl_Position = MVP * (GetSkinMatrix() * vec4(va_Position, 1.0));
+#else
   gl_Position = MVP * vec4(va_Position, 1.0);
+#endif
 }
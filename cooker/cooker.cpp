@@ -0,0 +1,661 @@
+/*
+=========================================
+ Offline asset cooker
+
+ usage: cooker <source dir> <output dir> [-f] [-q fast|normal|high]
+        cooker -bench <image> [iterations]
+        cooker -bench-anim [keys] [iterations]
+        cooker -bench-math [matrices] [iterations]
+        cooker -bench-cull [objects] [iterations]
+        cooker -anim-report <scene> [position error] [rotation error deg]
+        cooker -check-usage [images]
+
+ Converts source assets into engine-ready files:
+   .gltf / .glb             -> .jsb (mesh optimized native scene, animation
+                               keys reduced, quantized once when loaded)
+   .jpg / .png / .tga / .bmp -> .dds (decoded, top row first,
+                               Kaiser filtered mip chain, block compressed:
+                               BC5 for normal maps (an n / nrm / normal
+                               name token), BC3 if the alpha is used, BC1
+                               otherwise)
+
+ Every input gets a content hash key (input bytes, glTF buffer/image
+ dependencies and the cooker version). Keys are kept in <output>/cook.cache,
+ unchanged inputs are skipped, -f forces a full rebuild. -q sets the block
+ encoder quality (default normal).
+
+ -bench times the mip generator kernels (scalar vs. SIMD) on one image.
+ -bench-anim times animation key lookups on a synthetic track (default
+ 10000 keys).
+ -bench-math times the 4x4 matrix kernels against GLM on random node
+ transforms (default 4096 matrices).
+ -bench-cull times batch frustum culling of spheres and boxes for every
+ SIMD level (default 100000 objects).
+ -anim-report loads a glTF scene with raw and with compressed animations
+ (key reduction within the given errors, quantization) and logs the key
+ data size and the largest error per clip.
+ -check-usage checks the image usage (color, normal, linear) guessed for
+ the texture names of the assets and logs the usage of the given images.
+=========================================
+*/
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+#include "system/SystemTypes.hpp"
+#include "system/Logger.hpp"
+#include "system/Hash.hpp"
+#include "system/Timer.hpp"
+#include "system/ThreadPool.hpp"
+#include "scene/Scene.hpp"
+#include "scene/SceneFile.hpp"
+#include "scene/AnimationTrack.hpp"
+#include "math/Mat4.hpp"
+#include "math/Frustum.hpp"
+#include "graphics/DdsFile.hpp"
+#include "graphics/MipGenerator.hpp"
+#include "graphics/BlockEncoder.hpp"
+
+#include "json.hpp"
+#include "stb_image.h"
+
+using namespace jse;
+namespace fs = std::filesystem;
+
+// bump whenever the output of any converter changes
+static const u64 kCookerVersion = 10;
+static const char* const kCookCacheFile = "cook.cache";
+
+enum CookType
+{
+	CookType_Scene,
+	CookType_Texture,
+	CookType_LastEnum
+};
+
+enum CookResult
+{
+	CookResult_UpToDate,
+	CookResult_Cooked,
+	CookResult_Failed
+};
+
+struct CookJob_t
+{
+	fs::path input;
+	fs::path output;
+	String key;			// path relative to the source dir, used in the cache
+	CookType type;
+	u64 hash;
+	CookResult result;
+};
+
+typedef std::map<String, u64> CookCache;
+
+static BlockQuality sBlockQuality = BlockQuality_Normal;
+
+static bool Cooker_HasExt(const fs::path& aPath, std::initializer_list<const char*> aExts)
+{
+	String ext = aPath.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+
+	for (const char* e : aExts)
+	{
+		if (ext == e)
+			return true;
+	}
+
+	return false;
+}
+
+static bool Cooker_ReadFile(const fs::path& aPath, ByteVector& aData)
+{
+	std::ifstream in(aPath, std::ios::binary | std::ios::ate);
+	if (!in.good())
+		return false;
+
+	aData.resize(size_t(in.tellg()));
+	in.seekg(0);
+	in.read(reinterpret_cast<char*>(aData.data()), aData.size());
+
+	return in.good();
+}
+
+static bool Cooker_HashFile(const fs::path& aPath, u64& aHash)
+{
+	ByteVector data;
+	if (!Cooker_ReadFile(aPath, data))
+		return false;
+
+	aHash = Hash64(data);
+
+	return true;
+}
+
+/* external buffers and images referenced by a .gltf file */
+static void Cooker_GetGltfDependencies(const ByteVector& aData, const fs::path& aDir, std::vector<fs::path>& aDeps)
+{
+	auto json = nlohmann::json::parse(aData.begin(), aData.end(), nullptr, false);
+	if (json.is_discarded())
+		return;
+
+	for (const char* section : { "buffers", "images" })
+	{
+		if (!json.contains(section))
+			continue;
+
+		for (const auto& it : json[section])
+		{
+			if (!it.contains("uri"))
+				continue;
+
+			const String uri = it["uri"].get<String>();
+			if (uri.compare(0, 5, "data:") != 0)
+			{
+				aDeps.push_back(aDir / uri);
+			}
+		}
+	}
+}
+
+static bool Cooker_ComputeHash(CookJob_t& aJob)
+{
+	ByteVector data;
+	if (!Cooker_ReadFile(aJob.input, data))
+	{
+		Error("Cannot read %s", aJob.input.string().c_str());
+		return false;
+	}
+
+	u64 hash = HashCombine(Hash64(data), kCookerVersion);
+	hash = HashCombine(hash, aJob.type == CookType_Scene ? kSceneFileVersion : u64(sBlockQuality));
+
+	if (Cooker_HasExt(aJob.input, { ".gltf" }))
+	{
+		std::vector<fs::path> deps;
+		Cooker_GetGltfDependencies(data, aJob.input.parent_path(), deps);
+
+		for (const auto& dep : deps)
+		{
+			u64 depHash = 0;
+			if (!Cooker_HashFile(dep, depHash))
+			{
+				Warning("%s: missing dependency %s", aJob.key.c_str(), dep.string().c_str());
+			}
+			hash = HashCombine(hash, depHash);
+		}
+	}
+
+	aJob.hash = hash;
+
+	return true;
+}
+
+static bool Cooker_CookScene(const CookJob_t& aJob)
+{
+	// no graphics driver: the scene only lives on the CPU side
+	Scene scene(aJob.key, nullptr, nullptr, nullptr);
+
+	// keys are reduced here and written as floats, the loader quantizes them once
+	AnimationCompressParams_t animParams;
+	animParams.quantize = false;
+	scene.SetAnimationCompression(animParams);
+
+	if (!scene.LoadScene(aJob.input.string()))
+		return false;
+
+	GetDefaultThreadPool().ParallelFor(scene.GetMeshNum(), [&scene](size_t i) {
+		scene.GetMeshByIndex(int(i))->Optimize();
+	});
+
+	return scene.SaveScene(aJob.output.string());
+}
+
+static bool Cooker_LoadImage(const fs::path& aPath, Bitmap& aBitmap)
+{
+	static const PixelFormat formats[] = { PixelFormat_Luminance, PixelFormat_LuminanceAlpha, PixelFormat_RGB, PixelFormat_RGBA };
+	int x, y, n;
+
+	// kept top row first like the DDS files, blocks are encoded in file order
+	stbi_set_flip_vertically_on_load_thread(0);
+
+	unsigned char* data = stbi_load(aPath.string().c_str(), &x, &y, &n, 0);
+	if (!data)
+	{
+		Error("%s: %s", aPath.string().c_str(), stbi_failure_reason());
+		return false;
+	}
+
+	// two channel images are expanded, DDS is written with 1, 3 or 4 channels
+	if (n == 2)
+	{
+		stbi_image_free(data);
+		data = stbi_load(aPath.string().c_str(), &x, &y, &n, 4);
+		n = 4;
+	}
+
+	if (!data)
+		return false;
+
+	aBitmap.SetFileName(aPath.string());
+	aBitmap.SetSize(x, y, 1);
+	aBitmap.SetPixelFormat(formats[n - 1]);
+	aBitmap.SetCompressed(false);
+	aBitmap.SetBytesPerPixel(n);
+	aBitmap.Init(1, 1);
+	aBitmap.GetData(0, 0)->SetData(data, x * y * n);
+	stbi_image_free(data);
+
+	return true;
+}
+
+static PixelFormat Cooker_GetBlockFormat(const fs::path& aPath, const Bitmap& aBitmap)
+{
+	if (MipGen_GetImageUsage(aPath.string()) == ImageUsage_Normal)
+		return PixelFormat_BC5;
+
+	if (aBitmap.GetBytesPerPixel() == 4)
+	{
+		const BitmapData* data = aBitmap.GetData(0, 0);
+		for (int i = 3; i < data->GetSize(); i += 4)
+		{
+			if (data->GetData()[i] != 255)
+				return PixelFormat_DXT5;
+		}
+	}
+
+	return PixelFormat_DXT1;
+}
+
+static bool Cooker_CookTexture(const CookJob_t& aJob)
+{
+	Bitmap bitmap;
+	if (!Cooker_LoadImage(aJob.input, bitmap))
+		return false;
+
+	MipGenParams_t mipParams;
+	mipParams.filter = MipFilter_Kaiser;
+	mipParams.srgb = MipGen_IsColorImage(aJob.input.string());
+
+	if (!GenerateMipmaps(bitmap, mipParams))
+		return false;
+
+	BlockEncodeParams_t params;
+	params.format = Cooker_GetBlockFormat(aJob.input, bitmap);
+	params.quality = sBlockQuality;
+
+	BlockEncodeStats_t stats;
+	if (!EncodeBitmap(bitmap, bitmap, params, &stats))
+		return false;
+
+	static const char* const formatNames[] = { "BC1", "BC3", "BC5" };
+	const char* formatName = formatNames[params.format == PixelFormat_DXT1 ? 0 : params.format == PixelFormat_DXT5 ? 1 : 2];
+
+	Info("%s: %s %s, RMSE %.3f, PSNR %.2fdB, %fms", aJob.key.c_str(), formatName, GetBlockQualityName(params.quality), stats.rmse, stats.psnr, stats.encodeMs);
+
+	// loaded top row first, so odd block heights need no flip after encoding
+	return DdsFile_Write(aJob.output.string(), bitmap, true);
+}
+
+static int Cooker_Benchmark(const fs::path& aImage, const int aIterations)
+{
+	Bitmap bitmap;
+	if (!Cooker_LoadImage(aImage, bitmap))
+		return 1;
+
+	Info("%s: %dx%d, %d channels, %s", aImage.string().c_str(), bitmap.GetSizeX(), bitmap.GetSizeY(), bitmap.GetBytesPerPixel(), Cpu_GetSimdLevelName(Cpu_GetSimdLevel()));
+	MipGen_Benchmark(bitmap, aIterations);
+
+	return 0;
+}
+
+static int Cooker_CheckUsage(const int aCount, char** aImages)
+{
+	struct UsageCheck_t
+	{
+		const char* name;
+		ImageUsage usage;
+	};
+
+	static const UsageCheck_t checks[] = {
+		{ "MetalCorrodedHeavy001_COL_1K_METALNESS.jpg", ImageUsage_Color },
+		{ "MetalCorrodedHeavy001_NRM_1K_METALNESS.jpg", ImageUsage_Normal },
+		{ "MetalCorrodedHeavy001_ROUGHNESS_1K_METALNESS.jpg", ImageUsage_Linear },
+		{ "MetalCorrodedHeavy001_METALNESS_1K_METALNESS.jpg", ImageUsage_Linear },
+		{ "MetalCorrodedHeavy001_DISP_1K_METALNESS.jpg", ImageUsage_Linear },
+		{ "MetalCorrodedHeavy001_Sphere.jpg", ImageUsage_Color },
+		{ "space-crate1-albedo.png", ImageUsage_Color },
+		{ "space-crate1-normal-ogl.png", ImageUsage_Normal },
+		{ "space-crate1-metallic-space-crate1-roughness.png", ImageUsage_Linear },
+		{ "textures/rock_n.tga", ImageUsage_Normal }
+	};
+
+	static const char* const usageNames[] = { "color", "normal", "linear" };
+	static_assert(ImageUsage_LastEnum == 3, "name per image usage");
+
+	int failed = 0;
+	for (const UsageCheck_t& c : checks)
+	{
+		const ImageUsage usage = MipGen_GetImageUsage(c.name);
+		if (usage != c.usage)
+		{
+			Error("%s: %s, expected %s", c.name, usageNames[usage], usageNames[c.usage]);
+			failed++;
+		}
+	}
+
+	for (int i = 0; i < aCount; ++i)
+	{
+		Info("%s: %s", aImages[i], usageNames[MipGen_GetImageUsage(aImages[i])]);
+	}
+
+	Info("%d of %d usage checks failed", failed, int(sizeof(checks) / sizeof(checks[0])));
+
+	return failed ? 1 : 0;
+}
+
+static int Cooker_AnimReport(const fs::path& aScene, const AnimationCompressParams_t& aParams)
+{
+	AnimationCompressParams_t none;
+	none.reduce = false;
+	none.quantize = false;
+
+	Scene raw("raw", nullptr, nullptr, nullptr);
+	Scene packed("packed", nullptr, nullptr, nullptr);
+	raw.SetAnimationCompression(none);
+	packed.SetAnimationCompression(aParams);
+
+	if (!raw.LoadScene(aScene.string()) || !packed.LoadScene(aScene.string()))
+		return 1;
+
+	AnimationManager& rawAnims = raw.GetAnimationManager();
+	AnimationManager& packedAnims = packed.GetAnimationManager();
+
+	size_t totalRaw = 0, totalPacked = 0;
+
+	for (size_t i = 0; i < rawAnims.GetAnimationNum(); ++i)
+	{
+		Animation* a = rawAnims.GetAnimation(i);
+		Animation* b = packedAnims.GetAnimation(i);
+
+		size_t keysRaw = 0, keysPacked = 0;
+		float maxError[AnimationTrackType_LastEnum] = {};
+
+		for (size_t t = 0; t < a->GetTrackNum(); ++t)
+		{
+			const AnimationTrack& ta = a->GetTrack(t);
+			const AnimationTrack& tb = b->GetTrack(t);
+			const std::vector<float>& times = ta.GetKeyTimes();
+
+			keysRaw += ta.GetKeyframeNum();
+			keysPacked += tb.GetKeyframeNum();
+
+			// at every source key and halfway to the next one
+			int cursorA = -1, cursorB = -1;
+			for (size_t k = 0; k < times.size(); ++k)
+			{
+				for (int half = 0; half < (k + 1 < times.size() ? 2 : 1); ++half)
+				{
+					const float time = half ? 0.5f * (times[k] + times[k + 1]) : times[k];
+					const float error = AnimationTrack_GetError(ta.GetType(), ta.Sample(time, cursorA), tb.Sample(time, cursorB));
+
+					maxError[ta.GetType()] = std::max(maxError[ta.GetType()], error);
+				}
+			}
+		}
+
+		totalRaw += a->GetMemorySize();
+		totalPacked += b->GetMemorySize();
+
+		Info("%s: %d tracks, %d -> %d keys, %d -> %d bytes (%.1f%%), max error: position %.5f, rotation %.4f deg, scale %.5f, weight %.5f",
+			a->GetName().c_str(), int(a->GetTrackNum()), int(keysRaw), int(keysPacked), int(a->GetMemorySize()), int(b->GetMemorySize()),
+			100.0 * b->GetMemorySize() / std::max<size_t>(a->GetMemorySize(), 1),
+			maxError[AnimationTrackType_Position], glm::degrees(maxError[AnimationTrackType_Rotation]), maxError[AnimationTrackType_Scale], maxError[AnimationTrackType_Weight]);
+	}
+
+	Info("%d animations: %d -> %d bytes (%.1f%%)", int(rawAnims.GetAnimationNum()), int(totalRaw), int(totalPacked), 100.0 * totalPacked / std::max<size_t>(totalRaw, 1));
+
+	return 0;
+}
+
+static bool Cooker_LoadCache(const fs::path& aPath, CookCache& aCache)
+{
+	std::ifstream in(aPath);
+	if (!in.good())
+		return false;
+
+	String line;
+	while (std::getline(in, line))
+	{
+		const size_t sep = line.find(' ');
+		if (sep == String::npos)
+			continue;
+
+		aCache[line.substr(sep + 1)] = std::stoull(line.substr(0, sep), nullptr, 16);
+	}
+
+	return true;
+}
+
+static bool Cooker_SaveCache(const fs::path& aPath, const CookCache& aCache)
+{
+	std::ofstream out(aPath, std::ios::trunc);
+	for (const auto& it : aCache)
+	{
+		out << HashToString(it.second) << ' ' << it.first << '\n';
+	}
+
+	return out.good();
+}
+
+static void Cooker_CollectJobs(const fs::path& aSrcDir, const fs::path& aDstDir, std::vector<CookJob_t>& aJobs)
+{
+	for (const auto& entry : fs::recursive_directory_iterator(aSrcDir))
+	{
+		if (!entry.is_regular_file())
+			continue;
+
+		const fs::path& p = entry.path();
+		const fs::path rel = fs::relative(p, aSrcDir);
+
+		CookJob_t job{};
+		job.input = p;
+		job.key = rel.generic_string();
+
+		if (Cooker_HasExt(p, { ".gltf", ".glb" }))
+		{
+			job.type = CookType_Scene;
+			job.output = (aDstDir / rel).replace_extension(kSceneFileExt);
+		}
+		else if (Cooker_HasExt(p, { ".jpg", ".jpeg", ".png", ".tga", ".bmp" }))
+		{
+			job.type = CookType_Texture;
+			job.output = (aDstDir / rel).replace_extension(kDdsFileExt);
+		}
+		else
+		{
+			if (Cooker_HasExt(p, { ".blend", ".3ds" }))
+			{
+				Warning("%s: no importer, export it to glTF first", job.key.c_str());
+			}
+			else if (Cooker_HasExt(p, { ".tif", ".tiff" }))
+			{
+				Warning("%s: TIFF is not supported, convert it to PNG first", job.key.c_str());
+			}
+			continue;
+		}
+
+		aJobs.push_back(job);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 2 && String(argv[1]) == "-anim-report")
+	{
+		AnimationCompressParams_t params;
+		if (argc > 3) params.maxPositionError = float(std::atof(argv[3]));
+		if (argc > 4) params.maxRotationError = glm::radians(float(std::atof(argv[4])));
+		params.maxScaleError = params.maxPositionError;
+
+		return Cooker_AnimReport(argv[2], params);
+	}
+
+	if (argc > 1 && String(argv[1]) == "-bench-anim")
+	{
+		AnimationTrack_Benchmark(argc > 2 ? std::max(2, std::atoi(argv[2])) : 10000, argc > 3 ? std::max(1, std::atoi(argv[3])) : 20);
+		return 0;
+	}
+
+	if (argc > 1 && String(argv[1]) == "-bench-math")
+	{
+		Mat4_Benchmark(argc > 2 ? std::max(1, std::atoi(argv[2])) : 4096, argc > 3 ? std::max(1, std::atoi(argv[3])) : 100);
+		return 0;
+	}
+
+	if (argc > 1 && String(argv[1]) == "-bench-cull")
+	{
+		Frustum_Benchmark(argc > 2 ? std::max(1, std::atoi(argv[2])) : 100000, argc > 3 ? std::max(1, std::atoi(argv[3])) : 100);
+		return 0;
+	}
+
+	if (argc > 1 && String(argv[1]) == "-check-usage")
+	{
+		return Cooker_CheckUsage(argc - 2, argv + 2);
+	}
+
+	if (argc > 2 && String(argv[1]) == "-bench")
+	{
+		return Cooker_Benchmark(argv[2], argc > 3 ? std::max(1, std::atoi(argv[3])) : 10);
+	}
+
+	if (argc < 3)
+	{
+		Info("usage: %s <source dir> <output dir> [-f] [-q fast|normal|high]", argv[0]);
+		Info("       %s -bench <image> [iterations]", argv[0]);
+		Info("       %s -bench-anim [keys] [iterations]", argv[0]);
+		Info("       %s -bench-math [matrices] [iterations]", argv[0]);
+		Info("       %s -bench-cull [objects] [iterations]", argv[0]);
+		Info("       %s -anim-report <scene> [position error] [rotation error deg]", argv[0]);
+		Info("       %s -check-usage [images]", argv[0]);
+		return 1;
+	}
+
+	const fs::path srcDir = argv[1];
+	const fs::path dstDir = argv[2];
+	bool force = false;
+
+	for (int i = 3; i < argc; ++i)
+	{
+		const String arg = argv[i];
+
+		if (arg == "-f")
+		{
+			force = true;
+		}
+		else if (arg == "-q" && i + 1 < argc)
+		{
+			sBlockQuality = GetBlockQuality(argv[++i]);
+			if (sBlockQuality == BlockQuality_LastEnum)
+			{
+				Error("Unknown quality %s", argv[i]);
+				return 1;
+			}
+		}
+	}
+
+	std::error_code ec;
+	if (!fs::is_directory(srcDir, ec))
+	{
+		Error("Source directory %s not found", srcDir.string().c_str());
+		return 1;
+	}
+
+	SimpleTimer timer;
+
+	CookCache cache;
+	const fs::path cachePath = dstDir / kCookCacheFile;
+	if (!force)
+	{
+		Cooker_LoadCache(cachePath, cache);
+	}
+
+	std::vector<CookJob_t> jobs;
+	Cooker_CollectJobs(srcDir, dstDir, jobs);
+
+	std::atomic<int> numCooked{ 0 };
+	std::atomic<int> numFailed{ 0 };
+
+	GetDefaultThreadPool().ParallelFor(jobs.size(), [&](size_t i) {
+		CookJob_t& job = jobs[i];
+
+		if (!Cooker_ComputeHash(job))
+		{
+			job.result = CookResult_Failed;
+			numFailed++;
+			return;
+		}
+
+		auto it = cache.find(job.key);
+		if (it != cache.end() && it->second == job.hash && fs::exists(job.output))
+		{
+			job.result = CookResult_UpToDate;
+			return;
+		}
+
+		std::error_code err;
+		fs::create_directories(job.output.parent_path(), err);
+
+		SimpleTimer jobTimer;
+		bool ok = false;
+
+		switch (job.type)
+		{
+		case CookType_Scene: ok = Cooker_CookScene(job); break;
+		case CookType_Texture: ok = Cooker_CookTexture(job); break;
+		default: break;
+		}
+
+		if (ok)
+		{
+			job.result = CookResult_Cooked;
+			numCooked++;
+			jobTimer.PrintElapsedTime("Cooked " + job.key + " ->");
+		}
+		else
+		{
+			job.result = CookResult_Failed;
+			numFailed++;
+			Error("Failed to cook %s", job.key.c_str());
+		}
+	});
+
+	// failed entries are dropped so they are retried next time
+	for (const auto& job : jobs)
+	{
+		if (job.result == CookResult_Failed)
+		{
+			cache.erase(job.key);
+		}
+		else
+		{
+			cache[job.key] = job.hash;
+		}
+	}
+
+	fs::create_directories(dstDir, ec);
+	if (!Cooker_SaveCache(cachePath, cache))
+	{
+		Error("Cannot write %s", cachePath.string().c_str());
+	}
+
+	Info("%d assets: %d cooked, %d up to date, %d failed", int(jobs.size()), numCooked.load(), int(jobs.size()) - numCooked.load() - numFailed.load(), numFailed.load());
+	timer.PrintElapsedTime("Cooking finished in");
+
+	return numFailed.load() == 0 ? 0 : 2;
+}
@@ -6,6 +6,7 @@
 #include <string>
 #include <functional>
 #include <thread>
+#include <filesystem>
 #include "SDL.h"
 
 #include "graphics/GraphicsTypes.hpp"
@@ -102,7 +103,8 @@ int main(int argc, char** argv)
 
 	ShaderManager sm(gl, &fs);
 
-	if (!sm.Init()) {
+	// programs compile on the driver's threads while the scene loads
+	if (!sm.BeginInit()) {
         Info("Shader manager init failed !");
 		return 255;
 	}
@@ -112,10 +114,23 @@ int main(int argc, char** argv)
 	float Rl = .3f;
 	scene->SetDefaultLightRadius(Rl);
 
-	scene->LoadScene(fs.Resolve("test2.gltf"));
-	//scene->LoadScene(fs.Resolve("test2.gltf"));
+	// prefer the cooker output (cooker assets assets/cooked), fall back to the source asset
+	const String cookedScene = fs.Resolve("cooked/test2.jsb");
+	if (std::filesystem::exists(cookedScene))
+	{
+		scene->LoadScene(cookedScene);
+	}
+	else
+	{
+		scene->LoadScene(fs.Resolve("test2.gltf"));
+	}
 	scene->Compile();
 
+	if (!sm.EndInit()) {
+        Info("Shader manager init failed !");
+		return 255;
+	}
+
 
 	n = gl->GetCaps(GraphicsCaps_MaxTextureImageUnits);
 	Info("Max texture units: %d", n);
@@ -180,6 +195,7 @@ int main(int argc, char** argv)
 	float pitch = 0.f, yaw = -90.f;
 
 	bool srgb = true;
+	bool statsLog = false;
 
 	gl->SetBlendEnabled(false);
 	gl->SetBlendFunc(BlendFunc_SrcAlpha, BlendFunc_OneMinusSrcAlpha);
@@ -215,6 +231,13 @@ int main(int argc, char** argv)
 				srgb = !srgb;
 				gl->SetsRGBFrameBufferEnabled(srgb);
 			}
+
+			if (key.mKey == Key_P)
+			{
+				// draw calls and sampled animation tracks, logged about twice a second
+				statsLog = !statsLog;
+				scene->SetStatsLogInterval(statsLog ? 30 : 0);
+			}
 		}
 
 		if (input->IsKeyDown(Key_W))